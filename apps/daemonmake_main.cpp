@@ -1,4 +1,6 @@
+#include <chrono>
 #include <iostream>
+#include <string_view>
 
 #include "daemonmake/commands.hpp"
 
@@ -6,11 +8,63 @@ int main(int argc, char** argv) {
   using namespace daemonmake;
 
   if (argc < 2) {
-    std::cerr << "Usage: daemonmake <command> [root]\n";
+    std::cerr << "Usage: daemonmake <command> [root]\n"
+              << "       daemonmake why <file> [root]\n"
+              << "       daemonmake record <trace> [root]\n"
+              << "       daemonmake replay <trace> [--speed=<x>] "
+                 "[--debounce-ms=<ms>] [--build-ms=<ms>]\n";
     return 1;
   }
 
   std::string cmd{argv[1]};
+
+  if (cmd == "why") {
+    if (argc < 3) {
+      std::cerr << "Usage: daemonmake why <file> [root]\n";
+      return 1;
+    }
+    return run_why(argv[2], (argc >= 4) ? argv[3] : std::string{});
+  }
+
+  if (cmd == "record") {
+    if (argc < 3) {
+      std::cerr << "Usage: daemonmake record <trace> [root]\n";
+      return 1;
+    }
+    return run_record(argv[2], (argc >= 4) ? argv[3] : std::string{});
+  }
+
+  if (cmd == "replay") {
+    if (argc < 3) {
+      std::cerr << "Usage: daemonmake replay <trace> [--speed=<x>] "
+                   "[--debounce-ms=<ms>] [--build-ms=<ms>]\n";
+      return 1;
+    }
+    ReplayOptions options;
+    try {
+      for (int i{3}; i < argc; ++i) {
+        const std::string_view arg{argv[i]};
+        const auto value{std::string{arg.substr(arg.find('=') + 1)}};
+        if (arg.starts_with("--speed="))
+          options.speed = std::stod(value);
+        else if (arg.starts_with("--debounce-ms="))
+          options.debounce = std::chrono::milliseconds{std::stoll(value)};
+        else if (arg.starts_with("--build-ms="))
+          options.build_time = std::chrono::milliseconds{std::stoll(value)};
+        else
+          throw std::invalid_argument{std::string{arg}};
+      }
+    } catch (const std::exception&) {
+      std::cerr << "daemonmake replay: invalid options\n";
+      return 1;
+    }
+    if (options.speed <= 0) {
+      std::cerr << "daemonmake replay: --speed must be positive\n";
+      return 1;
+    }
+    return run_replay(argv[2], options);
+  }
+
   std::string root{(argc >= 3) ? argv[2] : std::string{}};
 
   if (cmd == "init") return run_init(root);
@@ -18,6 +72,7 @@ int main(int argc, char** argv) {
   if (cmd == "build") return run_build(root);
   if (cmd == "gencmake") return run_generate_cmake(root);
   if (cmd == "daemon") return run_daemon(root);
+  if (cmd == "profile") return run_profile(root);
 
   std::cerr << "Unknown command: " << cmd << std::endl;
   return 1;
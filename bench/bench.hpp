@@ -0,0 +1,63 @@
+#ifndef DAEMONMAKE__BENCH_BENCH
+#define DAEMONMAKE__BENCH_BENCH
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+namespace daemonmake::bench {
+
+using json = nlohmann::json;
+using clock = std::chrono::steady_clock;
+
+/**
+ * @return The median of a non-empty set of samples.
+ */
+inline double median(std::vector<double> samples) {
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                   samples.end());
+  return samples[samples.size() / 2];
+}
+
+/**
+ * Runs fn the given number of times and returns the median wall time of a
+ * single run in nanoseconds.
+ *
+ * @param iterations Number of timed runs.
+ * @param fn         The operation to time.
+ */
+template <typename Fn>
+double median_ns(int iterations, Fn&& fn) {
+  std::vector<double> samples;
+  samples.reserve(static_cast<std::size_t>(iterations));
+  for (int i{}; i < iterations; ++i) {
+    const auto start{clock::now()};
+    fn();
+    const auto stop{clock::now()};
+    samples.push_back(
+        std::chrono::duration<double, std::nano>(stop - start).count());
+  }
+  return median(std::move(samples));
+}
+
+/**
+ * Prints one result as a JSON line on stdout.
+ *
+ * @param record Must contain at least a "bench" name.
+ */
+inline void report(const json& record) { std::cout << record.dump() << '\n'; }
+
+/**
+ * Keeps the optimiser from discarding a computed value.
+ */
+template <typename T>
+void do_not_optimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}  // namespace daemonmake::bench
+
+#endif
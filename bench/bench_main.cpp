@@ -0,0 +1,37 @@
+#include <iostream>
+#include <string_view>
+
+namespace daemonmake::bench {
+
+void run_build_queue_benchmarks();
+void run_file_watcher_benchmarks();
+void run_latency_benchmarks();
+void run_link_profile_benchmarks();
+void run_logger_benchmarks();
+void run_project_benchmarks();
+void run_target_graph_benchmarks();
+
+}  // namespace daemonmake::bench
+
+// Prints one JSON object per line so results can be diffed and tracked.
+// An optional argument restricts the run to suites whose name contains it.
+int main(int argc, char** argv) {
+  using namespace daemonmake::bench;
+
+  const std::string_view filter{argc >= 2 ? argv[1] : ""};
+  const auto wanted{[&](std::string_view suite) {
+    return filter.empty() || suite.find(filter) != std::string_view::npos;
+  }};
+
+  if (wanted("project")) run_project_benchmarks();
+  if (wanted("target_graph")) run_target_graph_benchmarks();
+  if (wanted("build_queue")) run_build_queue_benchmarks();
+  if (wanted("file_watcher")) run_file_watcher_benchmarks();
+  if (wanted("logger")) run_logger_benchmarks();
+  // Builds real projects and takes minutes, so it only runs when asked for.
+  if (filter == "link_profile") run_link_profile_benchmarks();
+  // Drives a live daemon against a stub cmake and waits out every debounce.
+  if (filter == "latency") run_latency_benchmarks();
+
+  return 0;
+}
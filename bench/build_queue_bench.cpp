@@ -0,0 +1,64 @@
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "daemonmake/build_queue.hpp"
+
+namespace daemonmake::bench {
+
+namespace {
+
+std::vector<FileEvent> make_events(std::size_t count, std::size_t unique_paths) {
+  std::vector<FileEvent> events;
+  events.reserve(count);
+  for (std::size_t i{}; i < count; ++i) {
+    events.push_back({"/project/src/lib" + std::to_string(i % unique_paths % 50) +
+                          "/file" + std::to_string(i % unique_paths) + ".cpp",
+                      FileEventType::Modified});
+  }
+  return events;
+}
+
+}  // namespace
+
+void run_build_queue_benchmarks() {
+  for (const std::size_t count : {1'000, 10'000, 100'000}) {
+    // Editor save bursts touch the same few files repeatedly; checkouts
+    // touch many files once.
+    for (const std::size_t unique_paths : {std::size_t{16}, count}) {
+      const auto events{make_events(count, unique_paths)};
+
+      const double push_ns{median_ns(5, [&] {
+        BuildQueue queue{count};
+        for (const auto& event : events) queue.push_event(event);
+      })};
+
+      // Shutting down first makes pop skip the debounce wait, so only the
+      // hand-off of the coalesced batch is measured.
+      std::size_t batch{};
+      std::vector<double> pop_samples;
+      for (int i{}; i < 5; ++i) {
+        BuildQueue queue{count};
+        for (const auto& event : events) queue.push_event(event);
+        queue.shutdown();
+
+        const auto start{clock::now()};
+        batch = queue.pop_all_events(std::stop_token{}).events.size();
+        pop_samples.push_back(
+            std::chrono::duration<double, std::nano>(clock::now() - start)
+                .count());
+      }
+      const double pop_ns{median(std::move(pop_samples))};
+
+      report({{"bench", "build_queue"},
+              {"events", count},
+              {"unique_paths", unique_paths},
+              {"push_ns_per_event", push_ns / static_cast<double>(count)},
+              {"pop_ns", pop_ns},
+              {"batch", batch}});
+    }
+  }
+}
+
+}  // namespace daemonmake::bench
@@ -0,0 +1,110 @@
+#include <ctime>
+#include <fstream>
+#include <string>
+
+#include "bench.hpp"
+#include "daemonmake/file_watcher.hpp"
+#include "daemonmake/polling_watcher.hpp"
+#include "daemonmake/project.hpp"
+#include "project_generator.hpp"
+
+namespace daemonmake::bench {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::size_t max_touched_files{2'000};
+
+constexpr std::chrono::seconds idle_poll_time{3};
+
+double process_cpu_ns() {
+  timespec ts{};
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) * 1e9 + static_cast<double>(ts.tv_nsec);
+}
+
+void bench_polling(std::string_view size, const Config& cfg,
+                   const TreeScan& scan) {
+  const double setup_ns{median_ns(3, [&] {
+    const PollingWatcher watcher{cfg.project_root, scan};
+  })};
+
+  // Every directory due on every call, without a budget: one full pass.
+  const PollingOptions eager{.hot_interval{},
+                                      .cold_interval{},
+                                      .stats_per_second = SIZE_MAX};
+  PollingWatcher full{cfg.project_root, scan, eager};
+  full.wait_for_events();
+  const double pass_ns{median_ns(5, [&] { full.wait_for_events(); })};
+
+  // Default intervals on an idle tree: what the daemon pays to stand by.
+  PollingWatcher idle{cfg.project_root, scan};
+  const auto cpu_start{process_cpu_ns()};
+  const auto start{clock::now()};
+  while (clock::now() - start < idle_poll_time) idle.wait_for_events();
+  const double wall_ns{
+      std::chrono::duration<double, std::nano>(clock::now() - start).count()};
+
+  report({{"bench", "polling_watcher"},
+          {"size", size},
+          {"files", full.file_count()},
+          {"setup_ns", setup_ns},
+          {"index_bytes", full.memory_usage()},
+          {"pass_ns_per_file",
+           pass_ns / static_cast<double>(std::max<std::size_t>(
+                         full.file_count(), 1))},
+          {"idle_cpu_fraction", (process_cpu_ns() - cpu_start) / wall_ns}});
+}
+
+void bench_watcher(const fs::path& workspace, std::string_view size,
+                   const ProjectSpec& spec) {
+  const auto root{workspace / std::string{size} / "bench_project"};
+  generate_project(root, spec);
+  const auto cfg{make_default_config(root)};
+  const auto scan{walk_trees(cfg.project_root, project_tree_roots(cfg))};
+
+  const double setup_ns{median_ns(3, [&] {
+    const FileWatcher watcher{cfg.project_root, scan};
+  })};
+
+  FileWatcher watcher{cfg.project_root, scan};
+  const auto touched{std::min(max_touched_files, scan.files.size())};
+  for (std::size_t i{}; i < touched; ++i)
+    std::ofstream{cfg.project_root / scan.files[i], std::ios::app} << ' ';
+
+  // The events are already queued in the kernel; this times reading and
+  // decoding them into FileEvents.
+  std::size_t received{};
+  const auto start{clock::now()};
+  const auto give_up{start + std::chrono::seconds{5}};
+  while (received < touched && clock::now() < give_up)
+    received += watcher.wait_for_events().size();
+  const double drain_ns{
+      std::chrono::duration<double, std::nano>(clock::now() - start).count()};
+
+  report({{"bench", "file_watcher"},
+          {"size", size},
+          {"directories", scan.directories.size()},
+          {"setup_ns", setup_ns},
+          {"events", received},
+          {"decode_ns_per_event",
+           received ? drain_ns / static_cast<double>(received) : 0.0}});
+
+  bench_polling(size, cfg, scan);
+}
+
+}  // namespace
+
+void run_file_watcher_benchmarks() {
+  const auto workspace{make_workspace("file_watcher_bench")};
+
+  bench_watcher(workspace, "small", small_project);
+  bench_watcher(workspace, "medium", medium_project);
+  bench_watcher(workspace, "large", large_project);
+
+  std::error_code ec;
+  fs::remove_all(workspace, ec);
+}
+
+}  // namespace daemonmake::bench
@@ -0,0 +1,284 @@
+#include <stdlib.h>
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "daemonmake/config.hpp"
+#include "daemonmake/daemon.hpp"
+#include "daemonmake/logger.hpp"
+#include "project_generator.hpp"
+
+namespace daemonmake::bench {
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+namespace {
+
+// The stub's clock is `date +%s%N`, so edits are stamped on the same one.
+using wall_clock = std::chrono::system_clock;
+
+// How long to wait after the last edit before a storm is considered
+// settled. Must exceed the build queue's debounce window.
+constexpr auto settle_after_edit{2000ms};
+constexpr auto settle_after_invocation{500ms};
+constexpr auto settle_timeout{60s};
+
+constexpr int build_durations_ms[]{100, 1000};
+
+std::int64_t wall_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             wall_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * A cmake replacement that appends "start|end <ns> <args>" to a log for
+ * every invocation and sleeps during `cmake --build`.
+ */
+fs::path write_cmake_stub(const fs::path& dir, const fs::path& log,
+                          int build_ms) {
+  fs::create_directories(dir);
+  const auto stub{dir / "cmake"};
+  {
+    std::ofstream out{stub};
+    out << "#!/bin/sh\n"
+        << "echo \"start $(date +%s%N) $*\" >> '" << log.string() << "'\n"
+        << "if [ \"$1\" = --build ]; then sleep " << build_ms / 1000 << '.'
+        << std::to_string(1000 + build_ms % 1000).substr(1) << "; fi\n"
+        << "echo \"end $(date +%s%N) $*\" >> '" << log.string() << "'\n";
+  }
+  fs::permissions(stub, fs::perms::owner_all, fs::perm_options::add);
+  return stub;
+}
+
+struct Invocation {
+  bool start{};
+  std::int64_t ns{};
+  bool build_step{};  // `cmake --build` rather than configure
+};
+
+std::vector<Invocation> read_log(const fs::path& log) {
+  std::vector<Invocation> invocations;
+  std::ifstream in{log};
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields{line};
+    std::string phase;
+    std::string first_arg;
+    Invocation invocation;
+    fields >> phase >> invocation.ns >> first_arg;
+    invocation.start = phase == "start";
+    invocation.build_step = first_arg == "--build";
+    invocations.push_back(invocation);
+  }
+  return invocations;
+}
+
+/**
+ * Drives the project tree and watches the stub's log.
+ */
+class Harness {
+ public:
+  Harness(fs::path root, fs::path log)
+      : root_{std::move(root)}, log_{std::move(log)} {}
+
+  void touch(const std::string& rel) {
+    std::ofstream{root_ / rel, std::ios::app} << "// edit " << ++edits_ << '\n';
+    stamp_edit();
+  }
+
+  // What editors that never write in place do: write a sibling, then
+  // rename it over the original.
+  void atomic_save(const std::string& rel) {
+    const auto target{root_ / rel};
+    const auto temp{fs::path{target} += ".tmp"};
+    fs::copy_file(target, temp, fs::copy_options::overwrite_existing);
+    std::ofstream{temp, std::ios::app} << "// edit " << ++edits_ << '\n';
+    fs::rename(temp, target);
+    stamp_edit();
+  }
+
+  void create(const std::string& rel) {
+    std::ofstream{root_ / rel} << "#pragma once\n";
+    stamp_edit();
+  }
+
+  void remove(const std::string& rel) {
+    fs::remove(root_ / rel);
+    stamp_edit();
+  }
+
+  // Blocks until a `cmake --build` is running.
+  bool wait_for_build_in_flight() {
+    const auto deadline{clock::now() + settle_timeout};
+    while (clock::now() < deadline) {
+      int running{};
+      for (const auto& invocation : read_log(log_)) {
+        if (invocation.build_step) running += invocation.start ? 1 : -1;
+      }
+      if (running > 0) return true;
+      std::this_thread::sleep_for(5ms);
+    }
+    return false;
+  }
+
+  /**
+   * Waits for the daemon to go quiet, then summarises the builds the
+   * storm caused and clears the log for the next one.
+   */
+  json finish(std::string_view scenario) {
+    const auto last_edit{last_edit_steady_};
+    auto deadline{clock::now() + settle_timeout};
+    std::vector<Invocation> invocations;
+    while (clock::now() < deadline) {
+      invocations = read_log(log_);
+      int running{};
+      for (const auto& invocation : invocations)
+        running += invocation.start ? 1 : -1;
+      const auto last_activity{
+          invocations.empty() ? std::int64_t{} : invocations.back().ns};
+      const auto idle{std::chrono::nanoseconds{wall_ns() - last_activity}};
+      if (running == 0 && clock::now() - last_edit >= settle_after_edit &&
+          idle >= settle_after_invocation)
+        break;
+      std::this_thread::sleep_for(20ms);
+    }
+
+    // A build begins with its configure step.
+    std::vector<std::int64_t> build_starts;
+    for (const auto& invocation : invocations) {
+      if (invocation.start && !invocation.build_step)
+        build_starts.push_back(invocation.ns);
+    }
+
+    // Builds that began before the storm ended are superseded by a later
+    // one, so their work is thrown away.
+    std::size_t wasted{};
+    for (const auto start : build_starts) {
+      if (start < last_edit_ns_) ++wasted;
+    }
+
+    json record{{"bench", "latency"},
+                {"scenario", scenario},
+                {"edits", edit_count_},
+                {"builds", build_starts.size()},
+                {"wasted_builds", wasted}};
+    if (!build_starts.empty()) {
+      record["first_save_to_build_ms"] =
+          (build_starts.front() - *first_edit_ns_) / 1e6;
+      record["last_save_to_build_ms"] =
+          (build_starts.back() - last_edit_ns_) / 1e6;
+    }
+    if (clock::now() >= deadline) record["timed_out"] = true;
+
+    std::ofstream{log_, std::ios::trunc};
+    edit_count_ = 0;
+    first_edit_ns_.reset();
+    return record;
+  }
+
+ private:
+  void stamp_edit() {
+    last_edit_ns_ = wall_ns();
+    last_edit_steady_ = clock::now();
+    if (!first_edit_ns_) first_edit_ns_ = last_edit_ns_;
+    ++edit_count_;
+  }
+
+  fs::path root_;
+  fs::path log_;
+  std::size_t edits_{};
+  std::size_t edit_count_{};
+  std::optional<std::int64_t> first_edit_ns_;
+  std::int64_t last_edit_ns_{};
+  clock::time_point last_edit_steady_{};
+};
+
+void bench_build_duration(const fs::path& workspace, int build_ms) {
+  const auto root{workspace / ("build_" + std::to_string(build_ms) + "ms") /
+                  "bench_project"};
+  generate_project(root, small_project);
+
+  const auto log{root.parent_path() / "cmake.log"};
+  const auto stub_dir{root.parent_path() / "stub"};
+  write_cmake_stub(stub_dir, log, build_ms);
+  std::ofstream{log};
+
+  const std::string old_path{::getenv("PATH") ? ::getenv("PATH") : ""};
+  ::setenv("PATH", (stub_dir.string() + ":" + old_path).c_str(), 1);
+
+  // Keeps the daemon's progress messages out of the JSON output.
+  set_log_level(LogLevel::Warning);
+
+  std::vector<json> records;
+  {
+    Harness harness{root, log};
+    Daemon daemon{make_default_config(root)};
+    daemon.run();
+    // Lets the watcher register its directories.
+    std::this_thread::sleep_for(500ms);
+
+    // The first build also configures from scratch; leave it out.
+    harness.touch(std::string{leaf_source});
+    harness.finish("warmup");
+
+    harness.touch(std::string{leaf_source});
+    records.push_back(harness.finish("single_save"));
+
+    harness.atomic_save(std::string{leaf_source});
+    records.push_back(harness.finish("atomic_save"));
+
+    // A branch switch: many rewrites with a few files added and removed,
+    // landing in waves as git works through the index.
+    for (std::size_t wave{}; wave < 3; ++wave) {
+      for (std::size_t lib{}; lib < small_project.libraries; ++lib) {
+        for (std::size_t f{}; f < small_project.files_per_library; ++f) {
+          harness.touch("src/lib" + std::to_string(lib) + "/f" +
+                        std::to_string(f) + ".cpp");
+        }
+      }
+      harness.create("include/bench_project/lib" + std::to_string(wave) +
+                     "/checkout.hpp");
+      std::this_thread::sleep_for(50ms);
+    }
+    for (std::size_t wave{}; wave < 3; ++wave) {
+      harness.remove("include/bench_project/lib" + std::to_string(wave) +
+                     "/checkout.hpp");
+    }
+    records.push_back(harness.finish("checkout_burst"));
+
+    harness.touch(std::string{leaf_source});
+    if (harness.wait_for_build_in_flight())
+      harness.touch(std::string{leaf_source});
+    records.push_back(harness.finish("mid_build_edit"));
+
+    daemon.stop();
+  }
+
+  set_log_level(LogLevel::Info);
+  ::setenv("PATH", old_path.c_str(), 1);
+
+  for (auto& record : records) {
+    record["stub_build_ms"] = build_ms;
+    record["files"] = file_count(small_project);
+    report(record);
+  }
+}
+
+}  // namespace
+
+void run_latency_benchmarks() {
+  const auto workspace{make_workspace("latency")};
+  for (const auto build_ms : build_durations_ms)
+    bench_build_duration(workspace, build_ms);
+  fs::remove_all(workspace);
+}
+
+}  // namespace daemonmake::bench
@@ -0,0 +1,113 @@
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "bench.hpp"
+#include "daemonmake/cmake_builder.hpp"
+#include "daemonmake/project.hpp"
+#include "daemonmake/subprocess.hpp"
+#include "project_generator.hpp"
+
+namespace daemonmake::bench {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int incremental_iterations{3};
+
+// Builds quietly; the JSON lines on stdout stay parseable.
+bool run_quiet(const std::vector<std::string>& argv) {
+  std::string output;
+  return run_subprocess_capture(argv, output) == 0;
+}
+
+// The linker the dev-fast probes settled on, read back from the cache.
+std::string chosen_linker(const fs::path& build_dir) {
+  std::ifstream cache{build_dir / "CMakeCache.txt"};
+  std::string line;
+  std::string linker{"default"};
+  while (std::getline(cache, line)) {
+    for (const std::string_view candidate : {"lld", "mold"}) {
+      if (line == "DAEMONMAKE_HAVE_LD_" + std::string{candidate} + ":INTERNAL=1")
+        linker = candidate;
+    }
+  }
+  return linker;
+}
+
+void bench_profile(const fs::path& workspace, const ProjectSpec& spec,
+                   std::string_view profile, bool incremental_link_flags) {
+  const auto variant{std::string{profile} +
+                     (incremental_link_flags ? "-incremental" : "")};
+  const auto root{workspace / variant / "bench_project"};
+  generate_project(root, spec);
+
+  auto cfg{make_default_config(root)};
+  cfg.build_profile = profile;
+  cfg.incremental_link_flags = incremental_link_flags;
+
+  auto pl{make_project_layout(cfg.project_root)};
+  discover_targets(cfg, pl);
+  infer_target_dependencies(pl);
+  write_cmakelists(cfg, pl, true);
+
+  json record{{"bench", "link_profile"},
+              {"profile", profile},
+              {"incremental_link_flags", incremental_link_flags},
+              {"libraries", spec.libraries},
+              {"apps", spec.apps}};
+
+  const std::string build_dir{cfg.build_directory.string()};
+  const auto jobs{std::to_string(std::max(1L, ::sysconf(_SC_NPROCESSORS_ONLN)))};
+  const std::vector<std::string> build_cmd{"cmake", "--build", build_dir,
+                                           "-j", jobs};
+
+  bool ok{run_quiet({"cmake", "-S", cfg.project_root.string(), "-B",
+                     build_dir, "-DCMAKE_BUILD_TYPE=Debug"})};
+  const auto start{clock::now()};
+  ok = ok && run_quiet(build_cmd);
+  record["full_build_ns"] =
+      std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+  record["linker"] = chosen_linker(cfg.build_directory);
+
+  if (!ok) {
+    record["skipped"] = "cmake configure or build failed";
+    report(record);
+    return;
+  }
+
+  // An edit to the leaf library recompiles one file and relinks everything
+  // above it, which is the cycle the profile is meant to speed up.
+  const auto leaf{cfg.project_root / leaf_source};
+  record["incremental_ns"] = median_ns(incremental_iterations, [&] {
+    fs::last_write_time(leaf, fs::file_time_type::clock::now());
+    ok = run_quiet(build_cmd) && ok;
+  });
+  if (!ok) record["skipped"] = "incremental rebuild failed";
+  report(record);
+}
+
+}  // namespace
+
+void run_link_profile_benchmarks() {
+  if (!run_quiet({"cmake", "--version"})) {
+    report({{"bench", "link_profile"}, {"skipped", "cmake not found"}});
+    return;
+  }
+
+  const auto workspace{make_workspace("link_profile")};
+  const ProjectSpec spec{.libraries = 30, .files_per_library = 6, .apps = 20};
+
+  bench_profile(workspace, spec, build_profile_default, false);
+  bench_profile(workspace, spec, build_profile_dev_fast, false);
+  bench_profile(workspace, spec, build_profile_dev_fast, true);
+
+  std::error_code ec;
+  fs::remove_all(workspace, ec);
+}
+
+}  // namespace daemonmake::bench
@@ -0,0 +1,74 @@
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "daemonmake/logger.hpp"
+
+namespace daemonmake::bench {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Median per-record cost seen by the calling threads, with every thread
+// logging bursts of records at once. Between bursts, each thread
+// optionally drains the rings itself, so the next burst starts empty.
+double log_ns_per_record(std::size_t threads, int bursts, std::size_t records,
+                         bool drain_between) {
+  std::vector<std::vector<double>> samples(threads);
+  {
+    std::vector<std::jthread> workers;
+    for (std::size_t t{}; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        for (int burst{}; burst < bursts; ++burst) {
+          const auto start{clock::now()};
+          for (std::size_t i{}; i < records; ++i)
+            log_debug("Built {target} in {duration_ms} ms",
+                      {{"target", "lib"}, {"task", i}, {"thread", t},
+                       {"duration_ms", std::chrono::microseconds{1500}}});
+          samples[t].push_back(
+              std::chrono::duration<double, std::nano>(clock::now() - start)
+                  .count() /
+              static_cast<double>(records));
+          if (drain_between) flush_log();
+        }
+      });
+    }
+  }
+  std::vector<double> all;
+  for (const auto& thread_samples : samples)
+    all.insert(all.end(), thread_samples.begin(), thread_samples.end());
+  return median(std::move(all));
+}
+
+}  // namespace
+
+void run_logger_benchmarks() {
+  const auto log_file{fs::temp_directory_path() / "daemonmake_logger_bench" /
+                      "log.jsonl"};
+
+  for (const std::size_t threads : {1, 4}) {
+    configure_logging({LogLevel::Info, log_file, false});
+    const double disabled_ns{log_ns_per_record(threads, 5, 100'000, false)};
+
+    configure_logging({LogLevel::Debug, log_file, false});
+    // Bursts that fit in the per-thread rings measure what the caller pays.
+    const double enqueue_ns{log_ns_per_record(threads, 50, 100, true)};
+    // Longer runs are bound by how fast the flusher formats and writes.
+    const double sustained_ns{log_ns_per_record(threads, 3, 20'000, false)};
+    flush_log();
+
+    report({{"bench", "logger"},
+            {"threads", threads},
+            {"disabled_ns_per_record", disabled_ns},
+            {"enqueue_ns_per_record", enqueue_ns},
+            {"sustained_ns_per_record", sustained_ns}});
+  }
+
+  configure_logging({});
+  fs::remove_all(log_file.parent_path());
+}
+
+}  // namespace daemonmake::bench
@@ -0,0 +1,118 @@
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+
+#include "bench.hpp"
+#include "daemonmake/cmake_builder.hpp"
+#include "daemonmake/compact_layout.hpp"
+#include "daemonmake/layout_patch.hpp"
+#include "daemonmake/layout_snapshot.hpp"
+#include "daemonmake/project.hpp"
+#include "daemonmake/target_graph.hpp"
+#include "project_generator.hpp"
+
+namespace daemonmake::bench {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int iterations{5};
+
+void bench_project(const fs::path& workspace, std::string_view size,
+                   const ProjectSpec& spec) {
+  const auto root{workspace / std::string{size} / "bench_project"};
+  generate_project(root, spec);
+  const auto cfg{make_default_config(root)};
+
+  const auto record{[&](std::string_view bench, double ns) {
+    report({{"bench", bench},
+            {"size", size},
+            {"files", file_count(spec)},
+            {"libraries", spec.libraries},
+            {"median_ns", ns}});
+  }};
+
+  TreeScan scan;
+  record("walk_trees", median_ns(iterations, [&] {
+           scan = walk_trees(cfg.project_root, project_tree_roots(cfg));
+         }));
+
+  auto pl{make_project_layout(cfg.project_root)};
+  record("discover_targets", median_ns(iterations, [&] {
+           discover_targets(cfg, pl);
+         }));
+  record("discover_targets_from_scan", median_ns(iterations, [&] {
+           discover_targets(cfg, pl, scan);
+         }));
+
+  // Inference overwrites the dependency lists in place, so every run sees
+  // the same input.
+  record("infer_target_dependencies_cold", median_ns(iterations, [&] {
+           infer_target_dependencies(pl);
+         }));
+  IncludeCache cache;
+  infer_target_dependencies(pl, {}, &cache);
+  record("infer_target_dependencies_warm", median_ns(iterations, [&] {
+           infer_target_dependencies(pl, {}, &cache);
+         }));
+  record("infer_target_dependencies_preamble", median_ns(iterations, [&] {
+           infer_target_dependencies(pl, {.stop_after_preamble = true});
+         }));
+
+  record("target_graph_from_layout", median_ns(iterations, [&] {
+           const TargetGraph graph{pl};
+           do_not_optimize(graph.size());
+         }));
+  record("compact_layout", median_ns(iterations, [&] {
+           const CompactLayout layout{pl, std::make_shared<PathTable>()};
+           do_not_optimize(layout.targets().size());
+         }));
+
+  record("write_cmakelists", median_ns(iterations, [&] {
+           write_cmakelists(cfg, pl, true);
+         }));
+
+  const auto snapshot_path{root / layout_snapshot_default_location};
+  record("layout_snapshot_save", median_ns(iterations, [&] {
+           save_layout_snapshot(snapshot_path, cfg, pl, scan, cache);
+         }));
+  record("layout_snapshot_load", median_ns(iterations, [&] {
+           const auto snapshot{load_layout_snapshot(snapshot_path, cfg)};
+           do_not_optimize(snapshot.has_value());
+         }));
+
+  // One source file appearing in a library and going again, as the daemon
+  // applies them without rediscovering.
+  const CompactLayout layout{pl, std::make_shared<PathTable>()};
+  const auto added{
+      (fs::path{pl.targets.front().source_files.front()}.parent_path() /
+       "bench_added.cpp")
+          .generic_string()};
+  std::ofstream{root / added} << "int bench_added() { return 0; }\n";
+  std::optional<LayoutPatch> patch;
+  record("patch_layout_add_source", median_ns(iterations, [&] {
+           patch = patch_layout(cfg, layout, {added}, cache);
+         }));
+  fs::remove(root / added);
+  record("patch_layout_remove_source", median_ns(iterations, [&] {
+           const auto removed{patch_layout(cfg, patch->layout, {added}, cache)};
+           do_not_optimize(removed.has_value());
+         }));
+}
+
+}  // namespace
+
+void run_project_benchmarks() {
+  const auto workspace{make_workspace("project_bench")};
+
+  bench_project(workspace, "small", small_project);
+  bench_project(workspace, "medium", medium_project);
+  bench_project(workspace, "large", large_project);
+
+  std::error_code ec;
+  fs::remove_all(workspace, ec);
+}
+
+}  // namespace daemonmake::bench
@@ -0,0 +1,86 @@
+#include "project_generator.hpp"
+
+#include <unistd.h>
+
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+namespace daemonmake::bench {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void write_file(const fs::path& path, const std::string& contents) {
+  fs::create_directories(path.parent_path());
+  std::ofstream out{path};
+  out << contents;
+  if (!out) throw std::runtime_error("Failed to write " + path.string());
+}
+
+std::string lib_name(std::size_t i) { return "lib" + std::to_string(i); }
+
+std::string function_name(std::size_t lib, std::size_t file) {
+  return lib_name(lib) + "_f" + std::to_string(file);
+}
+
+}  // namespace
+
+fs::path make_workspace(std::string_view suite) {
+  const auto dir{fs::temp_directory_path() /
+                 ("daemonmake_" + std::string{suite} + "_" +
+                  std::to_string(::getpid()))};
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  return dir;
+}
+
+void generate_project(const fs::path& root, const ProjectSpec& spec) {
+  const auto name{root.filename().string()};
+  fs::remove_all(root);
+
+  std::mt19937 rng{42};
+  std::vector<std::set<std::size_t>> deps(spec.libraries);
+  for (std::size_t i{1}; i < spec.libraries; ++i) {
+    deps[i].insert(i - 1);  // Keeps every library above lib0.
+    std::uniform_int_distribution<std::size_t> pick{0, i - 1};
+    while (deps[i].size() < std::min(spec.fan_out, i)) deps[i].insert(pick(rng));
+  }
+
+  for (std::size_t lib{}; lib < spec.libraries; ++lib) {
+    for (std::size_t file{}; file < spec.files_per_library; ++file) {
+      const auto fn{function_name(lib, file)};
+      const auto header{name + "/" + lib_name(lib) + "/f" +
+                        std::to_string(file) + ".hpp"};
+
+      write_file(root / "include" / header,
+                 "#pragma once\n\nint " + fn + "(int x);\n");
+
+      std::string src{"#include <" + header + ">\n"};
+      for (const auto dep : deps[lib])
+        src += "#include <" + name + "/" + lib_name(dep) + "/f0.hpp>\n";
+      src += "\nint " + fn + "(int x) {\n  int r{x * " +
+             std::to_string(lib + file + 1) + "};\n";
+      for (const auto dep : deps[lib])
+        src += "  r += " + function_name(dep, 0) + "(x - 1);\n";
+      src += "  return r;\n}\n";
+      write_file(root / "src" / lib_name(lib) /
+                     ("f" + std::to_string(file) + ".cpp"),
+                 src);
+    }
+  }
+
+  for (std::size_t app{}; app < spec.apps; ++app) {
+    const auto lib{spec.libraries - 1 - app % spec.libraries};
+    write_file(root / "apps" / ("app" + std::to_string(app) + ".cpp"),
+               "#include <" + name + "/" + lib_name(lib) +
+                   "/f0.hpp>\n\nint main(int argc, char**) {\n  return " +
+                   function_name(lib, 0) + "(argc) == 0;\n}\n");
+  }
+}
+
+}  // namespace daemonmake::bench
@@ -0,0 +1,70 @@
+#ifndef DAEMONMAKE__BENCH_PROJECT_GENERATOR
+#define DAEMONMAKE__BENCH_PROJECT_GENERATOR
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+namespace daemonmake::bench {
+
+/**
+ * Shape of a generated project.
+ */
+struct ProjectSpec {
+  std::size_t libraries{20};
+  std::size_t files_per_library{5};
+  std::size_t apps{10};
+  // Each library depends on up to this many lower-numbered libraries.
+  std::size_t fan_out{3};
+};
+
+/**
+ * Writes a compilable project following daemonmake's conventions:
+ * src/lib<i>/, include/<name>/lib<i>/ and one apps/app<k>.cpp per app.
+ *
+ * Library dependencies are expressed as includes, so discovery and
+ * inference recover them. Apps depend on the highest-numbered libraries,
+ * and every library reaches lib0, which makes lib0 the leaf whose edit
+ * fans out the furthest. The layout is deterministic for a given spec.
+ *
+ * @param root Directory to create; its name becomes the project name.
+ * @param spec Project shape.
+ */
+void generate_project(const std::filesystem::path& root, const ProjectSpec& spec);
+
+/**
+ * Creates an empty scratch directory under the system temp directory.
+ *
+ * @param suite Used in the directory name.
+ */
+std::filesystem::path make_workspace(std::string_view suite);
+
+/**
+ * Project sizes shared by the suites that scale with the tree.
+ */
+inline constexpr ProjectSpec small_project{.libraries = 10,
+                                           .files_per_library = 10,
+                                           .apps = 5,
+                                           .fan_out = 3};
+inline constexpr ProjectSpec medium_project{.libraries = 50,
+                                            .files_per_library = 40,
+                                            .apps = 20,
+                                            .fan_out = 4};
+inline constexpr ProjectSpec large_project{.libraries = 200,
+                                           .files_per_library = 50,
+                                           .apps = 50,
+                                           .fan_out = 6};
+
+/**
+ * @return Number of .cpp and .hpp files generate_project() writes.
+ */
+inline std::size_t file_count(const ProjectSpec& spec) {
+  return 2 * spec.libraries * spec.files_per_library + spec.apps;
+}
+
+// A source file in the leaf library, relative to the project root.
+inline constexpr std::string_view leaf_source{"src/lib0/f0.cpp"};
+
+}  // namespace daemonmake::bench
+
+#endif
@@ -0,0 +1,69 @@
+#include <random>
+#include <string>
+
+#include "bench.hpp"
+#include "daemonmake/target_graph.hpp"
+
+namespace daemonmake::bench {
+
+namespace {
+
+// A layered DAG: every target depends on up to fan_out earlier targets.
+ProjectLayout make_synthetic_layout(std::size_t num_targets,
+                                    std::size_t fan_out) {
+  std::mt19937 rng{42};
+  ProjectLayout pl{"bench", "/nonexistent", {}};
+  pl.targets.reserve(num_targets);
+
+  for (std::size_t i{}; i < num_targets; ++i) {
+    Target target{"t" + std::to_string(i), TargetType::Library, {}, {}, {}};
+    if (i > 0) {
+      std::uniform_int_distribution<std::size_t> pick{0, i - 1};
+      for (std::size_t d{}; d < fan_out; ++d)
+        target.dependencies.push_back("t" + std::to_string(pick(rng)));
+    }
+    pl.targets.push_back(std::move(target));
+  }
+
+  return pl;
+}
+
+}  // namespace
+
+void run_target_graph_benchmarks() {
+  for (const std::size_t num_targets : {100, 1'000, 10'000, 20'000}) {
+    const auto pl{make_synthetic_layout(num_targets, 4)};
+
+    TargetGraph graph;
+    const double build_ns{median_ns(num_targets >= 10'000 ? 3 : 10, [&] {
+      graph = TargetGraph{pl};
+    })};
+    report({{"bench", "target_graph_build"},
+            {"targets", num_targets},
+            {"median_ns", build_ns},
+            {"memory_bytes", graph.memory_usage()},
+            {"cyclic", graph.cyclic_targets().size()}});
+
+    std::mt19937 rng{7};
+    std::uniform_int_distribution<TargetId> pick{
+        0, static_cast<TargetId>(num_targets - 1)};
+    for (const std::size_t batch : {1, 16, 256}) {
+      std::vector<TargetId> changed(batch);
+      for (auto& id : changed) id = pick(rng);
+
+      std::size_t affected{};
+      const double query_ns{median_ns(101, [&] {
+        const auto set{graph.affected(changed)};
+        affected = set.count();
+        do_not_optimize(affected);
+      })};
+      report({{"bench", "target_graph_affected"},
+              {"targets", num_targets},
+              {"batch", batch},
+              {"median_ns", query_ns},
+              {"affected", affected}});
+    }
+  }
+}
+
+}  // namespace daemonmake::bench
@@ -0,0 +1,104 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_BINARY_IO
+#define DAEMONMAKE__DAEMONMAKE_BINARY_IO
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace daemonmake {
+
+/**
+ * Helpers shared by the on-disk caches in .daemonmake/.
+ *
+ * Files are written in host byte order; every format carries a magic and a
+ * version so a file from another build is rejected rather than misread.
+ */
+
+template <typename T>
+void write_pod(std::ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void write_array(std::ostream& out, const std::vector<T>& values) {
+  out.write(reinterpret_cast<const char*>(values.data()),
+            static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+/**
+ * Writes a length-prefixed string.
+ */
+inline void write_string(std::ostream& out, std::string_view value) {
+  write_pod(out, static_cast<std::uint32_t>(value.size()));
+  out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+/**
+ * Writes a file through a temporary sibling and renames it into place, so
+ * readers never observe a half-written file.
+ *
+ * @param file_path The destination.
+ * @param write     Fills the stream.
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void write_file_atomically(const std::filesystem::path& file_path,
+                           const std::function<void(std::ostream&)>& write);
+
+/**
+ * Bounds-checked cursor over a loaded file. Reads past the end yield
+ * zero values and clear ok instead of throwing.
+ */
+struct BinaryReader {
+  std::string_view data;
+  bool ok{true};
+
+  template <typename T>
+  T pod() {
+    T value{};
+    if (data.size() < sizeof(T)) {
+      ok = false;
+      return value;
+    }
+    std::memcpy(&value, data.data(), sizeof(T));
+    data.remove_prefix(sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  std::vector<T> array(std::size_t count) {
+    if (data.size() / sizeof(T) < count) {
+      ok = false;
+      return {};
+    }
+    std::vector<T> values(count);
+    std::memcpy(values.data(), data.data(), count * sizeof(T));
+    data.remove_prefix(count * sizeof(T));
+    return values;
+  }
+
+  /**
+   * Reads raw bytes. The view points into the file.
+   */
+  std::string_view bytes(std::size_t count) {
+    if (!ok || data.size() < count) {
+      ok = false;
+      return {};
+    }
+    const auto value{data.substr(0, count)};
+    data.remove_prefix(count);
+    return value;
+  }
+
+  /**
+   * Reads a length-prefixed string. The view points into the file.
+   */
+  std::string_view string() { return bytes(pod<std::uint32_t>()); }
+};
+
+}  // namespace daemonmake
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_BUILD_BACKEND
+#define DAEMONMAKE__DAEMONMAKE_BUILD_BACKEND
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "daemonmake/config.hpp"
+
+namespace daemonmake {
+
+/**
+ * What to build.
+ */
+struct BuildRequest {
+  // CMake target names; empty builds everything.
+  std::vector<std::string> targets;
+  // How many leading targets to build in a build tool invocation of their
+  // own before the rest, so their errors do not wait on the others. 0 or
+  // all of them builds everything in one invocation. The second invocation
+  // is skipped after a failure unless the config keeps going.
+  std::size_t first_batch{};
+  // Called after each invocation for every target it built, with the
+  // invocation's exit code and the span of the target's steps in ninja's
+  // log. Targets that logged no steps are reported only on failure, with a
+  // zero duration.
+  std::function<void(const std::string& target, int exit_code,
+                     std::chrono::steady_clock::duration duration)>
+      on_target_built;
+};
+
+/**
+ * Runs builds of a project whose CMakeLists.txt is already in place.
+ *
+ * Implementations configure the build tree when it needs it and then
+ * build, honouring the job count and keep-going setting of the config.
+ */
+class BuildBackend {
+ public:
+  virtual ~BuildBackend() = default;
+
+  /**
+   * Configures if needed, then builds.
+   *
+   * @param request The targets to build.
+   * @return Exit code of the build tool.
+   */
+  virtual int build(const BuildRequest& request) = 0;
+
+  /**
+   * Lists the steps a build of the request would run, without running it.
+   *
+   * @param request The targets to consider.
+   * @return Step descriptions, or std::nullopt if the backend cannot tell.
+   */
+  virtual std::optional<std::vector<std::string>> pending(
+      const BuildRequest& request) = 0;
+
+  /**
+   * @return The backend's config name.
+   */
+  virtual std::string_view name() const = 0;
+};
+
+/**
+ * Creates the backend the config asks for.
+ *
+ * The Ninja backend falls back to the CMake one, with a warning, when no
+ * ninja executable is on PATH. A project with C++20 modules gets the Ninja
+ * backend whatever the config says, since no other generator CMake offers
+ * on this platform can build them.
+ *
+ * @param cfg     Project configuration.
+ * @param modules Whether the project has module interface units.
+ * @return The backend; it keeps a copy of cfg.
+ */
+std::unique_ptr<BuildBackend> make_build_backend(const Config& cfg,
+                                                 bool modules = false);
+
+/**
+ * Reads the generator a build tree was configured with.
+ *
+ * @param build_directory The CMake binary directory.
+ * @return The generator name, or an empty string if not configured.
+ */
+std::string cached_generator(const std::filesystem::path& build_directory);
+
+}  // namespace daemonmake
+
+#endif
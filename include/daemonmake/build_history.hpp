@@ -0,0 +1,101 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_BUILD_HISTORY
+#define DAEMONMAKE__DAEMONMAKE_BUILD_HISTORY
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "daemonmake/target_graph.hpp"
+
+namespace daemonmake {
+
+inline constexpr std::string_view build_history_default_location{
+    ".daemonmake/build_history.bin"};
+
+/**
+ * What past builds of one target looked like.
+ */
+struct TargetBuildStats {
+  // Smoothed duration of successful builds; negative until one succeeds.
+  double expected_ms{-1};
+  std::uint32_t builds{};
+  std::uint32_t failures{};
+  bool last_failed{};
+};
+
+/**
+ * Per-target build durations and failures, kept across daemon runs.
+ */
+class BuildHistory {
+ public:
+  /**
+   * Reads a history written by save().
+   *
+   * @return The history, or std::nullopt if missing, corrupt or from
+   *         another format version.
+   */
+  static std::optional<BuildHistory> load(
+      const std::filesystem::path& file_path);
+
+  /**
+   * Persists the history.
+   *
+   * @throws std::runtime_error If the file cannot be written.
+   */
+  void save(const std::filesystem::path& file_path) const;
+
+  /**
+   * Records one build of a target. Failed builds stop early, so only
+   * successful ones update the expected duration.
+   *
+   * @param target    The target name.
+   * @param duration  Wall time of the build.
+   * @param succeeded Whether it built.
+   */
+  void record(std::string_view target,
+              std::chrono::steady_clock::duration duration, bool succeeded);
+
+  /**
+   * @return The target's stats, or nullptr if it was never built.
+   */
+  const TargetBuildStats* find(std::string_view target) const;
+
+  std::size_t size() const { return targets_.size(); }
+
+ private:
+  std::map<std::string, TargetBuildStats, std::less<>> targets_;
+};
+
+/**
+ * Orders targets so that feedback on an edit arrives as early as possible.
+ *
+ * The edited targets and whatever they need from the set come first, then
+ * targets whose last build failed, then the rest, shortest expected
+ * duration first. Targets never built successfully count as instant, so
+ * they get measured early. Within those priorities every target follows
+ * its dependencies in the set, except on a dependency cycle.
+ *
+ * @param graph        The dependency graph.
+ * @param targets      The targets to order.
+ * @param edited       Targets containing the edited files.
+ * @param history      Past builds.
+ * @param edited_count Set to how many leading targets of the result are
+ *                     edited ones or what they need.
+ * @return Every member of targets, in build order.
+ */
+std::vector<TargetId> schedule_targets(const TargetGraph& graph,
+                                       const TargetSet& targets,
+                                       std::span<const TargetId> edited,
+                                       const BuildHistory& history,
+                                       std::size_t* edited_count = nullptr);
+
+}  // namespace daemonmake
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef DAEMONMAKE__DAEMONMAKE_BUILD_QUEUE
 #define DAEMONMAKE__DAEMONMAKE_BUILD_QUEUE
 
+#include <chrono>
 #include <condition_variable>
 #include <filesystem>
 #include <map>
@@ -12,6 +13,10 @@
 
 namespace daemonmake {
 
+inline constexpr std::chrono::milliseconds build_queue_default_debounce{1000};
+inline constexpr std::chrono::milliseconds build_queue_default_hold_timeout{
+    60000};
+
 /**
  * A thread-safe, debouncing priority queue for file system events.
  * 
@@ -22,9 +27,15 @@ namespace daemonmake {
 class BuildQueue {
  public:
   /**
-   * @param capacity Maximum number of unique file paths allowed in the queue.
+   * @param capacity     Maximum number of unique file paths allowed in the
+   *                     queue.
+   * @param debounce     Period of silence that ends a batch.
+   * @param hold_timeout Longest a hold() may delay a batch.
    */
-  explicit BuildQueue(size_t capacity);
+  explicit BuildQueue(
+      size_t capacity,
+      std::chrono::milliseconds debounce = build_queue_default_debounce,
+      std::chrono::milliseconds hold_timeout = build_queue_default_hold_timeout);
 
   /**
    * Represents a batch of work to be processed by the builder.
@@ -70,6 +81,27 @@ class BuildQueue {
    */
   Task pop_all_events(const std::stop_token& token);
 
+  /**
+   * Holds batches back while an external operation, such as a git
+   * checkout, is still rewriting files.
+   *
+   * While held, events keep accumulating and pop_all_events() does not
+   * return them, even after the debounce period; releasing the hold lets
+   * the batch go as soon as the debounce period has passed. A hold that
+   * outlives the hold timeout is ignored, so a stale lock cannot stop
+   * builds for good.
+   *
+   * @param active Whether the operation is in progress.
+   */
+  void hold(bool active);
+
+  /**
+   * Checks for queued work without waiting or consuming it.
+   *
+   * @return True if any event is waiting to be popped.
+   */
+  bool has_pending_events();
+
   /**
    * Signals the queue to stop accepting events and wakes all waiting threads.
    */
@@ -77,10 +109,14 @@ class BuildQueue {
 
  private:
   size_t capacity_;
+  std::chrono::milliseconds debounce_;
+  std::chrono::milliseconds hold_timeout_;
   std::map<std::filesystem::path, FileEventType> events_{};
   bool needs_full_rebuild_{};
   std::chrono::steady_clock::time_point last_event_pushed_{};
   bool shutdown_{};
+  bool held_{};
+  std::chrono::steady_clock::time_point held_since_{};
 
   std::mutex mtx_;
   std::condition_variable_any cv_not_full_;
@@ -21,12 +21,22 @@ namespace daemonmake {
 int cmake_build(const Config& cfg, const ProjectLayout& pl,
                 bool overwrite = false);
 
+/**
+ * Configures and builds a project whose CMakeLists.txt is already in place,
+ * using the backend the config selects.
+ *
+ * @param cfg Project configuration, including project_root and build_directory.
+ * @return Exit code of the build command.
+ */
+int cmake_build(const Config& cfg);
+
 /**
  * Writes a CMakeLists.txt file for the given project configuration and layout.
  *
  * Generates target definitions, include paths, compiler settings, and
  * inter-target dependencies. If a CMakeLists.txt already exists and overwrite
- * is false, throws std::runtime_error. Also throws on I/O errors.
+ * is false, throws std::runtime_error. Also throws on I/O errors. An existing
+ * file with identical content is left untouched.
  *
  * @param cfg        Project configuration.
  * @param pl         Discovered project layout.
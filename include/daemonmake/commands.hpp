@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include "daemonmake/event_trace.hpp"
+
 namespace daemonmake {
 
 /**
@@ -52,6 +54,35 @@ int run_build(const std::string& root_arg);
  */
 int run_generate_cmake(const std::string& root_arg);
 
+/**
+ * Explains what a change to the given file would rebuild.
+ *
+ * Uses the header index harvested from the compiler's depfiles after the
+ * last build to list the translation units that include the file, the
+ * targets that recompile them, and the targets that relink as a result.
+ * With the Ninja backend, also lists the steps already out of date.
+ *
+ * @param file_arg Path of the file to explain, absolute or relative to the
+ *                 current directory.
+ * @param root_arg Project root path. If empty, uses the current directory.
+ * @return 0 on success, non-zero on failure.
+ */
+int run_why(const std::string& file_arg, const std::string& root_arg);
+
+/**
+ * Reports where compile time goes, from the traces collected with
+ * compile_time_profiling enabled.
+ *
+ * Collects any traces newer than the stored profile first, then prints the
+ * slowest translation units with their change since the previous compile,
+ * the headers and template instantiations with the most time across the
+ * project, and the history of project totals.
+ *
+ * @param root_arg Project root path. If empty, uses the current directory.
+ * @return 0 on success, non-zero if there is nothing to report.
+ */
+int run_profile(const std::string& root_arg);
+
 /**
  * Runs the daemon in the foreground for the given project.
  *
@@ -63,6 +94,28 @@ int run_generate_cmake(const std::string& root_arg);
  */
 int run_daemon(const std::string& root_arg);
 
+/**
+ * Records the project's filesystem events to a trace until interrupted.
+ *
+ * Watches the same directories as the daemon, but never builds. The trace
+ * can be replayed later with run_replay().
+ *
+ * @param trace_arg Destination trace file.
+ * @param root_arg  Project root path. If empty, uses the current directory.
+ * @return 0 on clean exit, 1 if an exception is thrown.
+ */
+int run_record(const std::string& trace_arg, const std::string& root_arg);
+
+/**
+ * Replays a recorded trace through the build queue against a builder that
+ * only sleeps, and prints the builds it triggered and their latencies.
+ *
+ * @param trace_arg The trace file.
+ * @param options   Replay speed, debounce and build duration.
+ * @return 0 on success, non-zero if the trace cannot be read.
+ */
+int run_replay(const std::string& trace_arg, const ReplayOptions& options);
+
 }  // namespace daemonmake
 
 #endif
\ No newline at end of file
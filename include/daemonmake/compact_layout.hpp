@@ -0,0 +1,302 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_COMPACT_LAYOUT
+#define DAEMONMAKE__DAEMONMAKE_COMPACT_LAYOUT
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "daemonmake/project.hpp"
+
+namespace daemonmake {
+
+using FileId = std::uint32_t;
+
+/**
+ * An append-only array whose elements never move.
+ *
+ * Storage is a list of fixed-size chunks whose directory is reserved up
+ * front, so push_back() never touches existing elements. A reader that
+ * learned an index before an append, or below a size() it loaded, may keep
+ * reading it while a single writer appends.
+ */
+template <typename T>
+class StableArray {
+ public:
+  StableArray() { chunks_.reserve(max_chunks); }
+
+  const T& operator[](std::size_t i) const {
+    return chunks_[i >> chunk_bits][i & (chunk_size - 1)];
+  }
+
+  T& operator[](std::size_t i) {
+    return chunks_[i >> chunk_bits][i & (chunk_size - 1)];
+  }
+
+  // Assigns rather than copies, so T may be an atomic set from its value.
+  template <typename U = T>
+  void push_back(U&& value) {
+    const auto size{size_.load(std::memory_order_relaxed)};
+    if ((size & (chunk_size - 1)) == 0) {
+      if (chunks_.size() == max_chunks)
+        throw std::length_error("StableArray capacity exceeded");
+      chunks_.push_back(std::make_unique<T[]>(chunk_size));
+    }
+    chunks_[size >> chunk_bits][size & (chunk_size - 1)] =
+        std::forward<U>(value);
+    size_.store(size + 1, std::memory_order_release);
+  }
+
+  std::size_t size() const { return size_.load(std::memory_order_acquire); }
+
+  std::size_t memory_usage() const {
+    return chunks_.capacity() * sizeof(std::unique_ptr<T[]>) +
+           chunks_.size() * chunk_size * sizeof(T);
+  }
+
+ private:
+  static constexpr std::size_t chunk_bits{12};
+  static constexpr std::size_t chunk_size{std::size_t{1} << chunk_bits};
+  static constexpr std::size_t max_chunks{std::size_t{1} << 11};
+
+  std::vector<std::unique_ptr<T[]>> chunks_;
+  std::atomic<std::size_t> size_{};
+};
+
+/**
+ * Append-only table of interned project-relative paths.
+ *
+ * Paths are stored as a tree of nodes, each naming its parent and one
+ * interned path component, so a deep tree costs a few bytes per file
+ * instead of a full string. Storage never moves, so an id obtained before
+ * a later intern() stays resolvable while the single writer keeps
+ * appending.
+ *
+ * Readers on other threads look paths up with find_frozen(), bounded by a
+ * size() taken when their view was built: each node also links to its
+ * first child and next sibling, and a new node is linked in only once it
+ * is fully written.
+ */
+class PathTable {
+ public:
+  PathTable();
+
+  // Non-copyable; entries are referenced by address.
+  PathTable(const PathTable&) = delete;
+  PathTable& operator=(const PathTable&) = delete;
+
+  /**
+   * Returns the id of a path, adding it and any missing parents.
+   * Writer only.
+   *
+   * @param rel_path Project-relative path using '/' separators.
+   */
+  FileId intern(std::string_view rel_path);
+
+  /**
+   * Looks up a path without adding it. Writer only.
+   *
+   * @param rel_path Project-relative path using '/' separators.
+   */
+  std::optional<FileId> find(std::string_view rel_path) const;
+
+  /**
+   * Looks up a path among the first count ids, ignoring any added since.
+   * Safe from any thread while the writer appends, for a count no larger
+   * than a size() that thread has seen. Scans siblings, so it is slower
+   * than find() in wide directories.
+   *
+   * @param rel_path Project-relative path using '/' separators.
+   * @param count    Number of ids the caller's view covers.
+   */
+  std::optional<FileId> find_frozen(std::string_view rel_path,
+                                    std::size_t count) const;
+
+  /**
+   * Reconstructs the full project-relative path of an id.
+   */
+  std::string path(FileId id) const;
+
+  /**
+   * @return The last path component of an id.
+   */
+  std::string_view filename(FileId id) const {
+    return components_[node(id).component];
+  }
+
+  FileId parent(FileId id) const { return node(id).parent; }
+
+  /**
+   * @return Number of ids handed out, including the root.
+   */
+  std::size_t size() const { return nodes_.size(); }
+
+  /**
+   * @return Approximate heap footprint in bytes. Writer only.
+   */
+  std::size_t memory_usage() const;
+
+  // Id of the empty path that every top-level component hangs off.
+  static constexpr FileId root{0};
+
+ private:
+  struct Node {
+    FileId parent;
+    std::uint32_t component;
+    // Added before this node under the same parent, or root for none.
+    FileId next_sibling;
+  };
+
+  const Node& node(FileId id) const { return nodes_[id]; }
+
+  std::uint32_t intern_component(std::string_view component);
+
+  std::pmr::monotonic_buffer_resource strings_;
+  std::size_t string_bytes_{};
+  StableArray<std::string_view> components_;
+  StableArray<Node> nodes_;
+  // Latest child of each node, or root for none; published last.
+  StableArray<std::atomic<FileId>> first_children_;
+
+  // Writer-side indexes.
+  std::unordered_map<std::string_view, std::uint32_t> component_ids_;
+  std::unordered_map<std::uint64_t, FileId> children_;
+};
+
+/**
+ * A target whose file lists and dependencies live in a CompactLayout arena.
+ */
+struct CompactTarget {
+  std::string_view name;
+  TargetType type;
+  std::span<const FileId> source_files;
+  std::span<const FileId> header_files;
+  std::span<const TargetId> dependencies;
+};
+
+/**
+ * Memory-lean equivalent of ProjectLayout for long-lived holders.
+ *
+ * Paths are FileIds into a shared PathTable, dependencies are TargetIds,
+ * and every per-target array is carved out of one arena owned by the
+ * layout, so a rediscovery frees the previous layout in one step.
+ *
+ * The layout remembers how many paths the table held when it was built, so
+ * a published layout can be read from any thread while the writer interns
+ * paths for the next one.
+ */
+class CompactLayout {
+ public:
+  CompactLayout() = default;
+
+  /**
+   * Interns a discovered layout.
+   *
+   * Dependencies naming no target are dropped, as in TargetGraph.
+   *
+   * @param pl    The layout to compact.
+   * @param paths Table to intern paths into; reusing one across
+   *              rediscoveries keeps FileIds stable.
+   */
+  CompactLayout(const ProjectLayout& pl, std::shared_ptr<PathTable> paths);
+
+  /**
+   * Derives a layout from another with some targets replaced, added or
+   * dropped, without expanding the rest: their file and dependency ids are
+   * copied into the new arena. Targets are kept in discovery order.
+   *
+   * @param base    The layout to start from; its path table is shared.
+   * @param updated Targets to add, or to replace by name.
+   * @param removed Names of targets to drop.
+   */
+  CompactLayout(const CompactLayout& base, const std::vector<Target>& updated,
+                const std::vector<std::string>& removed);
+
+  /**
+   * Expands the layout back into the form write_cmakelists() consumes.
+   */
+  ProjectLayout to_project_layout() const;
+
+  const std::string& project_name() const { return project_name_; }
+  const std::filesystem::path& project_root() const { return project_root_; }
+
+  std::span<const CompactTarget> targets() const { return targets_; }
+
+  /**
+   * The shared path table. Ids of this layout resolve from any thread;
+   * look paths up with find() instead of PathTable::find().
+   */
+  const PathTable& paths() const { return *paths_; }
+
+  /**
+   * Looks up a path among those the table held when this layout was built.
+   * Safe from any thread.
+   *
+   * @param rel_path Project-relative path using '/' separators.
+   */
+  std::optional<FileId> find(std::string_view rel_path) const {
+    if (!paths_) return std::nullopt;
+    return paths_->find_frozen(rel_path, path_count_);
+  }
+
+  /**
+   * Finds the target a source or header file belongs to.
+   *
+   * @param file A FileId from paths().
+   * @return The owning target, or std::nullopt for unowned files.
+   */
+  std::optional<TargetId> owner(FileId file) const {
+    if (file >= owners_.size() || owners_[file] == no_owner) return std::nullopt;
+    return owners_[file];
+  }
+
+  /**
+   * @return Approximate heap footprint in bytes, excluding the shared
+   *         path table.
+   */
+  std::size_t memory_usage() const;
+
+ private:
+  static constexpr TargetId no_owner{~TargetId{}};
+
+  // Uninitialised storage for count objects from the arena.
+  template <typename T>
+  std::span<T> allocate(std::size_t count);
+
+  std::string_view copy_name(std::string_view name);
+  std::span<FileId> intern_files(const std::vector<std::string>& files);
+  void index_owners();
+
+  std::string project_name_;
+  std::filesystem::path project_root_;
+  std::shared_ptr<PathTable> paths_;
+  // paths_->size() once this layout's paths were interned.
+  std::size_t path_count_{};
+
+  std::shared_ptr<std::pmr::monotonic_buffer_resource> arena_;
+  std::span<CompactTarget> targets_;
+  std::span<TargetId> owners_;
+  std::size_t arena_bytes_{};
+};
+
+/**
+ * Maps translation units to the targets that compile them.
+ *
+ * @param layout The compacted layout.
+ * @param tus    Project-relative source paths.
+ * @return Names of the owning targets, sorted and unique.
+ */
+std::vector<std::string> targets_for_translation_units(
+    const CompactLayout& layout, const std::vector<std::string_view>& tus);
+
+}  // namespace daemonmake
+
+#endif
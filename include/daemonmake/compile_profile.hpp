@@ -0,0 +1,190 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_COMPILE_PROFILE
+#define DAEMONMAKE__DAEMONMAKE_COMPILE_PROFILE
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "daemonmake/config.hpp"
+
+namespace daemonmake {
+
+inline constexpr std::string_view compile_profile_default_location{
+    ".daemonmake/compile_profile.bin"};
+// Compiler launcher that moves GCC's -ftime-report out of stderr.
+inline constexpr std::string_view time_report_launcher_location{
+    ".daemonmake/time-report.sh"};
+
+/**
+ * A named cost: a header's parse time or a template's instantiation time.
+ */
+struct TimedEntry {
+  std::string name;
+  double ms{};
+};
+
+/**
+ * Where the compiler spent its time on one translation unit.
+ *
+ * Header and template times are inclusive: a header's time includes the
+ * headers it includes, an instantiation's time the ones it triggers.
+ * Clang traces fill every field; GCC's -ftime-report has no per-header or
+ * per-template breakdown, so those lists stay empty.
+ */
+struct TranslationUnitProfile {
+  // Project-relative source path.
+  std::string source;
+  // Modification time of the trace it was read from.
+  std::int64_t trace_mtime{};
+
+  double total_ms{};
+  // Preprocessing, parsing and template instantiation.
+  double frontend_ms{};
+  // Optimisation and code generation.
+  double backend_ms{};
+  double template_ms{};
+  // total_ms of the previous compile, or negative if this is the first.
+  double previous_total_ms{-1};
+
+  // Slowest first, capped.
+  std::vector<TimedEntry> headers;
+  std::vector<TimedEntry> templates;
+};
+
+/**
+ * Project totals after one collection that found new traces.
+ */
+struct ProfileSample {
+  // Seconds since the epoch.
+  std::int64_t time{};
+  std::uint32_t translation_units{};
+  // Translation units recompiled since the previous sample.
+  std::uint32_t recompiled{};
+  double total_ms{};
+  double frontend_ms{};
+  double template_ms{};
+};
+
+/**
+ * A header or template with its cost summed over every translation unit.
+ */
+struct ProfileHotspot {
+  std::string name;
+  double total_ms{};
+  // Translation units it appears in.
+  std::uint32_t count{};
+};
+
+/**
+ * Parses a clang -ftime-trace file.
+ *
+ * @param file         The trace, written next to the object file.
+ * @param project_root Header paths under it are made project-relative.
+ * @return The profile without source and mtime, or std::nullopt if the
+ *         file is not a time trace.
+ */
+std::optional<TranslationUnitProfile> parse_clang_time_trace(
+    const std::filesystem::path& file,
+    const std::filesystem::path& project_root);
+
+/**
+ * Parses the table GCC prints with -ftime-report, using wall times.
+ *
+ * @param text The report as saved by the time-report launcher.
+ * @return The profile without source and mtime, or std::nullopt if there
+ *         is no TOTAL line.
+ */
+std::optional<TranslationUnitProfile> parse_gcc_time_report(
+    std::string_view text);
+
+/**
+ * Writes the compiler launcher used with GCC. It runs the compiler, saves
+ * the -ftime-report table as <object>.time-report and passes every other
+ * line of stderr through. An identical existing file is left untouched.
+ *
+ * @param file Destination; made executable.
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void write_time_report_launcher(const std::filesystem::path& file);
+
+/**
+ * Per-translation-unit compile times gathered from the build tree, and
+ * their history.
+ *
+ * Each translation unit keeps the figures of its latest compile, so after
+ * an incremental build the profile still covers the whole project.
+ */
+class CompileProfile {
+ public:
+  /**
+   * Reads a profile written by save().
+   *
+   * @return The profile, or std::nullopt if missing, corrupt or from
+   *         another format version.
+   */
+  static std::optional<CompileProfile> load(
+      const std::filesystem::path& file_path);
+
+  /**
+   * Persists the profile.
+   *
+   * @throws std::runtime_error If the file cannot be written.
+   */
+  void save(const std::filesystem::path& file_path) const;
+
+  /**
+   * Reads every trace in the build tree that changed since the last
+   * collection, forgets translation units whose trace is gone, and records
+   * a history sample if anything was recompiled.
+   *
+   * @param cfg Project configuration.
+   * @return Number of translation units read.
+   */
+  std::size_t collect(const Config& cfg);
+
+  const std::map<std::string, TranslationUnitProfile>& translation_units()
+      const {
+    return translation_units_;
+  }
+
+  const std::vector<ProfileSample>& history() const { return history_; }
+
+  /**
+   * @return The headers with the most parse time across the project,
+   *         slowest first.
+   */
+  std::vector<ProfileHotspot> expensive_headers(std::size_t top) const;
+
+  /**
+   * @return The template instantiations with the most time across the
+   *         project, slowest first.
+   */
+  std::vector<ProfileHotspot> slowest_templates(std::size_t top) const;
+
+  /**
+   * @return The slowest translation units, slowest first.
+   */
+  std::vector<const TranslationUnitProfile*> slowest_translation_units(
+      std::size_t top) const;
+
+ private:
+  std::map<std::string, TranslationUnitProfile> translation_units_;
+  std::vector<ProfileSample> history_;
+};
+
+/**
+ * Loads the project's profile, collects new traces and saves it if any
+ * were found. Failures are logged and otherwise ignored.
+ *
+ * @param cfg Project configuration.
+ * @return The updated profile.
+ */
+CompileProfile update_compile_profile(const Config& cfg);
+
+}  // namespace daemonmake
+
+#endif
@@ -3,15 +3,51 @@
 
 #include <filesystem>
 #include <string>
+#include <vector>
+
+#include "daemonmake/logger.hpp"
 
 namespace daemonmake {
 
 inline constexpr std::string_view default_source_folder_name{"src"};
 inline constexpr std::string_view default_apps_folder_name{"apps"};
 inline constexpr std::string_view default_include_folder_name{"include"};
+inline constexpr std::string_view default_tests_folder_name{"tests"};
 inline constexpr std::string_view config_default_location{
     ".daemonmake/config.json"};
 
+// Static libraries, as a release build would link them.
+inline constexpr std::string_view build_mode_release{"release"};
+// Shared (or object) libraries, so an edit relinks one library instead of
+// every executable above it.
+inline constexpr std::string_view build_mode_dev{"dev"};
+
+// Toolchain defaults, as CMake picks them.
+inline constexpr std::string_view build_profile_default{"default"};
+// Fastest available linker and split debug info, chosen at configure time.
+inline constexpr std::string_view build_profile_dev_fast{"dev-fast"};
+
+// `cmake --build` with whatever generator CMake defaults to.
+inline constexpr std::string_view build_backend_cmake{"cmake"};
+// The Ninja generator, with ninja invoked directly.
+inline constexpr std::string_view build_backend_ninja{"ninja"};
+
+// inotify, or stat polling where the filesystem makes inotify unreliable.
+inline constexpr std::string_view file_watcher_auto{"auto"};
+inline constexpr std::string_view file_watcher_inotify{"inotify"};
+// Stat polling everywhere, e.g. for edits made inside a VM or container.
+inline constexpr std::string_view file_watcher_poll{"poll"};
+
+/**
+ * Extra compile flags for the targets or source files matching a glob.
+ */
+struct FlagOverride {
+  // A glob (*, ?, [...]) over target names, or over project-relative
+  // source paths if it contains a '/'.
+  std::string match;
+  std::vector<std::string> flags;
+};
+
 /**
  * Project configuration state.
  *
@@ -29,6 +65,68 @@ struct Config {
   std::string source_folder_name;
   std::string include_folder_name;
   std::string apps_folder_name;
+  // Each source file directly in this folder becomes a test executable.
+  std::string tests_folder_name{default_tests_folder_name};
+
+  // Only scan the #include preamble of each file when inferring dependencies.
+  bool include_scan_preamble_only{};
+
+  // How write_cmakelists() links libraries: build_mode_release or
+  // build_mode_dev.
+  std::string build_mode{build_mode_release};
+
+  // Toolchain tuning applied by write_cmakelists(): build_profile_default
+  // or build_profile_dev_fast.
+  std::string build_profile{build_profile_default};
+  // With dev-fast, also trade link-time optimisation for faster relinks.
+  bool incremental_link_flags{};
+  // Compile with -ftime-trace (clang) or -ftime-report (GCC) and collect
+  // the results for `daemonmake profile`.
+  bool compile_time_profiling{};
+  // Applied in order after every other flag, so later entries win.
+  std::vector<FlagOverride> flag_overrides{};
+
+  // Compile recently edited targets with focus_flags and every other
+  // target with stable_flags.
+  bool focus_mode{};
+  std::vector<std::string> focus_flags{"-O0", "-g"};
+  std::vector<std::string> stable_flags{"-O2"};
+  // How long a target stays in focus after its last edit.
+  unsigned focus_window_minutes{60};
+
+  // What runs the build: build_backend_cmake or build_backend_ninja.
+  std::string build_backend{build_backend_cmake};
+  // Parallel build jobs; 0 leaves the choice to the build tool.
+  unsigned build_jobs{};
+  // Keep building other targets after a failure.
+  bool keep_going{};
+  // Have the daemon keep the build tree on tmpfs and write it back to
+  // build_directory in the background.
+  bool ram_build_directory{};
+  // Largest build tree kept in RAM; beyond it the daemon builds on disk.
+  unsigned ram_build_budget_mb{2048};
+  // Have the daemon build the edited targets and what they need before
+  // the rest of the affected targets, recording each target's build time.
+  bool ordered_builds{true};
+
+  // After each successful daemon build, run the tests the change affects.
+  bool run_affected_tests{};
+  // Tests run at once; 0 uses one per hardware thread.
+  unsigned test_jobs{};
+
+  // How the daemon notices edits: file_watcher_auto, file_watcher_inotify
+  // or file_watcher_poll.
+  std::string file_watcher{file_watcher_auto};
+
+  // Longest the daemon waits for a git checkout, rebase or merge to finish
+  // before building anyway; 0 builds during git operations.
+  unsigned git_hold_timeout_seconds{60};
+
+  // Least severe messages shown: log_level_debug, log_level_info,
+  // log_level_warning or log_level_error.
+  std::string log_level{log_level_info};
+  // Also append every message as JSON to log_default_location.
+  bool log_file{};
 };
 
 /**
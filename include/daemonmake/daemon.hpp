@@ -3,13 +3,26 @@
 
 #include <filesystem>
 #include <map>
-#include <mutex>
+#include <memory>
+#include <optional>
+#include <set>
+#include <stop_token>
 #include <thread>
 #include <vector>
 
+#include "daemonmake/build_backend.hpp"
+#include "daemonmake/build_history.hpp"
 #include "daemonmake/build_queue.hpp"
+#include "daemonmake/compact_layout.hpp"
 #include "daemonmake/config.hpp"
+#include "daemonmake/focus.hpp"
+#include "daemonmake/header_index.hpp"
+#include "daemonmake/include_cache.hpp"
+#include "daemonmake/layout_snapshot.hpp"
 #include "daemonmake/project.hpp"
+#include "daemonmake/project_snapshot.hpp"
+#include "daemonmake/ram_build.hpp"
+#include "daemonmake/target_graph.hpp"
 
 namespace daemonmake {
 
@@ -22,14 +35,16 @@ inline constexpr ssize_t daemon_build_queue_size{1000};
  * 1. A FileWatcher thread that monitors the filesystem and produces events.
  * 2. A Builder thread that consumes events and executes build commands.
  *
- * This class is thread-safe; internal state like the ProjectLayout is protected
- * by a mutex to allow concurrent access between discovery and build phases.
+ * Discovery results are published as immutable ProjectSnapshots: the builder
+ * thread prepares each new one off to the side and swaps it in atomically,
+ * so readers get a consistent view without waiting for a rediscovery.
  */
 class Daemon {
  public:
   /**
    * Initializes the daemon with the provided configuration.
-   * Performs an initial project scan to populate the layout and graph.
+   * Populates the layout and graph from the persisted snapshot when one
+   * matches the configuration, and performs a full project scan otherwise.
    *
    * @param cfg The project-specific configuration settings.
    */
@@ -53,33 +68,184 @@ class Daemon {
    */
   void stop();
 
+  /**
+   * Returns the current layout, graph and header index. Safe to call from
+   * any thread; never blocks behind discovery or a build. Paths in the
+   * layout are looked up with CompactLayout::find(), which only sees those
+   * interned before it was published.
+   */
+  std::shared_ptr<const ProjectSnapshot> snapshot() const {
+    return snapshot_.load();
+  }
+
  private:
   /**
    * Re-scans the filesystem to discover targets and update the dependency
-   * graph. Thread-safe: locks the internal mutex to prevent reading stale
-   * layout data.
+   * graph. Only files changed since the previous scan have their includes
+   * re-read. Publishes a new snapshot that keeps the current header index.
+   * Builder thread only.
    */
   void update_pl();
 
   /**
-   * Triggers a full project rebuild and re-discovery.
+   * As update_pl(), reusing a tree scan taken by the caller.
+   * @param scan A walk of project_tree_roots() relative to the project root.
+   */
+  void update_pl(const TreeScan& scan);
+
+  /**
+   * Applies the files a task created, deleted or modified to the current
+   * layout and publishes the result, without walking the tree. Builder
+   * thread only.
+   * @param task The batch being rebuilt.
+   * @return The targets whose CMake definitions changed, or std::nullopt
+   *         if the change needs update_pl() instead.
+   */
+  std::optional<std::vector<std::string>> patch_pl(const BuildQueue::Task& task);
+
+  /**
+   * Publishes a new layout and its graph alongside the current header
+   * index. Builder thread only.
+   * @param layout        The layout to publish.
+   * @param rebuild_graph False keeps the current graph, for a layout with
+   *                      the same targets and dependencies.
+   * @return The published snapshot.
+   */
+  std::shared_ptr<const ProjectSnapshot> publish_layout(
+      CompactLayout layout, bool rebuild_graph = true);
+
+  /**
+   * Creates the build backend on first use, and again when C++20 module
+   * units appear in or disappear from the layout, since they need Ninja.
+   */
+  void select_backend();
+
+  /**
+   * Adopts the layout, graph and include cache persisted by a previous run.
+   * The tree scan is reused if no directory changed since, and retaken
+   * otherwise; either way the first builder iteration revalidates it.
+   * @return False if there is no usable snapshot.
+   */
+  bool load_snapshot();
+
+  /**
+   * Persists the current discovery results for the next daemon start.
+   * Failures are logged and otherwise ignored.
+   */
+  void save_snapshot(const ProjectLayout& pl, const TreeScan& scan);
+
+  /**
+   * Triggers a full project rebuild and re-discovery, followed by every
+   * test when affected tests are enabled.
+   * @param token Stops the test stage.
    * @return The exit code of the underlying build command.
    */
-  int rebuild_all();
+  int rebuild_all(const std::stop_token& token);
 
   /**
-   * Executes a build based on specific changed files.
-   * @param task A batch of file events and build flags from the queue.
+   * Executes a build based on specific changed files, followed by the
+   * tests it affects when enabled. With ordered builds the edited targets
+   * and what they need build before the other affected targets, and
+   * their durations are recorded. In focus mode, a target entering focus regenerates
+   * CMakeLists.txt first.
+   * @param task         A batch of file events and build flags from the queue.
+   * @param restructured Targets whose definitions patch_pl() changed, or
+   *                     std::nullopt after a full rediscovery or when the
+   *                     task created and deleted nothing.
+   * @param token        Stops the test stage.
    * @return The exit code of the underlying build command.
    */
-  int rebuild_changed(BuildQueue::Task& task);
+  int rebuild_changed(BuildQueue::Task& task,
+                      const std::optional<std::vector<std::string>>& restructured,
+                      const std::stop_token& token);
+
+  /**
+   * Runs the tests among the given targets in parallel, tests that failed
+   * last time first, printing each failure as soon as it happens. New
+   * edits arriving in the queue cancel the run.
+   * @param targets Targets rebuilt; empty means every test.
+   * @param token   Stops the run as well.
+   */
+  void run_affected_tests(const std::vector<std::string>& targets,
+                          const std::stop_token& token);
+
+  /**
+   * Merges the dependencies of translation units compiled since the last
+   * harvest into the header index after a successful build, persists it
+   * and publishes it with the current layout. Failures are logged and
+   * leave the previous index in place.
+   */
+  void refresh_header_index();
+
+  /**
+   * Reports which translation units and targets the modified files in a
+   * task affect, according to the header index. After a layout patch,
+   * created files count for their targets, deleted headers for the
+   * translation units that included them, and restructured targets for
+   * themselves. A modified module interface counts for its target, whose
+   * dependents are its importers.
+   * @param task         The batch being rebuilt.
+   * @param restructured As passed to rebuild_changed().
+   * @return The targets containing the modified files, or std::nullopt if
+   *         the index cannot account for every change.
+   */
+  std::optional<std::vector<TargetId>> report_affected(
+      const BuildQueue::Task& task,
+      const std::optional<std::vector<std::string>>& restructured);
+
+  /**
+   * Adds the targets owning the task's files to the focus set, drops
+   * targets that left the focus window, and persists the set.
+   * @param task The batch being rebuilt.
+   * @return Whether the focused targets changed.
+   */
+  bool update_focus(const BuildQueue::Task& task);
+
+  /**
+   * Persists the build history. Failures are logged and otherwise ignored.
+   */
+  void save_build_history();
+
+  /**
+   * Configures and builds, regenerating CMakeLists.txt from the current
+   * layout first when requested or when it is missing. Afterwards collects
+   * compile-time traces when profiling is enabled and schedules a
+   * write-back of a RAM build tree.
+   * @param regenerate Whether the layout changed since the last write.
+   * @param request    The targets to build; empty builds everything.
+   * @return The exit code of the underlying build command.
+   */
+  int build(bool regenerate, const BuildRequest& request = {});
 
   Config cfg_;
-  ProjectLayout pl_;
+  // Set when the build tree is kept in RAM; destroyed after the threads,
+  // so the last write-back follows the last build.
+  std::unique_ptr<RamBuildDirectory> ram_build_;
+  // Paths stay interned across rediscoveries so FileIds remain stable.
+  std::shared_ptr<PathTable> paths_;
+  ProjectSnapshotCell snapshot_;
+  std::unique_ptr<BuildBackend> backend_;
+  // Whether backend_ was chosen for a layout with module units.
+  bool modules_{};
   BuildQueue build_queue_;
-  TargetGraph graph_;
+  // Discovery's working state; touched by the builder thread only.
+  IncludeCache include_cache_;
+  // What the header index has seen of the build tree; builder thread only.
+  HeaderIndexHarvester header_harvester_;
+  // Tests that failed in the last run that reached them.
+  std::set<std::string> failing_tests_;
+  // Per-target build times; builder thread only.
+  BuildHistory build_history_;
+  // Recently edited targets; builder thread only.
+  FocusSet focus_;
+
+  // Startup walk shared by the first discovery and the watcher; released
+  // once the watcher has registered its directories.
+  TreeScan startup_scan_;
+  // Set when the layout came from a snapshot and has not been checked
+  // against file contents yet.
+  bool revalidate_on_start_{};
 
-  std::mutex mtx_;
   std::jthread watcher_thread_;
   std::jthread builder_thread_;
 };
@@ -0,0 +1,128 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_EVENT_TRACE
+#define DAEMONMAKE__DAEMONMAKE_EVENT_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "daemonmake/build_queue.hpp"
+#include "daemonmake/file_watcher.hpp"
+
+namespace daemonmake {
+
+/**
+ * A watcher event and when it was observed, relative to the start of the
+ * recording. Paths are relative to the project root.
+ */
+struct TraceEvent {
+  std::chrono::nanoseconds offset;
+  FileEvent event;
+};
+
+/**
+ * Appends watcher events to a binary trace as they arrive.
+ *
+ * Each path is written out the first time it appears and referenced by
+ * index afterwards, so long recordings of the same few files stay small.
+ * Every batch is flushed, and a trace cut short by a crash still loads up
+ * to its last complete event.
+ */
+class EventTraceWriter {
+ public:
+  /**
+   * Creates or truncates the trace and starts its clock.
+   *
+   * @param file_path    Destination file.
+   * @param project_root Event paths are stored relative to this.
+   * @throws std::runtime_error If the file cannot be opened.
+   */
+  EventTraceWriter(const std::filesystem::path& file_path,
+                   std::filesystem::path project_root);
+
+  /**
+   * Records a batch of events, all stamped with the current time.
+   *
+   * @param events Events as returned by FileWatcher::wait_for_events().
+   * @throws std::runtime_error If the file cannot be written.
+   */
+  void write(const std::vector<FileEvent>& events);
+
+  /**
+   * @return Number of events written so far.
+   */
+  std::size_t size() const { return count_; }
+
+ private:
+  std::ofstream out_;
+  std::filesystem::path project_root_;
+  std::chrono::steady_clock::time_point start_;
+  std::unordered_map<std::string, std::uint32_t> path_ids_;
+  std::size_t count_{};
+};
+
+/**
+ * Loads a trace written by EventTraceWriter.
+ *
+ * @param file_path The trace file.
+ * @return The events in recording order, or std::nullopt if the file is
+ *         missing or not a trace of this format version.
+ */
+std::optional<std::vector<TraceEvent>> load_event_trace(
+    const std::filesystem::path& file_path);
+
+/**
+ * Policy and timing for replaying a trace.
+ */
+struct ReplayOptions {
+  // Values above 1 compress time: event gaps, the debounce and build
+  // durations all shrink by this factor, so decisions match a replay at
+  // recorded speed while reported times stay in trace time.
+  double speed{1.0};
+  std::chrono::milliseconds debounce{build_queue_default_debounce};
+  // How long the stand-in builder takes for every build.
+  std::chrono::milliseconds build_time{1000};
+};
+
+/**
+ * One build the replayed daemon decided to run.
+ */
+struct ReplayBuild {
+  std::chrono::nanoseconds start;  // trace time
+  std::chrono::nanoseconds end;
+  std::size_t events{};
+  bool full_rebuild{};
+  bool discovery{};
+  // An event for one of its files arrived while it ran, so another build
+  // has to follow.
+  bool wasted{};
+};
+
+/**
+ * The outcome of a replay.
+ */
+struct ReplayReport {
+  std::vector<ReplayBuild> builds;
+  // Per event, the time from the event to the start of the build that
+  // picked it up. Events cancelled out by the queue have no entry.
+  std::vector<std::chrono::nanoseconds> latencies;
+};
+
+/**
+ * Feeds a trace through a BuildQueue in real time and runs the daemon's
+ * builder loop against a builder that only sleeps.
+ *
+ * @param events  A loaded trace.
+ * @param options Replay speed, debounce and build duration.
+ * @return The builds that ran and the latency of every event.
+ */
+ReplayReport replay_event_trace(const std::vector<TraceEvent>& events,
+                                const ReplayOptions& options);
+
+}  // namespace daemonmake
+
+#endif
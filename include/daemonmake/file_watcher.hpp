@@ -2,9 +2,13 @@
 #define DAEMONMAKE__DAEMONMAKE_FILE_WATCHER
 
 #include <filesystem>
-#include <unordered_map>
+#include <memory>
+#include <string_view>
 #include <vector>
 
+#include "daemonmake/config.hpp"
+#include "daemonmake/tree_walker.hpp"
+
 namespace daemonmake {
 
 /**
@@ -23,29 +27,69 @@ struct FileEvent {
 };
 
 /**
- * Linux-specific file watcher using the inotify API.
- * Monitored directories are watched recursively. This class handles
- * the complexities of inotify, such as mapping watch descriptors back
- * to paths and updating watches when new directories are created.
+ * A source of filesystem events for a set of watched trees.
+ */
+class WatchBackend {
+ public:
+  virtual ~WatchBackend() = default;
+
+  /**
+   * Blocks for a short duration to wait for filesystem events.
+   *
+   * @return The events that occurred; empty on timeout.
+   */
+  virtual std::vector<FileEvent> wait_for_events() = 0;
+
+  /**
+   * @return The backend's file_watcher setting, e.g. "inotify".
+   */
+  virtual std::string_view name() const = 0;
+};
+
+/**
+ * Whether inotify sees every change under a path. Network and FUSE
+ * filesystems only report changes made through the local kernel, so edits
+ * made on another host or inside a VM go unnoticed.
+ *
+ * @param path A directory on the filesystem to check.
+ * @return False for NFS, SMB/CIFS, FUSE, 9p, AFS, Ceph, GPFS, Lustre and
+ *         VirtualBox shared folders.
+ */
+bool inotify_reliable(const std::filesystem::path& path);
+
+/**
+ * Recursively watches directory trees and reports changes as FileEvents.
+ *
+ * Changes come from inotify, or from stat polling (PollingWatcher) on
+ * filesystems where inotify is not reliable. Editor swap and temporary
+ * files are filtered out either way.
  */
 class FileWatcher {
  public:
   /**
-   * Initializes inotify and establishes recursive watches on all roots.
-   * 
+   * Establishes recursive watches on all roots.
+   *
    * @param roots A list of directory paths to monitor.
+   * @param mode  file_watcher_auto, file_watcher_inotify or
+   *              file_watcher_poll.
    * @throws std::runtime_error If inotify_init fails.
    */
-  explicit FileWatcher(const std::vector<std::filesystem::path>& roots);
+  explicit FileWatcher(const std::vector<std::filesystem::path>& roots,
+                       std::string_view mode = file_watcher_auto);
 
   /**
-   * Closes the inotify file descriptor and stops all watches.
+   * Watches every directory of an existing scan, so a caller that already
+   * walked the tree does not walk it again.
+   *
+   * @param base The directory the scan is relative to.
+   * @param scan The directories to monitor.
+   * @param mode file_watcher_auto, file_watcher_inotify or file_watcher_poll.
+   * @throws std::runtime_error If inotify_init fails.
    */
-  ~FileWatcher();
+  FileWatcher(const std::filesystem::path& base, const TreeScan& scan,
+              std::string_view mode = file_watcher_auto);
 
-  // Non-copyable due to file descriptor ownership.
-  FileWatcher(const FileWatcher&) = delete;
-  FileWatcher& operator=(const FileWatcher&) = delete;
+  ~FileWatcher();
 
   FileWatcher(FileWatcher&&) noexcept;
   FileWatcher& operator=(FileWatcher&&) noexcept;
@@ -58,17 +102,13 @@ class FileWatcher {
    */
   std::vector<FileEvent> wait_for_events();
 
- private:
- /**
-   * Registers a single directory with the inotify instance.
-   * 
-   * @param dir The directory path to watch.
+  /**
+   * @return The backend in use, "inotify" or "poll".
    */
-  void add_watch(const std::filesystem::path& dir);
+  std::string_view backend_name() const;
 
-  int inotify_fd_;
-  std::vector<std::filesystem::path> roots_;
-  std::unordered_map<int, std::filesystem::path> wd_to_path_;
+ private:
+  std::unique_ptr<WatchBackend> backend_;
 };
 
 }  // namespace daemonmake
@@ -0,0 +1,77 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_FOCUS
+#define DAEMONMAKE__DAEMONMAKE_FOCUS
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace daemonmake {
+
+inline constexpr std::string_view focus_default_location{
+    ".daemonmake/focus.json"};
+
+/**
+ * The targets being actively edited, for focus mode.
+ *
+ * The daemon adds a target when one of its files changes and drops it once
+ * it has gone unedited for the focus window. write_cmakelists() reads the
+ * persisted set, so CLI regenerations agree with the daemon and do not
+ * flip flags back and forth.
+ */
+class FocusSet {
+ public:
+  /**
+   * Reads a set written by save().
+   *
+   * @return The set; empty if the file is missing or unreadable.
+   */
+  static FocusSet load(const std::filesystem::path& file_path);
+
+  /**
+   * Persists the set, replacing the file atomically since
+   * write_cmakelists() may read it at any time.
+   *
+   * @throws std::runtime_error If the file cannot be written.
+   */
+  void save(const std::filesystem::path& file_path);
+
+  /**
+   * Records an edit of a target.
+   *
+   * @param target The target name.
+   * @param now    Seconds since the epoch.
+   * @return Whether the target was not focused before.
+   */
+  bool touch(std::string_view target, std::int64_t now);
+
+  /**
+   * Drops targets last edited more than window_seconds before now.
+   *
+   * @return Whether any target was dropped.
+   */
+  bool expire(std::int64_t now, std::int64_t window_seconds);
+
+  bool contains(std::string_view target) const {
+    return last_edit_.find(target) != last_edit_.end();
+  }
+
+  bool empty() const { return last_edit_.empty(); }
+
+  /**
+   * @return Whether targets or edit times changed since the set was loaded
+   *         or saved.
+   */
+  bool unsaved() const { return unsaved_; }
+
+ private:
+  // Target name to seconds since the epoch.
+  std::map<std::string, std::int64_t, std::less<>> last_edit_;
+  bool unsaved_{};
+};
+
+}  // namespace daemonmake
+
+#endif
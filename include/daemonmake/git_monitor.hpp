@@ -0,0 +1,69 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_GIT_MONITOR
+#define DAEMONMAKE__DAEMONMAKE_GIT_MONITOR
+
+#include <filesystem>
+#include <optional>
+
+namespace daemonmake {
+
+/**
+ * Finds the git directory of the repository containing a path.
+ *
+ * Follows `gitdir:` files, so worktrees and submodules resolve to the
+ * directory git actually writes its state to.
+ *
+ * @param start A directory inside the working tree.
+ * @return The git directory, or std::nullopt outside a repository.
+ */
+std::optional<std::filesystem::path> find_git_dir(
+    const std::filesystem::path& start);
+
+/**
+ * Checks for the marker files git keeps while it rewrites the working
+ * tree: index.lock, rebase-merge/, rebase-apply/, MERGE_HEAD,
+ * CHERRY_PICK_HEAD, REVERT_HEAD and sequencer/.
+ *
+ * @param git_dir A repository's git directory.
+ * @return True if any of them exists.
+ */
+bool git_operation_in_progress(const std::filesystem::path& git_dir);
+
+/**
+ * Tracks whether a git operation is running in the project's repository.
+ *
+ * Watches the top level of the git directory with inotify and only
+ * re-checks the markers when an entry there is created, removed or
+ * renamed. Outside a repository it always reports false.
+ */
+class GitOperationMonitor {
+ public:
+  /**
+   * @param project_root Directory inside the working tree.
+   */
+  explicit GitOperationMonitor(const std::filesystem::path& project_root);
+
+  /**
+   * Closes the inotify file descriptor.
+   */
+  ~GitOperationMonitor();
+
+  // Non-copyable due to file descriptor ownership.
+  GitOperationMonitor(const GitOperationMonitor&) = delete;
+  GitOperationMonitor& operator=(const GitOperationMonitor&) = delete;
+
+  /**
+   * Drains pending notifications without blocking.
+   *
+   * @return True while an operation is in flight.
+   */
+  bool in_progress();
+
+ private:
+  int inotify_fd_{-1};
+  std::filesystem::path git_dir_;
+  bool in_progress_{};
+};
+
+}  // namespace daemonmake
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_HEADER_INDEX
+#define DAEMONMAKE__DAEMONMAKE_HEADER_INDEX
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "daemonmake/config.hpp"
+#include "daemonmake/ninja_log.hpp"
+#include "daemonmake/project.hpp"
+
+namespace daemonmake {
+
+inline constexpr std::string_view header_index_default_location{
+    ".daemonmake/header_index.bin"};
+
+/**
+ * The dependencies the compiler recorded for one translation unit.
+ */
+struct TranslationUnitDeps {
+  std::string translation_unit;
+  std::vector<std::string> headers;
+};
+
+/**
+ * Parses the prerequisites of the first rule in a Makefile-style depfile.
+ *
+ * Handles line continuations and escaped spaces as written by gcc/clang -MD.
+ *
+ * @param text The depfile contents.
+ * @return Prerequisites in order; the first is normally the source file.
+ */
+std::vector<std::string> parse_depfile(std::string_view text);
+
+/**
+ * Parses the output of `ninja -t deps`.
+ *
+ * @param text The captured output.
+ * @return One entry per output whose first dependency is taken as its TU.
+ */
+std::vector<TranslationUnitDeps> parse_ninja_deps(std::string_view text);
+
+/**
+ * File-level reverse include graph: header -> translation units.
+ *
+ * Built from the real dependencies the compiler reports, so it reflects
+ * transitive includes and preprocessor conditionals exactly as last built.
+ * Only files under the project root are kept, as project-relative paths.
+ *
+ * Paths are stored sorted for binary-search lookup, and edges in CSR form,
+ * which is also the on-disk layout.
+ */
+class HeaderIndex {
+ public:
+  HeaderIndex() = default;
+
+  /**
+   * Builds the index from per-TU dependency lists.
+   *
+   * @param deps         Dependency lists, paths absolute or relative to base.
+   * @param base         Directory relative paths are resolved against.
+   * @param project_root Files outside this directory are dropped.
+   */
+  HeaderIndex(const std::vector<TranslationUnitDeps>& deps,
+              const std::filesystem::path& base,
+              const std::filesystem::path& project_root);
+
+  /**
+   * Collects dependencies from the build tree.
+   *
+   * Uses `ninja -t deps` when the tree was generated by Ninja, and otherwise
+   * reads every *.d depfile under the build directory.
+   *
+   * @param cfg The project configuration.
+   * @return The harvested index; empty if nothing has been built yet.
+   */
+  static HeaderIndex harvest(const Config& cfg);
+
+  /**
+   * Returns a copy with the dependencies of some translation units
+   * replaced; the others keep theirs.
+   *
+   * @param deps         New dependency lists, as for the constructor.
+   * @param base         Directory relative paths are resolved against.
+   * @param project_root Files outside this directory are dropped.
+   */
+  HeaderIndex merged(const std::vector<TranslationUnitDeps>& deps,
+                     const std::filesystem::path& base,
+                     const std::filesystem::path& project_root) const;
+
+  /**
+   * Reads an index written by save().
+   *
+   * @param file_path Location of the index file.
+   * @return The index, or std::nullopt if the file is missing or invalid.
+   */
+  static std::optional<HeaderIndex> load(const std::filesystem::path& file_path);
+
+  /**
+   * Writes the index in its compact binary form.
+   *
+   * @param file_path Destination; parent directories are created.
+   * @throws std::runtime_error If the file cannot be written.
+   */
+  void save(const std::filesystem::path& file_path) const;
+
+  /**
+   * Finds the translation units that must recompile when a file changes.
+   *
+   * A translation unit is reported for itself.
+   *
+   * @param rel_path Project-relative path of the changed file.
+   * @return Project-relative TU paths, sorted.
+   */
+  std::vector<std::string_view> translation_units_for(
+      std::string_view rel_path) const;
+
+  bool empty() const { return edges_.empty(); }
+
+ private:
+  std::optional<std::uint32_t> find(std::string_view rel_path) const;
+
+  std::vector<std::string> paths_;
+  std::vector<std::uint32_t> offsets_;
+  std::vector<std::uint32_t> edges_;
+};
+
+/**
+ * Keeps a HeaderIndex current across builds by re-reading only the
+ * dependencies of translation units compiled since the last harvest: the
+ * outputs ninja logged meanwhile, or depfiles written since.
+ *
+ * The first harvest reads everything, as do harvests after ninja
+ * recompacted its log or rebuilt a large share of the project.
+ */
+class HeaderIndexHarvester {
+ public:
+  /**
+   * @param cfg The project configuration; only its paths are kept.
+   */
+  explicit HeaderIndexHarvester(const Config& cfg);
+
+  /**
+   * Brings an index up to date with the build tree.
+   *
+   * @param index The index as of the last harvest.
+   * @return The updated index, or std::nullopt if nothing was compiled
+   *         since the last harvest.
+   */
+  std::optional<HeaderIndex> harvest(const HeaderIndex& index);
+
+ private:
+  std::optional<HeaderIndex> harvest_ninja(const HeaderIndex& index);
+  std::optional<HeaderIndex> harvest_depfiles(const HeaderIndex& index);
+
+  Config cfg_;
+  bool primed_{};
+  NinjaLogTail ninja_log_;
+  // Newest depfile seen by the last harvest.
+  std::filesystem::file_time_type depfiles_seen_{
+      std::filesystem::file_time_type::min()};
+};
+
+/**
+ * Maps translation units to the targets that compile them.
+ *
+ * @param pl  The discovered layout.
+ * @param tus Project-relative source paths.
+ * @return Names of the owning targets, sorted and unique.
+ */
+std::vector<std::string> targets_for_translation_units(
+    const ProjectLayout& pl, const std::vector<std::string_view>& tus);
+
+}  // namespace daemonmake
+
+#endif
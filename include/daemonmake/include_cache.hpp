@@ -0,0 +1,120 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_INCLUDE_CACHE
+#define DAEMONMAKE__DAEMONMAKE_INCLUDE_CACHE
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace daemonmake {
+
+/**
+ * Identity of a file's contents as far as the filesystem can tell.
+ *
+ * Two equal stamps mean the file was neither replaced (dev/inode) nor
+ * written to (size/mtime) in between.
+ */
+struct FileStamp {
+  std::uint64_t dev{};
+  std::uint64_t ino{};
+  std::uint64_t size{};
+  std::int64_t mtime_ns{};
+
+  bool operator==(const FileStamp&) const = default;
+};
+
+/**
+ * Reads the stamp of a file with a single statx call.
+ *
+ * @param file_path The file to inspect.
+ * @return The stamp, or std::nullopt if the file cannot be stat'ed.
+ */
+std::optional<FileStamp> stat_file(const std::filesystem::path& file_path);
+
+/**
+ * Whether a stamp is too recent to vouch for the contents it describes.
+ *
+ * Mirrors git's "racily clean" rule: a file written in the same clock tick
+ * as it was read may change again without its stamp moving.
+ */
+bool is_racy(const FileStamp& stamp);
+
+/**
+ * Remembers which project libraries each file includes, and which modules
+ * it imports and exports.
+ *
+ * Entries are keyed by project-relative path and validated against a
+ * FileStamp, so unchanged files never have to be read again. The cache is
+ * not internally synchronised: concurrent find() calls are fine, but
+ * mutation must be exclusive.
+ */
+class IncludeCache {
+ public:
+  /**
+   * The cached contribution of one file to its target's dependencies.
+   */
+  struct Entry {
+    FileStamp stamp;
+    std::vector<std::string> libs;
+    // Imports resolve against the exports of the whole layout, so they are
+    // kept by name.
+    std::vector<std::string> imports;
+    std::string exported_module;
+  };
+
+  /**
+   * Looks up a file whose contents still match the given stamp.
+   *
+   * @param rel_path Project-relative path of the file.
+   * @param stamp    The file's current stamp.
+   * @return The cached entry, or nullptr if absent or stale.
+   */
+  const Entry* find(const std::string& rel_path, const FileStamp& stamp) const;
+
+  /**
+   * Inserts or replaces the entry for a file.
+   *
+   * @param rel_path Project-relative path of the file.
+   * @param entry    The freshly scanned contribution.
+   */
+  void store(const std::string& rel_path, Entry entry);
+
+  /**
+   * Drops the entry for a file, if any.
+   *
+   * @param rel_path Project-relative path of the file.
+   */
+  void erase(const std::string& rel_path) { entries_.erase(rel_path); }
+
+  /**
+   * Drops entries for every file not in the given set.
+   *
+   * @param live_paths Project-relative paths that still exist.
+   */
+  template <typename PathSet>
+  void retain(const PathSet& live_paths) {
+    std::erase_if(entries_, [&](const auto& kv) {
+      return !live_paths.contains(kv.first);
+    });
+  }
+
+  /**
+   * Drops every entry.
+   */
+  void clear() { entries_.clear(); }
+
+  std::size_t size() const { return entries_.size(); }
+
+  const std::unordered_map<std::string, Entry>& entries() const {
+    return entries_;
+  }
+
+ private:
+  std::unordered_map<std::string, Entry> entries_;
+};
+
+}  // namespace daemonmake
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_INCLUDE_SCANNER
+#define DAEMONMAKE__DAEMONMAKE_INCLUDE_SCANNER
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace daemonmake {
+
+/**
+ * Read-only memory mapping of a file.
+ *
+ * The mapping stays valid for the lifetime of the object, so string_views
+ * handed out by scan_includes() must not outlive it. Empty or unreadable
+ * files produce an empty mapping rather than an error.
+ *
+ * Only for files that are replaced by rename rather than rewritten in
+ * place, such as the daemon's own state: touching a page past the end of a
+ * file truncated under the mapping raises SIGBUS. Use FileReader for
+ * sources and build outputs.
+ */
+class MappedFile {
+ public:
+  /**
+   * Maps the whole file read-only.
+   *
+   * @param file_path The file to map.
+   */
+  explicit MappedFile(const std::filesystem::path& file_path);
+
+  /**
+   * Unmaps the file.
+   */
+  ~MappedFile();
+
+  // Non-copyable due to mapping ownership.
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&&) noexcept;
+  MappedFile& operator=(MappedFile&&) noexcept;
+
+  /**
+   * @return True if the file was opened, even if it is empty.
+   */
+  bool is_open() const { return open_; }
+
+  /**
+   * @return The mapped bytes, or an empty view for empty files.
+   */
+  std::string_view contents() const {
+    return {static_cast<const char*>(data_), size_};
+  }
+
+ private:
+  void* data_{};
+  std::size_t size_{};
+  bool open_{};
+};
+
+/**
+ * Reads whole files into a buffer that is reused from one file to the next.
+ *
+ * Reads with pread(), so a file truncated or rewritten meanwhile comes back
+ * short or mixed rather than faulting; callers that cache the result check
+ * the file's stamp first, and the change raises its own event.
+ */
+class FileReader {
+ public:
+  /**
+   * Reads the whole file, growing the buffer if it grew since fstat().
+   *
+   * @param file_path The file to read.
+   * @return The contents, valid until the next call, or std::nullopt if the
+   *         file cannot be opened or read.
+   */
+  std::optional<std::string_view> read(const std::filesystem::path& file_path);
+
+ private:
+  // Grows the buffer to at least capacity bytes, keeping the first used.
+  void reserve(std::size_t capacity, std::size_t used);
+
+  std::unique_ptr<char[]> buffer_;
+  std::size_t capacity_{};
+};
+
+/**
+ * Tuning knobs for scan_includes().
+ */
+struct IncludeScanOptions {
+  // Stop at the first declaration outside of any #if block. Include guards
+  // are recognised and do not count as a block.
+  bool stop_after_preamble{false};
+};
+
+/**
+ * Extracts the targets of #include directives from a C++ source buffer.
+ *
+ * Both "quoted" and <angled> forms are reported, including spellings such as
+ * "# include". Directives inside comments, string literals (raw strings
+ * included) and character literals are ignored. The search for candidate
+ * bytes is vectorised where the platform allows it.
+ *
+ * @param source  The file contents, typically from FileReader::read().
+ * @param options Scanner behaviour.
+ * @return Views into source naming each included header, in file order.
+ */
+std::vector<std::string_view> scan_includes(
+    std::string_view source, const IncludeScanOptions& options = {});
+
+/**
+ * What a C++ source buffer depends on, as views into the buffer.
+ */
+struct SourceDependencies {
+  // Headers named by #include directives and header-unit imports.
+  std::vector<std::string_view> includes;
+  // Named modules imported, including the one a module implementation unit
+  // imports implicitly. Partitions are not listed.
+  std::vector<std::string_view> imports;
+  // The module a module interface unit (or one of its partitions) exports.
+  std::string_view exported_module;
+};
+
+/**
+ * As scan_includes(), also reading C++20 module declarations.
+ *
+ * Like directives, "module", "export module", "import" and "export import"
+ * declarations are only recognised at the start of a line and never end
+ * the preamble. They must end with ';' on the same line and come before
+ * any other code, as C++20 requires of module units; later lines starting
+ * with those words are taken as code.
+ *
+ * @param source  The file contents, typically from FileReader::read().
+ * @param options Scanner behaviour.
+ * @return Everything the source declares a dependency on, in file order.
+ */
+SourceDependencies scan_dependencies(std::string_view source,
+                                     const IncludeScanOptions& options = {});
+
+}  // namespace daemonmake
+
+#endif
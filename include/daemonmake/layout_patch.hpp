@@ -0,0 +1,60 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_LAYOUT_PATCH
+#define DAEMONMAKE__DAEMONMAKE_LAYOUT_PATCH
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "daemonmake/compact_layout.hpp"
+#include "daemonmake/config.hpp"
+#include "daemonmake/include_cache.hpp"
+
+namespace daemonmake {
+
+/**
+ * A layout with a batch of file changes applied.
+ */
+struct LayoutPatch {
+  CompactLayout layout;
+  // Targets added, removed, or whose sources or dependencies changed: the
+  // ones whose CMake definitions differ. Sorted. A header appearing or
+  // disappearing changes the layout but no definition.
+  std::vector<std::string> changed_targets;
+  // Whether targets or dependency edges changed, so the TargetGraph of the
+  // previous layout no longer fits.
+  bool graph_changed{};
+};
+
+/**
+ * Applies a batch of created, deleted and modified files to a layout
+ * instead of rediscovering the project.
+ *
+ * Every path is checked against the filesystem, so neither the order of
+ * the events nor how the queue folded them matters; a deleted directory
+ * takes the files below it along. Files join or leave the target that
+ * discover_targets() would give them. A library appears with its source
+ * directory, picking up the headers already in its include directory, and
+ * disappears with it; apps and tests appear and disappear with their
+ * files. Only the targets touched have their dependencies re-inferred,
+ * unless a library appeared, which any file may include, or a module
+ * interface came or went, which any file may import. Files whose include
+ * cache entry still matches their stamp are not read again. A modified file
+ * in the batch re-infers its target as well.
+ *
+ * @param cfg       Project configuration.
+ * @param layout    The current layout.
+ * @param rel_paths Project-relative paths of created, deleted and modified
+ *                  files.
+ * @param cache     Include cache; updated for the files read, and entries
+ *                  of deleted files are dropped.
+ * @return The patched layout, or std::nullopt when a tree root itself was
+ *         created or deleted and discovery has to run.
+ */
+std::optional<LayoutPatch> patch_layout(const Config& cfg,
+                                        const CompactLayout& layout,
+                                        const std::vector<std::string>& rel_paths,
+                                        IncludeCache& cache);
+
+}  // namespace daemonmake
+
+#endif
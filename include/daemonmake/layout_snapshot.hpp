@@ -0,0 +1,76 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_LAYOUT_SNAPSHOT
+#define DAEMONMAKE__DAEMONMAKE_LAYOUT_SNAPSHOT
+
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "daemonmake/config.hpp"
+#include "daemonmake/include_cache.hpp"
+#include "daemonmake/project.hpp"
+#include "daemonmake/tree_walker.hpp"
+
+namespace daemonmake {
+
+inline constexpr std::string_view layout_snapshot_default_location{
+    ".daemonmake/layout.bin"};
+
+/**
+ * The results of discovery and dependency inference, as persisted between
+ * daemon runs.
+ */
+struct LayoutSnapshot {
+  ProjectLayout layout;
+  TreeScan scan;
+  IncludeCache include_cache;
+
+  // Stamps of the project root followed by every scanned directory. A
+  // directory's mtime moves whenever an entry is added, removed or renamed
+  // in it, so matching stamps mean the scan is still accurate.
+  std::vector<FileStamp> directory_stamps;
+};
+
+/**
+ * Writes a snapshot of the current layout.
+ *
+ * Directory stamps are taken at save time; stamps recent enough to be
+ * racy are stored poisoned so the next load treats them as changed.
+ *
+ * @param file_path Destination file.
+ * @param cfg       The configuration the layout was discovered with.
+ * @param pl        Discovered layout with dependencies inferred.
+ * @param scan      The tree scan discovery ran on.
+ * @param cache     The include cache after inference.
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void save_layout_snapshot(const std::filesystem::path& file_path,
+                          const Config& cfg, const ProjectLayout& pl,
+                          const TreeScan& scan, const IncludeCache& cache);
+
+/**
+ * Loads a snapshot written by save_layout_snapshot().
+ *
+ * @param file_path The snapshot file.
+ * @param cfg       The current configuration.
+ * @return The snapshot, or std::nullopt if the file is missing, corrupt,
+ *         from another format version, or was taken with different
+ *         discovery settings.
+ */
+std::optional<LayoutSnapshot> load_layout_snapshot(
+    const std::filesystem::path& file_path, const Config& cfg);
+
+/**
+ * Checks whether any scanned directory changed since the snapshot was
+ * taken, with one statx per directory and no directory reads.
+ *
+ * @param project_root The root the snapshot's scan is relative to.
+ * @param snapshot     A loaded snapshot.
+ * @return True if every directory stamp still matches.
+ */
+bool directories_unchanged(const std::filesystem::path& project_root,
+                           const LayoutSnapshot& snapshot);
+
+}  // namespace daemonmake
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_LOGGER
+#define DAEMONMAKE__DAEMONMAKE_LOGGER
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+
+namespace daemonmake {
+
+inline constexpr std::string_view log_default_location{
+    ".daemonmake/log.jsonl"};
+
+inline constexpr std::string_view log_level_debug{"debug"};
+inline constexpr std::string_view log_level_info{"info"};
+inline constexpr std::string_view log_level_warning{"warning"};
+inline constexpr std::string_view log_level_error{"error"};
+
+enum class LogLevel : std::uint8_t { Debug, Info, Warning, Error, Off };
+
+/**
+ * Parses a config log level name.
+ *
+ * @param name One of the log_level_* names.
+ * @return The level, or std::nullopt for an unknown name.
+ */
+std::optional<LogLevel> parse_log_level(std::string_view name);
+
+/**
+ * A named value attached to a log record.
+ *
+ * Holds a view of the caller's data; the logger copies it before the call
+ * returns. Durations are recorded in milliseconds.
+ */
+struct LogField {
+  using Value = std::variant<std::string_view, std::int64_t, std::uint64_t,
+                             double, bool>;
+
+  LogField(std::string_view key, std::string_view value)
+      : key{key}, value{value} {}
+  LogField(std::string_view key, const std::string& value)
+      : key{key}, value{std::string_view{value}} {}
+  LogField(std::string_view key, const char* value)
+      : key{key}, value{std::string_view{value}} {}
+  LogField(std::string_view key, bool value) : key{key}, value{value} {}
+  LogField(std::string_view key, double value) : key{key}, value{value} {}
+  template <std::signed_integral T>
+  LogField(std::string_view key, T value)
+      : key{key}, value{static_cast<std::int64_t>(value)} {}
+  template <std::unsigned_integral T>
+  LogField(std::string_view key, T value)
+      : key{key}, value{static_cast<std::uint64_t>(value)} {}
+  template <typename Rep, typename Period>
+  LogField(std::string_view key, std::chrono::duration<Rep, Period> value)
+      : key{key},
+        value{std::chrono::duration<double, std::milli>{value}.count()} {}
+
+  std::string_view key;
+  Value value;
+};
+
+/**
+ * Where log records go.
+ */
+struct LogOptions {
+  LogLevel level{LogLevel::Info};
+  // JSON-lines file to append every record to; empty disables it.
+  std::filesystem::path json_file;
+  // Whether records also go to stdout and stderr.
+  bool console{true};
+};
+
+namespace detail {
+
+inline std::atomic<LogLevel> log_threshold{LogLevel::Info};
+
+void write_log(LogLevel level, std::string_view message,
+               std::initializer_list<LogField> fields);
+
+}  // namespace detail
+
+/**
+ * Applies log options. The JSON file is opened in append mode, and its
+ * parent directory is created if needed.
+ *
+ * @param options The new options.
+ * @throws std::runtime_error If the JSON file cannot be opened.
+ */
+void configure_logging(const LogOptions& options);
+
+/**
+ * Changes the level without touching the sinks.
+ */
+inline void set_log_level(LogLevel level) {
+  detail::log_threshold.store(level, std::memory_order_relaxed);
+}
+
+/**
+ * A single relaxed load, so callers can guard expensive field values.
+ */
+inline bool log_enabled(LogLevel level) {
+  return level >= detail::log_threshold.load(std::memory_order_relaxed);
+}
+
+/**
+ * Records a message.
+ *
+ * The calling thread only copies the message and fields into its own
+ * lock-free ring; a background flusher formats and writes them, in
+ * timestamp order across threads. A full ring makes the caller wait for
+ * the flusher rather than drop records.
+ *
+ * The message is a template: `{key}` is replaced by the value of the field
+ * with that key on the console. The JSON sink gets the rendered message
+ * plus every field as a separate member.
+ *
+ * Info and Debug go to stdout, Warning and Error to stderr.
+ *
+ * @param level   Severity; records below the configured level are skipped.
+ * @param message Message template.
+ * @param fields  Structured values.
+ */
+inline void log(LogLevel level, std::string_view message,
+                std::initializer_list<LogField> fields = {}) {
+  if (log_enabled(level)) detail::write_log(level, message, fields);
+}
+
+inline void log_debug(std::string_view message,
+                      std::initializer_list<LogField> fields = {}) {
+  log(LogLevel::Debug, message, fields);
+}
+
+inline void log_info(std::string_view message,
+                     std::initializer_list<LogField> fields = {}) {
+  log(LogLevel::Info, message, fields);
+}
+
+inline void log_warning(std::string_view message,
+                        std::initializer_list<LogField> fields = {}) {
+  log(LogLevel::Warning, message, fields);
+}
+
+inline void log_error(std::string_view message,
+                      std::initializer_list<LogField> fields = {}) {
+  log(LogLevel::Error, message, fields);
+}
+
+/**
+ * Writes out everything logged so far, from every thread, before
+ * returning. Call it before handing the terminal to a child process.
+ */
+void flush_log();
+
+}  // namespace daemonmake
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_NINJA_LOG
+#define DAEMONMAKE__DAEMONMAKE_NINJA_LOG
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace daemonmake {
+
+/**
+ * One step ninja completed, as recorded in .ninja_log.
+ */
+struct NinjaLogEntry {
+  // Milliseconds since the start of the build that ran the step.
+  std::int64_t start_ms{};
+  std::int64_t end_ms{};
+  // Relative to the build directory.
+  std::string output;
+};
+
+/**
+ * Parses .ninja_log lines: "start\tend\tmtime\toutput\thash". Comments and
+ * malformed lines are skipped.
+ *
+ * @param text Whole lines of the log.
+ * @return The entries in file order.
+ */
+std::vector<NinjaLogEntry> parse_ninja_log(std::string_view text);
+
+/**
+ * Follows the .ninja_log of a build tree, returning what each build
+ * appended.
+ *
+ * Ninja only appends to the log, except when it recompacts or recreates
+ * it at the start of a build; a log shorter than the last read is taken
+ * as such and read again from the top.
+ */
+class NinjaLogTail {
+ public:
+  /**
+   * @param build_directory The tree whose .ninja_log to follow.
+   */
+  explicit NinjaLogTail(std::filesystem::path build_directory)
+      : path_{std::move(build_directory) / ".ninja_log"} {}
+
+  /**
+   * Skips everything logged so far.
+   */
+  void skip_to_end();
+
+  /**
+   * Reads the entries logged since the last call.
+   *
+   * @param restarted Set when the log was recompacted or recreated, so the
+   *                  result may repeat steps of earlier builds.
+   * @return The new entries; empty if there are none or no log.
+   */
+  std::vector<NinjaLogEntry> read_new(bool* restarted = nullptr);
+
+ private:
+  std::filesystem::path path_;
+  std::uintmax_t offset_{};
+};
+
+}  // namespace daemonmake
+
+#endif
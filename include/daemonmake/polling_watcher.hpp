@@ -0,0 +1,151 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_POLLING_WATCHER
+#define DAEMONMAKE__DAEMONMAKE_POLLING_WATCHER
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "daemonmake/file_watcher.hpp"
+#include "daemonmake/tree_walker.hpp"
+
+namespace daemonmake {
+
+/**
+ * How hard the polling watcher works.
+ */
+struct PollingOptions {
+  // Rescan interval of a directory where something just changed.
+  std::chrono::milliseconds hot_interval{200};
+  // Longest any directory goes without a rescan, CPU budget permitting.
+  std::chrono::milliseconds cold_interval{3000};
+  // Each stretch this long without a change doubles a directory's
+  // interval, from hot_interval up to cold_interval.
+  std::chrono::milliseconds cooldown{std::chrono::seconds{30}};
+  // Upper bound on stat calls per second, which bounds CPU use on large
+  // trees: directories due beyond it wait, most overdue first.
+  std::size_t stats_per_second{50'000};
+};
+
+/**
+ * Finds changes by stat'ing the watched trees, for filesystems where
+ * inotify misses writes made elsewhere (NFS, SSHFS and other FUSE mounts,
+ * some container bind mounts).
+ *
+ * Every watched directory keeps a compact index of its files' sizes and
+ * mtimes. A rescan re-lists a directory only when its own mtime moved, then
+ * stats its files in parallel batches on the shared thread pool. Events
+ * are the ones inotify would produce: Created and Deleted from listings,
+ * Modified when a file's size or mtime changes.
+ */
+class PollingWatcher : public WatchBackend {
+ public:
+  /**
+   * Indexes every directory and file of an existing scan.
+   *
+   * @param base    The directory the scan is relative to.
+   * @param scan    The trees to monitor.
+   * @param options Scan intervals and budget.
+   */
+  PollingWatcher(const std::filesystem::path& base, const TreeScan& scan,
+                 PollingOptions options = {});
+
+  /**
+   * Rescans the directories that are due, or waits briefly if none are.
+   */
+  std::vector<FileEvent> wait_for_events() override;
+
+  std::string_view name() const override;
+
+  /**
+   * @return Number of files indexed.
+   */
+  std::size_t file_count() const;
+
+  /**
+   * @return Approximate heap footprint of the index in bytes.
+   */
+  std::size_t memory_usage() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct FileRecord {
+    std::uint32_t name_offset{};
+    std::uint32_t name_size{};
+    std::uint64_t size{};
+    // unknown_mtime until the first stat.
+    std::int64_t mtime_ns{};
+  };
+
+  struct Directory {
+    // File names back to back; records point into it.
+    std::string names;
+    // Sorted by name.
+    std::vector<FileRecord> files;
+    // The directory's own mtime when it was last listed.
+    std::int64_t mtime_ns{};
+    Clock::time_point last_change{};
+    Clock::time_point next_scan{};
+  };
+
+  static constexpr std::int64_t unknown_mtime{INT64_MIN};
+
+  static std::string_view file_name(const Directory& dir,
+                                    const FileRecord& file) {
+    return std::string_view{dir.names}.substr(file.name_offset,
+                                              file.name_size);
+  }
+
+  std::filesystem::path full_path(const std::string& rel_dir,
+                                  std::string_view name) const;
+
+  /**
+   * Indexes a directory found by a listing, with everything below it.
+   *
+   * @param rel_dir The directory, relative to the base.
+   * @param events  Receives a Created event per file found.
+   */
+  void add_tree(const std::string& rel_dir, std::vector<FileEvent>& events);
+
+  /**
+   * Drops a directory that disappeared, with everything below it.
+   *
+   * @param rel_dir The directory, relative to the base.
+   * @param events  Receives a Deleted event per indexed file.
+   */
+  void remove_tree(const std::string& rel_dir, std::vector<FileEvent>& events);
+
+  /**
+   * Re-reads a directory whose mtime moved and diffs it against the index.
+   *
+   * @return False if the directory is gone.
+   */
+  bool relist(const std::string& rel_dir, Directory& dir,
+              std::vector<FileEvent>& events);
+
+  /**
+   * Stats the files of the given directories in parallel, reporting and
+   * recording changes.
+   */
+  void stat_files(const std::vector<std::pair<const std::string*, Directory*>>&
+                      directories,
+                  Clock::time_point now, std::vector<FileEvent>& events);
+
+  Clock::duration interval(const Directory& dir, Clock::time_point now) const;
+
+  std::filesystem::path base_;
+  PollingOptions options_;
+  // Keyed by path relative to the base, so a subtree is one range.
+  std::map<std::string, Directory> directories_;
+  // Stat calls the budget allows right now; negative after a large round.
+  double stat_credit_{};
+  Clock::time_point last_round_{Clock::now()};
+};
+
+}  // namespace daemonmake
+
+#endif
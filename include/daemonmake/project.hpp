@@ -1,13 +1,16 @@
 #ifndef DAEMONMAKE__DAEMONMAKE_PROJECT
 #define DAEMONMAKE__DAEMONMAKE_PROJECT
 
+#include <cstdint>
 #include <filesystem>
 #include <string>
 #include <string_view>
-#include <unordered_map>
 #include <vector>
 
 #include "daemonmake/config.hpp"
+#include "daemonmake/include_cache.hpp"
+#include "daemonmake/include_scanner.hpp"
+#include "daemonmake/tree_walker.hpp"
 
 namespace daemonmake {
 
@@ -16,7 +19,7 @@ inline constexpr std::string_view default_lib_name{"UnnamedLib"};
 /**
  * Indicates the build artifact type for a target.
  */
-enum class TargetType { Library, Executable };
+enum class TargetType { Library, Executable, Test };
 
 /**
  * Represents a build artifact discovered in the project.
@@ -41,27 +44,7 @@ struct ProjectLayout {
   std::vector<Target> targets;
 };
 
-using TargetId = uint32_t;
-
-/**
- * A directed graph representing the build dependency hierarchy.
- *
- * Provides efficient lookups for both direct dependencies (what I need)
- * and reverse dependencies (who needs me).
- */
-struct TargetGraph {
-  std::unordered_map<std::string, TargetId> target_name_to_id;
-  std::vector<std::vector<TargetId>> dependencies;
-  std::vector<std::vector<TargetId>> reverse_dependencies;
-
-  TargetGraph() = default;
-  /**
-   * Constructs the graph from a fully discovered ProjectLayout.
-   * 
-   * @param pl The layout used to populate nodes and edges.
-   */
-  TargetGraph(const ProjectLayout& pl);
-};
+using TargetId = std::uint32_t;
 
 /**
  * Creates a base ProjectLayout for a given root directory.
@@ -71,12 +54,68 @@ struct TargetGraph {
  */
 ProjectLayout make_project_layout(const std::filesystem::path& project_root);
 
+/**
+ * @return The project-relative directories holding sources, headers, apps
+ *         and tests: everything discovery reads and the watcher monitors.
+ */
+std::vector<std::string> project_tree_roots(const Config& cfg);
+
+/**
+ * @param folder A project-relative folder from the config.
+ * @return The folder as a '/'-terminated prefix of project-relative paths.
+ */
+std::string folder_prefix(const std::string& folder);
+
+/**
+ * @return Whether discovery compiles a file (.cpp, or a module interface
+ *         unit in a library).
+ */
+bool is_source(std::string_view path);
+
+/**
+ * @return Whether a file is a C++20 module interface unit (.cppm, .ixx).
+ */
+bool is_module_interface(std::string_view path);
+
+/**
+ * @return Whether discovery lists a file as a header (.hpp, .h).
+ */
+bool is_header(std::string_view path);
+
+/**
+ * The name discovery gives the target built from an app or test source:
+ * the file's stem, prefixed with "test_" for tests so that a test named
+ * after the library or app it covers does not clash with it.
+ *
+ * @param path A source file directly under the apps or tests folder.
+ * @param type TargetType::Executable or TargetType::Test.
+ */
+std::string executable_target_name(std::string_view path, TargetType type);
+
+/**
+ * @return Whether any target compiles a module interface unit.
+ */
+bool has_module_units(const ProjectLayout& pl);
+
+/**
+ * Where discover_targets() lists a target: libraries come first, then the
+ * default library, apps and tests. Targets of equal rank are sorted by
+ * name.
+ *
+ * @return A rank from 0 to 3.
+ */
+int discovery_rank(TargetType type, std::string_view name);
+
 /**
  * Scans the filesystem to identify libraries and executables.
  *
  * Logic:
- * - Subdirectories in 'src/' become Library targets.
+ * - Subdirectories in 'src/' become Library targets, module interface
+ *   units included.
  * - Files in 'apps/' become individual Executable targets.
+ * - Files in 'tests/' become individual Test targets, named test_<stem>.
+ * - An app or test whose name is already taken by a target listed before
+ *   it is skipped with a warning.
  * - Headers are associated based on <project_name>/<target_name> structure.
  *
  * @param cfg The project configuration.
@@ -84,13 +123,46 @@ ProjectLayout make_project_layout(const std::filesystem::path& project_root);
  */
 void discover_targets(const Config& cfg, ProjectLayout& pl);
 
+/**
+ * Identifies libraries and executables from an existing tree scan.
+ *
+ * Same rules as discover_targets(cfg, pl), without touching the filesystem.
+ *
+ * @param cfg  The project configuration.
+ * @param pl   The layout to populate with discovered targets.
+ * @param scan A walk of project_tree_roots(cfg) relative to the project root.
+ */
+void discover_targets(const Config& cfg, ProjectLayout& pl,
+                      const TreeScan& scan);
+
 /**
  * Analyzes file contents to find inter-target dependencies.
  *
- * Parses #include "project/target/..." strings to map relationships.
+ * Parses #include "project/target/..." and <project/target/...> directives
+ * to map relationships, and imports of modules that a target's interface
+ * units export. Includes and imports outside of the project are ignored.
  * @param pl The layout to update with dependency metadata.
+ * @param options Include scanner behaviour.
+ * @param cache Optional per-file cache. When given, only files whose stamp
+ *              changed since the last call are read, and entries for files
+ *              that no longer exist are dropped.
+ */
+void infer_target_dependencies(ProjectLayout& pl,
+                               const IncludeScanOptions& options = {},
+                               IncludeCache* cache = nullptr);
+
+/**
+ * As infer_target_dependencies() with a cache, for a layout holding only
+ * some of the project's targets: cache entries of files outside it are
+ * kept, and imports only resolve to modules exported inside it.
+ *
+ * @param pl      The targets to update, with the project's name and root.
+ * @param options Include scanner behaviour.
+ * @param cache   Per-file cache.
  */
-void infer_target_dependencies(ProjectLayout& pl);
+void refresh_target_dependencies(ProjectLayout& pl,
+                                 const IncludeScanOptions& options,
+                                 IncludeCache& cache);
 
 }  // namespace daemonmake
 
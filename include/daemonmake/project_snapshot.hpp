@@ -0,0 +1,68 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_PROJECT_SNAPSHOT
+#define DAEMONMAKE__DAEMONMAKE_PROJECT_SNAPSHOT
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "daemonmake/compact_layout.hpp"
+#include "daemonmake/header_index.hpp"
+#include "daemonmake/target_graph.hpp"
+
+namespace daemonmake {
+
+/**
+ * A consistent, immutable view of everything discovery knows about the
+ * project.
+ *
+ * The parts are shared, so publishing a new header index after a build
+ * reuses the layout and graph of the previous snapshot instead of copying
+ * them. Graph ids are layout target indices.
+ */
+struct ProjectSnapshot {
+  std::shared_ptr<const CompactLayout> layout{
+      std::make_shared<const CompactLayout>()};
+  std::shared_ptr<const TargetGraph> graph{
+      std::make_shared<const TargetGraph>()};
+  std::shared_ptr<const HeaderIndex> header_index{
+      std::make_shared<const HeaderIndex>()};
+  // Incremented by every publish.
+  std::uint64_t generation{};
+};
+
+/**
+ * Publishes ProjectSnapshots from one writer to any number of readers.
+ *
+ * The writer prepares the next snapshot off to the side and swaps it in
+ * with a single atomic store. Readers never wait for the writer: load()
+ * hands out the snapshot current at that moment, which stays valid for as
+ * long as the reader holds it even if newer ones are published meanwhile.
+ */
+class ProjectSnapshotCell {
+ public:
+  /**
+   * @return The current snapshot; never null.
+   */
+  std::shared_ptr<const ProjectSnapshot> load() const {
+    return current_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Makes next the current snapshot. Single writer only.
+   *
+   * @param next The snapshot to publish; its generation is overwritten.
+   */
+  void publish(ProjectSnapshot next) {
+    next.generation = load()->generation + 1;
+    current_.store(std::make_shared<const ProjectSnapshot>(std::move(next)),
+                   std::memory_order_release);
+  }
+
+ private:
+  std::atomic<std::shared_ptr<const ProjectSnapshot>> current_{
+      std::make_shared<const ProjectSnapshot>()};
+};
+
+}  // namespace daemonmake
+
+#endif
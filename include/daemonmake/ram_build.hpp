@@ -0,0 +1,133 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_RAM_BUILD
+#define DAEMONMAKE__DAEMONMAKE_RAM_BUILD
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "daemonmake/config.hpp"
+
+namespace daemonmake {
+
+/**
+ * Where CMake builds when the RAM build directory is enabled: a
+ * per-project directory under $XDG_RUNTIME_DIR, or /dev/shm without one.
+ *
+ * CMake always sees this path. It is either a real tmpfs directory held by
+ * the daemon or a symlink to the on-disk build directory, so the build tree
+ * moves between the two without reconfiguring. The directory is created
+ * with mode 0700, and an entry at this path that is not a mode 0700
+ * directory or a symlink owned by the current user is never used.
+ *
+ * @param cfg Project configuration.
+ */
+std::filesystem::path ram_build_path(const Config& cfg);
+
+/**
+ * Prepares cfg for a one-off command when the RAM build directory is
+ * enabled: points build_directory at ram_build_path(), first linking that
+ * path to the on-disk tree unless it already exists. Does nothing when the
+ * mode is off, or when the path is held by another user.
+ *
+ * @param cfg Project configuration; build_directory is updated.
+ */
+void redirect_build_directory(Config& cfg);
+
+/**
+ * Keeps the daemon's build tree on tmpfs and writes it back to the
+ * configured build directory in the background.
+ *
+ * Write-back is incremental: the writer remembers the size and mtime of
+ * every file it last copied, so a pass only touches the on-disk tree for
+ * files a build changed. Copies keep their mtimes, so either copy is up to
+ * date for make and ninja.
+ */
+class RamBuildDirectory {
+ public:
+  /**
+   * Restores the on-disk tree into RAM, or keeps the RAM tree a previous
+   * daemon left behind, and starts the writer. Falls back to the on-disk
+   * tree when it exceeds the budget or the free space on tmpfs. If
+   * ram_build_path() is held by another user, builds in the configured
+   * directory and never touches that path.
+   *
+   * @param cfg Project configuration; build_directory is redirected to
+   *            ram_build_path() unless it is held by another user.
+   */
+  explicit RamBuildDirectory(Config& cfg);
+
+  /**
+   * Stops the writer and writes everything back.
+   */
+  ~RamBuildDirectory();
+
+  RamBuildDirectory(const RamBuildDirectory&) = delete;
+  RamBuildDirectory& operator=(const RamBuildDirectory&) = delete;
+
+  /**
+   * Wakes the writer for a pass, e.g. after a build.
+   */
+  void request_sync();
+
+  /**
+   * @return Whether the build tree currently lives in RAM.
+   */
+  bool in_ram() const { return in_ram_.load(std::memory_order_relaxed); }
+
+  /**
+   * @return Whether the RAM tree outgrew the budget at the last pass.
+   */
+  bool over_budget() const {
+    return over_budget_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Writes everything back, then replaces the RAM tree with a link to the
+   * on-disk tree. Call between builds.
+   */
+  void fall_back_to_disk();
+
+ private:
+  struct FileState {
+    std::uintmax_t size{};
+    std::int64_t mtime{};
+    bool symlink{};
+
+    bool operator==(const FileState&) const = default;
+  };
+  // Relative path to state, for files and symlinks.
+  using TreeState = std::map<std::string, FileState>;
+
+  static TreeState scan(const std::filesystem::path& root,
+                        std::uintmax_t* total_bytes = nullptr);
+  bool restore();
+  // Writes back every change since the last pass. Caller holds mutex_.
+  void sync();
+  void link_to_disk();
+
+  std::filesystem::path disk_;
+  std::filesystem::path ram_;
+  std::uintmax_t budget_bytes_{};
+
+  // Serialises passes and guards synced_.
+  std::mutex mutex_;
+  // What the on-disk tree holds, as of the last pass.
+  TreeState synced_;
+
+  std::atomic_bool in_ram_{};
+  std::atomic_bool over_budget_{};
+
+  std::mutex wake_mutex_;
+  std::condition_variable_any wake_;
+  bool sync_requested_{};
+  std::jthread writer_;
+};
+
+}  // namespace daemonmake
+
+#endif
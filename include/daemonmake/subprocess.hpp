@@ -0,0 +1,56 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_SUBPROCESS
+#define DAEMONMAKE__DAEMONMAKE_SUBPROCESS
+
+#include <filesystem>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+namespace daemonmake {
+
+/**
+ * Runs a command via fork/exec and waits for it to finish.
+ *
+ * The child inherits stdout and stderr. The command is looked up on PATH.
+ *
+ * @param argv Program name followed by its arguments.
+ * @return The child's exit code, 127 if it could not be executed, or 1 if
+ *         it could not be started or did not exit normally.
+ */
+int run_subprocess(const std::vector<std::string>& argv);
+
+/**
+ * Runs a command like run_subprocess(), capturing its standard output.
+ *
+ * Standard error is still inherited from the parent.
+ *
+ * @param argv   Program name followed by its arguments.
+ * @param output Receives everything the child wrote to stdout.
+ * @return The child's exit code, as for run_subprocess().
+ */
+int run_subprocess_capture(const std::vector<std::string>& argv,
+                           std::string& output);
+
+// Returned by run_subprocess_cancellable() when the child was killed on
+// request.
+inline constexpr int subprocess_cancelled{-1};
+
+/**
+ * Runs a command in its own process group, capturing stdout and stderr
+ * together, and kills the whole group if a stop is requested first.
+ *
+ * @param argv              Program name followed by its arguments.
+ * @param working_directory Directory the child starts in.
+ * @param output            Receives everything the child wrote.
+ * @param token             Requesting a stop kills the child.
+ * @return The child's exit code as for run_subprocess(), or
+ *         subprocess_cancelled.
+ */
+int run_subprocess_cancellable(const std::vector<std::string>& argv,
+                               const std::filesystem::path& working_directory,
+                               std::string& output,
+                               const std::stop_token& token);
+
+}  // namespace daemonmake
+
+#endif
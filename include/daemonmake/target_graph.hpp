@@ -0,0 +1,204 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_TARGET_GRAPH
+#define DAEMONMAKE__DAEMONMAKE_TARGET_GRAPH
+
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "daemonmake/compact_layout.hpp"
+#include "daemonmake/project.hpp"
+
+namespace daemonmake {
+
+/**
+ * A fixed-size set of targets stored as a bitset.
+ */
+class TargetSet {
+ public:
+  TargetSet() = default;
+
+  /**
+   * @param size Number of targets in the universe.
+   */
+  explicit TargetSet(std::size_t size) : size_{size}, words_((size + 63) / 64) {}
+
+  void insert(TargetId id) { words_[id / 64] |= std::uint64_t{1} << (id % 64); }
+
+  bool contains(TargetId id) const {
+    return (words_[id / 64] >> (id % 64)) & 1;
+  }
+
+  /**
+   * Adds every member of a bitset row of the same universe.
+   *
+   * @param row Words laid out as in this set.
+   */
+  void merge(std::span<const std::uint64_t> row) {
+    for (std::size_t w{}; w < words_.size(); ++w) words_[w] |= row[w];
+  }
+
+  std::size_t count() const {
+    std::size_t n{};
+    for (const auto word : words_) n += static_cast<std::size_t>(std::popcount(word));
+    return n;
+  }
+
+  bool empty() const {
+    for (const auto word : words_)
+      if (word != 0) return false;
+    return true;
+  }
+
+  /**
+   * @return Members in ascending id order.
+   */
+  std::vector<TargetId> to_vector() const {
+    std::vector<TargetId> ids;
+    for (std::size_t w{}; w < words_.size(); ++w) {
+      for (auto word{words_[w]}; word != 0; word &= word - 1)
+        ids.push_back(static_cast<TargetId>(w * 64 + std::countr_zero(word)));
+    }
+    return ids;
+  }
+
+  std::size_t universe_size() const { return size_; }
+
+ private:
+  std::size_t size_{};
+  std::vector<std::uint64_t> words_;
+};
+
+/**
+ * A directed graph representing the build dependency hierarchy.
+ *
+ * Adjacency is stored in compressed sparse row form in both directions, so
+ * direct dependencies (what I need) and reverse dependencies (who needs me)
+ * are contiguous spans. Construction also detects cycles, assigns each
+ * target a topological level, and precomputes the transitive dependents of
+ * every target as a bitset row, so the set of targets affected by a batch
+ * of changes is a handful of bitwise ORs.
+ */
+class TargetGraph {
+ public:
+  TargetGraph() = default;
+
+  /**
+   * Constructs the graph from a fully discovered ProjectLayout.
+   *
+   * Target ids follow the order of pl.targets. Dependencies on names that
+   * are not targets are skipped and reported by unresolved_dependencies().
+   *
+   * @param pl The layout used to populate nodes and edges.
+   */
+  explicit TargetGraph(const ProjectLayout& pl);
+
+  /**
+   * Constructs the graph from a compacted layout, whose dependencies are
+   * already resolved to ids.
+   *
+   * @param layout The layout used to populate nodes and edges.
+   */
+  explicit TargetGraph(const CompactLayout& layout);
+
+  std::size_t size() const { return names_.size(); }
+
+  const std::string& name(TargetId id) const { return names_[id]; }
+
+  /**
+   * Looks up a target by name.
+   *
+   * @param name The target name.
+   * @return The id, or std::nullopt if there is no such target.
+   */
+  std::optional<TargetId> find(std::string_view name) const;
+
+  std::span<const TargetId> dependencies(TargetId id) const {
+    return {dep_edges_.data() + dep_offsets_[id],
+            dep_edges_.data() + dep_offsets_[id + 1]};
+  }
+
+  std::span<const TargetId> reverse_dependencies(TargetId id) const {
+    return {rdep_edges_.data() + rdep_offsets_[id],
+            rdep_edges_.data() + rdep_offsets_[id + 1]};
+  }
+
+  /**
+   * Length of the longest dependency chain below a target. Targets with no
+   * dependencies are at level 0; every target is above all of its
+   * dependencies unless they share a cycle.
+   */
+  std::uint32_t level(TargetId id) const { return levels_[id]; }
+
+  /**
+   * @return Targets on at least one dependency cycle, in id order.
+   */
+  const std::vector<TargetId>& cyclic_targets() const { return cyclic_; }
+
+  bool has_cycle() const { return !cyclic_.empty(); }
+
+  /**
+   * @return (dependent, missing name) pairs for dependencies that named no
+   *         known target.
+   */
+  const std::vector<std::pair<TargetId, std::string>>& unresolved_dependencies()
+      const {
+    return unresolved_;
+  }
+
+  /**
+   * Computes every target that must rebuild when the given targets change:
+   * the targets themselves and everything depending on them transitively.
+   *
+   * @param changed Ids of the changed targets.
+   * @return The affected set.
+   */
+  TargetSet affected(std::span<const TargetId> changed) const;
+
+  /**
+   * @return Approximate heap footprint of the graph in bytes.
+   */
+  std::size_t memory_usage() const;
+
+ private:
+  // Targets without dependents (apps, tests) have no stored row; their
+  // closure is just themselves.
+  static constexpr std::uint32_t no_row{~std::uint32_t{}};
+
+  std::span<const std::uint64_t> closure_row(std::uint32_t row) const {
+    return {closures_.data() + std::size_t{row} * words_per_row_,
+            words_per_row_};
+  }
+
+  // Strongly connected components in bottom-up topological order.
+  struct Components;
+
+  void set_names(std::vector<std::string> names);
+  void build(std::vector<std::pair<TargetId, TargetId>> edges);
+  Components compute_levels_and_cycles();
+  void compute_closures(const Components& components);
+
+  std::vector<std::string> names_;
+  std::vector<TargetId> by_name_;
+
+  std::vector<std::uint32_t> dep_offsets_{0};
+  std::vector<TargetId> dep_edges_;
+  std::vector<std::uint32_t> rdep_offsets_{0};
+  std::vector<TargetId> rdep_edges_;
+
+  std::vector<std::uint32_t> levels_;
+  std::vector<TargetId> cyclic_;
+  std::vector<std::pair<TargetId, std::string>> unresolved_;
+
+  std::size_t words_per_row_{};
+  std::vector<std::uint32_t> row_of_;
+  std::vector<std::uint64_t> closures_;
+};
+
+}  // namespace daemonmake
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_TEST_RUNNER
+#define DAEMONMAKE__DAEMONMAKE_TEST_RUNNER
+
+#include <chrono>
+#include <functional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include "daemonmake/config.hpp"
+#include "daemonmake/subprocess.hpp"
+
+namespace daemonmake {
+
+/**
+ * The outcome of one test executable.
+ */
+struct TestResult {
+  std::string name;
+  // Exit code, or subprocess_cancelled if it was killed.
+  int exit_code{};
+  // Everything the test wrote to stdout and stderr.
+  std::string output;
+  std::chrono::nanoseconds duration{};
+
+  bool passed() const { return exit_code == 0; }
+  bool cancelled() const { return exit_code == subprocess_cancelled; }
+};
+
+/**
+ * Runs built test executables in parallel.
+ *
+ * Each test runs from the build directory, as ctest would run it, and at
+ * most cfg.test_jobs run at once. Tests start in the given order.
+ *
+ * @param cfg       Project configuration; executables are looked up in
+ *                  its build directory.
+ * @param tests     Test target names.
+ * @param token     Requesting a stop kills running tests and skips the
+ *                  rest.
+ * @param on_result Called as each test finishes; calls are serialised.
+ * @return Results of the tests that were started, in completion order.
+ */
+std::vector<TestResult> run_tests(
+    const Config& cfg, const std::vector<std::string>& tests,
+    const std::stop_token& token,
+    const std::function<void(const TestResult&)>& on_result);
+
+}  // namespace daemonmake
+
+#endif
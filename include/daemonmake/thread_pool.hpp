@@ -0,0 +1,103 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_THREAD_POOL
+#define DAEMONMAKE__DAEMONMAKE_THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace daemonmake {
+
+/**
+ * A fixed-size work-stealing thread pool.
+ *
+ * Each worker owns a deque. Jobs submitted from a worker go to the back of
+ * its own deque and are popped LIFO; idle workers steal from the front of
+ * other deques. Jobs submitted from outside the pool are spread round-robin.
+ */
+class ThreadPool {
+ public:
+  /**
+   * Starts the worker threads.
+   *
+   * @param num_threads Number of workers. Zero selects the hardware
+   *                    concurrency.
+   */
+  explicit ThreadPool(std::size_t num_threads = 0);
+
+  /**
+   * Stops and joins all workers. Jobs that have not started are dropped.
+   */
+  ~ThreadPool();
+
+  // Non-copyable due to thread ownership.
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * Schedules a job for asynchronous execution.
+   *
+   * @param job The callable to run on a worker.
+   */
+  void submit(std::function<void()> job);
+
+  /**
+   * Runs fn(i) for every i in [0, count) and blocks until all calls return.
+   *
+   * The calling thread takes part in the work, so it is safe to call from
+   * inside a pool job. The first exception thrown by fn is rethrown here
+   * after all other iterations have finished.
+   *
+   * @param count Number of iterations.
+   * @param fn    The loop body.
+   */
+  void parallel_for(std::size_t count,
+                    const std::function<void(std::size_t)>& fn);
+
+  /**
+   * @return The number of worker threads.
+   */
+  std::size_t size() const { return workers_.size(); }
+
+ private:
+  struct Worker {
+    std::mutex mtx;
+    std::deque<std::function<void()>> jobs;
+  };
+
+  /**
+   * Pops from the worker's own deque, or steals from another one.
+   *
+   * @param self Index of the worker looking for work.
+   * @param job  Receives the job on success.
+   * @return True if a job was found.
+   */
+  bool try_pop(std::size_t self, std::function<void()>& job);
+
+  void worker_loop(const std::stop_token& token, std::size_t index);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<std::size_t> pending_{};
+  std::atomic<std::size_t> next_queue_{};
+
+  std::mutex sleep_mtx_;
+  std::condition_variable_any cv_work_;
+
+  // Declared last so the threads are joined before the queues go away.
+  std::vector<std::jthread> threads_;
+};
+
+/**
+ * Returns the process-wide pool used by discovery and dependency inference.
+ */
+ThreadPool& shared_thread_pool();
+
+}  // namespace daemonmake
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef DAEMONMAKE__DAEMONMAKE_TREE_WALKER
+#define DAEMONMAKE__DAEMONMAKE_TREE_WALKER
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace daemonmake {
+
+/**
+ * Every directory and regular file found under a set of roots.
+ *
+ * Paths are relative to the walk base, use '/' separators and are sorted,
+ * so consumers can locate a subtree with a binary search on its prefix.
+ */
+struct TreeScan {
+  std::vector<std::string> directories;  // includes the roots themselves
+  std::vector<std::string> files;
+};
+
+/**
+ * Walks directory trees in one pass using getdents64.
+ *
+ * Entry types come from d_type, so regular files and directories cost no
+ * stat call; only filesystems that report DT_UNKNOWN, and symlinks, fall
+ * back to fstatat. Symlinks to files are listed as files; symlinks to
+ * directories are not descended into. Independent subtrees are walked in
+ * parallel on the shared thread pool. Missing roots and unreadable
+ * directories are skipped.
+ *
+ * @param base  Directory the roots and results are relative to.
+ * @param roots Relative roots to walk. An empty string walks base itself.
+ * @return The combined scan.
+ */
+TreeScan walk_trees(const std::filesystem::path& base,
+                    const std::vector<std::string>& roots);
+
+}  // namespace daemonmake
+
+#endif
@@ -0,0 +1,28 @@
+#include "daemonmake/binary_io.hpp"
+
+#include <stdexcept>
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+void write_file_atomically(const fs::path& file_path,
+                           const std::function<void(std::ostream&)>& write) {
+  fs::create_directories(file_path.parent_path());
+
+  const fs::path tmp_path{file_path.string() + ".tmp"};
+  std::ofstream out{tmp_path, std::ios::binary | std::ios::trunc};
+  if (!out)
+    throw std::runtime_error("Failed to open " + tmp_path.string() +
+                             " for writing");
+
+  write(out);
+
+  out.close();
+  if (!out)
+    throw std::runtime_error("Failed to write " + tmp_path.string());
+
+  fs::rename(tmp_path, file_path);
+}
+
+}  // namespace daemonmake
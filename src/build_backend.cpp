@@ -0,0 +1,371 @@
+#include "daemonmake/build_backend.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <span>
+#include <sstream>
+#include <unordered_set>
+
+#include "daemonmake/logger.hpp"
+#include "daemonmake/ninja_log.hpp"
+#include "daemonmake/subprocess.hpp"
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::string_view ninja_generator{"Ninja"};
+
+bool on_path(std::string_view program) {
+  const char* path{std::getenv("PATH")};
+  if (!path) return false;
+
+  std::istringstream dirs{path};
+  std::string dir;
+  while (std::getline(dirs, dir, ':')) {
+    const auto candidate{(dir.empty() ? fs::path{"."} : fs::path{dir}) /
+                         program};
+    if (::access(candidate.c_str(), X_OK) == 0) return true;
+  }
+  return false;
+}
+
+std::string join_command(const std::vector<std::string>& argv) {
+  std::string cmd;
+  for (const auto& arg : argv) {
+    if (!cmd.empty()) cmd += ' ';
+    cmd += arg;
+  }
+  return cmd;
+}
+
+int run_logged(const std::vector<std::string>& argv) {
+  if (log_enabled(LogLevel::Info))
+    log_info("{command}", {{"command", join_command(argv)}});
+  return run_subprocess(argv);
+}
+
+/**
+ * Extracts the target from a CMake object path, such as
+ * "CMakeFiles/app.dir/src/main.cpp.o".
+ *
+ * @return The target name, or an empty view for other outputs.
+ */
+std::string_view object_target(std::string_view output) {
+  constexpr std::string_view objects{"CMakeFiles/"};
+  const auto start{output.find(objects)};
+  if (start == std::string_view::npos) return {};
+  output.remove_prefix(start + objects.size());
+  const auto end{output.find(".dir/")};
+  return end == std::string_view::npos ? std::string_view{}
+                                       : output.substr(0, end);
+}
+
+/**
+ * Runs the build tool for some targets and reports each one to the
+ * request's callback, timed from the steps ninja logged meanwhile.
+ */
+int build_batch(const BuildRequest& request, std::span<const std::string> batch,
+                NinjaLogTail& ninja_log,
+                const std::function<int(const std::vector<std::string>&)>& run) {
+  const int rc{run({batch.begin(), batch.end()})};
+  if (!request.on_target_built) return rc;
+
+  // Steps of one target overlap, so its time is from its first start to
+  // its last end. A recompacted log mixes in older builds; skip its times.
+  std::map<std::string_view, std::pair<std::int64_t, std::int64_t>> spans;
+  bool restarted{};
+  auto entries{ninja_log.read_new(&restarted)};
+  if (restarted) entries.clear();
+  for (const auto& entry : entries) {
+    const auto target{object_target(entry.output)};
+    if (target.empty()) continue;
+    const auto [it, inserted]{
+        spans.try_emplace(target, entry.start_ms, entry.end_ms)};
+    if (inserted) continue;
+    it->second.first = std::min(it->second.first, entry.start_ms);
+    it->second.second = std::max(it->second.second, entry.end_ms);
+  }
+
+  for (const auto& target : batch) {
+    const auto it{spans.find(target)};
+    if (it != spans.end())
+      request.on_target_built(
+          target, rc,
+          std::chrono::milliseconds{it->second.second - it->second.first});
+    else if (rc != 0)
+      request.on_target_built(target, rc, {});
+  }
+  return rc;
+}
+
+/**
+ * Runs the build tool for the request's first batch, then for the rest, or
+ * once for everything when there is no split.
+ *
+ * @param request         The request, for its split and callback.
+ * @param targets         The targets to pass; empty builds everything.
+ * @param build_directory Where ninja logs its steps, if it is the tool.
+ * @param keep_going      Whether to build the rest after a failed batch.
+ * @param run             Runs the build tool for some targets.
+ * @return The first non-zero exit code, or 0.
+ */
+int build_targets(
+    const BuildRequest& request, const std::vector<std::string>& targets,
+    const fs::path& build_directory, bool keep_going,
+    const std::function<int(const std::vector<std::string>&)>& run) {
+  if (targets.empty()) return run(targets);
+
+  NinjaLogTail ninja_log{build_directory};
+  if (request.on_target_built) ninja_log.skip_to_end();
+
+  const std::span<const std::string> all{targets};
+  const auto split{request.first_batch < targets.size() ? request.first_batch
+                                                        : 0};
+  if (split == 0) return build_batch(request, all, ninja_log, run);
+
+  const int rc{build_batch(request, all.first(split), ninja_log, run)};
+  if (rc != 0 && !keep_going) return rc;
+  const int rest{build_batch(request, all.subspan(split), ninja_log, run)};
+  return rc != 0 ? rc : rest;
+}
+
+/**
+ * `cmake --build`, after a configure step on every call.
+ */
+class CMakeBackend : public BuildBackend {
+ public:
+  explicit CMakeBackend(const Config& cfg) : cfg_{cfg} {}
+
+  int build(const BuildRequest& request) override {
+    fs::create_directories(cfg_.build_directory);
+
+    int rc{run_logged({"cmake", "-S", cfg_.project_root.string(), "-B",
+                       cfg_.build_directory.string()})};
+    if (rc != 0) {
+      log_error("CMake configuration failed (rc={rc})", {{"rc", rc}});
+    }
+
+    return build_targets(request, request.targets, cfg_.build_directory,
+                         cfg_.keep_going,
+                         [this](const std::vector<std::string>& targets) {
+                           return build_tool(targets);
+                         });
+  }
+
+  std::optional<std::vector<std::string>> pending(const BuildRequest&) override {
+    return std::nullopt;
+  }
+
+  std::string_view name() const override { return build_backend_cmake; }
+
+ private:
+  int build_tool(const std::vector<std::string>& targets) const {
+    std::vector<std::string> argv{"cmake", "--build",
+                                  cfg_.build_directory.string()};
+    if (cfg_.build_jobs > 0)
+      argv.insert(argv.end(), {"--parallel", std::to_string(cfg_.build_jobs)});
+    if (!targets.empty()) {
+      argv.emplace_back("--target");
+      argv.insert(argv.end(), targets.begin(), targets.end());
+    }
+    // cmake --build has no portable keep-going switch; pass the native one.
+    if (cfg_.keep_going) {
+      const auto generator{cached_generator(cfg_.build_directory)};
+      if (generator == ninja_generator)
+        argv.insert(argv.end(), {"--", "-k", "0"});
+      else if (generator.ends_with("Makefiles"))
+        argv.insert(argv.end(), {"--", "-k"});
+    }
+
+    const int rc{run_logged(argv)};
+    if (rc != 0) {
+      log_error("CMake build failed (rc={rc})", {{"rc", rc}});
+    }
+    return rc;
+  }
+
+  Config cfg_;
+};
+
+/**
+ * The Ninja generator, driven by calling ninja directly.
+ *
+ * CMake only runs when the tree has no build.ninja yet; after that the
+ * manifest's own regeneration rule re-runs CMake when CMakeLists.txt
+ * changes, so a cycle with no structural change is a single ninja call.
+ */
+class NinjaBackend : public BuildBackend {
+ public:
+  explicit NinjaBackend(const Config& cfg) : cfg_{cfg} {}
+
+  int build(const BuildRequest& request) override {
+    if (!ensure_configured()) return 1;
+
+    return build_targets(request, known_targets(request),
+                         cfg_.build_directory, cfg_.keep_going,
+                         [this](const std::vector<std::string>& targets) {
+                           return build_tool(targets);
+                         });
+  }
+
+  std::optional<std::vector<std::string>> pending(
+      const BuildRequest& request) override {
+    if (!fs::exists(cfg_.build_directory / "build.ninja")) return std::nullopt;
+
+    // Brings the log's output mtimes up to date, so outputs rewritten
+    // outside ninja are not reported as stale. Racing a concurrent build's
+    // log append at worst costs that build a redundant step next time.
+    std::string output;
+    auto argv{ninja_command()};
+    argv.insert(argv.end(), {"-t", "restat"});
+    run_subprocess_capture(argv, output);
+
+    argv = ninja_command();
+    argv.push_back("-n");
+    const auto targets{known_targets(request)};
+    argv.insert(argv.end(), targets.begin(), targets.end());
+    output.clear();
+    if (run_subprocess_capture(argv, output) != 0) return std::nullopt;
+
+    // Steps print as "[i/n] description".
+    std::vector<std::string> steps;
+    std::istringstream lines{output};
+    std::string line;
+    while (std::getline(lines, line)) {
+      if (!line.starts_with('[')) continue;
+      const auto end{line.find("] ")};
+      if (end != std::string::npos) steps.push_back(line.substr(end + 2));
+    }
+    return steps;
+  }
+
+  std::string_view name() const override { return build_backend_ninja; }
+
+ private:
+  std::vector<std::string> ninja_command() const {
+    return {"ninja", "-C", cfg_.build_directory.string()};
+  }
+
+  int build_tool(const std::vector<std::string>& targets) const {
+    auto argv{ninja_command()};
+    if (cfg_.build_jobs > 0)
+      argv.insert(argv.end(), {"-j", std::to_string(cfg_.build_jobs)});
+    if (cfg_.keep_going) argv.insert(argv.end(), {"-k", "0"});
+    argv.insert(argv.end(), targets.begin(), targets.end());
+
+    const int rc{run_logged(argv)};
+    if (rc != 0)
+      log_error("ninja failed (rc={rc})", {{"rc", rc}});
+    return rc;
+  }
+
+  /**
+   * Generates build.ninja if it is missing. A tree configured with another
+   * generator is wiped first, since CMake refuses to switch in place.
+   */
+  bool ensure_configured() {
+    if (fs::exists(cfg_.build_directory / "build.ninja")) return true;
+
+    const auto generator{cached_generator(cfg_.build_directory)};
+    if (!generator.empty() && generator != ninja_generator) {
+      log_info("Reconfiguring {build_directory} from {generator} to Ninja",
+               {{"build_directory", cfg_.build_directory.string()},
+                {"generator", generator}});
+      fs::remove(cfg_.build_directory / "CMakeCache.txt");
+      fs::remove_all(cfg_.build_directory / "CMakeFiles");
+    }
+
+    fs::create_directories(cfg_.build_directory);
+    const int rc{run_logged({"cmake", "-S", cfg_.project_root.string(), "-B",
+                             cfg_.build_directory.string(), "-G",
+                             std::string{ninja_generator}})};
+    if (rc != 0) {
+      log_error("CMake configuration failed (rc={rc})", {{"rc", rc}});
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Returns the requested targets if ninja knows every one of them, and
+   * nothing (build all) otherwise, e.g. when a target was added since the
+   * manifest was last generated.
+   */
+  std::vector<std::string> known_targets(const BuildRequest& request) {
+    if (request.targets.empty()) return {};
+
+    // The list only changes with the manifest, so it is read again only
+    // when build.ninja was rewritten.
+    std::error_code ec;
+    const auto mtime{
+        fs::last_write_time(cfg_.build_directory / "build.ninja", ec)};
+    if (ec || !known_mtime_ || *known_mtime_ != mtime) {
+      std::string output;
+      auto argv{ninja_command()};
+      argv.insert(argv.end(), {"-t", "targets", "all"});
+      if (run_subprocess_capture(argv, output) != 0) return {};
+
+      // Lines read "<output>: <rule>".
+      known_.clear();
+      std::istringstream lines{output};
+      std::string line;
+      while (std::getline(lines, line)) {
+        const auto colon{line.rfind(": ")};
+        if (colon != std::string::npos) known_.insert(line.substr(0, colon));
+      }
+      known_mtime_ = ec ? std::nullopt : std::optional{mtime};
+    }
+
+    const bool all_known{std::all_of(
+        request.targets.begin(), request.targets.end(),
+        [&](const std::string& target) { return known_.count(target) != 0; })};
+    return all_known ? request.targets : std::vector<std::string>{};
+  }
+
+  Config cfg_;
+  // What `ninja -t targets all` listed for the build.ninja of known_mtime_.
+  std::unordered_set<std::string> known_;
+  std::optional<fs::file_time_type> known_mtime_;
+};
+
+}  // namespace
+
+std::unique_ptr<BuildBackend> make_build_backend(const Config& cfg,
+                                                 bool modules) {
+  if (modules && cfg.build_backend != build_backend_ninja) {
+    if (on_path("ninja")) {
+      log_info("C++20 modules need the Ninja generator; building with ninja");
+      return std::make_unique<NinjaBackend>(cfg);
+    }
+    log_warning(
+        "C++20 modules need the Ninja generator but no ninja executable is on "
+        "PATH; CMake will refuse to configure");
+  } else if (cfg.build_backend == build_backend_ninja) {
+    if (on_path("ninja")) return std::make_unique<NinjaBackend>(cfg);
+    log_warning(
+        "build_backend is ninja but no ninja executable is on PATH; using "
+        "cmake --build");
+  }
+  return std::make_unique<CMakeBackend>(cfg);
+}
+
+std::string cached_generator(const fs::path& build_directory) {
+  std::ifstream cache{build_directory / "CMakeCache.txt"};
+  constexpr std::string_view key{"CMAKE_GENERATOR:INTERNAL="};
+  std::string line;
+  while (std::getline(cache, line)) {
+    if (line.starts_with(key)) return line.substr(key.size());
+  }
+  return {};
+}
+
+}  // namespace daemonmake
@@ -0,0 +1,179 @@
+#include "daemonmake/build_history.hpp"
+
+#include <algorithm>
+#include <queue>
+#include <tuple>
+
+#include "daemonmake/binary_io.hpp"
+#include "daemonmake/include_scanner.hpp"
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char history_magic[4]{'D', 'M', 'B', 'H'};
+constexpr std::uint32_t history_version{1};
+
+// Weight of the newest build in the expected duration. High enough to
+// follow a target that grew, low enough that one slow build on a busy
+// machine does not reorder everything.
+constexpr double duration_smoothing{0.3};
+
+enum class Urgency : std::uint8_t { Edited, Failing, Other };
+
+}  // namespace
+
+std::optional<BuildHistory> BuildHistory::load(const fs::path& file_path) {
+  const MappedFile file{file_path};
+  if (!file.is_open()) return std::nullopt;
+
+  BinaryReader reader{file.contents()};
+  if (reader.bytes(sizeof(history_magic)) !=
+      std::string_view{history_magic, sizeof(history_magic)})
+    return std::nullopt;
+  if (reader.pod<std::uint32_t>() != history_version) return std::nullopt;
+
+  BuildHistory history;
+  const auto num_targets{reader.pod<std::uint32_t>()};
+  for (std::uint32_t i{}; i < num_targets && reader.ok; ++i) {
+    std::string name{reader.string()};
+    TargetBuildStats stats;
+    stats.expected_ms = reader.pod<double>();
+    stats.builds = reader.pod<std::uint32_t>();
+    stats.failures = reader.pod<std::uint32_t>();
+    stats.last_failed = reader.pod<std::uint8_t>() != 0;
+    history.targets_.emplace(std::move(name), stats);
+  }
+  if (!reader.ok) return std::nullopt;
+  return history;
+}
+
+void BuildHistory::save(const fs::path& file_path) const {
+  write_file_atomically(file_path, [&](std::ostream& out) {
+    out.write(history_magic, sizeof(history_magic));
+    write_pod(out, history_version);
+    write_pod(out, static_cast<std::uint32_t>(targets_.size()));
+    for (const auto& [name, stats] : targets_) {
+      write_string(out, name);
+      write_pod(out, stats.expected_ms);
+      write_pod(out, stats.builds);
+      write_pod(out, stats.failures);
+      write_pod(out, static_cast<std::uint8_t>(stats.last_failed));
+    }
+  });
+}
+
+void BuildHistory::record(std::string_view target,
+                          std::chrono::steady_clock::duration duration,
+                          bool succeeded) {
+  auto it{targets_.find(target)};
+  if (it == targets_.end())
+    it = targets_.emplace(std::string{target}, TargetBuildStats{}).first;
+  auto& stats{it->second};
+
+  ++stats.builds;
+  stats.last_failed = !succeeded;
+  if (!succeeded) {
+    ++stats.failures;
+    return;
+  }
+  const double ms{
+      std::chrono::duration<double, std::milli>{duration}.count()};
+  stats.expected_ms =
+      stats.expected_ms < 0
+          ? ms
+          : stats.expected_ms + duration_smoothing * (ms - stats.expected_ms);
+}
+
+const TargetBuildStats* BuildHistory::find(std::string_view target) const {
+  const auto it{targets_.find(target)};
+  return it == targets_.end() ? nullptr : &it->second;
+}
+
+std::vector<TargetId> schedule_targets(const TargetGraph& graph,
+                                       const TargetSet& targets,
+                                       std::span<const TargetId> edited,
+                                       const BuildHistory& history,
+                                       std::size_t* edited_count) {
+  const auto members{targets.to_vector()};
+  std::vector<Urgency> urgency(graph.size(), Urgency::Other);
+  std::vector<double> expected_ms(graph.size());
+  for (const auto id : members) {
+    if (const auto* stats{history.find(graph.name(id))}) {
+      expected_ms[id] = std::max(stats->expected_ms, 0.0);
+      if (stats->last_failed) urgency[id] = Urgency::Failing;
+    }
+  }
+
+  // An edited target cannot build before its dependencies in the set, so
+  // they share its urgency.
+  std::vector<TargetId> stack;
+  for (const auto id : edited) {
+    if (!targets.contains(id) || urgency[id] == Urgency::Edited) continue;
+    urgency[id] = Urgency::Edited;
+    stack.push_back(id);
+    while (!stack.empty()) {
+      const auto current{stack.back()};
+      stack.pop_back();
+      for (const auto dep : graph.dependencies(current)) {
+        if (!targets.contains(dep) || urgency[dep] == Urgency::Edited) continue;
+        urgency[dep] = Urgency::Edited;
+        stack.push_back(dep);
+      }
+    }
+  }
+  if (edited_count)
+    *edited_count = static_cast<std::size_t>(std::count(
+        urgency.begin(), urgency.end(), Urgency::Edited));
+
+  const auto key{[&](TargetId id) {
+    return std::tuple{urgency[id], expected_ms[id], id};
+  }};
+  const auto later{[&](TargetId a, TargetId b) { return key(a) > key(b); }};
+
+  // Kahn's algorithm with a priority queue: a target becomes ready once
+  // every dependency of it in the set is scheduled.
+  std::vector<std::uint32_t> waiting_on(graph.size());
+  std::priority_queue<TargetId, std::vector<TargetId>, decltype(later)> ready{
+      later};
+  for (const auto id : members) {
+    for (const auto dep : graph.dependencies(id))
+      if (dep != id && targets.contains(dep)) ++waiting_on[id];
+    if (waiting_on[id] == 0) ready.push(id);
+  }
+
+  std::vector<bool> scheduled(graph.size());
+  std::vector<TargetId> order;
+  order.reserve(members.size());
+  while (order.size() < members.size()) {
+    if (ready.empty()) {
+      // Only a dependency cycle stalls; release its most urgent member.
+      TargetId next{};
+      bool found{};
+      for (const auto id : members) {
+        if (scheduled[id] || (found && !later(next, id))) continue;
+        next = id;
+        found = true;
+      }
+      waiting_on[next] = 0;
+      ready.push(next);
+    }
+
+    const auto id{ready.top()};
+    ready.pop();
+    if (scheduled[id]) continue;
+    scheduled[id] = true;
+    order.push_back(id);
+    for (const auto dependent : graph.reverse_dependencies(id)) {
+      if (dependent == id || !targets.contains(dependent) ||
+          scheduled[dependent] || waiting_on[dependent] == 0)
+        continue;
+      if (--waiting_on[dependent] == 0) ready.push(dependent);
+    }
+  }
+  return order;
+}
+
+}  // namespace daemonmake
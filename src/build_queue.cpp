@@ -1,11 +1,14 @@
 #include "daemonmake/build_queue.hpp"
 
+#include <algorithm>
+
 namespace daemonmake {
 
 using clock = std::chrono::steady_clock;
-using namespace std::chrono_literals;
 
-BuildQueue::BuildQueue(size_t capacity) : capacity_{capacity} {}
+BuildQueue::BuildQueue(size_t capacity, std::chrono::milliseconds debounce,
+                       std::chrono::milliseconds hold_timeout)
+    : capacity_{capacity}, debounce_{debounce}, hold_timeout_{hold_timeout} {}
 
 void BuildQueue::push_event(const FileEvent& event) {
   std::unique_lock<std::mutex> lock{mtx_};
@@ -37,17 +40,25 @@ BuildQueue::Task BuildQueue::pop_all_events(const std::stop_token& token) {
       !needs_full_rebuild_)
     return {};
 
-  // For debouncing and trying to group more events
-  const auto debounce_timeout{1000ms};
+  // For debouncing and trying to group more events. A hold keeps the batch
+  // open, full rebuilds included, until it is released or times out.
+  while (!shutdown_ && !token.stop_requested()) {
+    const auto hold_deadline{held_since_ + hold_timeout_};
+    const bool holding{held_ && clock::now() < hold_deadline};
+    if (needs_full_rebuild_ && !holding) break;
 
-  while (!shutdown_ && !token.stop_requested() && !needs_full_rebuild_) {
     const auto last_push_before_sleep{last_event_pushed_};
-    const auto deadline{last_event_pushed_ + debounce_timeout};
+    const bool held_before_sleep{held_};
+    const auto deadline{
+        holding ? std::max(last_event_pushed_ + debounce_, hold_deadline)
+                : last_event_pushed_ + debounce_};
     cv_not_empty_.wait_until(
-        lock, token, deadline, [this, last_push_before_sleep] {
-          return shutdown_ || last_event_pushed_ != last_push_before_sleep;
+        lock, token, deadline,
+        [this, last_push_before_sleep, held_before_sleep] {
+          return shutdown_ || last_event_pushed_ != last_push_before_sleep ||
+                 held_ != held_before_sleep;
         });
-    if (last_push_before_sleep == last_event_pushed_ &&
+    if (!holding && last_push_before_sleep == last_event_pushed_ &&
         clock::now() >= deadline)
       break;
   }
@@ -60,6 +71,20 @@ BuildQueue::Task BuildQueue::pop_all_events(const std::stop_token& token) {
   return task;
 }
 
+void BuildQueue::hold(bool active) {
+  {
+    std::scoped_lock<std::mutex> lock{mtx_};
+    if (active && !held_) held_since_ = clock::now();
+    held_ = active;
+  }
+  cv_not_empty_.notify_all();
+}
+
+bool BuildQueue::has_pending_events() {
+  std::scoped_lock<std::mutex> lock{mtx_};
+  return !events_.empty() || needs_full_rebuild_;
+}
+
 void BuildQueue::shutdown() {
   {
     std::scoped_lock<std::mutex> lock{mtx_};
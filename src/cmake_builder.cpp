@@ -1,15 +1,21 @@
 #include "daemonmake/cmake_builder.hpp"
 
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <unistd.h>
+#include <fnmatch.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <sstream>
 #include <stdexcept>
 
+#include "daemonmake/build_backend.hpp"
+#include "daemonmake/compile_profile.hpp"
+#include "daemonmake/focus.hpp"
+
 namespace daemonmake {
 
 namespace fs = std::filesystem;
@@ -31,32 +37,156 @@ std::string extract_cxx_standard_number(const std::string& standard) {
   return digits;
 }
 
-int run_subprocess(const std::vector<std::string>& argv) {
-  if (argv.empty()) return 1;
+// Chooses the add_library() kind of every library in dev mode.
+//
+// A library with a single dependent gains nothing from being its own shared
+// object: its objects are folded into that dependent, which has to relink
+// on an edit either way. CMake does not forward the objects of an OBJECT
+// library through another OBJECT library, so that dependent must not be
+// one itself. Everything else becomes SHARED.
+std::map<std::string_view, std::string_view> dev_library_kinds(
+    const ProjectLayout& pl) {
+  std::map<std::string_view, std::vector<const Target*>> dependents;
+  for (const auto& t : pl.targets)
+    for (const auto& dep : t.dependencies) dependents[dep].push_back(&t);
+
+  std::map<std::string_view, std::string_view> kinds;
+  const std::function<std::string_view(const Target&)> kind_of{
+      [&](const Target& t) -> std::string_view {
+        if (t.type != TargetType::Library) return {};
+        const auto [it, inserted]{kinds.try_emplace(t.name, "SHARED")};
+        if (!inserted) return it->second;  // Known, or on a cycle.
+
+        const auto deps_it{dependents.find(t.name)};
+        if (deps_it != dependents.end() && deps_it->second.size() == 1 &&
+            kind_of(*deps_it->second.front()) != "OBJECT")
+          kinds[t.name] = "OBJECT";
+        return kinds[t.name];
+      }};
+  for (const auto& t : pl.targets) kind_of(t);
+  return kinds;
+}
 
-  std::vector<char*> args;
-  for (auto& arg : argv) {
-    args.push_back(const_cast<char*>(arg.c_str()));
+// Configure-time probes for the dev-fast profile. Every option is checked
+// against the actual toolchain, so a missing linker or an old compiler
+// only loses that one speed-up.
+void write_dev_fast_profile(std::ostream& oss, bool incremental_link_flags) {
+  oss << "# dev-fast profile: fastest available linker, split debug info\n";
+  oss << "include(CheckCXXCompilerFlag)\n";
+  oss << "include(CheckLinkerFlag)\n";
+  oss << "set(DAEMONMAKE_FUSE_LD \"\")\n";
+  oss << "set(DAEMONMAKE_LINKER default)\n";
+  oss << "# A linker is only probed once it is on PATH; one that went away\n";
+  oss << "# is forgotten, so installs and removals show up on reconfigure\n";
+  oss << "foreach(linker mold lld)\n";
+  oss << "    set(program DAEMONMAKE_LD_${linker}_PROGRAM)\n";
+  oss << "    if (${program} AND NOT EXISTS \"${${program}}\")\n";
+  oss << "        unset(${program} CACHE)\n";
+  oss << "        unset(DAEMONMAKE_HAVE_LD_${linker} CACHE)\n";
+  oss << "    endif()\n";
+  oss << "    find_program(${program} ld.${linker})\n";
+  oss << "    if (NOT ${program})\n";
+  oss << "        continue()\n";
+  oss << "    endif()\n";
+  oss << "    check_linker_flag(CXX \"-fuse-ld=${linker}\" "
+         "DAEMONMAKE_HAVE_LD_${linker})\n";
+  oss << "    if (DAEMONMAKE_HAVE_LD_${linker})\n";
+  oss << "        set(DAEMONMAKE_FUSE_LD -fuse-ld=${linker})\n";
+  oss << "        set(DAEMONMAKE_LINKER ${linker})\n";
+  oss << "        add_link_options(${DAEMONMAKE_FUSE_LD})\n";
+  oss << "        break()\n";
+  oss << "    endif()\n";
+  oss << "endforeach()\n";
+  oss << "message(STATUS \"daemonmake: linker flag '${DAEMONMAKE_FUSE_LD}'\")\n";
+  oss << "check_cxx_compiler_flag(-gsplit-dwarf DAEMONMAKE_HAVE_SPLIT_DWARF)\n";
+  oss << "if (DAEMONMAKE_HAVE_SPLIT_DWARF)\n";
+  oss << "    add_compile_options(-g -gsplit-dwarf)\n";
+  oss << "endif()\n";
+  oss << "# Linker-specific flags are probed with the chosen linker, and\n";
+  oss << "# cached per linker so that a different one is probed again\n";
+  oss << "set(DAEMONMAKE_LINK_PROBE ${DAEMONMAKE_FUSE_LD} -Wl,--gdb-index)\n";
+  oss << "check_linker_flag(CXX \"${DAEMONMAKE_LINK_PROBE}\" "
+         "DAEMONMAKE_HAVE_GDB_INDEX_${DAEMONMAKE_LINKER})\n";
+  oss << "if (DAEMONMAKE_HAVE_GDB_INDEX_${DAEMONMAKE_LINKER})\n";
+  oss << "    add_link_options(-Wl,--gdb-index)\n";
+  oss << "endif()\n";
+  if (incremental_link_flags) {
+    oss << "# Incremental-friendly: skip linker optimisation passes and let\n";
+    oss << "# dependents compile before the libraries they link are done\n";
+    oss << "set(CMAKE_OPTIMIZE_DEPENDENCIES ON)\n";
+    oss << "set(DAEMONMAKE_LINK_PROBE ${DAEMONMAKE_FUSE_LD} -Wl,-O0)\n";
+    oss << "check_linker_flag(CXX \"${DAEMONMAKE_LINK_PROBE}\" "
+           "DAEMONMAKE_HAVE_LINK_O0_${DAEMONMAKE_LINKER})\n";
+    oss << "if (DAEMONMAKE_HAVE_LINK_O0_${DAEMONMAKE_LINKER})\n";
+    oss << "    add_link_options(-Wl,-O0)\n";
+    oss << "endif()\n";
   }
-  args.push_back(nullptr);
+  oss << "\n";
+}
+
+// Per-TU timing for `daemonmake profile`. GCC prints its report on
+// stderr, so a launcher moves it next to the object file.
+void write_compile_time_profiling(std::ostream& oss) {
+  oss << "# Compile-time profiling, collected by `daemonmake profile`\n";
+  oss << "if (CMAKE_CXX_COMPILER_ID MATCHES \"Clang\")\n";
+  oss << "    add_compile_options(-ftime-trace)\n";
+  oss << "elseif (CMAKE_CXX_COMPILER_ID STREQUAL \"GNU\")\n";
+  oss << "    add_compile_options(-ftime-report)\n";
+  oss << "    set(CMAKE_CXX_COMPILER_LAUNCHER\n";
+  oss << "        ${CMAKE_CURRENT_SOURCE_DIR}/" << time_report_launcher_location
+      << "\n";
+  oss << "        ${CMAKE_CXX_COMPILER_LAUNCHER})\n";
+  oss << "endif()\n\n";
+}
 
-  pid_t pid{::fork()};
+bool glob_matches(const std::string& pattern, const std::string& name) {
+  return ::fnmatch(pattern.c_str(), name.c_str(), 0) == 0;
+}
 
-  if (pid < 0) {
-    return 1;
-  } else if (pid == 0) {
-    ::execvp(args[0], args.data());
-    ::_exit(127);
-  }
+// A pattern with a '/' matches source paths, otherwise target names.
+bool matches_sources(const FlagOverride& override) {
+  return override.match.find('/') != std::string::npos;
+}
 
-  // Parent
-  int status{};
-  if (waitpid(pid, &status, 0) < 0) {
-    return 1;
+void write_quoted_flags(std::ostream& oss,
+                        const std::vector<std::string>& flags) {
+  for (std::size_t i{}; i < flags.size(); ++i) {
+    oss << (i == 0 ? "\"" : " \"");
+    for (const char ch : flags[i]) {
+      if (ch == '"' || ch == '\\' || ch == '$') oss << '\\';
+      oss << ch;
+    }
+    oss << '"';
   }
+}
 
-  if (WIFEXITED(status)) return WEXITSTATUS(status);
-  return 1;
+// Flags for one target: focus flags first, then every matching override,
+// so explicit configuration wins.
+void write_target_flags(std::ostream& oss, const Config& cfg,
+                        const FocusSet& focus, const Target& t) {
+  if (cfg.focus_mode && focus.contains(t.name) && !cfg.focus_flags.empty()) {
+    oss << "target_compile_options(" << t.name << " PRIVATE ";
+    write_quoted_flags(oss, cfg.focus_flags);
+    oss << ")\n";
+  }
+  for (const auto& override : cfg.flag_overrides) {
+    if (override.flags.empty()) continue;
+    if (!matches_sources(override)) {
+      if (!glob_matches(override.match, t.name)) continue;
+      oss << "target_compile_options(" << t.name << " PRIVATE ";
+      write_quoted_flags(oss, override.flags);
+      oss << ")\n";
+      continue;
+    }
+    for (const auto& src : t.source_files) {
+      if (!glob_matches(override.match, src)) continue;
+      // Source properties apply after the target's options.
+      oss << "set_property(SOURCE " << src
+          << " APPEND PROPERTY COMPILE_OPTIONS ";
+      write_quoted_flags(oss, override.flags);
+      oss << ")\n";
+    }
+  }
 }
 
 }  // namespace
@@ -70,26 +200,11 @@ int cmake_build(const Config& cfg, const ProjectLayout& pl, bool overwrite) {
     write_cmakelists(cfg, pl, overwrite);
   }
 
-  const std::string configure_cmd{"cmake -S " + cfg.project_root.string() +
-                                  " -B " + cfg.build_directory.string()};
-
-  std::cout << "[daemonmake] " << configure_cmd << '\n';
-  int rc{run_subprocess({"cmake", "-S", cfg.project_root.string(), "-B",
-                         cfg.build_directory.string()})};
-  if (rc != 0) {
-    std::cerr << "daemonmake build: CMake configuration failed (rc=" << rc
-              << ")\n";
-  }
-
-  const std::string build_cmd{"cmake --build " + cfg.build_directory.string()};
-
-  std::cout << "[daemonmake] " << build_cmd << '\n';
-  rc = run_subprocess({"cmake", "--build", cfg.build_directory.string()});
-  if (rc != 0) {
-    std::cerr << "daemonmake build: CMake build failed (rc=" << rc << ")\n";
-  }
+  return make_build_backend(cfg, has_module_units(pl))->build({});
+}
 
-  return rc;
+int cmake_build(const Config& cfg) {
+  return make_build_backend(cfg)->build({});
 }
 
 // TODO: For future versions, add Conan/vcpkg support or update only specific
@@ -108,18 +223,64 @@ void write_cmakelists(const Config& cfg, const ProjectLayout& pl,
 
   const std::string cxx_std_num{extract_cxx_standard_number(cfg.cxx_standard)};
 
-  oss << "cmake_minimum_required(VERSION 3.20)\n";
+  // 3.28 scans every C++20 source for imports, so only projects that use
+  // modules pay for it.
+  const bool modules{has_module_units(pl)};
+  oss << "cmake_minimum_required(VERSION " << (modules ? "3.28" : "3.20")
+      << ")\n";
   oss << "project(" << pl.project_name << " LANGUAGES CXX)\n\n";
 
   oss << "set(CMAKE_CXX_STANDARD " << cxx_std_num << ")\n";
   oss << "set(CMAKE_CXX_STANDARD_REQUIRED ON)\n";
   oss << "set(CMAKE_CXX_EXTENSIONS OFF)\n\n";
 
+  if (modules) {
+    oss << "# C++20 modules: only the Ninja generator orders module builds\n";
+    oss << "if (NOT CMAKE_GENERATOR MATCHES \"Ninja\")\n";
+    oss << "    message(FATAL_ERROR \"C++20 modules need the Ninja generator "
+           "(build_backend \\\"ninja\\\")\")\n";
+    oss << "endif()\n\n";
+  }
+
   oss << "# Compiler configured by daemonmake\n";
   oss << "if (NOT CMAKE_CXX_COMPILER)\n";
   oss << "    set(CMAKE_CXX_COMPILER \"" << cfg.compiler << "\")\n";
   oss << "endif()\n\n";
 
+  if (cfg.build_profile == build_profile_dev_fast)
+    write_dev_fast_profile(oss, cfg.incremental_link_flags);
+
+  if (cfg.compile_time_profiling) {
+    write_time_report_launcher(cfg.project_root / time_report_launcher_location);
+    write_compile_time_profiling(oss);
+  }
+
+  const auto focus{cfg.focus_mode
+                       ? FocusSet::load(cfg.project_root / focus_default_location)
+                       : FocusSet{}};
+  if (cfg.focus_mode && !cfg.stable_flags.empty()) {
+    oss << "# Focus mode: targets edited recently (" << focus_default_location
+        << ")\n";
+    oss << "# compile with the focus flags, everything else with these\n";
+    oss << "add_compile_options(";
+    write_quoted_flags(oss, cfg.stable_flags);
+    oss << ")\n\n";
+  }
+
+  const bool dev_mode{cfg.build_mode == build_mode_dev};
+  if (dev_mode) {
+    oss << "# Development mode: libraries are shared so an edit relinks one\n";
+    oss << "# library, and executables are not relinked when it changes\n";
+    oss << "set(CMAKE_POSITION_INDEPENDENT_CODE ON)\n";
+    oss << "set(CMAKE_VISIBILITY_INLINES_HIDDEN ON)\n";
+    oss << "set(CMAKE_LINK_DEPENDS_NO_SHARED ON)\n";
+    oss << "set(CMAKE_SKIP_BUILD_RPATH OFF)\n";
+    oss << "set(CMAKE_BUILD_RPATH_USE_ORIGIN ON)\n\n";
+  }
+
+  const auto library_kinds{dev_mode ? dev_library_kinds(pl)
+                                    : std::map<std::string_view, std::string_view>{}};
+
   oss << "# Assume public headers live under include/\n";
   oss << "set(PROJECT_INCLUDE_DIR ${CMAKE_CURRENT_SOURCE_DIR}/include)\n\n";
 
@@ -134,18 +295,49 @@ void write_cmakelists(const Config& cfg, const ProjectLayout& pl,
     }
 
     oss << t.name;
-
-    if (!t.source_files.empty()) {
-      oss << "\n";
-      for (const auto& src : t.source_files) {
-        oss << "    " << src << "\n";
+    if (const auto kind{library_kinds.find(t.name)}; kind != library_kinds.end())
+      oss << ' ' << kind->second;
+
+    std::vector<std::string_view> interfaces;
+    bool listed_sources{};
+    for (const auto& src : t.source_files) {
+      if (is_module_interface(src)) {
+        interfaces.push_back(src);
+        continue;
       }
+      if (!listed_sources) oss << "\n";
+      listed_sources = true;
+      oss << "    " << src << "\n";
     }
 
     oss << ")\n\n";
 
+    // Importers of other targets need the interfaces, hence PUBLIC.
+    if (!interfaces.empty()) {
+      oss << "target_sources(" << t.name << "\n";
+      oss << "    PUBLIC\n";
+      oss << "        FILE_SET CXX_MODULES FILES\n";
+      for (const auto& src : interfaces) oss << "            " << src << "\n";
+      oss << ")\n";
+    }
+
     oss << "target_include_directories(" << t.name
-        << " PRIVATE ${PROJECT_INCLUDE_DIR})\n\n";
+        << " PRIVATE ${PROJECT_INCLUDE_DIR})\n";
+    write_target_flags(oss, cfg, focus, t);
+    oss << "\n";
+  }
+
+  const bool has_tests{std::any_of(
+      pl.targets.begin(), pl.targets.end(),
+      [](const Target& t) { return t.type == TargetType::Test; })};
+  if (has_tests) {
+    oss << "# Tests discovered by daemonmake\n\n";
+    oss << "enable_testing()\n";
+    for (const auto& t : pl.targets) {
+      if (t.type == TargetType::Test)
+        oss << "add_test(NAME " << t.name << " COMMAND " << t.name << ")\n";
+    }
+    oss << "\n";
   }
 
   oss << "# Inferred dependencies between targets\n\n";
@@ -161,6 +353,14 @@ void write_cmakelists(const Config& cfg, const ProjectLayout& pl,
     oss << ")\n\n";
   }
 
+  // Rewriting identical content would still bump the mtime and make the
+  // next build reconfigure for nothing.
+  const auto content{oss.str()};
+  if (std::ifstream existing{cmake_path}) {
+    const std::string current{std::istreambuf_iterator<char>{existing}, {}};
+    if (current == content) return;
+  }
+
   fs::create_directories(cmake_path.parent_path());
 
   std::ofstream out{cmake_path};
@@ -169,7 +369,7 @@ void write_cmakelists(const Config& cfg, const ProjectLayout& pl,
                              " for writing CMakeLists.txt");
   }
 
-  out << oss.str();
+  out << content;
   out.flush();
   if (!out) {
     throw std::runtime_error("Failed to write CMakeLists.txt to " +
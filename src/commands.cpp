@@ -1,16 +1,26 @@
 #include "daemonmake/commands.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <csignal>
+#include <ctime>
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
 #include <thread>
 
+#include "daemonmake/build_backend.hpp"
 #include "daemonmake/cmake_builder.hpp"
+#include "daemonmake/compile_profile.hpp"
 #include "daemonmake/config.hpp"
 #include "daemonmake/daemon.hpp"
+#include "daemonmake/file_watcher.hpp"
+#include "daemonmake/header_index.hpp"
+#include "daemonmake/logger.hpp"
 #include "daemonmake/project.hpp"
+#include "daemonmake/ram_build.hpp"
+#include "daemonmake/target_graph.hpp"
 
 namespace daemonmake {
 
@@ -37,6 +47,8 @@ void print_project_summary(const Config& cfg, const ProjectLayout& pl) {
     std::cout << "  - ";
     if (t.type == TargetType::Library) {
       std::cout << "lib ";
+    } else if (t.type == TargetType::Test) {
+      std::cout << "test ";
     } else {
       std::cout << "exe ";
     }
@@ -52,9 +64,40 @@ void print_project_summary(const Config& cfg, const ProjectLayout& pl) {
     std::cout << ")\n";
   }
 
+  const TargetGraph graph{pl};
+  for (const auto& [id, dep] : graph.unresolved_dependencies()) {
+    std::cout << "warning: " << graph.name(id) << " includes headers of "
+              << dep << ", which is not a target\n";
+  }
+  if (graph.has_cycle()) {
+    std::cout << "warning: dependency cycle among:";
+    for (const auto id : graph.cyclic_targets())
+      std::cout << " " << graph.name(id);
+    std::cout << "\n";
+  }
+
   std::cout << std::endl;
 }
 
+// Applies the config's log level, and its JSON log file if enabled.
+void configure_logging(const Config& cfg) {
+  LogOptions options{*parse_log_level(cfg.log_level), {}};
+  if (cfg.log_file) options.json_file = cfg.project_root / log_default_location;
+  daemonmake::configure_logging(options);
+}
+
+double seconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+
+// Nearest-rank percentile of sorted samples.
+std::chrono::nanoseconds percentile(
+    const std::vector<std::chrono::nanoseconds>& sorted, double fraction) {
+  const auto rank{static_cast<std::size_t>(
+      fraction * static_cast<double>(sorted.size() - 1) + 0.5)};
+  return sorted[rank];
+}
+
 }  // namespace
 
 int run_init(const std::string& root_arg) {
@@ -66,7 +109,7 @@ int run_init(const std::string& root_arg) {
 
     ProjectLayout pl{make_project_layout(cfg.project_root)};
     discover_targets(cfg, pl);
-    infer_target_dependencies(pl);
+    infer_target_dependencies(pl, {cfg.include_scan_preamble_only});
 
     print_project_summary(cfg, pl);
     return 0;
@@ -84,7 +127,7 @@ int run_status(const std::string& root_arg) {
 
     ProjectLayout pl{make_project_layout(cfg.project_root)};
     discover_targets(cfg, pl);
-    infer_target_dependencies(pl);
+    infer_target_dependencies(pl, {cfg.include_scan_preamble_only});
 
     print_project_summary(cfg, pl);
     return 0;
@@ -99,12 +142,16 @@ int run_build(const std::string& root_arg) {
   try {
     fs::path resolved_root{resolve_root(root_arg)};
     Config cfg{load_config(resolved_root)};
+    configure_logging(cfg);
+    redirect_build_directory(cfg);
 
     ProjectLayout pl{make_project_layout(cfg.project_root)};
     discover_targets(cfg, pl);
-    infer_target_dependencies(pl);
+    infer_target_dependencies(pl, {cfg.include_scan_preamble_only});
 
-    return cmake_build(cfg, pl);
+    const int rc{cmake_build(cfg, pl)};
+    if (cfg.compile_time_profiling) update_compile_profile(cfg);
+    return rc;
   } catch (const std::exception& ex) {
     std::cerr << "daemonmake build failed: " << ex.what() << '\n';
     return 1;
@@ -118,7 +165,7 @@ int run_generate_cmake(const std::string& root_arg) {
 
     ProjectLayout pl{make_project_layout(cfg.project_root)};
     discover_targets(cfg, pl);
-    infer_target_dependencies(pl);
+    infer_target_dependencies(pl, {cfg.include_scan_preamble_only});
 
     write_cmakelists(cfg, pl);
     return 0;
@@ -128,6 +175,150 @@ int run_generate_cmake(const std::string& root_arg) {
   }
 }
 
+int run_why(const std::string& file_arg, const std::string& root_arg) {
+  try {
+    fs::path resolved_root{resolve_root(root_arg)};
+    Config cfg{load_config(resolved_root)};
+    redirect_build_directory(cfg);
+
+    ProjectLayout pl{make_project_layout(cfg.project_root)};
+    discover_targets(cfg, pl);
+    infer_target_dependencies(pl, {cfg.include_scan_preamble_only});
+    const TargetGraph graph{pl};
+
+    auto index{HeaderIndex::load(cfg.project_root /
+                                 header_index_default_location)};
+    if (!index || index->empty()) index = HeaderIndex::harvest(cfg);
+    if (index->empty()) {
+      std::cerr << "daemonmake why: no dependency information found in "
+                << cfg.build_directory << "; build the project first.\n";
+      return 1;
+    }
+
+    const auto rel_path{
+        fs::weakly_canonical(fs::absolute(file_arg))
+            .lexically_relative(cfg.project_root)
+            .generic_string()};
+    const auto tus{index->translation_units_for(rel_path)};
+
+    std::cout << rel_path << " is compiled into " << tus.size()
+              << " translation unit(s):\n";
+    for (const auto tu : tus) std::cout << "  " << tu << "\n";
+
+    const auto recompiled{targets_for_translation_units(pl, tus)};
+
+    // Everything that links a recompiled target, directly or not, relinks.
+    std::vector<TargetId> changed;
+    for (const auto& name : recompiled) {
+      if (const auto id{graph.find(name)}) changed.push_back(*id);
+    }
+    std::vector<std::string> relinked;
+    for (const auto id : graph.affected(changed).to_vector()) {
+      if (!std::binary_search(recompiled.begin(), recompiled.end(),
+                              graph.name(id)))
+        relinked.push_back(graph.name(id));
+    }
+
+    std::cout << "Targets recompiled:";
+    for (const auto& name : recompiled) std::cout << " " << name;
+    std::cout << "\nTargets relinked:";
+    for (const auto& name : relinked) std::cout << " " << name;
+    std::cout << "\n";
+
+    // What is already out of date, as the build tool itself sees it.
+    if (const auto steps{make_build_backend(cfg)->pending({})}) {
+      std::cout << "Pending build steps: " << steps->size() << "\n";
+      for (const auto& step : *steps) std::cout << "  " << step << "\n";
+    }
+    std::cout << std::flush;
+    return 0;
+  } catch (const std::exception& ex) {
+    std::cerr << "daemonmake why failed: " << ex.what() << '\n';
+    return 1;
+  }
+}
+
+int run_profile(const std::string& root_arg) {
+  constexpr std::size_t top{10};
+  constexpr std::size_t history_shown{10};
+
+  try {
+    fs::path resolved_root{resolve_root(root_arg)};
+    Config cfg{load_config(resolved_root)};
+    redirect_build_directory(cfg);
+
+    // Picks up traces from builds the daemon did not run.
+    const auto profile{update_compile_profile(cfg)};
+    const auto& tus{profile.translation_units()};
+    if (tus.empty()) {
+      std::cerr << "daemonmake profile: no compile-time traces found in "
+                << cfg.build_directory
+                << "; set \"compile_time_profiling\": true and build.\n";
+      return 1;
+    }
+
+    double total_ms{};
+    for (const auto& [source, tu] : tus) total_ms += tu.total_ms;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << tus.size() << " translation unit(s), " << total_ms / 1000.0
+              << " s of compile time\n";
+
+    std::cout << "\nSlowest translation units:\n";
+    for (const auto* tu : profile.slowest_translation_units(top)) {
+      std::cout << "  " << std::setw(10) << tu->total_ms << " ms  "
+                << tu->source << " (frontend " << tu->frontend_ms
+                << " ms, templates " << tu->template_ms << " ms, backend "
+                << tu->backend_ms << " ms";
+      if (tu->previous_total_ms >= 0)
+        std::cout << ", " << std::showpos
+                  << tu->total_ms - tu->previous_total_ms << std::noshowpos
+                  << " ms since last compile";
+      std::cout << ")\n";
+    }
+
+    const auto headers{profile.expensive_headers(top)};
+    if (!headers.empty()) {
+      std::cout << "\nMost expensive headers (parse time incl. nested "
+                   "includes):\n";
+      for (const auto& header : headers)
+        std::cout << "  " << std::setw(10) << header.total_ms << " ms  "
+                  << header.name << " (" << header.count << " TU(s))\n";
+    }
+
+    const auto templates{profile.slowest_templates(top)};
+    if (!templates.empty()) {
+      std::cout << "\nSlowest template instantiations:\n";
+      for (const auto& instantiation : templates)
+        std::cout << "  " << std::setw(10) << instantiation.total_ms << " ms  "
+                  << instantiation.name << " (" << instantiation.count
+                  << " TU(s))\n";
+    }
+    if (headers.empty() && templates.empty())
+      std::cout << "\nPer-header and per-template times need clang's "
+                   "-ftime-trace.\n";
+
+    const auto& history{profile.history()};
+    std::cout << "\nHistory:\n";
+    for (auto it{history.size() > history_shown ? history.end() - history_shown
+                                                : history.begin()};
+         it != history.end(); ++it) {
+      const std::time_t time{static_cast<std::time_t>(it->time)};
+      std::tm local{};
+      ::localtime_r(&time, &local);
+      std::cout << "  " << std::put_time(&local, "%Y-%m-%d %H:%M:%S") << "  "
+                << std::setw(10) << it->total_ms / 1000.0 << " s total, "
+                << it->template_ms / 1000.0 << " s templates, "
+                << it->recompiled << " of " << it->translation_units
+                << " TU(s) recompiled\n";
+    }
+    return 0;
+  } catch (const std::exception& ex) {
+    std::cerr << "daemonmake profile failed: " << ex.what() << '\n';
+    return 1;
+  }
+}
+
 int run_daemon(const std::string& root_arg) {
   using namespace std::chrono_literals;
 
@@ -135,20 +326,21 @@ int run_daemon(const std::string& root_arg) {
   try {
     fs::path resolved_root{resolve_root(root_arg)};
     Config cfg{load_config(resolved_root)};
+    configure_logging(cfg);
 
     std::signal(SIGINT, handle_sigint);
 
     Daemon dmon{cfg};
     // Start background threads
     dmon.run();
-    std::cout << "[daemonmake] daemon running. Press Ctrl+C to stop.\n";
+    log_info("daemon running. Press Ctrl+C to stop.");
 
     while (!g_stop.load(std::memory_order_relaxed)) {
       std::this_thread::sleep_for(50ms);
     }
 
     dmon.stop();
-    std::cout << "[daemonmake] daemon shut down.\n";
+    log_info("daemon shut down.");
     return 0;
   } catch (const std::exception& ex) {
     std::cerr << "daemonmake daemon failed: " << ex.what() << '\n';
@@ -156,4 +348,76 @@ int run_daemon(const std::string& root_arg) {
   }
 }
 
-}  // namespace daemonmake
\ No newline at end of file
+int run_record(const std::string& trace_arg, const std::string& root_arg) {
+  using namespace std::chrono_literals;
+
+  try {
+    fs::path resolved_root{resolve_root(root_arg)};
+    Config cfg{load_config(resolved_root)};
+
+    std::signal(SIGINT, handle_sigint);
+
+    FileWatcher watcher{cfg.project_root,
+                        walk_trees(cfg.project_root, project_tree_roots(cfg)),
+                        cfg.file_watcher};
+    EventTraceWriter writer{trace_arg, cfg.project_root};
+    std::cout << "[daemonmake] Recording to " << trace_arg
+              << ". Press Ctrl+C to stop.\n";
+
+    while (!g_stop.load(std::memory_order_relaxed))
+      writer.write(watcher.wait_for_events());
+
+    std::cout << "[daemonmake] Recorded " << writer.size() << " event(s).\n";
+    return 0;
+  } catch (const std::exception& ex) {
+    std::cerr << "daemonmake record failed: " << ex.what() << '\n';
+    return 1;
+  }
+}
+
+int run_replay(const std::string& trace_arg, const ReplayOptions& options) {
+  const auto events{load_event_trace(trace_arg)};
+  if (!events) {
+    std::cerr << "daemonmake replay: " << trace_arg
+              << " is not a daemonmake event trace\n";
+    return 1;
+  }
+
+  std::cout << "Replaying " << events->size() << " event(s) at "
+            << options.speed << "x with a " << options.debounce.count()
+            << " ms debounce and " << options.build_time.count()
+            << " ms builds\n";
+  const auto report{replay_event_trace(*events, options)};
+
+  std::size_t full{};
+  std::size_t discovery{};
+  std::size_t wasted{};
+  std::cout << std::fixed << std::setprecision(3);
+  for (const auto& build : report.builds) {
+    std::cout << "  " << std::setw(10) << seconds(build.start) << "s  "
+              << (build.full_rebuild ? "full rebuild"
+                                     : std::to_string(build.events) +
+                                           " file(s)");
+    if (build.discovery) std::cout << ", discovery";
+    if (build.wasted) std::cout << ", wasted";
+    std::cout << '\n';
+    full += build.full_rebuild;
+    discovery += build.discovery;
+    wasted += build.wasted;
+  }
+
+  std::cout << "Builds: " << report.builds.size() << " (" << full
+            << " full, " << discovery << " with discovery, " << wasted
+            << " wasted)\n";
+  if (!report.latencies.empty()) {
+    auto latencies{report.latencies};
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "Event-to-build latency: median "
+              << seconds(percentile(latencies, 0.5)) << "s, p90 "
+              << seconds(percentile(latencies, 0.9)) << "s, max "
+              << seconds(latencies.back()) << "s\n";
+  }
+  return 0;
+}
+
+}  // namespace daemonmake
@@ -0,0 +1,311 @@
+#include "daemonmake/compact_layout.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+namespace daemonmake {
+
+namespace {
+
+constexpr std::uint64_t child_key(FileId parent, std::uint32_t component) {
+  return (std::uint64_t{parent} << 32) | component;
+}
+
+template <typename Fn>
+void for_each_component(std::string_view rel_path, Fn&& fn) {
+  while (!rel_path.empty()) {
+    const auto slash{rel_path.find('/')};
+    const auto component{rel_path.substr(0, slash)};
+    if (!component.empty() && component != ".") {
+      if (!fn(component)) return;
+    }
+    if (slash == std::string_view::npos) break;
+    rel_path.remove_prefix(slash + 1);
+  }
+}
+
+}  // namespace
+
+PathTable::PathTable() {
+  components_.push_back({});
+  component_ids_.emplace(std::string_view{}, 0);
+  nodes_.push_back(Node{root, 0, root});
+  first_children_.push_back(root);
+}
+
+FileId PathTable::intern(std::string_view rel_path) {
+  FileId current{root};
+  for_each_component(rel_path, [&](std::string_view component) {
+    const auto component_id{intern_component(component)};
+    const auto [it, inserted]{children_.try_emplace(
+        child_key(current, component_id), static_cast<FileId>(nodes_.size()))};
+    if (inserted) {
+      nodes_.push_back(Node{
+          current, component_id,
+          first_children_[current].load(std::memory_order_relaxed)});
+      first_children_.push_back(root);
+      first_children_[current].store(it->second, std::memory_order_release);
+    }
+    current = it->second;
+    return true;
+  });
+  return current;
+}
+
+std::optional<FileId> PathTable::find(std::string_view rel_path) const {
+  FileId current{root};
+  bool found{true};
+  for_each_component(rel_path, [&](std::string_view component) {
+    const auto component_it{component_ids_.find(component)};
+    if (component_it == component_ids_.end()) return found = false;
+    const auto child_it{
+        children_.find(child_key(current, component_it->second))};
+    if (child_it == children_.end()) return found = false;
+    current = child_it->second;
+    return true;
+  });
+  if (!found) return std::nullopt;
+  return current;
+}
+
+std::optional<FileId> PathTable::find_frozen(std::string_view rel_path,
+                                             std::size_t count) const {
+  FileId current{root};
+  bool found{true};
+  for_each_component(rel_path, [&](std::string_view component) {
+    // Children added after the caller's view are at the front of the list.
+    auto child{first_children_[current].load(std::memory_order_acquire)};
+    while (child != root && (child >= count || filename(child) != component))
+      child = node(child).next_sibling;
+    if (child == root) return found = false;
+    current = child;
+    return true;
+  });
+  if (!found) return std::nullopt;
+  return current;
+}
+
+std::string PathTable::path(FileId id) const {
+  std::vector<std::string_view> parts;
+  std::size_t length{};
+  for (; id != root; id = node(id).parent) {
+    parts.push_back(filename(id));
+    length += parts.back().size() + 1;
+  }
+
+  std::string result;
+  result.reserve(length);
+  for (auto it{parts.rbegin()}; it != parts.rend(); ++it) {
+    if (!result.empty()) result.push_back('/');
+    result.append(*it);
+  }
+  return result;
+}
+
+std::size_t PathTable::memory_usage() const {
+  // Hash nodes cost roughly a key, a value and two pointers each.
+  constexpr std::size_t hash_node_overhead{2 * sizeof(void*)};
+  return string_bytes_ + components_.memory_usage() + nodes_.memory_usage() +
+         first_children_.memory_usage() +
+         component_ids_.size() *
+             (sizeof(std::string_view) + sizeof(std::uint32_t) +
+              hash_node_overhead) +
+         children_.size() *
+             (sizeof(std::uint64_t) + sizeof(FileId) + hash_node_overhead);
+}
+
+std::uint32_t PathTable::intern_component(std::string_view component) {
+  const auto it{component_ids_.find(component)};
+  if (it != component_ids_.end()) return it->second;
+
+  auto* chars{static_cast<char*>(strings_.allocate(component.size(), 1))};
+  std::memcpy(chars, component.data(), component.size());
+  string_bytes_ += component.size();
+
+  const std::string_view stored{chars, component.size()};
+  const auto id{static_cast<std::uint32_t>(components_.size())};
+  components_.push_back(stored);
+  component_ids_.emplace(stored, id);
+  return id;
+}
+
+template <typename T>
+std::span<T> CompactLayout::allocate(std::size_t count) {
+  arena_bytes_ += count * sizeof(T);
+  auto* data{static_cast<T*>(arena_->allocate(
+      std::max<std::size_t>(count, 1) * sizeof(T), alignof(T)))};
+  return {data, count};
+}
+
+std::string_view CompactLayout::copy_name(std::string_view name) {
+  auto chars{allocate<char>(name.size())};
+  std::copy(name.begin(), name.end(), chars.begin());
+  return {chars.data(), chars.size()};
+}
+
+std::span<FileId> CompactLayout::intern_files(
+    const std::vector<std::string>& files) {
+  auto out{allocate<FileId>(files.size())};
+  for (std::size_t i{}; i < files.size(); ++i) out[i] = paths_->intern(files[i]);
+  return out;
+}
+
+void CompactLayout::index_owners() {
+  owners_ = allocate<TargetId>(path_count_);
+  std::fill(owners_.begin(), owners_.end(), no_owner);
+  for (TargetId id{}; id < targets_.size(); ++id) {
+    for (const auto file : targets_[id].source_files) owners_[file] = id;
+    for (const auto file : targets_[id].header_files) owners_[file] = id;
+  }
+}
+
+CompactLayout::CompactLayout(const ProjectLayout& pl,
+                             std::shared_ptr<PathTable> paths)
+    : project_name_{pl.project_name},
+      project_root_{pl.project_root},
+      paths_{std::move(paths)},
+      arena_{std::make_shared<std::pmr::monotonic_buffer_resource>()} {
+  std::unordered_map<std::string_view, TargetId> ids;
+  for (TargetId id{}; id < pl.targets.size(); ++id)
+    ids.emplace(pl.targets[id].name, id);
+
+  targets_ = allocate<CompactTarget>(pl.targets.size());
+
+  for (TargetId id{}; id < pl.targets.size(); ++id) {
+    const auto& target{pl.targets[id]};
+
+    std::set<TargetId> dep_ids;
+    for (const auto& dep : target.dependencies) {
+      const auto it{ids.find(dep)};
+      if (it != ids.end() && it->second != id) dep_ids.insert(it->second);
+    }
+    auto deps{allocate<TargetId>(dep_ids.size())};
+    std::copy(dep_ids.begin(), dep_ids.end(), deps.begin());
+
+    new (&targets_[id]) CompactTarget{copy_name(target.name), target.type,
+                                      intern_files(target.source_files),
+                                      intern_files(target.header_files), deps};
+  }
+
+  path_count_ = paths_->size();
+  index_owners();
+}
+
+CompactLayout::CompactLayout(const CompactLayout& base,
+                             const std::vector<Target>& updated,
+                             const std::vector<std::string>& removed)
+    : project_name_{base.project_name_},
+      project_root_{base.project_root_},
+      paths_{base.paths_},
+      arena_{std::make_shared<std::pmr::monotonic_buffer_resource>()} {
+  // Each entry is either a target kept from base or an updated one.
+  struct Entry {
+    std::string_view name;
+    TargetType type;
+    const CompactTarget* kept;
+    const Target* updated;
+  };
+
+  std::unordered_map<std::string_view, const Target*> replaced;
+  for (const auto& target : updated) replaced.emplace(target.name, &target);
+
+  std::vector<Entry> entries;
+  entries.reserve(base.targets_.size() + updated.size());
+  for (const auto& target : base.targets_) {
+    if (replaced.count(target.name) == 0 &&
+        std::find(removed.begin(), removed.end(), target.name) == removed.end())
+      entries.push_back({target.name, target.type, &target, nullptr});
+  }
+  for (const auto& target : updated)
+    entries.push_back({target.name, target.type, nullptr, &target});
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const Entry& a, const Entry& b) {
+                     const auto rank_a{discovery_rank(a.type, a.name)};
+                     const auto rank_b{discovery_rank(b.type, b.name)};
+                     return rank_a != rank_b ? rank_a < rank_b : a.name < b.name;
+                   });
+
+  std::unordered_map<std::string_view, TargetId> ids;
+  for (TargetId id{}; id < entries.size(); ++id) ids.emplace(entries[id].name, id);
+
+  const auto copy_files{[this](std::span<const FileId> files) {
+    auto out{allocate<FileId>(files.size())};
+    std::copy(files.begin(), files.end(), out.begin());
+    return out;
+  }};
+
+  targets_ = allocate<CompactTarget>(entries.size());
+  for (TargetId id{}; id < entries.size(); ++id) {
+    const auto& entry{entries[id]};
+
+    std::set<TargetId> dep_ids;
+    const auto add_dep{[&](std::string_view name) {
+      const auto it{ids.find(name)};
+      if (it != ids.end() && it->second != id) dep_ids.insert(it->second);
+    }};
+    if (entry.kept) {
+      for (const auto dep : entry.kept->dependencies)
+        add_dep(base.targets_[dep].name);
+    } else {
+      for (const auto& dep : entry.updated->dependencies) add_dep(dep);
+    }
+    auto deps{allocate<TargetId>(dep_ids.size())};
+    std::copy(dep_ids.begin(), dep_ids.end(), deps.begin());
+
+    new (&targets_[id]) CompactTarget{
+        copy_name(entry.name), entry.type,
+        entry.kept ? copy_files(entry.kept->source_files)
+                   : intern_files(entry.updated->source_files),
+        entry.kept ? copy_files(entry.kept->header_files)
+                   : intern_files(entry.updated->header_files),
+        deps};
+  }
+
+  path_count_ = paths_->size();
+  index_owners();
+}
+
+ProjectLayout CompactLayout::to_project_layout() const {
+  ProjectLayout pl{project_name_, project_root_, {}};
+  pl.targets.reserve(targets_.size());
+
+  const auto expand{[this](std::span<const FileId> files) {
+    std::vector<std::string> out;
+    out.reserve(files.size());
+    for (const auto file : files) out.push_back(paths_->path(file));
+    return out;
+  }};
+
+  for (const auto& target : targets_) {
+    std::vector<std::string> deps;
+    deps.reserve(target.dependencies.size());
+    for (const auto dep : target.dependencies)
+      deps.emplace_back(targets_[dep].name);
+
+    pl.targets.push_back({std::string{target.name}, target.type,
+                          expand(target.source_files),
+                          expand(target.header_files), std::move(deps)});
+  }
+
+  return pl;
+}
+
+std::size_t CompactLayout::memory_usage() const {
+  return sizeof(*this) + project_name_.capacity() +
+         project_root_.native().capacity() + arena_bytes_;
+}
+
+std::vector<std::string> targets_for_translation_units(
+    const CompactLayout& layout, const std::vector<std::string_view>& tus) {
+  std::set<std::string> targets;
+  for (const auto tu : tus) {
+    const auto file{layout.find(tu)};
+    if (!file) continue;
+    if (const auto owner{layout.owner(*file)})
+      targets.emplace(layout.targets()[*owner].name);
+  }
+  return {targets.begin(), targets.end()};
+}
+
+}  // namespace daemonmake
@@ -0,0 +1,416 @@
+#include "daemonmake/compile_profile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <nlohmann/json.hpp>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "daemonmake/binary_io.hpp"
+#include "daemonmake/include_scanner.hpp"
+#include "daemonmake/logger.hpp"
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+constexpr char profile_magic[4]{'D', 'M', 'C', 'P'};
+constexpr std::uint32_t profile_version{1};
+
+constexpr std::string_view clang_trace_suffix{".json"};
+constexpr std::string_view gcc_report_suffix{".o.time-report"};
+
+// Keeps the stored profile small on projects with deep include trees.
+constexpr std::size_t max_entries_per_translation_unit{100};
+constexpr std::size_t max_history{200};
+
+constexpr std::string_view time_report_launcher{R"(#!/bin/sh
+# Generated by daemonmake: runs a compile with -ftime-report, saves GCC's
+# timing table as <object>.time-report and passes the rest of stderr on.
+object=
+previous=
+for arg in "$@"; do
+  if [ "$previous" = "-o" ]; then object=$arg; fi
+  previous=$arg
+done
+if [ -z "$object" ]; then exec "$@"; fi
+"$@" 2>"$object.stderr"
+status=$?
+awk -v report="$object.time-report" '
+  !in_report && /^[[:space:]]*$/ { blank = blank "\n"; next }
+  /^Time variable/ { in_report = 1; blank = "" }
+  in_report { print > report; if ($1 == "TOTAL") in_report = 0; next }
+  { printf "%s", blank > "/dev/stderr"; blank = ""; print > "/dev/stderr" }
+' "$object.stderr"
+rm -f "$object.stderr"
+exit $status
+)"};
+
+// Sums entries by name, sorts them slowest first and caps the list.
+std::vector<TimedEntry> top_entries(
+    const std::unordered_map<std::string, double>& totals) {
+  std::vector<TimedEntry> entries;
+  entries.reserve(totals.size());
+  for (const auto& [name, ms] : totals) entries.push_back({name, ms});
+  const auto keep{std::min(entries.size(), max_entries_per_translation_unit)};
+  std::partial_sort(entries.begin(), entries.begin() + keep, entries.end(),
+                    [](const auto& a, const auto& b) { return a.ms > b.ms; });
+  entries.resize(keep);
+  return entries;
+}
+
+std::string display_path(const std::string& path, const fs::path& root) {
+  const auto rel{fs::path{path}.lexically_normal().lexically_relative(root)};
+  if (rel.empty() || *rel.begin() == "..") return path;
+  return rel.generic_string();
+}
+
+// CMake places objects at CMakeFiles/<target>.dir/<source path>.o for
+// sources inside the project, and compilers write their traces beside.
+std::optional<std::string> trace_source(const fs::path& trace,
+                                        const fs::path& objects_root) {
+  const auto rel{trace.lexically_relative(objects_root)};
+  if (rel.empty() || *rel.begin() == "..") return std::nullopt;
+  if (!rel.begin()->string().ends_with(".dir")) return std::nullopt;
+
+  fs::path source;
+  for (auto it{std::next(rel.begin())}; it != rel.end(); ++it) source /= *it;
+  auto name{source.generic_string()};
+  for (const auto suffix : {gcc_report_suffix, clang_trace_suffix}) {
+    if (name.ends_with(suffix)) {
+      name.resize(name.size() - suffix.size());
+      return name;
+    }
+  }
+  return std::nullopt;
+}
+
+std::vector<ProfileHotspot> hotspots(
+    const std::map<std::string, TranslationUnitProfile>& tus,
+    std::vector<TimedEntry> TranslationUnitProfile::*entries,
+    std::size_t top) {
+  std::unordered_map<std::string_view, ProfileHotspot> totals;
+  for (const auto& [source, tu] : tus) {
+    for (const auto& entry : tu.*entries) {
+      auto& hotspot{totals[entry.name]};
+      hotspot.total_ms += entry.ms;
+      ++hotspot.count;
+    }
+  }
+
+  std::vector<ProfileHotspot> result;
+  result.reserve(totals.size());
+  for (auto& [name, hotspot] : totals) {
+    hotspot.name = name;
+    result.push_back(std::move(hotspot));
+  }
+  const auto keep{std::min(result.size(), top)};
+  std::partial_sort(
+      result.begin(), result.begin() + keep, result.end(),
+      [](const auto& a, const auto& b) { return a.total_ms > b.total_ms; });
+  result.resize(keep);
+  return result;
+}
+
+void write_entries(std::ostream& out, const std::vector<TimedEntry>& entries) {
+  write_pod(out, static_cast<std::uint32_t>(entries.size()));
+  for (const auto& entry : entries) {
+    write_string(out, entry.name);
+    write_pod(out, entry.ms);
+  }
+}
+
+std::vector<TimedEntry> read_entries(BinaryReader& reader) {
+  std::vector<TimedEntry> entries;
+  const auto count{reader.pod<std::uint32_t>()};
+  for (std::uint32_t i{}; i < count && reader.ok; ++i) {
+    auto& entry{entries.emplace_back()};
+    entry.name = reader.string();
+    entry.ms = reader.pod<double>();
+  }
+  return entries;
+}
+
+}  // namespace
+
+std::optional<TranslationUnitProfile> parse_clang_time_trace(
+    const fs::path& file, const fs::path& project_root) {
+  std::ifstream in{file};
+  if (!in) return std::nullopt;
+  // Braces would wrap the document in a one-element array.
+  const auto trace = json::parse(in, nullptr, false);
+  if (trace.is_discarded() || !trace.contains("traceEvents") ||
+      !trace["traceEvents"].is_array())
+    return std::nullopt;
+
+  TranslationUnitProfile profile;
+  std::unordered_map<std::string, double> headers;
+  std::unordered_map<std::string, double> templates;
+  for (const auto& event : trace["traceEvents"]) {
+    if (!event.is_object() || event.value("ph", "") != "X") continue;
+    const auto name{event.value("name", "")};
+    // Durations are in microseconds.
+    const double ms{event.value("dur", 0.0) / 1000.0};
+    std::string detail;
+    if (const auto args{event.find("args")};
+        args != event.end() && args->is_object())
+      detail = args->value("detail", "");
+
+    if (name == "Source") {
+      headers[display_path(detail, project_root)] += ms;
+    } else if (name == "InstantiateClass" || name == "InstantiateFunction") {
+      templates[detail] += ms;
+    } else if (name == "Total ExecuteCompiler") {
+      profile.total_ms = ms;
+    } else if (name == "Total Frontend") {
+      profile.frontend_ms = ms;
+    } else if (name == "Total Backend") {
+      profile.backend_ms = ms;
+    } else if (name == "Total InstantiateClass" ||
+               name == "Total InstantiateFunction") {
+      profile.template_ms += ms;
+    }
+  }
+  if (profile.total_ms == 0)
+    profile.total_ms = profile.frontend_ms + profile.backend_ms;
+
+  profile.headers = top_entries(headers);
+  profile.templates = top_entries(templates);
+  return profile;
+}
+
+std::optional<TranslationUnitProfile> parse_gcc_time_report(
+    std::string_view text) {
+  // Rows look like
+  //    phase parsing  :   0.20 ( 77%)   0.07 ( 88%)   0.28 ( 80%)  29M ( 84%)
+  // with usr, sys and wall seconds, then memory; percentages are skipped.
+  TranslationUnitProfile profile;
+  bool have_total{};
+  while (!text.empty()) {
+    const auto eol{text.find('\n')};
+    const auto line{text.substr(0, eol)};
+    text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+
+    const auto colon{line.find(':')};
+    if (colon == std::string_view::npos) continue;
+    auto name{line.substr(0, colon)};
+    name.remove_prefix(std::min(name.find_first_not_of(' '), name.size()));
+    name.remove_suffix(name.size() - (name.find_last_not_of(' ') + 1));
+
+    std::vector<double> seconds;
+    std::istringstream columns{std::string{line.substr(colon + 1)}};
+    for (std::string token; columns >> token;) {
+      if (token.front() == '(') {
+        // Skip to the end of the percentage.
+        while (token.back() != ')' && columns >> token) {
+        }
+        continue;
+      }
+      try {
+        std::size_t used{};
+        const double value{std::stod(token, &used)};
+        if (used == token.size()) seconds.push_back(value);
+      } catch (const std::exception&) {
+      }
+    }
+    if (seconds.size() < 3) continue;
+    const double wall_ms{seconds[2] * 1000.0};
+
+    if (name == "TOTAL") {
+      profile.total_ms = wall_ms;
+      have_total = true;
+    } else if (name == "phase parsing" || name == "phase lang. deferred") {
+      profile.frontend_ms += wall_ms;
+    } else if (name == "phase opt and generate") {
+      profile.backend_ms = wall_ms;
+    } else if (name == "template instantiation") {
+      profile.template_ms = wall_ms;
+    }
+  }
+  if (!have_total) return std::nullopt;
+  return profile;
+}
+
+void write_time_report_launcher(const fs::path& file) {
+  if (std::ifstream existing{file}) {
+    const std::string current{std::istreambuf_iterator<char>{existing}, {}};
+    if (current == time_report_launcher) return;
+  }
+
+  fs::create_directories(file.parent_path());
+  {
+    std::ofstream out{file};
+    out << time_report_launcher;
+    if (!out)
+      throw std::runtime_error("Failed to write " + file.string());
+  }
+  fs::permissions(file,
+                  fs::perms::owner_exec | fs::perms::group_exec |
+                      fs::perms::others_exec,
+                  fs::perm_options::add);
+}
+
+std::optional<CompileProfile> CompileProfile::load(const fs::path& file_path) {
+  const MappedFile file{file_path};
+  if (!file.is_open()) return std::nullopt;
+
+  BinaryReader reader{file.contents()};
+  if (reader.bytes(sizeof(profile_magic)) !=
+      std::string_view{profile_magic, sizeof(profile_magic)})
+    return std::nullopt;
+  if (reader.pod<std::uint32_t>() != profile_version) return std::nullopt;
+
+  CompileProfile profile;
+  const auto num_tus{reader.pod<std::uint32_t>()};
+  for (std::uint32_t i{}; i < num_tus && reader.ok; ++i) {
+    TranslationUnitProfile tu;
+    tu.source = reader.string();
+    tu.trace_mtime = reader.pod<std::int64_t>();
+    tu.total_ms = reader.pod<double>();
+    tu.frontend_ms = reader.pod<double>();
+    tu.backend_ms = reader.pod<double>();
+    tu.template_ms = reader.pod<double>();
+    tu.previous_total_ms = reader.pod<double>();
+    tu.headers = read_entries(reader);
+    tu.templates = read_entries(reader);
+    auto source{tu.source};
+    profile.translation_units_.emplace(std::move(source), std::move(tu));
+  }
+  profile.history_ =
+      reader.array<ProfileSample>(reader.pod<std::uint32_t>());
+  if (!reader.ok) return std::nullopt;
+  return profile;
+}
+
+void CompileProfile::save(const fs::path& file_path) const {
+  write_file_atomically(file_path, [&](std::ostream& out) {
+    out.write(profile_magic, sizeof(profile_magic));
+    write_pod(out, profile_version);
+    write_pod(out, static_cast<std::uint32_t>(translation_units_.size()));
+    for (const auto& [source, tu] : translation_units_) {
+      write_string(out, tu.source);
+      write_pod(out, tu.trace_mtime);
+      write_pod(out, tu.total_ms);
+      write_pod(out, tu.frontend_ms);
+      write_pod(out, tu.backend_ms);
+      write_pod(out, tu.template_ms);
+      write_pod(out, tu.previous_total_ms);
+      write_entries(out, tu.headers);
+      write_entries(out, tu.templates);
+    }
+    write_pod(out, static_cast<std::uint32_t>(history_.size()));
+    write_array(out, history_);
+  });
+}
+
+std::size_t CompileProfile::collect(const Config& cfg) {
+  const auto objects_root{cfg.build_directory / "CMakeFiles"};
+  std::set<std::string> present;
+  std::uint32_t recompiled{};
+
+  // Reports are rewritten in place by the compiler, so they are read rather
+  // than mapped.
+  FileReader reader;
+  std::error_code ec;
+  for (fs::recursive_directory_iterator it{
+           objects_root, fs::directory_options::skip_permission_denied, ec},
+       end;
+       it != end; it.increment(ec)) {
+    if (ec) break;
+    if (!it->is_regular_file(ec)) continue;
+    const auto source{trace_source(it->path(), objects_root)};
+    if (!source) continue;
+
+    const auto mtime{static_cast<std::int64_t>(
+        it->last_write_time(ec).time_since_epoch().count())};
+    if (ec) continue;
+    present.insert(*source);
+    const auto known{translation_units_.find(*source)};
+    if (known != translation_units_.end() && known->second.trace_mtime == mtime)
+      continue;
+
+    std::optional<TranslationUnitProfile> tu;
+    if (it->path().string().ends_with(gcc_report_suffix)) {
+      tu = parse_gcc_time_report(reader.read(it->path()).value_or(""));
+    } else {
+      tu = parse_clang_time_trace(it->path(), cfg.project_root);
+    }
+    if (!tu) continue;
+
+    tu->source = *source;
+    tu->trace_mtime = mtime;
+    if (known != translation_units_.end())
+      tu->previous_total_ms = known->second.total_ms;
+    translation_units_[*source] = std::move(*tu);
+    ++recompiled;
+  }
+
+  std::erase_if(translation_units_,
+                [&](const auto& tu) { return !present.contains(tu.first); });
+
+  if (recompiled > 0) {
+    ProfileSample sample{
+        std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count(),
+        static_cast<std::uint32_t>(translation_units_.size()), recompiled};
+    for (const auto& [source, tu] : translation_units_) {
+      sample.total_ms += tu.total_ms;
+      sample.frontend_ms += tu.frontend_ms;
+      sample.template_ms += tu.template_ms;
+    }
+    history_.push_back(sample);
+    if (history_.size() > max_history)
+      history_.erase(history_.begin(),
+                     history_.end() - static_cast<std::ptrdiff_t>(max_history));
+  }
+  return recompiled;
+}
+
+std::vector<ProfileHotspot> CompileProfile::expensive_headers(
+    std::size_t top) const {
+  return hotspots(translation_units_, &TranslationUnitProfile::headers, top);
+}
+
+std::vector<ProfileHotspot> CompileProfile::slowest_templates(
+    std::size_t top) const {
+  return hotspots(translation_units_, &TranslationUnitProfile::templates, top);
+}
+
+std::vector<const TranslationUnitProfile*>
+CompileProfile::slowest_translation_units(std::size_t top) const {
+  std::vector<const TranslationUnitProfile*> result;
+  result.reserve(translation_units_.size());
+  for (const auto& [source, tu] : translation_units_) result.push_back(&tu);
+  const auto keep{std::min(result.size(), top)};
+  std::partial_sort(
+      result.begin(), result.begin() + keep, result.end(),
+      [](const auto* a, const auto* b) { return a->total_ms > b->total_ms; });
+  result.resize(keep);
+  return result;
+}
+
+CompileProfile update_compile_profile(const Config& cfg) {
+  const auto file_path{cfg.project_root / compile_profile_default_location};
+  auto profile{CompileProfile::load(file_path).value_or(CompileProfile{})};
+  try {
+    if (const auto recompiled{profile.collect(cfg)}; recompiled > 0) {
+      profile.save(file_path);
+      log_debug("Compile profile updated with {translation_units} trace(s)",
+                {{"translation_units", recompiled}});
+    }
+  } catch (const std::exception& ex) {
+    log_warning("Failed to update compile profile: {error}",
+                {{"error", ex.what()}});
+  }
+  return profile;
+}
+
+}  // namespace daemonmake
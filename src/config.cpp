@@ -2,6 +2,7 @@
 
 #include <fstream>
 #include <iomanip>
+#include <stdexcept>
 #include <nlohmann/json.hpp>
 
 namespace daemonmake {
@@ -21,6 +22,15 @@ Config make_default_config(const std::filesystem::path& project_root) {
                 std::string{default_apps_folder_name}};
 }
 
+void to_json(json& j, const FlagOverride& o) {
+  j = json{{"match", o.match}, {"flags", o.flags}};
+}
+
+void from_json(const json& j, FlagOverride& o) {
+  o.match = j.at("match").get<std::string>();
+  o.flags = j.at("flags").get<std::vector<std::string>>();
+}
+
 void to_json(json& j, const Config& c) {
   j = json{{"project_root", c.project_root.string()},
            {"build_directory", c.build_directory.string()},
@@ -28,7 +38,30 @@ void to_json(json& j, const Config& c) {
            {"cxx_standard", c.cxx_standard},
            {"source_folder_name", c.source_folder_name},
            {"include_folder_name", c.include_folder_name},
-           {"apps_folder_name", c.apps_folder_name}};
+           {"apps_folder_name", c.apps_folder_name},
+           {"tests_folder_name", c.tests_folder_name},
+           {"include_scan_preamble_only", c.include_scan_preamble_only},
+           {"build_mode", c.build_mode},
+           {"build_profile", c.build_profile},
+           {"incremental_link_flags", c.incremental_link_flags},
+           {"compile_time_profiling", c.compile_time_profiling},
+           {"flag_overrides", c.flag_overrides},
+           {"focus_mode", c.focus_mode},
+           {"focus_flags", c.focus_flags},
+           {"stable_flags", c.stable_flags},
+           {"focus_window_minutes", c.focus_window_minutes},
+           {"build_backend", c.build_backend},
+           {"build_jobs", c.build_jobs},
+           {"keep_going", c.keep_going},
+           {"ordered_builds", c.ordered_builds},
+           {"ram_build_directory", c.ram_build_directory},
+           {"ram_build_budget_mb", c.ram_build_budget_mb},
+           {"run_affected_tests", c.run_affected_tests},
+           {"test_jobs", c.test_jobs},
+           {"file_watcher", c.file_watcher},
+           {"git_hold_timeout_seconds", c.git_hold_timeout_seconds},
+           {"log_level", c.log_level},
+           {"log_file", c.log_file}};
 }
 
 void from_json(const json& j, Config& c) {
@@ -39,6 +72,50 @@ void from_json(const json& j, Config& c) {
   c.source_folder_name = j.at("source_folder_name").get<std::string>();
   c.include_folder_name = j.at("include_folder_name").get<std::string>();
   c.apps_folder_name = j.at("apps_folder_name").get<std::string>();
+  c.tests_folder_name =
+      j.value("tests_folder_name", std::string{default_tests_folder_name});
+  c.include_scan_preamble_only = j.value("include_scan_preamble_only", false);
+  c.build_mode = j.value("build_mode", std::string{build_mode_release});
+  if (c.build_mode != build_mode_release && c.build_mode != build_mode_dev)
+    throw std::runtime_error("Unknown build_mode in config: " + c.build_mode);
+  c.build_profile =
+      j.value("build_profile", std::string{build_profile_default});
+  if (c.build_profile != build_profile_default &&
+      c.build_profile != build_profile_dev_fast)
+    throw std::runtime_error("Unknown build_profile in config: " +
+                             c.build_profile);
+  c.incremental_link_flags = j.value("incremental_link_flags", false);
+  c.compile_time_profiling = j.value("compile_time_profiling", false);
+  c.flag_overrides =
+      j.value("flag_overrides", std::vector<FlagOverride>{});
+  c.focus_mode = j.value("focus_mode", false);
+  c.focus_flags = j.value("focus_flags", Config{}.focus_flags);
+  c.stable_flags = j.value("stable_flags", Config{}.stable_flags);
+  c.focus_window_minutes = j.value("focus_window_minutes", 60u);
+  c.build_backend =
+      j.value("build_backend", std::string{build_backend_cmake});
+  if (c.build_backend != build_backend_cmake &&
+      c.build_backend != build_backend_ninja)
+    throw std::runtime_error("Unknown build_backend in config: " +
+                             c.build_backend);
+  c.build_jobs = j.value("build_jobs", 0u);
+  c.keep_going = j.value("keep_going", false);
+  c.ordered_builds = j.value("ordered_builds", true);
+  c.ram_build_directory = j.value("ram_build_directory", false);
+  c.ram_build_budget_mb = j.value("ram_build_budget_mb", 2048u);
+  c.run_affected_tests = j.value("run_affected_tests", false);
+  c.test_jobs = j.value("test_jobs", 0u);
+  c.file_watcher = j.value("file_watcher", std::string{file_watcher_auto});
+  if (c.file_watcher != file_watcher_auto &&
+      c.file_watcher != file_watcher_inotify &&
+      c.file_watcher != file_watcher_poll)
+    throw std::runtime_error("Unknown file_watcher in config: " +
+                             c.file_watcher);
+  c.git_hold_timeout_seconds = j.value("git_hold_timeout_seconds", 60u);
+  c.log_level = j.value("log_level", std::string{log_level_info});
+  if (!parse_log_level(c.log_level))
+    throw std::runtime_error("Unknown log_level in config: " + c.log_level);
+  c.log_file = j.value("log_file", false);
 }
 
 void save_json(const std::filesystem::path& p, const json& j) {
@@ -1,32 +1,83 @@
 #include "daemonmake/daemon.hpp"
 
+#include <algorithm>
 #include <chrono>
-#include <iostream>
+#include <cstdint>
 #include <stop_token>
 #include <thread>
 
 #include "daemonmake/cmake_builder.hpp"
+#include "daemonmake/compile_profile.hpp"
 #include "daemonmake/file_watcher.hpp"
+#include "daemonmake/git_monitor.hpp"
+#include "daemonmake/layout_patch.hpp"
+#include "daemonmake/logger.hpp"
+#include "daemonmake/test_runner.hpp"
 
 namespace daemonmake {
 
 namespace fs = std::filesystem;
 
+namespace {
+
+bool has_module_units(const CompactLayout& layout) {
+  for (const auto& target : layout.targets()) {
+    for (const auto file : target.source_files)
+      if (is_module_interface(layout.paths().filename(file))) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
 Daemon::Daemon(const Config& cfg)
     : cfg_{cfg},
-      pl_{make_project_layout(cfg.project_root)},
-      build_queue_{daemon_build_queue_size} {
-  update_pl();
+      ram_build_{cfg_.ram_build_directory
+                     ? std::make_unique<RamBuildDirectory>(cfg_)
+                     : nullptr},
+      paths_{std::make_shared<PathTable>()},
+      build_queue_{daemon_build_queue_size, build_queue_default_debounce,
+                   std::chrono::seconds{cfg_.git_hold_timeout_seconds}},
+      header_harvester_{cfg_},
+      build_history_{
+          BuildHistory::load(cfg_.project_root / build_history_default_location)
+              .value_or(BuildHistory{})},
+      focus_{FocusSet::load(cfg_.project_root / focus_default_location)} {
+  if (!load_snapshot()) {
+    startup_scan_ = walk_trees(cfg_.project_root, project_tree_roots(cfg_));
+    update_pl(startup_scan_);
+  }
+  if (auto index{HeaderIndex::load(cfg_.project_root /
+                                   header_index_default_location)}) {
+    auto next{*snapshot_.load()};
+    next.header_index = std::make_shared<const HeaderIndex>(std::move(*index));
+    snapshot_.publish(std::move(next));
+  }
+  select_backend();
 }
 
 Daemon::~Daemon() { stop(); }
 
 int Daemon::run() {
-  const auto watcher_loop{[this](const std::stop_token& token) {
-    FileWatcher watcher{{cfg_.project_root / cfg_.include_folder_name,
-                         cfg_.project_root / cfg_.source_folder_name,
-                         cfg_.project_root / cfg_.apps_folder_name}};
+  const auto startup_scan{
+      std::make_shared<const TreeScan>(std::move(startup_scan_))};
+
+  const auto watcher_loop{[this, startup_scan](const std::stop_token& token) {
+    FileWatcher watcher{cfg_.project_root, *startup_scan, cfg_.file_watcher};
+    log_info("Watching {directories} directories with {backend}",
+             {{"directories", startup_scan->directories.size()},
+              {"backend", watcher.backend_name()}});
+    std::optional<GitOperationMonitor> git;
+    if (cfg_.git_hold_timeout_seconds > 0) git.emplace(cfg_.project_root);
+    bool git_busy{};
     while (!token.stop_requested()) {
+      if (git && git->in_progress() != git_busy) {
+        git_busy = !git_busy;
+        log_info(git_busy ? "Git operation in progress; holding builds"
+                          : "Git operation finished");
+        build_queue_.hold(git_busy);
+      }
+
       auto events{watcher.wait_for_events()};
       for (const auto& e : events) {
         build_queue_.push_event(e);
@@ -34,21 +85,39 @@ int Daemon::run() {
     }
   }};
 
-  const auto builder_loop{[this](const std::stop_token& token) {
-    while (!token.stop_requested()) {
+  const auto builder_loop{[this, startup_scan](const std::stop_token& token) {
+    if (revalidate_on_start_) {
+      update_pl(*startup_scan);
+      const auto current{snapshot_.load()};
+      // The tree may have changed while the daemon was stopped.
+      write_cmakelists(cfg_, current->layout->to_project_layout(), true);
+      log_info("Revalidated layout snapshot ({targets} targets)",
+               {{"targets", current->layout->targets().size()}});
+    }
+
+    for (std::uint64_t task_id{1}; !token.stop_requested();) {
       auto task{build_queue_.pop_all_events(token)};
       if (task.events.empty() && !task.full_rebuild) continue;
+      const auto start{std::chrono::steady_clock::now()};
+      int rc{};
       if (task.full_rebuild) {
-        std::cout << "[daemonmake] Executing full rebuild...\n";
-        rebuild_all();
+        log_info("Executing full rebuild...", {{"task", task_id}});
+        rc = rebuild_all(token);
       } else {
+        std::optional<std::vector<std::string>> restructured;
         if (task.requires_discovery()) {
-          update_pl();
+          restructured = patch_pl(task);
+          if (!restructured) update_pl();
         }
-        std::cout << "[daemonmake] Detected " << task.events.size()
-                  << " changed file(s). Rebuilding...\n";
-        rebuild_changed(task);
+        log_info("Detected {files} changed file(s). Rebuilding...",
+                 {{"task", task_id}, {"files", task.events.size()}});
+        rc = rebuild_changed(task, restructured, token);
       }
+      log_info("Build finished in {duration_ms} ms (rc={rc})",
+               {{"task", task_id},
+                {"duration_ms", std::chrono::steady_clock::now() - start},
+                {"rc", rc}});
+      ++task_id;
     }
   }};
 
@@ -64,23 +133,352 @@ void Daemon::stop() {
   if (builder_thread_.joinable()) builder_thread_.request_stop();
 }
 
+bool Daemon::load_snapshot() {
+  auto snapshot{load_layout_snapshot(
+      cfg_.project_root / layout_snapshot_default_location, cfg_)};
+  if (!snapshot) return false;
+
+  include_cache_ = std::move(snapshot->include_cache);
+  publish_layout(CompactLayout{snapshot->layout, paths_});
+
+  if (directories_unchanged(cfg_.project_root, *snapshot))
+    startup_scan_ = std::move(snapshot->scan);
+  else
+    startup_scan_ = walk_trees(cfg_.project_root, project_tree_roots(cfg_));
+  revalidate_on_start_ = true;
+  return true;
+}
+
+void Daemon::save_snapshot(const ProjectLayout& pl, const TreeScan& scan) {
+  try {
+    save_layout_snapshot(cfg_.project_root / layout_snapshot_default_location,
+                         cfg_, pl, scan, include_cache_);
+  } catch (const std::exception& ex) {
+    log_warning("Failed to save layout snapshot: {error}",
+                {{"error", ex.what()}});
+  }
+}
+
 void Daemon::update_pl() {
-  std::scoped_lock<std::mutex> lock{mtx_};
-  discover_targets(cfg_, pl_);
-  infer_target_dependencies(pl_);
-  graph_ = TargetGraph{pl_};
+  update_pl(walk_trees(cfg_.project_root, project_tree_roots(cfg_)));
 }
 
-int Daemon::rebuild_all() {
+void Daemon::update_pl(const TreeScan& scan) {
+  // The string-heavy layout only lives for the duration of the scan.
+  auto pl{make_project_layout(cfg_.project_root)};
+  discover_targets(cfg_, pl, scan);
+  infer_target_dependencies(pl, {cfg_.include_scan_preamble_only},
+                            &include_cache_);
+
+  const auto& graph{*publish_layout(CompactLayout{pl, paths_})->graph};
+  if (graph.has_cycle())
+    log_warning("dependency cycle among {targets} target(s)",
+                {{"targets", graph.cyclic_targets().size()}});
+
+  save_snapshot(pl, scan);
+}
+
+std::optional<std::vector<std::string>> Daemon::patch_pl(
+    const BuildQueue::Task& task) {
+  // Modified files go along so an include edited in the same batch is
+  // picked up, as a full rediscovery would.
+  std::vector<std::string> paths;
+  for (const auto& [path, type] : task.events)
+    paths.push_back(path.lexically_relative(cfg_.project_root).generic_string());
+
+  // The saved snapshot is left as is: its directory stamps no longer match,
+  // so the next start rescans.
+  const auto start{std::chrono::steady_clock::now()};
+  auto patch{patch_layout(cfg_, *snapshot_.load()->layout, paths, include_cache_)};
+  if (!patch) return std::nullopt;
+  const auto& graph{
+      *publish_layout(std::move(patch->layout), patch->graph_changed)->graph};
+  if (patch->graph_changed && graph.has_cycle())
+    log_warning("dependency cycle among {targets} target(s)",
+                {{"targets", graph.cyclic_targets().size()}});
+
+  std::string names;
+  for (const auto& name : patch->changed_targets) {
+    if (!names.empty()) names += ' ';
+    names += name;
+  }
+  if (names.empty()) names = "none";
+  log_debug("Patched layout in {duration_ms} ms; changed targets: {targets}",
+            {{"duration_ms", std::chrono::steady_clock::now() - start},
+             {"targets", names}});
+  return std::move(patch->changed_targets);
+}
+
+void Daemon::select_backend() {
+  const bool modules{has_module_units(*snapshot_.load()->layout)};
+  if (backend_ && modules == modules_) return;
+  modules_ = modules;
+  backend_ = make_build_backend(cfg_, modules);
+}
+
+std::shared_ptr<const ProjectSnapshot> Daemon::publish_layout(
+    CompactLayout layout, bool rebuild_graph) {
+  auto next{*snapshot_.load()};
+  if (rebuild_graph) next.graph = std::make_shared<const TargetGraph>(layout);
+  next.layout = std::make_shared<const CompactLayout>(std::move(layout));
+  snapshot_.publish(std::move(next));
+  return snapshot_.load();
+}
+
+int Daemon::rebuild_all(const std::stop_token& token) {
   update_pl();
-  return cmake_build(cfg_, pl_, true);
+  const int rc{build(true)};
+  if (rc == 0 && cfg_.run_affected_tests) run_affected_tests({}, token);
+  return rc;
+}
+
+int Daemon::rebuild_changed(
+    BuildQueue::Task& task,
+    const std::optional<std::vector<std::string>>& restructured,
+    const std::stop_token& token) {
+  const bool refocused{cfg_.focus_mode && update_focus(task)};
+  BuildRequest request;
+  if (const auto edited{report_affected(task, restructured)}) {
+    const auto current{snapshot_.load()};
+    const auto& graph{*current->graph};
+    const auto affected{graph.affected(*edited)};
+    if (cfg_.ordered_builds) {
+      for (const auto id : schedule_targets(graph, affected, *edited,
+                                            build_history_,
+                                            &request.first_batch))
+        request.targets.push_back(graph.name(id));
+      request.on_target_built = [this](const std::string& target, int rc,
+                                       auto duration) {
+        build_history_.record(target, duration, rc == 0);
+        log_debug("Built {target} in {duration_ms} ms (rc={rc})",
+                  {{"target", target}, {"duration_ms", duration}, {"rc", rc}});
+      };
+    } else {
+      for (const auto id : affected.to_vector())
+        request.targets.push_back(graph.name(id));
+    }
+  }
+
+  // A patch that only moved headers leaves every CMake definition as is.
+  const bool layout_changed{task.requires_discovery() &&
+                            (!restructured || !restructured->empty())};
+  const int rc{build(layout_changed || refocused, request)};
+  if (request.on_target_built) save_build_history();
+  if (rc == 0 && cfg_.run_affected_tests)
+    run_affected_tests(request.targets, token);
+  return rc;
 }
 
-int Daemon::rebuild_changed(BuildQueue::Task& task) {
-  // TODO: Implement target builds for v2 (engage graph_ as well)
-  // for (const auto& [path, type] : task.events) {
-  // }
-  return cmake_build(cfg_, pl_, task.requires_discovery());
+bool Daemon::update_focus(const BuildQueue::Task& task) {
+  const std::int64_t now{std::chrono::duration_cast<std::chrono::seconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count()};
+  bool changed{
+      focus_.expire(now, std::int64_t{cfg_.focus_window_minutes} * 60)};
+
+  const auto current{snapshot_.load()};
+  const auto& layout{*current->layout};
+  for (const auto& [path, type] : task.events) {
+    if (type == FileEventType::Deleted) continue;
+    const auto file{layout.find(
+        path.lexically_relative(cfg_.project_root).generic_string())};
+    if (!file) continue;
+    const auto owner{layout.owner(*file)};
+    if (!owner) continue;
+    const auto name{layout.targets()[*owner].name};
+    if (focus_.touch(name, now)) {
+      log_info("{target} is now in focus", {{"target", name}});
+      changed = true;
+    }
+  }
+
+  if (!focus_.unsaved()) return changed;
+  try {
+    focus_.save(cfg_.project_root / focus_default_location);
+  } catch (const std::exception& ex) {
+    log_warning("Failed to save focus set: {error}", {{"error", ex.what()}});
+  }
+  return changed;
+}
+
+void Daemon::save_build_history() {
+  try {
+    build_history_.save(cfg_.project_root / build_history_default_location);
+  } catch (const std::exception& ex) {
+    log_warning("Failed to save build history: {error}",
+                {{"error", ex.what()}});
+  }
+}
+
+int Daemon::build(bool regenerate, const BuildRequest& request) {
+  if (ram_build_ && ram_build_->in_ram() && ram_build_->over_budget()) {
+    log_warning("Build tree outgrew ram_build_budget_mb; building on disk");
+    ram_build_->fall_back_to_disk();
+  }
+  if (regenerate || !fs::exists(cfg_.project_root / "CMakeLists.txt")) {
+    write_cmakelists(cfg_, snapshot_.load()->layout->to_project_layout(), true);
+    select_backend();
+  }
+  const int rc{backend_->build(request)};
+  if (rc == 0) refresh_header_index();
+  // Objects that compiled before a failure still have fresh traces.
+  if (cfg_.compile_time_profiling) update_compile_profile(cfg_);
+  if (ram_build_) ram_build_->request_sync();
+  return rc;
+}
+
+void Daemon::refresh_header_index() {
+  try {
+    auto harvested{header_harvester_.harvest(*snapshot_.load()->header_index)};
+    if (!harvested) return;
+    auto index{std::make_shared<const HeaderIndex>(std::move(*harvested))};
+    index->save(cfg_.project_root / header_index_default_location);
+    auto next{*snapshot_.load()};
+    next.header_index = std::move(index);
+    snapshot_.publish(std::move(next));
+  } catch (const std::exception& ex) {
+    log_warning("Failed to update header index: {error}",
+                {{"error", ex.what()}});
+  }
+}
+
+std::optional<std::vector<TargetId>> Daemon::report_affected(
+    const BuildQueue::Task& task,
+    const std::optional<std::vector<std::string>>& restructured) {
+  const auto current{snapshot_.load()};
+  const auto& header_index{*current->header_index};
+  const auto& graph{*current->graph};
+  if (header_index.empty()) return std::nullopt;
+
+  // Created and deleted files change the layout itself; after a full
+  // rediscovery the targets they touched are unknown. A modified file the
+  // index has never seen may belong to anything.
+  bool complete{!task.requires_discovery() || restructured.has_value()};
+  std::vector<TargetId> changed;
+  if (restructured) {
+    for (const auto& name : *restructured) {
+      if (const auto id{graph.find(name)}) changed.push_back(*id);
+    }
+  }
+  for (const auto& [path, type] : task.events) {
+    const auto rel_path{
+        path.lexically_relative(cfg_.project_root).generic_string()};
+    if (type == FileEventType::Created) {
+      if (const auto file{current->layout->find(rel_path)}) {
+        if (const auto owner{current->layout->owner(*file)})
+          changed.push_back(*owner);
+      }
+      continue;
+    }
+    if (type == FileEventType::Deleted) {
+      // Whatever included a deleted header now fails to compile.
+      const auto tus{header_index.translation_units_for(rel_path)};
+      for (const auto& name :
+           targets_for_translation_units(*current->layout, tus)) {
+        if (const auto id{graph.find(name)}) changed.push_back(*id);
+      }
+      continue;
+    }
+
+    // Importers do not list an interface in their depfiles; the graph
+    // leads from its target to theirs.
+    if (is_module_interface(rel_path)) {
+      const auto file{current->layout->find(rel_path)};
+      const auto owner{file ? current->layout->owner(*file) : std::nullopt};
+      if (owner) {
+        changed.push_back(*owner);
+        log_info("{file} -> module interface of {target}",
+                 {{"file", rel_path},
+                  {"target", current->layout->targets()[*owner].name}});
+        continue;
+      }
+    }
+
+    const auto tus{header_index.translation_units_for(rel_path)};
+    if (tus.empty()) {
+      complete = false;
+      continue;
+    }
+
+    std::string names;
+    for (const auto& name : targets_for_translation_units(*current->layout, tus)) {
+      if (!names.empty()) names += ' ';
+      names += name;
+      if (const auto id{graph.find(name)})
+        changed.push_back(*id);
+      else
+        complete = false;
+    }
+    log_info("{file} -> {translation_units} translation unit(s) in {targets}",
+             {{"file", rel_path},
+              {"translation_units", tus.size()},
+              {"targets", names}});
+  }
+
+  if (!complete || changed.empty()) return std::nullopt;
+  return changed;
+}
+
+void Daemon::run_affected_tests(const std::vector<std::string>& targets,
+                                const std::stop_token& token) {
+  using namespace std::chrono_literals;
+
+  const auto current{snapshot_.load()};
+  std::vector<std::string> tests;
+  for (const auto& target : current->layout->targets()) {
+    if (target.type != TargetType::Test) continue;
+    if (targets.empty() ||
+        std::find(targets.begin(), targets.end(), target.name) != targets.end())
+      tests.emplace_back(target.name);
+  }
+  if (tests.empty()) return;
+  std::stable_partition(tests.begin(), tests.end(), [this](const auto& name) {
+    return failing_tests_.count(name) != 0;
+  });
+
+  log_info("Running {tests} affected test(s)", {{"tests", tests.size()}});
+
+  // The results are stale as soon as another edit lands.
+  std::stop_source cancel;
+  std::jthread monitor{[&](const std::stop_token& done) {
+    while (!done.stop_requested()) {
+      if (token.stop_requested() || build_queue_.has_pending_events()) {
+        cancel.request_stop();
+        return;
+      }
+      std::this_thread::sleep_for(50ms);
+    }
+  }};
+
+  std::size_t passed{};
+  std::size_t failed{};
+  run_tests(cfg_, tests, cancel.get_token(), [&](const TestResult& result) {
+    if (result.cancelled()) return;
+    if (result.passed()) {
+      ++passed;
+      failing_tests_.erase(result.name);
+      return;
+    }
+    ++failed;
+    failing_tests_.insert(result.name);
+    log_info("FAILED {test} (rc={rc})\n{output}",
+             {{"test", result.name},
+              {"rc", result.exit_code},
+              {"duration_ms", result.duration},
+              {"output", result.output}});
+  });
+  monitor.request_stop();
+
+  if (cancel.stop_requested())
+    log_info(
+        "Tests: {passed} passed, {failed} failed, {cancelled} cancelled by new "
+        "changes",
+        {{"passed", passed},
+         {"failed", failed},
+         {"cancelled", tests.size() - passed - failed}});
+  else
+    log_info("Tests: {passed} passed, {failed} failed",
+             {{"passed", passed}, {"failed", failed}});
 }
 
 }  // namespace daemonmake
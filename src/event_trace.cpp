@@ -0,0 +1,192 @@
+#include "daemonmake/event_trace.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+
+#include "daemonmake/binary_io.hpp"
+#include "daemonmake/daemon.hpp"
+#include "daemonmake/include_scanner.hpp"
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+using clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr char trace_magic[4]{'D', 'M', 'E', 'T'};
+constexpr std::uint32_t trace_version{1};
+
+/**
+ * A build as seen by the replay's builder thread, in wall time.
+ */
+struct ReplayedTask {
+  clock::time_point start;
+  clock::time_point end;
+  BuildQueue::Task task;
+};
+
+bool picks_up(const BuildQueue::Task& task, const FileEvent& event) {
+  if (event.type == FileEventType::Overflow || task.full_rebuild)
+    return task.full_rebuild;
+  return task.events.count(event.path) != 0;
+}
+
+}  // namespace
+
+EventTraceWriter::EventTraceWriter(const fs::path& file_path,
+                                   fs::path project_root)
+    : out_{file_path, std::ios::binary | std::ios::trunc},
+      project_root_{std::move(project_root)},
+      start_{clock::now()} {
+  if (!out_)
+    throw std::runtime_error("Failed to open " + file_path.string() +
+                             " for writing");
+  out_.write(trace_magic, sizeof(trace_magic));
+  write_pod(out_, trace_version);
+  out_.flush();
+}
+
+void EventTraceWriter::write(const std::vector<FileEvent>& events) {
+  if (events.empty()) return;
+
+  const auto offset{static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                           start_)
+          .count())};
+  for (const auto& event : events) {
+    const auto rel_path{
+        event.path.empty()
+            ? std::string{}
+            : event.path.lexically_relative(project_root_).generic_string()};
+    const auto [it, inserted]{path_ids_.try_emplace(
+        rel_path, static_cast<std::uint32_t>(path_ids_.size()))};
+
+    write_pod(out_, offset);
+    write_pod(out_, static_cast<std::uint8_t>(event.type));
+    write_pod(out_, it->second);
+    // A path's first reference carries its text.
+    if (inserted) write_string(out_, rel_path);
+  }
+  out_.flush();
+  if (!out_) throw std::runtime_error("Failed to write event trace");
+  count_ += events.size();
+}
+
+std::optional<std::vector<TraceEvent>> load_event_trace(
+    const fs::path& file_path) {
+  const MappedFile file{file_path};
+  if (!file.is_open()) return std::nullopt;
+
+  BinaryReader reader{file.contents()};
+  if (reader.bytes(sizeof(trace_magic)) !=
+      std::string_view{trace_magic, sizeof(trace_magic)})
+    return std::nullopt;
+  if (reader.pod<std::uint32_t>() != trace_version) return std::nullopt;
+
+  std::vector<fs::path> paths;
+  std::vector<TraceEvent> events;
+  while (reader.ok && !reader.data.empty()) {
+    const auto offset{reader.pod<std::uint64_t>()};
+    const auto type{reader.pod<std::uint8_t>()};
+    const auto path_id{reader.pod<std::uint32_t>()};
+    if (path_id == paths.size()) paths.emplace_back(reader.string());
+
+    // A recording killed mid-write ends in a partial event; keep the rest.
+    if (!reader.ok || path_id >= paths.size() ||
+        type > static_cast<std::uint8_t>(FileEventType::Overflow))
+      break;
+    events.push_back({std::chrono::nanoseconds{offset},
+                      {paths[path_id], static_cast<FileEventType>(type)}});
+  }
+  return events;
+}
+
+ReplayReport replay_event_trace(const std::vector<TraceEvent>& events,
+                                const ReplayOptions& options) {
+  const auto scaled{[&](auto duration) {
+    return std::chrono::duration_cast<clock::duration>(duration /
+                                                       options.speed);
+  }};
+
+  BuildQueue queue{
+      daemon_build_queue_size,
+      std::max(std::chrono::milliseconds{1},
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   scaled(options.debounce)))};
+
+  std::vector<clock::time_point> pushed_at(events.size());
+  std::vector<ReplayedTask> tasks;
+  std::mutex tasks_mtx;
+  std::stop_source stop;
+  const auto start{clock::now()};
+
+  // Mirrors the daemon's builder loop, with a sleep in place of the build.
+  std::jthread builder{[&] {
+    const auto token{stop.get_token()};
+    for (;;) {
+      auto task{queue.pop_all_events(token)};
+      if (task.events.empty() && !task.full_rebuild) {
+        if (token.stop_requested()) break;
+        continue;
+      }
+
+      const auto build_start{clock::now()};
+      std::this_thread::sleep_for(scaled(options.build_time));
+
+      std::scoped_lock<std::mutex> lock{tasks_mtx};
+      tasks.push_back({build_start, clock::now(), std::move(task)});
+    }
+  }};
+
+  for (std::size_t i{}; i < events.size(); ++i) {
+    std::this_thread::sleep_until(start + scaled(events[i].offset));
+    pushed_at[i] = clock::now();
+    queue.push_event(events[i].event);
+  }
+
+  // Once the last batch has been popped, stopping only lets the builder
+  // drain what arrived during its final build.
+  std::this_thread::sleep_for(scaled(options.debounce) * 2);
+  stop.request_stop();
+  builder.join();
+
+  const auto trace_time{[&](clock::duration wall) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(wall *
+                                                                options.speed);
+  }};
+
+  ReplayReport report;
+  for (const auto& task : tasks) {
+    report.builds.push_back({trace_time(task.start - start),
+                             trace_time(task.end - start),
+                             task.task.events.size(), task.task.full_rebuild,
+                             task.task.requires_discovery()});
+  }
+
+  for (std::size_t i{}; i < events.size(); ++i) {
+    const auto& event{events[i].event};
+    // Builds never overlap, so at most one was running when this arrived.
+    const auto next{std::partition_point(
+        tasks.begin(), tasks.end(),
+        [&](const ReplayedTask& task) { return task.start < pushed_at[i]; })};
+    if (next != tasks.begin()) {
+      const auto running{std::prev(next)};
+      if (pushed_at[i] < running->end && picks_up(running->task, event))
+        report.builds[static_cast<std::size_t>(running - tasks.begin())]
+            .wasted = true;
+    }
+
+    const auto consumer{std::find_if(next, tasks.end(), [&](const auto& task) {
+      return picks_up(task.task, event);
+    })};
+    if (consumer != tasks.end())
+      report.latencies.push_back(trace_time(consumer->start - pushed_at[i]));
+  }
+  return report;
+}
+
+}  // namespace daemonmake
@@ -2,53 +2,81 @@
 
 #include <poll.h>
 #include <sys/inotify.h>
+#include <sys/vfs.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "daemonmake/polling_watcher.hpp"
+
 namespace daemonmake {
 
 namespace fs = std::filesystem;
 
-FileWatcher::FileWatcher(const std::vector<fs::path>& roots)
-    : inotify_fd_{inotify_init()}, roots_{roots} {
+namespace {
+
+/**
+ * Linux-specific watcher using the inotify API. Handles mapping watch
+ * descriptors back to paths and adding watches for new directories.
+ */
+class InotifyWatcher : public WatchBackend {
+ public:
+  /**
+   * Initializes inotify and watches every directory of a scan.
+   *
+   * @throws std::runtime_error If inotify_init fails.
+   */
+  InotifyWatcher(const fs::path& base, const TreeScan& scan);
+
+  /**
+   * Closes the inotify file descriptor and stops all watches.
+   */
+  ~InotifyWatcher() override;
+
+  // Non-copyable due to file descriptor ownership.
+  InotifyWatcher(const InotifyWatcher&) = delete;
+  InotifyWatcher& operator=(const InotifyWatcher&) = delete;
+
+  std::vector<FileEvent> wait_for_events() override;
+
+  std::string_view name() const override { return file_watcher_inotify; }
+
+ private:
+  /**
+   * Registers a single directory with the inotify instance.
+   *
+   * @param dir The directory path to watch.
+   */
+  void add_watch(const fs::path& dir);
+
+  /**
+   * Watches a newly created directory and its subdirectories, reporting
+   * files that appeared in it before the watches were in place.
+   *
+   * @param dir    The new directory.
+   * @param events Receives a Created event per file found.
+   */
+  void add_new_tree(const fs::path& dir, std::vector<FileEvent>& events);
+
+  int inotify_fd_;
+  std::unordered_map<int, fs::path> wd_to_path_;
+};
+
+InotifyWatcher::InotifyWatcher(const fs::path& base, const TreeScan& scan)
+    : inotify_fd_{inotify_init()} {
   if (inotify_fd_ < 0) throw std::runtime_error("Failed to initialize inotify");
 
-  for (const auto& root : roots_) {
-    if (fs::exists(root)) {
-      add_watch(root);
-      for (const auto& entry : fs::recursive_directory_iterator(root)) {
-        if (!fs::is_directory(entry)) continue;
-        add_watch(entry.path());
-      }
-    }
-  }
-}
-
-FileWatcher::~FileWatcher() {
-  if (inotify_fd_ >= 0) {
-    close(inotify_fd_);
-  }
+  for (const auto& dir : scan.directories)
+    add_watch(dir.empty() ? base : base / dir);
 }
 
-FileWatcher::FileWatcher(FileWatcher&& other) noexcept
-    : inotify_fd_{std::exchange(other.inotify_fd_, -1)},
-      roots_{std::move(other.roots_)},
-      wd_to_path_{std::move(other.wd_to_path_)} {}
-
-FileWatcher& FileWatcher::operator=(FileWatcher&& other) noexcept {
-  if (this == &other) return *this;
+InotifyWatcher::~InotifyWatcher() { close(inotify_fd_); }
 
-  if (inotify_fd_ >= 0) {
-    close(inotify_fd_);
-  }
-
-  roots_ = std::move(other.roots_);
-  inotify_fd_ = std::exchange(other.inotify_fd_, -1);
-  wd_to_path_ = std::move(other.wd_to_path_);
-
-  return *this;
-}
-
-std::vector<FileEvent> FileWatcher::wait_for_events() {
+std::vector<FileEvent> InotifyWatcher::wait_for_events() {
   pollfd pfd{};
   pfd.fd = inotify_fd_;
   pfd.events = POLLIN;
@@ -107,7 +135,7 @@ std::vector<FileEvent> FileWatcher::wait_for_events() {
 
     if (event->mask & (IN_CREATE | IN_MOVED_TO) &&
         fs::is_directory(full_path)) {
-      add_watch(full_path);
+      add_new_tree(full_path, events);
       i += EVENT_SIZE + event->len;
       continue;
     }
@@ -118,9 +146,7 @@ std::vector<FileEvent> FileWatcher::wait_for_events() {
     else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
       type = FileEventType::Deleted;
 
-    if (full_path.extension() != ".swp" && full_path.extension() != ".tmp") {
-      events.push_back({full_path, type});
-    }
+    events.push_back({full_path, type});
 
     i += EVENT_SIZE + event->len;
   }
@@ -128,7 +154,19 @@ std::vector<FileEvent> FileWatcher::wait_for_events() {
   return events;
 }
 
-void FileWatcher::add_watch(const fs::path& dir) {
+void InotifyWatcher::add_new_tree(const fs::path& dir,
+                                  std::vector<FileEvent>& events) {
+  // Watch first, then list: anything created after the walk raises its own
+  // event, anything created before is picked up by the walk.
+  add_watch(dir);
+  const auto scan{walk_trees(dir, {""})};
+  for (const auto& sub : scan.directories)
+    if (!sub.empty()) add_watch(dir / sub);
+  for (const auto& file : scan.files)
+    events.push_back({dir / file, FileEventType::Created});
+}
+
+void InotifyWatcher::add_watch(const fs::path& dir) {
   constexpr uint32_t mask{IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_TO |
                           IN_MOVED_FROM | IN_DELETE_SELF | IN_MOVE_SELF |
                           IN_IGNORED | IN_Q_OVERFLOW};
@@ -138,4 +176,73 @@ void FileWatcher::add_watch(const fs::path& dir) {
   wd_to_path_[wd] = dir;
 }
 
+/**
+ * Walks unrelated roots as one scan relative to /.
+ */
+TreeScan scan_roots(const std::vector<fs::path>& roots) {
+  std::vector<std::string> relative;
+  for (const auto& root : roots)
+    relative.push_back(fs::absolute(root).relative_path().string());
+  return walk_trees("/", relative);
+}
+
+}  // namespace
+
+bool inotify_reliable(const fs::path& path) {
+  struct statfs stats {};
+  if (statfs(path.c_str(), &stats) != 0) return true;
+
+  constexpr std::array<unsigned long, 11> unreliable{
+      0x6969,      // NFS
+      0x517B,      // SMB
+      0xFF534D42,  // CIFS
+      0xFE534D42,  // SMB2
+      0x65735546,  // FUSE (sshfs, rclone, virtiofs guests, ...)
+      0x01021997,  // 9p (WSL2 and VM shared folders)
+      0x5346414F,  // AFS
+      0x00C36400,  // Ceph
+      0x47504653,  // GPFS
+      0x0BD00BD0,  // Lustre
+      0x786F4256,  // VirtualBox shared folders
+  };
+  return std::find(unreliable.begin(), unreliable.end(),
+                   static_cast<unsigned long>(stats.f_type)) ==
+         unreliable.end();
+}
+
+FileWatcher::FileWatcher(const std::vector<fs::path>& roots,
+                         std::string_view mode)
+    : FileWatcher{"/", scan_roots(roots), mode} {}
+
+FileWatcher::FileWatcher(const fs::path& base, const TreeScan& scan,
+                         std::string_view mode) {
+  // The first directory of a sorted scan is a root.
+  const bool poll{
+      mode == file_watcher_poll ||
+      (mode == file_watcher_auto &&
+       !inotify_reliable(scan.directories.empty()
+                             ? base
+                             : base / scan.directories.front()))};
+  if (poll)
+    backend_ = std::make_unique<PollingWatcher>(base, scan);
+  else
+    backend_ = std::make_unique<InotifyWatcher>(base, scan);
+}
+
+FileWatcher::~FileWatcher() = default;
+
+FileWatcher::FileWatcher(FileWatcher&&) noexcept = default;
+FileWatcher& FileWatcher::operator=(FileWatcher&&) noexcept = default;
+
+std::vector<FileEvent> FileWatcher::wait_for_events() {
+  auto events{backend_->wait_for_events()};
+  std::erase_if(events, [](const FileEvent& e) {
+    const auto extension{e.path.extension()};
+    return extension == ".swp" || extension == ".tmp";
+  });
+  return events;
+}
+
+std::string_view FileWatcher::backend_name() const { return backend_->name(); }
+
 }  // namespace daemonmake
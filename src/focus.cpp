@@ -0,0 +1,55 @@
+#include "daemonmake/focus.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <nlohmann/json.hpp>
+
+#include "daemonmake/binary_io.hpp"
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+FocusSet FocusSet::load(const fs::path& file_path) {
+  FocusSet focus;
+  std::ifstream in{file_path};
+  if (!in) return focus;
+
+  const auto j = json::parse(in, nullptr, false);
+  if (!j.is_object()) return focus;
+  for (const auto& [target, time] : j.items()) {
+    if (time.is_number_integer())
+      focus.last_edit_.emplace(target, time.get<std::int64_t>());
+  }
+  return focus;
+}
+
+void FocusSet::save(const fs::path& file_path) {
+  write_file_atomically(file_path, [this](std::ostream& out) {
+    out << std::setw(4) << json(last_edit_) << '\n';
+  });
+  unsaved_ = false;
+}
+
+bool FocusSet::touch(std::string_view target, std::int64_t now) {
+  const auto it{last_edit_.find(target)};
+  if (it != last_edit_.end()) {
+    if (it->second != now) unsaved_ = true;
+    it->second = now;
+    return false;
+  }
+  last_edit_.emplace(std::string{target}, now);
+  unsaved_ = true;
+  return true;
+}
+
+bool FocusSet::expire(std::int64_t now, std::int64_t window_seconds) {
+  const auto dropped{std::erase_if(last_edit_, [&](const auto& entry) {
+    return now - entry.second > window_seconds;
+  })};
+  if (dropped != 0) unsaved_ = true;
+  return dropped != 0;
+}
+
+}  // namespace daemonmake
@@ -0,0 +1,87 @@
+#include "daemonmake/git_monitor.hpp"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <array>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::string_view operation_markers[]{
+    "index.lock",      "rebase-merge", "rebase-apply", "MERGE_HEAD",
+    "CHERRY_PICK_HEAD", "REVERT_HEAD",  "sequencer"};
+
+}  // namespace
+
+std::optional<fs::path> find_git_dir(const fs::path& start) {
+  std::error_code ec;
+  for (auto dir{fs::absolute(start, ec)}; !ec && !dir.empty();
+       dir = dir.parent_path()) {
+    const auto dot_git{dir / ".git"};
+    if (fs::is_directory(dot_git, ec)) return dot_git;
+
+    if (fs::is_regular_file(dot_git, ec)) {
+      std::ifstream in{dot_git};
+      std::string line;
+      constexpr std::string_view prefix{"gitdir: "};
+      if (std::getline(in, line) && line.starts_with(prefix)) {
+        const fs::path target{line.substr(prefix.size())};
+        return target.is_absolute() ? target : (dir / target).lexically_normal();
+      }
+      return std::nullopt;
+    }
+
+    if (dir == dir.root_path()) break;
+  }
+  return std::nullopt;
+}
+
+bool git_operation_in_progress(const fs::path& git_dir) {
+  std::error_code ec;
+  for (const auto marker : operation_markers) {
+    if (fs::exists(git_dir / marker, ec)) return true;
+  }
+  return false;
+}
+
+GitOperationMonitor::GitOperationMonitor(const fs::path& project_root) {
+  const auto git_dir{find_git_dir(project_root)};
+  if (!git_dir) return;
+
+  git_dir_ = *git_dir;
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ >= 0 &&
+      inotify_add_watch(inotify_fd_, git_dir_.c_str(),
+                        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO) <
+          0) {
+    close(inotify_fd_);
+    inotify_fd_ = -1;
+  }
+  in_progress_ = git_operation_in_progress(git_dir_);
+}
+
+GitOperationMonitor::~GitOperationMonitor() {
+  if (inotify_fd_ >= 0) close(inotify_fd_);
+}
+
+bool GitOperationMonitor::in_progress() {
+  if (git_dir_.empty()) return false;
+  // Without inotify, fall back to checking the markers every call.
+  if (inotify_fd_ < 0) return git_operation_in_progress(git_dir_);
+
+  alignas(inotify_event) std::array<char, 4096> buffer;
+  bool changed{};
+  while (read(inotify_fd_, buffer.data(), buffer.size()) > 0) changed = true;
+
+  if (changed) in_progress_ = git_operation_in_progress(git_dir_);
+  return in_progress_;
+}
+
+}  // namespace daemonmake
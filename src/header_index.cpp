@@ -0,0 +1,409 @@
+#include "daemonmake/header_index.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <unordered_map>
+
+#include "daemonmake/binary_io.hpp"
+#include "daemonmake/include_scanner.hpp"
+#include "daemonmake/subprocess.hpp"
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char index_magic[4]{'D', 'M', 'H', 'I'};
+constexpr std::uint32_t index_version{1};
+
+// Beyond this many rebuilt outputs one full `ninja -t deps` is cheaper
+// than listing them all, and keeps the command line short.
+constexpr std::size_t max_incremental_outputs{2000};
+
+std::optional<std::string> to_project_relative(const std::string& path,
+                                               const fs::path& base,
+                                               const fs::path& project_root) {
+  fs::path p{path};
+  if (p.is_relative()) p = base / p;
+  const auto rel{p.lexically_normal().lexically_relative(project_root)};
+  if (rel.empty() || *rel.begin() == "..") return std::nullopt;
+  return rel.generic_string();
+}
+
+}  // namespace
+
+std::vector<std::string> parse_depfile(std::string_view text) {
+  std::vector<std::string> prereqs;
+
+  // Skip the rule's target, which ends at the first unescaped ':' that is
+  // followed by whitespace.
+  std::size_t i{};
+  for (; i < text.size(); ++i) {
+    if (text[i] == '\\') {
+      ++i;
+      continue;
+    }
+    if (text[i] == ':' &&
+        (i + 1 == text.size() || text[i + 1] == ' ' || text[i + 1] == '\t' ||
+         text[i + 1] == '\n' || text[i + 1] == '\r'))
+      break;
+  }
+  if (i >= text.size()) return prereqs;
+  ++i;
+
+  std::string current;
+  for (; i < text.size(); ++i) {
+    const char ch{text[i]};
+    if (ch == '\\' && i + 1 < text.size()) {
+      const char next{text[i + 1]};
+      if (next == '\n' || next == '\r') {
+        // Line continuation.
+        ++i;
+        if (next == '\r' && i + 1 < text.size() && text[i + 1] == '\n') ++i;
+        if (!current.empty()) prereqs.push_back(std::move(current));
+        current.clear();
+        continue;
+      }
+      if (next == ' ' || next == '#' || next == '\\') {
+        current.push_back(next);
+        ++i;
+        continue;
+      }
+    }
+    if (ch == '$' && i + 1 < text.size() && text[i + 1] == '$') {
+      current.push_back('$');
+      ++i;
+      continue;
+    }
+    if (ch == ' ' || ch == '\t' || ch == '\r') {
+      if (!current.empty()) prereqs.push_back(std::move(current));
+      current.clear();
+      continue;
+    }
+    if (ch == '\n') break;  // End of the first rule.
+    current.push_back(ch);
+  }
+  if (!current.empty()) prereqs.push_back(std::move(current));
+
+  return prereqs;
+}
+
+std::vector<TranslationUnitDeps> parse_ninja_deps(std::string_view text) {
+  // Format:
+  //   <output>: #deps N, deps mtime M (VALID)
+  //       <dep>
+  //       ...
+  //   <blank line>
+  std::vector<TranslationUnitDeps> result;
+  bool in_record{};
+  bool have_tu{};
+
+  while (!text.empty()) {
+    const auto eol{text.find('\n')};
+    std::string_view line{text.substr(0, eol)};
+    text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+    if (line.empty()) {
+      in_record = false;
+      continue;
+    }
+
+    if (line.front() != ' ') {
+      in_record = line.find(": #deps") != std::string_view::npos;
+      have_tu = false;
+      continue;
+    }
+
+    if (!in_record) continue;
+    const auto first{line.find_first_not_of(' ')};
+    if (first == std::string_view::npos) continue;
+    const std::string dep{line.substr(first)};
+
+    if (!have_tu) {
+      result.push_back({dep, {}});
+      have_tu = true;
+    } else {
+      result.back().headers.push_back(dep);
+    }
+  }
+
+  return result;
+}
+
+HeaderIndex::HeaderIndex(const std::vector<TranslationUnitDeps>& deps,
+                         const fs::path& base, const fs::path& project_root) {
+  std::vector<std::vector<std::string>> normalized;  // TU first, then headers
+  std::set<std::string> paths;
+
+  for (const auto& tu_deps : deps) {
+    const auto tu{
+        to_project_relative(tu_deps.translation_unit, base, project_root)};
+    if (!tu) continue;
+
+    auto& files{normalized.emplace_back()};
+    files.push_back(*tu);
+    for (const auto& header : tu_deps.headers) {
+      auto rel{to_project_relative(header, base, project_root)};
+      if (rel) files.push_back(std::move(*rel));
+    }
+    paths.insert(files.begin(), files.end());
+  }
+
+  paths_.assign(std::make_move_iterator(paths.begin()),
+                std::make_move_iterator(paths.end()));
+
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;  // (file, tu)
+  for (const auto& files : normalized) {
+    const auto tu_id{*find(files.front())};
+    for (const auto& file : files) edges.emplace_back(*find(file), tu_id);
+  }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  // Edges sorted by file, then TU, are exactly CSR order.
+  offsets_.assign(paths_.size() + 1, 0);
+  edges_.reserve(edges.size());
+  for (const auto& [file_id, tu_id] : edges) {
+    ++offsets_[file_id + 1];
+    edges_.push_back(tu_id);
+  }
+  for (std::size_t i{1}; i < offsets_.size(); ++i)
+    offsets_[i] += offsets_[i - 1];
+}
+
+namespace {
+
+/**
+ * Runs `ninja -t deps`, for the given outputs or for every one.
+ *
+ * @return The parsed records, or std::nullopt if ninja failed.
+ */
+std::optional<std::vector<TranslationUnitDeps>> ninja_deps(
+    const Config& cfg, const std::vector<std::string>& outputs = {}) {
+  std::vector<std::string> argv{"ninja", "-C", cfg.build_directory.string(),
+                                "-t", "deps"};
+  argv.insert(argv.end(), outputs.begin(), outputs.end());
+  std::string output;
+  if (run_subprocess_capture(argv, output) != 0) return std::nullopt;
+  return parse_ninja_deps(output);
+}
+
+/**
+ * Reads the depfiles under the build directory written after since.
+ *
+ * @param newest Receives the newest depfile mtime seen.
+ */
+std::vector<TranslationUnitDeps> read_depfiles(const Config& cfg,
+                                               fs::file_time_type since,
+                                               fs::file_time_type& newest) {
+  std::vector<TranslationUnitDeps> deps;
+  // Depfiles are rewritten in place by the compiler, so they are read
+  // rather than mapped.
+  FileReader reader;
+  std::error_code ec;
+  for (fs::recursive_directory_iterator it{
+           cfg.build_directory, fs::directory_options::skip_permission_denied,
+           ec},
+       end;
+       it != end; it.increment(ec)) {
+    if (ec) break;
+    if (it->path().extension() != ".d") continue;
+    const auto mtime{it->last_write_time(ec)};
+    if (ec || mtime <= since) continue;
+    newest = std::max(newest, mtime);
+
+    auto prereqs{parse_depfile(reader.read(it->path()).value_or(""))};
+    if (prereqs.empty()) continue;
+
+    TranslationUnitDeps tu_deps{std::move(prereqs.front()), {}};
+    tu_deps.headers.assign(std::make_move_iterator(prereqs.begin() + 1),
+                           std::make_move_iterator(prereqs.end()));
+    deps.push_back(std::move(tu_deps));
+  }
+  return deps;
+}
+
+}  // namespace
+
+HeaderIndex HeaderIndex::harvest(const Config& cfg) {
+  std::vector<TranslationUnitDeps> deps;
+
+  if (fs::exists(cfg.build_directory / ".ninja_deps")) {
+    deps = ninja_deps(cfg).value_or(std::vector<TranslationUnitDeps>{});
+  } else if (fs::exists(cfg.build_directory)) {
+    auto newest{fs::file_time_type::min()};
+    deps = read_depfiles(cfg, fs::file_time_type::min(), newest);
+  }
+
+  return HeaderIndex{deps, cfg.build_directory, cfg.project_root};
+}
+
+HeaderIndex HeaderIndex::merged(const std::vector<TranslationUnitDeps>& deps,
+                                const fs::path& base,
+                                const fs::path& project_root) const {
+  // Recover each TU's forward list from the reverse edges; a TU lists
+  // itself, which the constructor adds back.
+  std::unordered_map<std::uint32_t, std::vector<std::string>> headers;
+  for (std::uint32_t file{}; file + 1 < offsets_.size(); ++file) {
+    for (auto e{offsets_[file]}; e < offsets_[file + 1]; ++e) {
+      auto& files{headers[edges_[e]]};
+      if (edges_[e] != file) files.push_back(paths_[file]);
+    }
+  }
+
+  std::set<std::string> replaced;
+  for (const auto& tu_deps : deps) {
+    if (auto tu{to_project_relative(tu_deps.translation_unit, base,
+                                    project_root)})
+      replaced.insert(std::move(*tu));
+  }
+
+  std::vector<TranslationUnitDeps> all;
+  all.reserve(headers.size() + deps.size());
+  for (auto& [tu, files] : headers) {
+    if (replaced.count(paths_[tu]) == 0)
+      all.push_back({paths_[tu], std::move(files)});
+  }
+  // Project-relative paths resolve against project_root; the new lists
+  // are made absolute so both kinds share one base.
+  for (const auto& tu_deps : deps) {
+    const auto absolute{[&](const std::string& path) {
+      const fs::path p{path};
+      return (p.is_relative() ? base / p : p).string();
+    }};
+    auto& entry{all.emplace_back()};
+    entry.translation_unit = absolute(tu_deps.translation_unit);
+    for (const auto& header : tu_deps.headers)
+      entry.headers.push_back(absolute(header));
+  }
+  return HeaderIndex{all, project_root, project_root};
+}
+
+HeaderIndexHarvester::HeaderIndexHarvester(const Config& cfg)
+    : cfg_{cfg}, ninja_log_{cfg.build_directory} {}
+
+std::optional<HeaderIndex> HeaderIndexHarvester::harvest(
+    const HeaderIndex& index) {
+  if (fs::exists(cfg_.build_directory / ".ninja_deps"))
+    return harvest_ninja(index);
+  if (fs::exists(cfg_.build_directory)) return harvest_depfiles(index);
+  return std::nullopt;
+}
+
+std::optional<HeaderIndex> HeaderIndexHarvester::harvest_ninja(
+    const HeaderIndex& index) {
+  bool restarted{};
+  const auto entries{ninja_log_.read_new(&restarted)};
+  if (!primed_ || restarted || entries.size() > max_incremental_outputs) {
+    primed_ = true;
+    return HeaderIndex::harvest(cfg_);
+  }
+  if (entries.empty()) return std::nullopt;
+
+  std::set<std::string> outputs;
+  for (const auto& entry : entries) outputs.insert(entry.output);
+  const auto deps{ninja_deps(cfg_, {outputs.begin(), outputs.end()})};
+  if (!deps) return HeaderIndex::harvest(cfg_);
+  if (deps->empty()) return std::nullopt;
+  return index.merged(*deps, cfg_.build_directory, cfg_.project_root);
+}
+
+std::optional<HeaderIndex> HeaderIndexHarvester::harvest_depfiles(
+    const HeaderIndex& index) {
+  const auto deps{read_depfiles(cfg_, depfiles_seen_, depfiles_seen_)};
+  if (!primed_) {
+    primed_ = true;
+    return HeaderIndex{deps, cfg_.build_directory, cfg_.project_root};
+  }
+  if (deps.empty()) return std::nullopt;
+  return index.merged(deps, cfg_.build_directory, cfg_.project_root);
+}
+
+std::optional<HeaderIndex> HeaderIndex::load(const fs::path& file_path) {
+  const MappedFile file{file_path};
+  if (!file.is_open()) return std::nullopt;
+
+  BinaryReader reader{file.contents()};
+  if (reader.bytes(sizeof(index_magic)) !=
+      std::string_view{index_magic, sizeof(index_magic)})
+    return std::nullopt;
+  if (reader.pod<std::uint32_t>() != index_version) return std::nullopt;
+
+  const auto num_paths{reader.pod<std::uint32_t>()};
+  const auto num_edges{reader.pod<std::uint32_t>()};
+  if (!reader.ok) return std::nullopt;
+
+  HeaderIndex index;
+  index.offsets_ = reader.array<std::uint32_t>(num_paths + 1ull);
+  index.edges_ = reader.array<std::uint32_t>(num_edges);
+  const auto string_offsets{reader.array<std::uint32_t>(num_paths + 1ull)};
+  if (!reader.ok || index.offsets_.back() != num_edges ||
+      string_offsets.back() != reader.data.size())
+    return std::nullopt;
+
+  index.paths_.reserve(num_paths);
+  for (std::uint32_t i{}; i < num_paths; ++i) {
+    if (string_offsets[i] > string_offsets[i + 1]) return std::nullopt;
+    index.paths_.emplace_back(
+        reader.data.substr(string_offsets[i],
+                           string_offsets[i + 1] - string_offsets[i]));
+  }
+  for (const auto edge : index.edges_)
+    if (edge >= num_paths) return std::nullopt;
+
+  return index;
+}
+
+void HeaderIndex::save(const fs::path& file_path) const {
+  std::vector<std::uint32_t> string_offsets{0};
+  for (const auto& path : paths_)
+    string_offsets.push_back(string_offsets.back() +
+                             static_cast<std::uint32_t>(path.size()));
+
+  write_file_atomically(file_path, [&](std::ostream& out) {
+    out.write(index_magic, sizeof(index_magic));
+    write_pod(out, index_version);
+    write_pod(out, static_cast<std::uint32_t>(paths_.size()));
+    write_pod(out, static_cast<std::uint32_t>(edges_.size()));
+    write_array(out, offsets_.empty() ? std::vector<std::uint32_t>{0} : offsets_);
+    write_array(out, edges_);
+    write_array(out, string_offsets);
+    for (const auto& path : paths_) out << path;
+  });
+}
+
+std::vector<std::string_view> HeaderIndex::translation_units_for(
+    std::string_view rel_path) const {
+  std::vector<std::string_view> tus;
+  const auto id{find(rel_path)};
+  if (!id) return tus;
+
+  for (auto e{offsets_[*id]}; e < offsets_[*id + 1]; ++e)
+    tus.push_back(paths_[edges_[e]]);
+  return tus;
+}
+
+std::optional<std::uint32_t> HeaderIndex::find(std::string_view rel_path) const {
+  const auto it{std::lower_bound(paths_.begin(), paths_.end(), rel_path)};
+  if (it == paths_.end() || *it != rel_path) return std::nullopt;
+  return static_cast<std::uint32_t>(it - paths_.begin());
+}
+
+std::vector<std::string> targets_for_translation_units(
+    const ProjectLayout& pl, const std::vector<std::string_view>& tus) {
+  std::unordered_map<std::string_view, const std::string*> owner;
+  for (const auto& target : pl.targets)
+    for (const auto& src : target.source_files) owner.emplace(src, &target.name);
+
+  std::set<std::string> targets;
+  for (const auto tu : tus) {
+    const auto it{owner.find(tu)};
+    if (it != owner.end()) targets.insert(*it->second);
+  }
+  return {targets.begin(), targets.end()};
+}
+
+}  // namespace daemonmake
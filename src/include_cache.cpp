@@ -0,0 +1,55 @@
+#include "daemonmake/include_cache.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include <chrono>
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::int64_t racy_window_ns{2'000'000'000};
+
+std::int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+std::optional<FileStamp> stat_file(const fs::path& file_path) {
+  struct statx stx {};
+  if (::statx(AT_FDCWD, file_path.c_str(), AT_STATX_SYNC_AS_STAT,
+              STATX_INO | STATX_SIZE | STATX_MTIME, &stx) != 0)
+    return std::nullopt;
+
+  return FileStamp{
+      static_cast<std::uint64_t>(makedev(stx.stx_dev_major, stx.stx_dev_minor)),
+      stx.stx_ino, stx.stx_size,
+      static_cast<std::int64_t>(stx.stx_mtime.tv_sec) * 1'000'000'000 +
+          stx.stx_mtime.tv_nsec};
+}
+
+bool is_racy(const FileStamp& stamp) {
+  return stamp.mtime_ns >= now_ns() - racy_window_ns;
+}
+
+const IncludeCache::Entry* IncludeCache::find(const std::string& rel_path,
+                                              const FileStamp& stamp) const {
+  const auto it{entries_.find(rel_path)};
+  if (it == entries_.end() || it->second.stamp != stamp) return nullptr;
+  return &it->second;
+}
+
+void IncludeCache::store(const std::string& rel_path, Entry entry) {
+  // Poison racy stamps so the next lookup rescans the file.
+  if (is_racy(entry.stamp)) entry.stamp.mtime_ns = -1;
+  entries_.insert_or_assign(rel_path, std::move(entry));
+}
+
+}  // namespace daemonmake
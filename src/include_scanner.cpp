@@ -0,0 +1,536 @@
+#include "daemonmake/include_scanner.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr bool is_ident_char(char ch) {
+  return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+         (ch >= '0' && ch <= '9') || ch == '_';
+}
+
+constexpr bool is_ident_start(char ch) {
+  return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+}
+
+constexpr bool is_hspace(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\v' || ch == '\f' || ch == '\r';
+}
+
+// Bytes that can change the lexer state. Everything else is plain code.
+constexpr std::array<bool, 256> make_special_table() {
+  std::array<bool, 256> table{};
+  for (unsigned char ch : {'#', '/', '"', '\'', '\n'}) table[ch] = true;
+  return table;
+}
+
+constexpr auto special_table{make_special_table()};
+
+const char* find_special(const char* p, const char* end) {
+#if defined(__SSE2__)
+  const __m128i hash{_mm_set1_epi8('#')};
+  const __m128i slash{_mm_set1_epi8('/')};
+  const __m128i dquote{_mm_set1_epi8('"')};
+  const __m128i squote{_mm_set1_epi8('\'')};
+  const __m128i newline{_mm_set1_epi8('\n')};
+
+  while (end - p >= 16) {
+    const __m128i chunk{
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))};
+    const __m128i hits{_mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, hash),
+                     _mm_cmpeq_epi8(chunk, slash)),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, dquote),
+                                  _mm_cmpeq_epi8(chunk, squote)),
+                     _mm_cmpeq_epi8(chunk, newline)))};
+    const int mask{_mm_movemask_epi8(hits)};
+    if (mask != 0) return p + __builtin_ctz(static_cast<unsigned>(mask));
+    p += 16;
+  }
+#endif
+  while (p < end && !special_table[static_cast<unsigned char>(*p)]) ++p;
+  return p;
+}
+
+class Scanner {
+ public:
+  Scanner(std::string_view source, const IncludeScanOptions& options)
+      : begin_{source.data()},
+        p_{source.data()},
+        end_{source.data() + source.size()},
+        options_{options} {}
+
+  SourceDependencies run() {
+    while (p_ < end_ && !done_) {
+      const char* next{find_special(p_, end_)};
+      if (at_line_start_) {
+        const char* q{p_};
+        while (q < next && is_hspace(*q)) ++q;
+        if (q < next) {
+          if (const char* after{seen_code_ ? nullptr : module_line(q)}) {
+            p_ = after;
+            continue;
+          }
+          mark_code();
+        }
+      }
+      p_ = next;
+      if (p_ >= end_ || done_) break;
+
+      switch (*p_) {
+        case '\n':
+          on_newline();
+          break;
+        case '#':
+          on_hash();
+          break;
+        case '/':
+          on_slash();
+          break;
+        case '"':
+          mark_code();
+          skip_string();
+          break;
+        case '\'':
+          on_quote();
+          break;
+      }
+    }
+
+    return std::move(result_);
+  }
+
+ private:
+  // A non-comment, non-whitespace token outside of a directive ends the
+  // preamble unless it sits inside an #if block.
+  void mark_code() {
+    if (!in_directive_) {
+      seen_anything_ = true;
+      seen_code_ = true;
+      if (options_.stop_after_preamble && depth_ == 0) done_ = true;
+    }
+    at_line_start_ = false;
+  }
+
+  bool is_continuation(const char* newline) const {
+    const char* q{newline};
+    if (q > begin_ && q[-1] == '\r') --q;
+    return q > begin_ && q[-1] == '\\';
+  }
+
+  void on_newline() {
+    if (!is_continuation(p_)) {
+      at_line_start_ = true;
+      in_directive_ = false;
+    }
+    ++p_;
+  }
+
+  void on_hash() {
+    if (!at_line_start_) {
+      // Stringizing inside a directive, or stray code.
+      mark_code();
+      ++p_;
+      return;
+    }
+
+    at_line_start_ = false;
+    in_directive_ = true;
+    ++p_;
+
+    skip_hspace();
+    const char* name_begin{p_};
+    while (p_ < end_ && is_ident_char(*p_)) ++p_;
+    const std::string_view name{name_begin,
+                                static_cast<std::size_t>(p_ - name_begin)};
+
+    if (name == "include" || name == "include_next" || name == "import") {
+      read_header_name();
+    } else if (name == "ifndef" && !seen_anything_) {
+      // Classic include guard: treat its body as top level. The matching
+      // #endif then arrives at depth 0 and is ignored below.
+    } else if (name == "if" || name == "ifdef" || name == "ifndef") {
+      ++depth_;
+    } else if (name == "endif") {
+      if (depth_ > 0) --depth_;
+    }
+
+    seen_anything_ = true;
+  }
+
+  void read_header_name() {
+    skip_hspace();
+    if (p_ >= end_) return;
+
+    char close{};
+    if (*p_ == '"')
+      close = '"';
+    else if (*p_ == '<')
+      close = '>';
+    else
+      return;  // Computed include, e.g. #include MACRO
+
+    const char* name_begin{p_ + 1};
+    const char* q{name_begin};
+    while (q < end_ && *q != close && *q != '\n') ++q;
+    if (q >= end_ || *q != close) return;
+
+    if (q > name_begin)
+      result_.includes.emplace_back(name_begin,
+                             static_cast<std::size_t>(q - name_begin));
+    p_ = q + 1;
+  }
+
+  /**
+   * Reads a module or import declaration starting at a line's first token.
+   * The whole declaration, up to its ';', must be on the line; anything
+   * else, such as `module.x = 1;` or `import(1);`, is plain code.
+   *
+   * @return Where scanning resumes, or nullptr if the line is plain code.
+   */
+  const char* module_line(const char* q) {
+    const auto word{[&] {
+      const char* begin{q};
+      while (q < end_ && is_ident_char(*q)) ++q;
+      return std::string_view{begin, static_cast<std::size_t>(q - begin)};
+    }};
+    // A dotted name such as a.b; empty unless it starts with an identifier.
+    const auto module_name{[&] {
+      const char* begin{q};
+      while (q < end_ && is_ident_start(*q)) {
+        while (q < end_ && is_ident_char(*q)) ++q;
+        if (end_ - q < 2 || *q != '.' || !is_ident_start(q[1])) break;
+        ++q;
+      }
+      return std::string_view{begin, static_cast<std::size_t>(q - begin)};
+    }};
+    const auto skip_hspace_at{[&] {
+      while (q < end_ && is_hspace(*q)) ++q;
+    }};
+    // Optional attributes, then the closing ';'.
+    const auto end_of_declaration{[&]() -> const char* {
+      skip_hspace_at();
+      if (end_ - q >= 2 && q[0] == '[' && q[1] == '[') {
+        while (end_ - q >= 2 && *q != '\n' && (q[0] != ']' || q[1] != ']'))
+          ++q;
+        if (end_ - q < 2 || *q == '\n') return nullptr;
+        q += 2;
+        skip_hspace_at();
+      }
+      if (q >= end_ || *q != ';') return nullptr;
+      at_line_start_ = false;
+      seen_anything_ = true;
+      return q + 1;
+    }};
+
+    auto keyword{word()};
+    const bool exported{keyword == "export"};
+    if (exported) {
+      skip_hspace_at();
+      keyword = word();
+    }
+
+    if (keyword == "module") {
+      skip_hspace_at();
+      if (!exported && q < end_ && *q == ';')
+        return end_of_declaration();  // Global module fragment.
+      if (q < end_ && *q == ':') {
+        ++q;
+        skip_hspace_at();
+        return !exported && word() == "private" ? end_of_declaration()
+                                                : nullptr;
+      }
+
+      const auto name{module_name()};
+      if (name.empty()) return nullptr;
+      skip_hspace_at();
+      const bool partition{q < end_ && *q == ':'};
+      if (partition) {
+        ++q;
+        skip_hspace_at();
+        if (module_name().empty()) return nullptr;
+      }
+      const char* after{end_of_declaration()};
+      if (!after) return nullptr;
+      if (exported)
+        result_.exported_module = name;
+      else if (!partition)
+        result_.imports.push_back(name);
+      return after;
+    }
+
+    if (keyword == "import") {
+      skip_hspace_at();
+      if (q < end_ && (*q == '<' || *q == '"')) {
+        // Header unit: as good as an #include.
+        const char close{*q == '<' ? '>' : '"'};
+        const char* name_begin{++q};
+        while (q < end_ && *q != close && *q != '\n') ++q;
+        if (q >= end_ || *q != close || q == name_begin) return nullptr;
+        const std::string_view header{
+            name_begin, static_cast<std::size_t>(q - name_begin)};
+        ++q;
+        const char* after{end_of_declaration()};
+        if (after) result_.includes.push_back(header);
+        return after;
+      }
+
+      const bool partition{q < end_ && *q == ':'};
+      if (partition) {
+        ++q;
+        skip_hspace_at();
+      }
+      const auto name{module_name()};
+      if (name.empty()) return nullptr;
+      const char* after{end_of_declaration()};
+      if (after && !partition) result_.imports.push_back(name);
+      return after;
+    }
+
+    return nullptr;
+  }
+
+  void on_slash() {
+    if (p_ + 1 < end_ && p_[1] == '/') {
+      // Line comment; honours backslash continuations.
+      const char* q{p_ + 2};
+      while (true) {
+        const void* nl{std::memchr(q, '\n', static_cast<std::size_t>(end_ - q))};
+        if (!nl) {
+          p_ = end_;
+          return;
+        }
+        q = static_cast<const char*>(nl);
+        if (!is_continuation(q)) break;
+        ++q;
+      }
+      p_ = q;  // Newline is handled by the main loop.
+      return;
+    }
+
+    if (p_ + 1 < end_ && p_[1] == '*') {
+      const char* q{p_ + 2};
+      while (true) {
+        const void* star{
+            std::memchr(q, '*', static_cast<std::size_t>(end_ - q))};
+        if (!star) {
+          p_ = end_;
+          return;
+        }
+        q = static_cast<const char*>(star) + 1;
+        if (q < end_ && *q == '/') {
+          p_ = q + 1;
+          return;
+        }
+      }
+    }
+
+    mark_code();
+    ++p_;
+  }
+
+  void on_quote() {
+    // A quote after a digit sequence is a separator (1'000), not a literal.
+    if (p_ > begin_ && is_ident_char(p_[-1])) {
+      const char* q{p_};
+      while (q > begin_ && (is_ident_char(q[-1]) || q[-1] == '\'')) --q;
+      if (*q >= '0' && *q <= '9') {
+        ++p_;
+        return;
+      }
+    }
+
+    mark_code();
+    const char* q{p_ + 1};
+    while (q < end_ && *q != '\'' && *q != '\n') {
+      if (*q == '\\') ++q;
+      ++q;
+    }
+    p_ = q < end_ && *q == '\'' ? q + 1 : q;
+  }
+
+  bool is_raw_string_start() const {
+    if (p_ == begin_ || p_[-1] != 'R') return false;
+    const char* q{p_ - 1};
+    // Allow the encoding prefixes LR, uR, UR and u8R.
+    if (q > begin_ && (q[-1] == 'L' || q[-1] == 'u' || q[-1] == 'U')) --q;
+    else if (q - begin_ >= 2 && q[-1] == '8' && q[-2] == 'u') q -= 2;
+    return q == begin_ || !is_ident_char(q[-1]);
+  }
+
+  void skip_string() {
+    if (is_raw_string_start()) {
+      const char* delim_begin{p_ + 1};
+      const char* q{delim_begin};
+      while (q < end_ && *q != '(' && q - delim_begin <= 16) ++q;
+      if (q >= end_ || *q != '(') {
+        ++p_;
+        return;
+      }
+
+      std::string closing{")"};
+      closing.append(delim_begin, q);
+      closing.push_back('"');
+
+      const std::string_view rest{q + 1, static_cast<std::size_t>(end_ - q - 1)};
+      const auto pos{rest.find(closing)};
+      p_ = pos == std::string_view::npos ? end_
+                                         : rest.data() + pos + closing.size();
+      return;
+    }
+
+    const char* q{p_ + 1};
+    while (q < end_ && *q != '"' && *q != '\n') {
+      if (*q == '\\') ++q;
+      ++q;
+    }
+    p_ = q < end_ && *q == '"' ? q + 1 : q;
+  }
+
+  // Blanks within a directive, including backslash line continuations.
+  void skip_hspace() {
+    while (p_ < end_) {
+      if (is_hspace(*p_)) {
+        ++p_;
+      } else if (*p_ == '\\' && p_ + 1 < end_ && p_[1] == '\n') {
+        p_ += 2;
+      } else if (*p_ == '\\' && p_ + 2 < end_ && p_[1] == '\r' &&
+                 p_[2] == '\n') {
+        p_ += 3;
+      } else {
+        break;
+      }
+    }
+  }
+
+  const char* begin_;
+  const char* p_;
+  const char* end_;
+  IncludeScanOptions options_;
+
+  SourceDependencies result_;
+  bool at_line_start_{true};
+  bool in_directive_{};
+  bool seen_anything_{};
+  // Module declarations only count before the first line of other code.
+  bool seen_code_{};
+  bool done_{};
+  int depth_{};
+};
+
+}  // namespace
+
+MappedFile::MappedFile(const fs::path& file_path) {
+  const int fd{::open(file_path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (fd < 0) return;
+
+  struct stat st {};
+  if (::fstat(fd, &st) == 0) {
+    open_ = true;
+    if (st.st_size > 0) {
+      void* data{::mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                        PROT_READ, MAP_PRIVATE, fd, 0)};
+      if (data != MAP_FAILED) {
+        ::madvise(data, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+        data_ = data;
+        size_ = static_cast<std::size_t>(st.st_size);
+      } else {
+        open_ = false;
+      }
+    }
+  }
+
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) ::munmap(data_, size_);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_{std::exchange(other.data_, nullptr)},
+      size_{std::exchange(other.size_, 0)},
+      open_{std::exchange(other.open_, false)} {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this == &other) return *this;
+
+  if (data_) ::munmap(data_, size_);
+
+  data_ = std::exchange(other.data_, nullptr);
+  size_ = std::exchange(other.size_, 0);
+  open_ = std::exchange(other.open_, false);
+
+  return *this;
+}
+
+std::optional<std::string_view> FileReader::read(const fs::path& file_path) {
+  const int fd{::open(file_path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (fd < 0) return std::nullopt;
+
+  // One byte past the expected size, so the common case ends with a single
+  // short read instead of growing the buffer.
+  struct stat st {};
+  const auto expected{::fstat(fd, &st) == 0 && st.st_size > 0
+                          ? static_cast<std::size_t>(st.st_size)
+                          : std::size_t{}};
+  reserve(expected + 1, 0);
+
+  std::size_t size{};
+  for (;;) {
+    if (size == capacity_) reserve(capacity_ * 2, size);
+    const auto n{::pread(fd, buffer_.get() + size, capacity_ - size,
+                         static_cast<off_t>(size))};
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      ::close(fd);
+      return std::nullopt;
+    }
+    if (n == 0) break;
+    size += static_cast<std::size_t>(n);
+  }
+
+  ::close(fd);
+  return std::string_view{buffer_.get(), size};
+}
+
+void FileReader::reserve(std::size_t capacity, std::size_t used) {
+  if (capacity <= capacity_) return;
+  // Doubling keeps a thread that scans files of growing size from
+  // reallocating for each one.
+  capacity = std::max(capacity, capacity_ * 2);
+  auto buffer{std::make_unique_for_overwrite<char[]>(capacity)};
+  std::copy_n(buffer_.get(), used, buffer.get());
+  buffer_ = std::move(buffer);
+  capacity_ = capacity;
+}
+
+std::vector<std::string_view> scan_includes(std::string_view source,
+                                            const IncludeScanOptions& options) {
+  return Scanner{source, options}.run().includes;
+}
+
+SourceDependencies scan_dependencies(std::string_view source,
+                                     const IncludeScanOptions& options) {
+  return Scanner{source, options}.run();
+}
+
+}  // namespace daemonmake
@@ -0,0 +1,408 @@
+#include "daemonmake/layout_patch.hpp"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "daemonmake/project.hpp"
+#include "daemonmake/tree_walker.hpp"
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * Inserts a file in sorted order, or removes it along with everything
+ * below it when it was a directory.
+ */
+void update_files(std::vector<std::string>& files, const std::string& rel_path,
+                  bool present) {
+  if (present) {
+    const auto it{std::lower_bound(files.begin(), files.end(), rel_path)};
+    if (it == files.end() || *it != rel_path) files.insert(it, rel_path);
+    return;
+  }
+  std::erase_if(files, [&](const std::string& file) {
+    return file.starts_with(rel_path) &&
+           (file.size() == rel_path.size() || file[rel_path.size()] == '/');
+  });
+}
+
+/**
+ * The targets a patch touches, expanded from the base layout into their
+ * string form on first use. Untouched targets are never expanded.
+ */
+class TargetEdits {
+ public:
+  explicit TargetEdits(const CompactLayout& base) : base_{base} {
+    for (TargetId id{}; id < base.targets().size(); ++id)
+      ids_.emplace(base.targets()[id].name, id);
+  }
+
+  /**
+   * @return The target for editing, or nullptr if there is none.
+   */
+  Target* find(const std::string& name) {
+    if (const auto it{edits_.find(name)}; it != edits_.end())
+      return it->second ? &*it->second : nullptr;
+    const auto id{ids_.find(name)};
+    if (id == ids_.end()) return nullptr;
+    return &*edits_.emplace(name, expand(id->second)).first->second;
+  }
+
+  /**
+   * @return The target for editing, created empty if there is none.
+   */
+  Target& find_or_add(const std::string& name, TargetType type) {
+    if (auto* target{find(name)}) return *target;
+    auto& slot{edits_[name]};
+    slot = Target{name, type, {}, {}, {}};
+    return *slot;
+  }
+
+  /**
+   * @return The target if an earlier edit already expanded it.
+   */
+  Target* edited(const std::string& name) {
+    const auto it{edits_.find(name)};
+    return it != edits_.end() && it->second ? &*it->second : nullptr;
+  }
+
+  void remove(const std::string& name) { edits_[name].reset(); }
+
+  /**
+   * Expands every remaining target, so all of them are re-inferred.
+   */
+  void touch_all() {
+    for (const auto& target : base_.targets()) find(std::string{target.name});
+  }
+
+  /**
+   * Moves the edited targets out, and lists the base targets removed.
+   */
+  void collect(std::vector<Target>& updated, std::vector<std::string>& removed) {
+    for (auto& [name, target] : edits_) {
+      if (target)
+        updated.push_back(std::move(*target));
+      else if (ids_.count(name) != 0)
+        removed.push_back(name);
+    }
+  }
+
+ private:
+  Target expand(TargetId id) const {
+    const auto& target{base_.targets()[id]};
+    const auto paths{[this](std::span<const FileId> files) {
+      std::vector<std::string> out;
+      out.reserve(files.size());
+      for (const auto file : files) out.push_back(base_.paths().path(file));
+      return out;
+    }};
+
+    Target out{std::string{target.name}, target.type,
+               paths(target.source_files), paths(target.header_files), {}};
+    for (const auto dep : target.dependencies)
+      out.dependencies.emplace_back(base_.targets()[dep].name);
+    return out;
+  }
+
+  const CompactLayout& base_;
+  std::unordered_map<std::string_view, TargetId> ids_;
+  // Touched targets by name; std::nullopt marks a removed one.
+  std::map<std::string, std::optional<Target>> edits_;
+};
+
+/**
+ * Re-infers the dependencies of the touched targets from the include
+ * cache, re-reading the files whose stamp no longer matches their entry.
+ * Imports resolve against the module interfaces of the whole patched
+ * layout.
+ */
+void infer_dependencies(ProjectLayout& touched,
+                        const std::vector<std::string>& removed,
+                        const CompactLayout& base, const Config& cfg,
+                        IncludeCache& cache) {
+  // A file edited in the same batch as a create or delete still has its old
+  // entry, so every file is checked against its stamp, not just new ones.
+  // The union below replaces the dependencies this computes.
+  refresh_target_dependencies(touched, {cfg.include_scan_preamble_only},
+                              cache);
+  const auto& entries{cache.entries()};
+
+  // Finding the exporters visits every file, so only when something
+  // imports.
+  const auto imports_any{[&](const std::vector<std::string>& files) {
+    return std::ranges::any_of(files, [&](const std::string& file) {
+      const auto it{entries.find(file)};
+      return it != entries.end() && !it->second.imports.empty();
+    });
+  }};
+  const bool imports{std::ranges::any_of(touched.targets, [&](const Target& t) {
+    return imports_any(t.source_files) || imports_any(t.header_files);
+  })};
+  std::unordered_map<std::string_view, std::string_view> module_owners;
+  const auto add_module{[&](const std::string& file, std::string_view owner) {
+    const auto it{entries.find(file)};
+    if (it != entries.end() && !it->second.exported_module.empty())
+      module_owners.emplace(it->second.exported_module, owner);
+  }};
+  if (imports) {
+    std::unordered_set<std::string_view> replaced{removed.begin(),
+                                                  removed.end()};
+    for (const auto& target : touched.targets) replaced.insert(target.name);
+    for (const auto& target : base.targets()) {
+      if (replaced.contains(target.name)) continue;
+      for (const auto file : target.source_files) {
+        if (is_module_interface(base.paths().filename(file)))
+          add_module(base.paths().path(file), target.name);
+      }
+    }
+    for (const auto& target : touched.targets) {
+      for (const auto& file : target.source_files)
+        if (is_module_interface(file)) add_module(file, target.name);
+    }
+  }
+
+  for (auto& target : touched.targets) {
+    std::set<std::string> deps;
+    const auto add_libs{[&](const std::string& file) {
+      const auto it{entries.find(file)};
+      if (it == entries.end()) return;
+      deps.insert(it->second.libs.begin(), it->second.libs.end());
+      for (const auto& module : it->second.imports) {
+        if (const auto owner{module_owners.find(module)};
+            owner != module_owners.end())
+          deps.emplace(owner->second);
+      }
+    }};
+    for (const auto& file : target.source_files) add_libs(file);
+    for (const auto& file : target.header_files) add_libs(file);
+    deps.erase(target.name);
+    target.dependencies.assign(deps.begin(), deps.end());
+  }
+}
+
+std::unordered_map<std::string_view, TargetId> ids_by_name(
+    const CompactLayout& layout) {
+  std::unordered_map<std::string_view, TargetId> ids;
+  for (TargetId id{}; id < layout.targets().size(); ++id)
+    ids.emplace(layout.targets()[id].name, id);
+  return ids;
+}
+
+std::vector<std::string_view> dependency_names(const CompactLayout& layout,
+                                               const CompactTarget& target) {
+  std::vector<std::string_view> names;
+  for (const auto dep : target.dependencies)
+    names.push_back(layout.targets()[dep].name);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+}  // namespace
+
+std::optional<LayoutPatch> patch_layout(const Config& cfg,
+                                        const CompactLayout& layout,
+                                        const std::vector<std::string>& rel_paths,
+                                        IncludeCache& cache) {
+  const auto& root{layout.project_root()};
+  const auto src{folder_prefix(cfg.source_folder_name)};
+  const auto include{
+      folder_prefix(cfg.include_folder_name + "/" + layout.project_name())};
+  const auto apps{folder_prefix(cfg.apps_folder_name)};
+  const auto tests{folder_prefix(cfg.tests_folder_name)};
+  const std::string default_lib{default_lib_name};
+
+  auto paths{rel_paths};
+  std::sort(paths.begin(), paths.end());
+  paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+  TargetEdits edits{layout};
+  bool library_added{};
+  // Another target may import what a module interface exports.
+  bool modules_changed{};
+
+  const auto library_dir_exists{[&](const std::string& lib) {
+    std::error_code ec;
+    return fs::is_directory(root / (src + lib), ec);
+  }};
+  // Discovery makes a library of every source subdirectory, with all the
+  // files below it and below its include directory.
+  const auto add_library{[&](const std::string& lib) -> Target& {
+    if (auto* target{edits.find(lib)}) {
+      if (target->type == TargetType::Library) return *target;
+      // Libraries are listed first, so they take the name from an app.
+      edits.remove(lib);
+    }
+    auto& target{edits.find_or_add(lib, TargetType::Library)};
+    const auto scan{walk_trees(root, {src + lib, include + lib})};
+    for (const auto& file : scan.files) {
+      if (file.starts_with(src + lib + "/")) {
+        if (is_source(file)) target.source_files.push_back(file);
+      } else if (is_header(file)) {
+        target.header_files.push_back(file);
+      }
+    }
+    library_added = true;
+    return target;
+  }};
+  // An app or test takes a name unless a target listed before it by
+  // discovery has it already.
+  const auto add_executable{[&](const std::string& name, TargetType type,
+                                const std::string& file) {
+    if (const auto* target{edits.find(name)};
+        target && discovery_rank(target->type, target->name) <
+                      discovery_rank(type, name))
+      return;
+    auto& target{edits.find_or_add(name, type)};
+    target = Target{name, type, {file}, {}, {}};
+  }};
+  // Hands a name that was given up to the app or test that was skipped
+  // for it, if any.
+  const auto reclaim{[&](const std::string& name) {
+    std::error_code ec;
+    if (const auto app{apps + name + ".cpp"};
+        fs::is_regular_file(root / app, ec)) {
+      add_executable(name, TargetType::Executable, app);
+      return;
+    }
+    constexpr std::string_view test_prefix{"test_"};
+    if (!name.starts_with(test_prefix)) return;
+    if (const auto test{tests + name.substr(test_prefix.size()) + ".cpp"};
+        fs::is_regular_file(root / test, ec))
+      add_executable(name, TargetType::Test, test);
+  }};
+  const auto remove_library{[&](const std::string& lib) {
+    const auto* target{edits.find(lib)};
+    if (lib == default_lib || !target || target->type != TargetType::Library)
+      return;
+    modules_changed = modules_changed ||
+                      std::ranges::any_of(target->source_files,
+                                          [](const std::string& file) {
+                                            return is_module_interface(file);
+                                          });
+    edits.remove(lib);
+    reclaim(lib);
+  }};
+
+  for (const auto& rel : paths) {
+    const auto as_dir{rel + '/'};
+    for (const auto* prefix : {&src, &include, &apps, &tests}) {
+      if (prefix->starts_with(as_dir)) return std::nullopt;
+    }
+
+    std::error_code ec;
+    const auto full_path{root / rel};
+    const bool is_file{fs::is_regular_file(full_path, ec)};
+    if (!is_file) cache.erase(rel);
+    if (is_module_interface(rel)) modules_changed = true;
+
+    if (rel.starts_with(src)) {
+      const auto rest{std::string_view{rel}.substr(src.size())};
+      const auto slash{rest.find('/')};
+      if (slash == std::string_view::npos) {
+        const std::string name{rest};
+        if (is_file) {
+          if (is_source(rel))
+            update_files(
+                edits.find_or_add(default_lib, TargetType::Library).source_files,
+                rel, true);
+        } else if (fs::is_directory(full_path, ec)) {
+          add_library(name);
+        } else if (!is_source(rel)) {
+          remove_library(name);
+        } else if (auto* target{edits.find(default_lib)}) {
+          update_files(target->source_files, rel, false);
+        }
+        continue;
+      }
+
+      const std::string lib{rest.substr(0, slash)};
+      if (!library_dir_exists(lib)) {
+        remove_library(lib);
+        continue;
+      }
+      update_files(add_library(lib).source_files, rel,
+                   is_file && is_source(rel));
+    } else if (rel.starts_with(include)) {
+      const auto rest{std::string_view{rel}.substr(include.size())};
+      const auto slash{rest.find('/')};
+      const bool header{is_file && is_header(rel)};
+      if (slash == std::string_view::npos) {
+        auto* target{header ? &edits.find_or_add(default_lib, TargetType::Library)
+                            : edits.find(default_lib)};
+        if (target) update_files(target->header_files, rel, header);
+        continue;
+      }
+
+      // Headers of a library without a source directory belong nowhere.
+      const std::string lib{rest.substr(0, slash)};
+      if (library_dir_exists(lib))
+        update_files(add_library(lib).header_files, rel, header);
+    } else {
+      const bool app{rel.starts_with(apps)};
+      if (!app && !rel.starts_with(tests)) continue;
+      const auto rest{std::string_view{rel}.substr(app ? apps.size() : tests.size())};
+      if (rest.find('/') != std::string_view::npos || !is_source(rel) ||
+          is_module_interface(rel))
+        continue;
+
+      const auto type{app ? TargetType::Executable : TargetType::Test};
+      const auto name{executable_target_name(rel, type)};
+      if (is_file) {
+        add_executable(name, type, rel);
+      } else if (const auto* target{edits.find(name)};
+                 target && target->source_files == std::vector{rel}) {
+        edits.remove(name);
+        reclaim(name);
+      }
+    }
+  }
+
+  if (const auto* target{edits.edited(default_lib)};
+      target && target->source_files.empty() && target->header_files.empty())
+    edits.remove(default_lib);
+  if (library_added || modules_changed) edits.touch_all();
+
+  ProjectLayout touched{layout.project_name(), root, {}};
+  std::vector<std::string> removed;
+  edits.collect(touched.targets, removed);
+  infer_dependencies(touched, removed, layout, cfg, cache);
+
+  LayoutPatch patch{CompactLayout{layout, touched.targets, removed}, {}, false};
+
+  const auto old_ids{ids_by_name(layout)};
+  const auto new_ids{ids_by_name(patch.layout)};
+  for (const auto& name : removed) {
+    patch.changed_targets.push_back(name);
+    patch.graph_changed = true;
+  }
+  for (const auto& target : touched.targets) {
+    const auto before{old_ids.find(target.name)};
+    const auto after{new_ids.find(target.name)};
+    if (after == new_ids.end()) continue;
+    if (before == old_ids.end()) {
+      patch.changed_targets.push_back(target.name);
+      patch.graph_changed = true;
+      continue;
+    }
+
+    const auto& old_target{layout.targets()[before->second]};
+    const auto& new_target{patch.layout.targets()[after->second]};
+    const bool deps_changed{dependency_names(layout, old_target) !=
+                            dependency_names(patch.layout, new_target)};
+    patch.graph_changed = patch.graph_changed || deps_changed;
+    if (deps_changed || old_target.type != new_target.type ||
+        !std::ranges::equal(old_target.source_files, new_target.source_files))
+      patch.changed_targets.push_back(target.name);
+  }
+  std::sort(patch.changed_targets.begin(), patch.changed_targets.end());
+
+  return patch;
+}
+
+}  // namespace daemonmake
@@ -0,0 +1,216 @@
+#include "daemonmake/layout_snapshot.hpp"
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+
+#include "daemonmake/binary_io.hpp"
+#include "daemonmake/include_scanner.hpp"
+#include "daemonmake/thread_pool.hpp"
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char snapshot_magic[4]{'D', 'M', 'L', 'S'};
+constexpr std::uint32_t snapshot_version{3};
+
+// Settings that change what discovery and inference produce. Anything
+// else in the config (compiler, build directory) leaves the layout valid.
+std::string discovery_key(const Config& cfg) {
+  return cfg.project_root.string() + '\n' + cfg.source_folder_name + '\n' +
+         cfg.include_folder_name + '\n' + cfg.apps_folder_name + '\n' +
+         cfg.tests_folder_name + '\n' +
+         (cfg.include_scan_preamble_only ? "preamble" : "full");
+}
+
+fs::path directory_path(const fs::path& project_root, const std::string& rel) {
+  return rel.empty() ? project_root : project_root / rel;
+}
+
+std::vector<FileStamp> stamp_directories(const fs::path& project_root,
+                                         const TreeScan& scan) {
+  std::vector<FileStamp> stamps(scan.directories.size() + 1);
+  shared_thread_pool().parallel_for(stamps.size(), [&](std::size_t i) {
+    const auto dir{i == 0 ? project_root
+                          : directory_path(project_root, scan.directories[i - 1])};
+    auto stamp{stat_file(dir).value_or(FileStamp{})};
+    if (is_racy(stamp)) stamp.mtime_ns = -1;
+    stamps[i] = stamp;
+  });
+  return stamps;
+}
+
+void write_ids(std::ostream& out, const std::vector<std::uint32_t>& ids) {
+  write_pod(out, static_cast<std::uint32_t>(ids.size()));
+  write_array(out, ids);
+}
+
+}  // namespace
+
+void save_layout_snapshot(const fs::path& file_path, const Config& cfg,
+                          const ProjectLayout& pl, const TreeScan& scan,
+                          const IncludeCache& cache) {
+  const auto stamps{stamp_directories(cfg.project_root, scan)};
+
+  std::unordered_map<std::string_view, std::uint32_t> file_ids;
+  file_ids.reserve(scan.files.size());
+  for (std::uint32_t i{}; i < scan.files.size(); ++i)
+    file_ids.emplace(scan.files[i], i);
+
+  // Every file a target lists came from the scan; anything else means the
+  // layout and scan disagree and the snapshot would be wrong.
+  const auto to_file_ids{[&](const std::vector<std::string>& files) {
+    std::vector<std::uint32_t> ids;
+    ids.reserve(files.size());
+    for (const auto& file : files) {
+      const auto it{file_ids.find(file)};
+      if (it == file_ids.end())
+        throw std::runtime_error("Layout file missing from scan: " + file);
+      ids.push_back(it->second);
+    }
+    return ids;
+  }};
+
+  write_file_atomically(file_path, [&](std::ostream& out) {
+    out.write(snapshot_magic, sizeof(snapshot_magic));
+    write_pod(out, snapshot_version);
+    write_string(out, discovery_key(cfg));
+    write_string(out, pl.project_name);
+    write_string(out, pl.project_root.string());
+
+    write_pod(out, static_cast<std::uint32_t>(scan.directories.size()));
+    write_pod(out, stamps.front());
+    for (std::size_t i{}; i < scan.directories.size(); ++i) {
+      write_string(out, scan.directories[i]);
+      write_pod(out, stamps[i + 1]);
+    }
+
+    write_pod(out, static_cast<std::uint32_t>(scan.files.size()));
+    for (const auto& file : scan.files) write_string(out, file);
+
+    write_pod(out, static_cast<std::uint32_t>(pl.targets.size()));
+    for (const auto& target : pl.targets) {
+      write_string(out, target.name);
+      write_pod(out, static_cast<std::uint8_t>(target.type));
+      write_ids(out, to_file_ids(target.source_files));
+      write_ids(out, to_file_ids(target.header_files));
+
+      write_pod(out, static_cast<std::uint32_t>(target.dependencies.size()));
+      for (const auto& dep : target.dependencies) write_string(out, dep);
+    }
+
+    std::vector<std::pair<std::uint32_t, const IncludeCache::Entry*>> entries;
+    for (const auto& [rel_path, entry] : cache.entries()) {
+      const auto it{file_ids.find(rel_path)};
+      if (it != file_ids.end()) entries.emplace_back(it->second, &entry);
+    }
+    write_pod(out, static_cast<std::uint32_t>(entries.size()));
+    for (const auto& [file_id, entry] : entries) {
+      write_pod(out, file_id);
+      write_pod(out, entry->stamp);
+      write_pod(out, static_cast<std::uint32_t>(entry->libs.size()));
+      for (const auto& lib : entry->libs) write_string(out, lib);
+      write_pod(out, static_cast<std::uint32_t>(entry->imports.size()));
+      for (const auto& module : entry->imports) write_string(out, module);
+      write_string(out, entry->exported_module);
+    }
+  });
+}
+
+std::optional<LayoutSnapshot> load_layout_snapshot(const fs::path& file_path,
+                                                   const Config& cfg) {
+  const MappedFile file{file_path};
+  if (!file.is_open()) return std::nullopt;
+
+  BinaryReader reader{file.contents()};
+  if (reader.bytes(sizeof(snapshot_magic)) !=
+      std::string_view{snapshot_magic, sizeof(snapshot_magic)})
+    return std::nullopt;
+  if (reader.pod<std::uint32_t>() != snapshot_version) return std::nullopt;
+  if (reader.string() != discovery_key(cfg)) return std::nullopt;
+
+  LayoutSnapshot snapshot;
+  snapshot.layout.project_name = reader.string();
+  snapshot.layout.project_root = reader.string();
+
+  const auto num_dirs{reader.pod<std::uint32_t>()};
+  snapshot.directory_stamps.push_back(reader.pod<FileStamp>());
+  for (std::uint32_t i{}; reader.ok && i < num_dirs; ++i) {
+    snapshot.scan.directories.emplace_back(reader.string());
+    snapshot.directory_stamps.push_back(reader.pod<FileStamp>());
+  }
+
+  const auto num_files{reader.pod<std::uint32_t>()};
+  for (std::uint32_t i{}; reader.ok && i < num_files; ++i)
+    snapshot.scan.files.emplace_back(reader.string());
+
+  const auto read_files{[&]() {
+    std::vector<std::string> files;
+    const auto count{reader.pod<std::uint32_t>()};
+    for (const auto id : reader.array<std::uint32_t>(count)) {
+      if (id >= snapshot.scan.files.size()) {
+        reader.ok = false;
+        break;
+      }
+      files.push_back(snapshot.scan.files[id]);
+    }
+    return files;
+  }};
+
+  const auto num_targets{reader.pod<std::uint32_t>()};
+  for (std::uint32_t i{}; reader.ok && i < num_targets; ++i) {
+    auto& target{snapshot.layout.targets.emplace_back()};
+    target.name = reader.string();
+    target.type = static_cast<TargetType>(reader.pod<std::uint8_t>());
+    target.source_files = read_files();
+    target.header_files = read_files();
+
+    const auto num_deps{reader.pod<std::uint32_t>()};
+    for (std::uint32_t d{}; reader.ok && d < num_deps; ++d)
+      target.dependencies.emplace_back(reader.string());
+  }
+
+  const auto num_entries{reader.pod<std::uint32_t>()};
+  for (std::uint32_t i{}; reader.ok && i < num_entries; ++i) {
+    const auto file_id{reader.pod<std::uint32_t>()};
+    IncludeCache::Entry entry{reader.pod<FileStamp>(), {}, {}, {}};
+    const auto num_libs{reader.pod<std::uint32_t>()};
+    for (std::uint32_t l{}; reader.ok && l < num_libs; ++l)
+      entry.libs.emplace_back(reader.string());
+    const auto num_imports{reader.pod<std::uint32_t>()};
+    for (std::uint32_t m{}; reader.ok && m < num_imports; ++m)
+      entry.imports.emplace_back(reader.string());
+    entry.exported_module = reader.string();
+    if (file_id >= snapshot.scan.files.size()) reader.ok = false;
+    if (reader.ok)
+      snapshot.include_cache.store(snapshot.scan.files[file_id],
+                                   std::move(entry));
+  }
+
+  if (!reader.ok || !reader.data.empty()) return std::nullopt;
+  return snapshot;
+}
+
+bool directories_unchanged(const fs::path& project_root,
+                           const LayoutSnapshot& snapshot) {
+  if (snapshot.directory_stamps.size() != snapshot.scan.directories.size() + 1)
+    return false;
+
+  std::atomic<bool> unchanged{true};
+  shared_thread_pool().parallel_for(
+      snapshot.directory_stamps.size(), [&](std::size_t i) {
+        if (!unchanged.load(std::memory_order_relaxed)) return;
+        const auto dir{i == 0 ? project_root
+                              : directory_path(project_root,
+                                               snapshot.scan.directories[i - 1])};
+        const auto stamp{stat_file(dir)};
+        if (!stamp || *stamp != snapshot.directory_stamps[i])
+          unchanged.store(false, std::memory_order_relaxed);
+      });
+  return unchanged;
+}
+
+}  // namespace daemonmake
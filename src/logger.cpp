@@ -0,0 +1,438 @@
+#include "daemonmake/logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// Longest a record waits for the flusher when nothing woke it.
+constexpr auto flush_interval{100ms};
+
+struct RecordField {
+  std::string key;
+  // Numbers and flags stay in value and are formatted by the flusher;
+  // strings are copied into text, leaving an empty string_view in value.
+  LogField::Value value;
+  std::string text;
+
+  bool is_string() const {
+    return std::holds_alternative<std::string_view>(value);
+  }
+};
+
+struct LogRecord {
+  std::chrono::system_clock::time_point time;
+  LogLevel level{};
+  std::string message;
+  // Slots keep their field strings between uses, so a warmed-up ring
+  // logs without allocating.
+  std::vector<RecordField> fields;
+  std::size_t field_count{};
+};
+
+/**
+ * Single-producer, single-consumer queue of one thread's records.
+ */
+struct LogRing {
+  static constexpr std::size_t capacity{256};
+
+  explicit LogRing(std::uint32_t thread) : thread{thread} {}
+
+  std::array<LogRecord, capacity> slots;
+  // Next slot to read; written by the consumer only.
+  alignas(64) std::atomic<std::size_t> head{};
+  // Next slot to write; written by the producer only.
+  alignas(64) std::atomic<std::size_t> tail{};
+  // Set once the producing thread has exited.
+  std::atomic<bool> orphaned{};
+  const std::uint32_t thread;
+};
+
+void append_value(std::string& out, const RecordField& field) {
+  std::visit(
+      [&](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string_view>) {
+          out.append(field.text);
+        } else if constexpr (std::is_same_v<T, bool>) {
+          out.append(v ? "true" : "false");
+        } else {
+          std::array<char, 64> buffer;
+          std::to_chars_result result;
+          if constexpr (std::is_same_v<T, double>) {
+            result = std::isfinite(v)
+                         ? std::to_chars(buffer.data(),
+                                         buffer.data() + buffer.size(), v,
+                                         std::chars_format::fixed, 1)
+                         : std::to_chars(buffer.data(),
+                                         buffer.data() + buffer.size(), 0);
+          } else {
+            result =
+                std::to_chars(buffer.data(), buffer.data() + buffer.size(), v);
+          }
+          out.append(buffer.data(), result.ptr);
+        }
+      },
+      field.value);
+}
+
+std::string_view level_name(LogLevel level) {
+  switch (level) {
+    case LogLevel::Debug:
+      return log_level_debug;
+    case LogLevel::Info:
+      return log_level_info;
+    case LogLevel::Warning:
+      return log_level_warning;
+    default:
+      return log_level_error;
+  }
+}
+
+// Replaces each `{key}` naming a field with its value.
+void render_message(const LogRecord& record, std::string& out) {
+  std::string_view message{record.message};
+  while (!message.empty()) {
+    const auto open{message.find('{')};
+    const auto close{message.find('}', open)};
+    if (open == std::string_view::npos || close == std::string_view::npos) {
+      out.append(message);
+      return;
+    }
+    out.append(message.substr(0, open));
+    const auto key{message.substr(open + 1, close - open - 1)};
+    const auto fields_end{record.fields.begin() + record.field_count};
+    const auto field{std::find_if(record.fields.begin(), fields_end,
+                                  [&](const auto& f) { return f.key == key; })};
+    if (field != fields_end)
+      append_value(out, *field);
+    else
+      out.append(message.substr(open, close - open + 1));
+    message.remove_prefix(close + 1);
+  }
+}
+
+void append_json_string(std::string& out, std::string_view text) {
+  out.push_back('"');
+  for (const char c : text) {
+    switch (c) {
+      case '"':
+        out.append("\\\"");
+        break;
+      case '\\':
+        out.append("\\\\");
+        break;
+      case '\n':
+        out.append("\\n");
+        break;
+      case '\r':
+        out.append("\\r");
+        break;
+      case '\t':
+        out.append("\\t");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          constexpr char hex[]{"0123456789abcdef"};
+          out.append("\\u00");
+          out.push_back(hex[(c >> 4) & 0xf]);
+          out.push_back(hex[c & 0xf]);
+        } else {
+          out.push_back(c);
+        }
+    }
+  }
+  out.push_back('"');
+}
+
+void append_timestamp(std::string& out,
+                      std::chrono::system_clock::time_point time) {
+  const auto since_epoch{time.time_since_epoch()};
+  const auto seconds{
+      std::chrono::duration_cast<std::chrono::seconds>(since_epoch)};
+  const auto millis{
+      std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch -
+                                                            seconds)};
+  const std::time_t t{static_cast<std::time_t>(seconds.count())};
+  std::tm utc{};
+  ::gmtime_r(&t, &utc);
+  std::array<char, 32> buffer;
+  const auto length{std::strftime(buffer.data(), buffer.size(),
+                                  "%Y-%m-%dT%H:%M:%S", &utc)};
+  out.append(buffer.data(), length);
+  std::array<char, 8> ms;
+  std::snprintf(ms.data(), ms.size(), ".%03dZ",
+                static_cast<int>(millis.count()));
+  out.append(ms.data());
+}
+
+class Logger {
+ public:
+  Logger() {
+    flusher_ = std::jthread{[this](const std::stop_token& token) {
+      while (!token.stop_requested()) {
+        {
+          std::unique_lock<std::mutex> lock{wake_mtx_};
+          wake_cv_.wait_for(lock, token, flush_interval,
+                            [this] { return wake_requested_; });
+          wake_requested_ = false;
+        }
+        drain();
+      }
+    }};
+  }
+
+  ~Logger() {
+    flusher_.request_stop();
+    flusher_.join();
+    drain();
+  }
+
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+
+  void configure(const LogOptions& options) {
+    std::ofstream json;
+    if (!options.json_file.empty()) {
+      fs::create_directories(options.json_file.parent_path());
+      json.open(options.json_file, std::ios::app);
+      if (!json)
+        throw std::runtime_error("Failed to open log file " +
+                                 options.json_file.string());
+    }
+    // Records already queued go to the previous sinks.
+    drain();
+    {
+      std::scoped_lock<std::mutex> lock{drain_mtx_};
+      json_ = std::move(json);
+      console_ = options.console;
+    }
+    set_log_level(options.level);
+  }
+
+  LogRing& ring() {
+    struct Handle {
+      std::shared_ptr<LogRing> ring;
+      ~Handle() {
+        if (ring) ring->orphaned.store(true, std::memory_order_release);
+      }
+    };
+    thread_local Handle handle;
+    if (!handle.ring) {
+      std::scoped_lock<std::mutex> lock{rings_mtx_};
+      handle.ring = std::make_shared<LogRing>(next_thread_++);
+      rings_.push_back(handle.ring);
+    }
+    return *handle.ring;
+  }
+
+  void wake() {
+    {
+      std::scoped_lock<std::mutex> lock{wake_mtx_};
+      wake_requested_ = true;
+    }
+    wake_cv_.notify_one();
+  }
+
+  // The only consumer of every ring; serialised by drain_mtx_.
+  void drain() {
+    std::scoped_lock<std::mutex> lock{drain_mtx_};
+
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+      std::scoped_lock<std::mutex> rings_lock{rings_mtx_};
+      rings = rings_;
+    }
+
+    struct Pending {
+      const LogRecord* record;
+      std::uint32_t thread;
+    };
+    std::vector<Pending> pending;
+    std::vector<std::size_t> tails(rings.size());
+    for (std::size_t i{}; i < rings.size(); ++i) {
+      auto& ring{*rings[i]};
+      tails[i] = ring.tail.load(std::memory_order_acquire);
+      for (auto slot{ring.head.load(std::memory_order_relaxed)};
+           slot != tails[i]; ++slot)
+        pending.push_back({&ring.slots[slot % LogRing::capacity], ring.thread});
+    }
+    if (pending.empty()) {
+      prune_orphans();
+      return;
+    }
+
+    // Each ring is already in order; merge them by time.
+    std::stable_sort(pending.begin(), pending.end(),
+                     [](const Pending& a, const Pending& b) {
+                       return a.record->time < b.record->time;
+                     });
+
+    bool wrote_stdout{};
+    bool wrote_stderr{};
+    for (const auto& [record, thread] : pending) {
+      message_.clear();
+      render_message(*record, message_);
+
+      if (console_) {
+        line_.assign("[daemonmake] ");
+        if (record->level == LogLevel::Warning) line_.append("Warning: ");
+        if (record->level == LogLevel::Error) line_.append("Error: ");
+        line_.append(message_);
+        if (line_.back() != '\n') line_.push_back('\n');
+        if (record->level >= LogLevel::Warning) {
+          std::cerr << line_;
+          wrote_stderr = true;
+        } else {
+          std::cout << line_;
+          wrote_stdout = true;
+        }
+      }
+
+      if (json_.is_open()) write_json(*record, thread);
+    }
+    if (wrote_stdout) std::cout.flush();
+    if (wrote_stderr) std::cerr.flush();
+    if (json_.is_open()) json_.flush();
+
+    for (std::size_t i{}; i < rings.size(); ++i)
+      rings[i]->head.store(tails[i], std::memory_order_release);
+    prune_orphans();
+  }
+
+ private:
+  void write_json(const LogRecord& record, std::uint32_t thread) {
+    line_.assign("{\"time\":\"");
+    append_timestamp(line_, record.time);
+    line_.append("\",\"level\":\"");
+    line_.append(level_name(record.level));
+    line_.append("\",\"thread\":");
+    line_.append(std::to_string(thread));
+    line_.append(",\"message\":");
+    append_json_string(line_, message_);
+    for (std::size_t i{}; i < record.field_count; ++i) {
+      const auto& field{record.fields[i]};
+      line_.push_back(',');
+      append_json_string(line_, field.key);
+      line_.push_back(':');
+      if (field.is_string())
+        append_json_string(line_, field.text);
+      else
+        append_value(line_, field);
+    }
+    line_.append("}\n");
+    json_ << line_;
+  }
+
+  // Forgets rings whose thread has exited once they are empty.
+  void prune_orphans() {
+    std::scoped_lock<std::mutex> lock{rings_mtx_};
+    std::erase_if(rings_, [](const auto& ring) {
+      return ring->orphaned.load(std::memory_order_acquire) &&
+             ring->head.load(std::memory_order_relaxed) ==
+                 ring->tail.load(std::memory_order_acquire);
+    });
+  }
+
+  std::mutex rings_mtx_;
+  std::vector<std::shared_ptr<LogRing>> rings_;
+  std::uint32_t next_thread_{};
+
+  std::mutex drain_mtx_;
+  std::ofstream json_;
+  bool console_{true};
+  // Formatting buffers reused across records; guarded by drain_mtx_.
+  std::string message_;
+  std::string line_;
+
+  std::mutex wake_mtx_;
+  std::condition_variable_any wake_cv_;
+  bool wake_requested_{};
+  std::jthread flusher_;
+};
+
+Logger& logger() {
+  static Logger instance;
+  return instance;
+}
+
+}  // namespace
+
+std::optional<LogLevel> parse_log_level(std::string_view name) {
+  if (name == log_level_debug) return LogLevel::Debug;
+  if (name == log_level_info) return LogLevel::Info;
+  if (name == log_level_warning) return LogLevel::Warning;
+  if (name == log_level_error) return LogLevel::Error;
+  return std::nullopt;
+}
+
+namespace detail {
+
+void write_log(LogLevel level, std::string_view message,
+               std::initializer_list<LogField> fields) {
+  auto& instance{logger()};
+  auto& ring{instance.ring()};
+
+  const auto tail{ring.tail.load(std::memory_order_relaxed)};
+  auto head{ring.head.load(std::memory_order_acquire)};
+  while (tail - head >= LogRing::capacity) {
+    instance.wake();
+    std::this_thread::yield();
+    head = ring.head.load(std::memory_order_acquire);
+  }
+
+  auto& record{ring.slots[tail % LogRing::capacity]};
+  record.time = std::chrono::system_clock::now();
+  record.level = level;
+  record.message.assign(message);
+  if (record.fields.size() < fields.size()) record.fields.resize(fields.size());
+  record.field_count = fields.size();
+  auto out{record.fields.begin()};
+  for (const auto& field : fields) {
+    out->key.assign(field.key);
+    if (const auto* text{std::get_if<std::string_view>(&field.value)}) {
+      out->text.assign(*text);
+      out->value = std::string_view{};
+    } else {
+      out->value = field.value;
+    }
+    ++out;
+  }
+  ring.tail.store(tail + 1, std::memory_order_release);
+
+  // Wake the flusher for the first record after a drain, before the ring
+  // fills, and for anything the user should see promptly; otherwise it
+  // batches on its own schedule.
+  if (tail == head || tail + 1 - head >= LogRing::capacity / 2 ||
+      level >= LogLevel::Warning)
+    instance.wake();
+}
+
+}  // namespace detail
+
+void configure_logging(const LogOptions& options) {
+  logger().configure(options);
+}
+
+void flush_log() { logger().drain(); }
+
+}  // namespace daemonmake
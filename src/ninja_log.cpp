@@ -0,0 +1,84 @@
+#include "daemonmake/ninja_log.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <system_error>
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// The next tab-separated field of line, consumed.
+std::string_view next_field(std::string_view& line) {
+  const auto tab{line.find('\t')};
+  const auto field{line.substr(0, tab)};
+  line.remove_prefix(tab == std::string_view::npos ? line.size() : tab + 1);
+  return field;
+}
+
+bool parse_ms(std::string_view field, std::int64_t& value) {
+  const auto [end, ec]{
+      std::from_chars(field.data(), field.data() + field.size(), value)};
+  return ec == std::errc{} && end == field.data() + field.size();
+}
+
+}  // namespace
+
+std::vector<NinjaLogEntry> parse_ninja_log(std::string_view text) {
+  std::vector<NinjaLogEntry> entries;
+  while (!text.empty()) {
+    const auto eol{text.find('\n')};
+    auto line{text.substr(0, eol)};
+    text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+    if (line.empty() || line.front() == '#') continue;
+
+    NinjaLogEntry entry;
+    if (!parse_ms(next_field(line), entry.start_ms) ||
+        !parse_ms(next_field(line), entry.end_ms))
+      continue;
+    next_field(line);  // mtime
+    const auto output{next_field(line)};
+    if (output.empty()) continue;
+    entry.output = output;
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+void NinjaLogTail::skip_to_end() {
+  std::error_code ec;
+  const auto size{fs::file_size(path_, ec)};
+  offset_ = ec ? 0 : size;
+}
+
+std::vector<NinjaLogEntry> NinjaLogTail::read_new(bool* restarted) {
+  if (restarted) *restarted = false;
+  std::error_code ec;
+  const auto size{fs::file_size(path_, ec)};
+  if (ec) {
+    offset_ = 0;
+    return {};
+  }
+  if (size < offset_) {
+    offset_ = 0;
+    if (restarted) *restarted = true;
+  }
+  if (size == offset_) return {};
+
+  std::ifstream in{path_, std::ios::binary};
+  in.seekg(static_cast<std::streamoff>(offset_));
+  std::string text(size - offset_, '\0');
+  in.read(text.data(), static_cast<std::streamsize>(text.size()));
+  text.resize(static_cast<std::size_t>(in.gcount()));
+
+  // A line still being written is left for the next call.
+  const auto last_newline{text.rfind('\n')};
+  if (last_newline == std::string::npos) return {};
+  text.resize(last_newline + 1);
+  offset_ += text.size();
+  return parse_ninja_log(text);
+}
+
+}  // namespace daemonmake
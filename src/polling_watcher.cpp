@@ -0,0 +1,409 @@
+#include "daemonmake/polling_watcher.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include "daemonmake/config.hpp"
+#include "daemonmake/thread_pool.hpp"
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// How long wait_for_events() blocks when nothing is due, as inotify's poll.
+constexpr std::chrono::milliseconds idle_wait{50};
+
+// Initial scans are spread over this many slots of the cold interval, so a
+// large tree is not rescanned in one burst.
+constexpr int initial_spread{16};
+
+std::optional<std::int64_t> mtime_of(int dir_fd, const char* path) {
+  struct statx stx {};
+  if (::statx(dir_fd, path, AT_STATX_SYNC_AS_STAT, STATX_MTIME, &stx) != 0)
+    return std::nullopt;
+  return std::int64_t{stx.stx_mtime.tv_sec} * 1'000'000'000 +
+         stx.stx_mtime.tv_nsec;
+}
+
+/**
+ * One level of a directory: regular files (and symlinks to them), and
+ * subdirectories (not symlinks to them), as the tree walker sees it.
+ */
+struct Listing {
+  std::vector<std::string> files;
+  std::vector<std::string> directories;
+};
+
+std::optional<Listing> list_directory(const fs::path& path) {
+  DIR* dir{::opendir(path.c_str())};
+  if (!dir) return std::nullopt;
+
+  Listing listing;
+  while (const dirent* entry{::readdir(dir)}) {
+    const std::string_view name{entry->d_name};
+    if (name == "." || name == "..") continue;
+
+    auto type{entry->d_type};
+    struct stat st {};
+    if (type == DT_UNKNOWN) {
+      if (::fstatat(::dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+        continue;
+      type = S_ISREG(st.st_mode)   ? DT_REG
+             : S_ISDIR(st.st_mode) ? DT_DIR
+             : S_ISLNK(st.st_mode) ? DT_LNK
+                                   : DT_UNKNOWN;
+    }
+    if (type == DT_LNK) {
+      if (::fstatat(::dirfd(dir), entry->d_name, &st, 0) == 0 &&
+          S_ISREG(st.st_mode))
+        type = DT_REG;
+    }
+
+    if (type == DT_REG)
+      listing.files.emplace_back(name);
+    else if (type == DT_DIR)
+      listing.directories.emplace_back(name);
+  }
+  ::closedir(dir);
+
+  std::sort(listing.files.begin(), listing.files.end());
+  std::sort(listing.directories.begin(), listing.directories.end());
+  return listing;
+}
+
+std::string child_prefix(const std::string& rel_dir) {
+  return rel_dir.empty() ? std::string{} : rel_dir + '/';
+}
+
+std::string join(const std::string& rel_dir, std::string_view name) {
+  auto path{child_prefix(rel_dir)};
+  path += name;
+  return path;
+}
+
+}  // namespace
+
+PollingWatcher::PollingWatcher(const fs::path& base, const TreeScan& scan,
+                               PollingOptions options)
+    : base_{base}, options_{options} {
+  const auto now{Clock::now()};
+  const auto cold_since{now - options_.cooldown * initial_spread};
+  for (const auto& rel : scan.directories) {
+    auto& dir{directories_[rel]};
+    dir.mtime_ns = mtime_of(AT_FDCWD, full_path(rel, {}).c_str())
+                       .value_or(unknown_mtime);
+    dir.last_change = cold_since;
+  }
+
+  for (const auto& file : scan.files) {
+    const auto slash{file.rfind('/')};
+    const auto it{directories_.find(
+        slash == std::string::npos ? std::string{} : file.substr(0, slash))};
+    if (it == directories_.end()) continue;
+    auto& dir{it->second};
+    const std::string_view name{
+        slash == std::string::npos ? file : std::string_view{file}.substr(slash + 1)};
+    dir.files.push_back({static_cast<std::uint32_t>(dir.names.size()),
+                         static_cast<std::uint32_t>(name.size()), 0,
+                         unknown_mtime});
+    dir.names += name;
+  }
+
+  std::vector<std::pair<const std::string*, Directory*>> all;
+  all.reserve(directories_.size());
+  for (auto& [rel, dir] : directories_) {
+    std::sort(dir.files.begin(), dir.files.end(),
+              [&dir](const FileRecord& a, const FileRecord& b) {
+                return file_name(dir, a) < file_name(dir, b);
+              });
+    all.emplace_back(&rel, &dir);
+  }
+  std::vector<FileEvent> ignored;
+  stat_files(all, now, ignored);
+
+  int slot{};
+  for (auto& [rel, dir] : directories_)
+    dir.next_scan = now + options_.cold_interval *
+                              (1 + slot++ % initial_spread) / initial_spread;
+}
+
+std::string_view PollingWatcher::name() const { return file_watcher_poll; }
+
+std::size_t PollingWatcher::file_count() const {
+  std::size_t count{};
+  for (const auto& [rel, dir] : directories_) count += dir.files.size();
+  return count;
+}
+
+std::size_t PollingWatcher::memory_usage() const {
+  // A red-black tree node carries three pointers and a colour.
+  constexpr std::size_t node_overhead{4 * sizeof(void*)};
+  std::size_t bytes{};
+  for (const auto& [rel, dir] : directories_) {
+    bytes += node_overhead + sizeof(std::string) + sizeof(Directory);
+    bytes += rel.capacity() > 15 ? rel.capacity() : 0;
+    bytes += dir.names.capacity() > 15 ? dir.names.capacity() : 0;
+    bytes += dir.files.capacity() * sizeof(FileRecord);
+  }
+  return bytes;
+}
+
+std::vector<FileEvent> PollingWatcher::wait_for_events() {
+  const auto now{Clock::now()};
+  const auto per_second{static_cast<double>(options_.stats_per_second)};
+  stat_credit_ = std::min(
+      stat_credit_ +
+          std::chrono::duration<double>(now - last_round_).count() * per_second,
+      per_second);
+  last_round_ = now;
+
+  std::vector<std::pair<Clock::time_point, std::string>> due;
+  auto next_due{now + idle_wait};
+  for (const auto& [rel, dir] : directories_) {
+    if (dir.next_scan <= now)
+      due.emplace_back(dir.next_scan, rel);
+    else
+      next_due = std::min(next_due, dir.next_scan);
+  }
+  if (due.empty() || stat_credit_ <= 0) {
+    std::this_thread::sleep_until(due.empty() ? next_due : now + idle_wait);
+    return {};
+  }
+
+  // Most overdue first, for as many stats as the budget allows. The last
+  // directory taken may overdraw it; the next rounds pay that back.
+  std::sort(due.begin(), due.end());
+  std::vector<std::string> taken;
+  for (auto& [time, rel] : due) {
+    if (stat_credit_ <= 0) break;
+    stat_credit_ -= 1.0 + static_cast<double>(directories_[rel].files.size());
+    taken.push_back(std::move(rel));
+  }
+
+  std::vector<FileEvent> events;
+  for (const auto& rel : taken) {
+    const auto it{directories_.find(rel)};
+    if (it == directories_.end()) continue;  // Went with its parent.
+    auto& dir{it->second};
+
+    const auto mtime{mtime_of(AT_FDCWD, full_path(rel, {}).c_str())};
+    if (!mtime || (*mtime != dir.mtime_ns && !relist(rel, dir, events))) {
+      const auto slash{rel.rfind('/')};
+      const auto parent{slash == std::string::npos
+                            ? directories_.end()
+                            : directories_.find(rel.substr(0, slash))};
+      if (parent != directories_.end()) {
+        // Its parent's listing reports the removal.
+        parent->second.mtime_ns = unknown_mtime;
+        parent->second.next_scan = now;
+        dir.next_scan = now + options_.hot_interval;
+      } else {
+        // A root went away, as inotify's IN_DELETE_SELF.
+        events.push_back({{}, FileEventType::Overflow});
+        remove_tree(rel, events);
+      }
+      continue;
+    }
+    if (*mtime != dir.mtime_ns) {
+      dir.mtime_ns = *mtime;
+      dir.last_change = now;
+    }
+  }
+
+  std::vector<std::pair<const std::string*, Directory*>> batch;
+  for (const auto& rel : taken) {
+    const auto it{directories_.find(rel)};
+    if (it != directories_.end() && it->second.next_scan <= now)
+      batch.emplace_back(&it->first, &it->second);
+  }
+  stat_files(batch, now, events);
+  return events;
+}
+
+void PollingWatcher::stat_files(
+    const std::vector<std::pair<const std::string*, Directory*>>& directories,
+    Clock::time_point now, std::vector<FileEvent>& events) {
+  struct Stamp {
+    std::uint64_t size{};
+    std::int64_t mtime_ns{unknown_mtime};
+  };
+  std::vector<std::vector<Stamp>> stamps(directories.size());
+
+  // One batch per directory: its files are stat'ed relative to one open
+  // descriptor, so each call resolves a single path component.
+  shared_thread_pool().parallel_for(directories.size(), [&](std::size_t i) {
+    const auto& [rel, dir]{directories[i]};
+    auto& out{stamps[i]};
+    out.resize(dir->files.size());
+    const int dir_fd{::open(full_path(*rel, {}).c_str(),
+                            O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    if (dir_fd < 0) return;
+    std::string name;
+    for (std::size_t f{}; f < dir->files.size(); ++f) {
+      name = file_name(*dir, dir->files[f]);
+      struct statx stx {};
+      if (::statx(dir_fd, name.c_str(), AT_STATX_SYNC_AS_STAT,
+                  STATX_SIZE | STATX_MTIME, &stx) != 0)
+        continue;
+      out[f] = {stx.stx_size, std::int64_t{stx.stx_mtime.tv_sec} * 1'000'000'000 +
+                                  stx.stx_mtime.tv_nsec};
+    }
+    ::close(dir_fd);
+  });
+
+  for (std::size_t i{}; i < directories.size(); ++i) {
+    const auto& [rel, dir]{directories[i]};
+    for (std::size_t f{}; f < dir->files.size(); ++f) {
+      auto& record{dir->files[f]};
+      const auto& stamp{stamps[i][f]};
+      if (stamp.mtime_ns == unknown_mtime) {
+        // Gone since the listing; the next one reports it.
+        dir->mtime_ns = unknown_mtime;
+        dir->last_change = now;
+        continue;
+      }
+      if (record.mtime_ns != unknown_mtime &&
+          (record.size != stamp.size || record.mtime_ns != stamp.mtime_ns)) {
+        events.push_back(
+            {full_path(*rel, file_name(*dir, record)), FileEventType::Modified});
+        dir->last_change = now;
+      }
+      record.size = stamp.size;
+      record.mtime_ns = stamp.mtime_ns;
+    }
+    dir->next_scan = dir->mtime_ns == unknown_mtime
+                         ? now + options_.hot_interval
+                         : now + interval(*dir, now);
+  }
+}
+
+bool PollingWatcher::relist(const std::string& rel_dir, Directory& dir,
+                            std::vector<FileEvent>& events) {
+  const auto listing{list_directory(full_path(rel_dir, {}))};
+  if (!listing) return false;
+
+  // Merge the sorted listing with the sorted index.
+  std::string names;
+  std::vector<FileRecord> files;
+  files.reserve(listing->files.size());
+  std::size_t old{};
+  for (const auto& name : listing->files) {
+    while (old < dir.files.size() && file_name(dir, dir.files[old]) < name) {
+      events.push_back({full_path(rel_dir, file_name(dir, dir.files[old])),
+                        FileEventType::Deleted});
+      ++old;
+    }
+    FileRecord record{static_cast<std::uint32_t>(names.size()),
+                      static_cast<std::uint32_t>(name.size()), 0,
+                      unknown_mtime};
+    if (old < dir.files.size() && file_name(dir, dir.files[old]) == name) {
+      record.size = dir.files[old].size;
+      record.mtime_ns = dir.files[old].mtime_ns;
+      ++old;
+    } else {
+      events.push_back({full_path(rel_dir, name), FileEventType::Created});
+    }
+    files.push_back(record);
+    names += name;
+  }
+  for (; old < dir.files.size(); ++old)
+    events.push_back({full_path(rel_dir, file_name(dir, dir.files[old])),
+                      FileEventType::Deleted});
+  dir.files = std::move(files);
+  dir.names = std::move(names);
+
+  // Subdirectories: the index holds the ones seen so far.
+  const auto prefix{child_prefix(rel_dir)};
+  std::vector<std::string> known;
+  for (auto it{directories_.lower_bound(prefix)};
+       it != directories_.end() && it->first.starts_with(prefix); ++it) {
+    if (it->first != rel_dir &&
+        it->first.find('/', prefix.size()) == std::string::npos)
+      known.push_back(it->first.substr(prefix.size()));
+  }
+  for (const auto& name : known) {
+    if (!std::binary_search(listing->directories.begin(),
+                            listing->directories.end(), name))
+      remove_tree(join(rel_dir, name), events);
+  }
+  for (const auto& name : listing->directories) {
+    if (!std::binary_search(known.begin(), known.end(), name))
+      add_tree(join(rel_dir, name), events);
+  }
+  return true;
+}
+
+void PollingWatcher::add_tree(const std::string& rel_dir,
+                              std::vector<FileEvent>& events) {
+  const auto now{Clock::now()};
+  const auto scan{walk_trees(base_, {rel_dir})};
+  std::vector<std::pair<const std::string*, Directory*>> added;
+  for (const auto& rel : scan.directories) {
+    const auto [it, inserted]{directories_.try_emplace(rel)};
+    if (!inserted) continue;
+    auto& dir{it->second};
+    dir.mtime_ns =
+        mtime_of(AT_FDCWD, full_path(rel, {}).c_str()).value_or(unknown_mtime);
+    dir.last_change = now;
+    added.emplace_back(&it->first, &dir);
+  }
+  for (const auto& file : scan.files) {
+    const auto slash{file.rfind('/')};
+    const auto it{directories_.find(file.substr(0, slash))};
+    if (it == directories_.end()) continue;
+    auto& dir{it->second};
+    const auto name{std::string_view{file}.substr(slash + 1)};
+    dir.files.push_back({static_cast<std::uint32_t>(dir.names.size()),
+                         static_cast<std::uint32_t>(name.size()), 0,
+                         unknown_mtime});
+    dir.names += name;
+    events.push_back({base_ / file, FileEventType::Created});
+  }
+  stat_files(added, now, events);
+}
+
+void PollingWatcher::remove_tree(const std::string& rel_dir,
+                                 std::vector<FileEvent>& events) {
+  const auto emit_deleted{[&](const std::string& rel, const Directory& dir) {
+    for (const auto& file : dir.files)
+      events.push_back(
+          {full_path(rel, file_name(dir, file)), FileEventType::Deleted});
+  }};
+
+  const auto prefix{child_prefix(rel_dir)};
+  auto it{directories_.lower_bound(prefix)};
+  while (it != directories_.end() && it->first.starts_with(prefix)) {
+    emit_deleted(it->first, it->second);
+    it = directories_.erase(it);
+  }
+  if (const auto self{directories_.find(rel_dir)}; self != directories_.end()) {
+    emit_deleted(self->first, self->second);
+    directories_.erase(self);
+  }
+}
+
+fs::path PollingWatcher::full_path(const std::string& rel_dir,
+                                   std::string_view name) const {
+  auto path{rel_dir.empty() ? base_ : base_ / rel_dir};
+  if (!name.empty()) path /= name;
+  return path;
+}
+
+PollingWatcher::Clock::duration PollingWatcher::interval(
+    const Directory& dir, Clock::time_point now) const {
+  const auto doublings{std::min<std::int64_t>(
+      (now - dir.last_change) / options_.cooldown, 30)};
+  return std::min<Clock::duration>(options_.hot_interval * (std::int64_t{1} << doublings),
+                                   options_.cold_interval);
+}
+
+}  // namespace daemonmake
@@ -1,107 +1,155 @@
 #include "daemonmake/project.hpp"
 
-#include <fstream>
-#include <iostream>
+#include <algorithm>
+#include <optional>
+#include <set>
+#include <span>
+#include <unordered_map>
 #include <unordered_set>
 
+#include "daemonmake/include_scanner.hpp"
+#include "daemonmake/logger.hpp"
+#include "daemonmake/thread_pool.hpp"
+
 namespace daemonmake {
 
 namespace fs = std::filesystem;
 
 namespace {
 
-std::vector<std::string> parse_includes(const fs::path& file_path) {
-  std::ifstream file{file_path};
-  if (!file.is_open()) return {};
+// Maps an include of the form <project>/<lib>/<...> to the library it belongs
+// to. Headers directly under <project>/ belong to the default lib.
+std::optional<std::string_view> include_to_lib_name(
+    std::string_view header, std::string_view project_name) {
+  const auto first_slash_pos{header.find('/')};
+  if (first_slash_pos == std::string_view::npos) return std::nullopt;
+  if (header.substr(0, first_slash_pos) != project_name) return std::nullopt;
 
-  std::vector<std::string> deps;
+  const auto second_slash_pos{header.find('/', first_slash_pos + 1)};
+  if (second_slash_pos == std::string_view::npos) return default_lib_name;
 
-  // TODO: Optimize in case cpp files are too long
-  std::string line;
-  while (std::getline(file, line)) {
-    const auto is_include{line.find("#include \"") != std::string::npos};
-    if (!is_include) continue;
+  return header.substr(first_slash_pos + 1,
+                       second_slash_pos - first_slash_pos - 1);
+}
 
-    const auto first_quote_pos{line.find('"')};
-    if (first_quote_pos == std::string::npos) continue;
+// The contiguous range of a sorted path list that lies under prefix.
+std::span<const std::string> under(const std::vector<std::string>& sorted,
+                                   std::string_view prefix) {
+  const auto first{std::lower_bound(sorted.begin(), sorted.end(), prefix)};
+  auto last{first};
+  while (last != sorted.end() && last->starts_with(prefix)) ++last;
+  return {first, last};
+}
 
-    const auto second_quote_pos{line.find('"', first_quote_pos + 1)};
-    if (second_quote_pos == std::string::npos) continue;
+// The name of a direct child of prefix, or empty for deeper paths.
+std::string_view child_name(std::string_view path, std::string_view prefix) {
+  path.remove_prefix(prefix.size());
+  return path.find('/') == std::string_view::npos ? path : std::string_view{};
+}
 
-    std::string header{line.substr(first_quote_pos + 1,
-                                   second_quote_pos - first_quote_pos - 1)};
+bool has_extension(std::string_view path, std::string_view ext) {
+  const auto name{path.substr(path.rfind('/') + 1)};
+  return name.size() > ext.size() && name.ends_with(ext);
+}
 
-    deps.push_back(std::move(header));
-  }
+}  // namespace
 
-  return deps;
+std::string folder_prefix(const std::string& folder) {
+  auto prefix{fs::path{folder}.lexically_normal().generic_string()};
+  if (!prefix.empty() && prefix.back() != '/') prefix.push_back('/');
+  return prefix;
 }
 
-}  // namespace
+bool is_source(std::string_view path) {
+  return has_extension(path, ".cpp") || is_module_interface(path);
+}
+
+bool is_module_interface(std::string_view path) {
+  return has_extension(path, ".cppm") || has_extension(path, ".ixx");
+}
+
+bool is_header(std::string_view path) {
+  return has_extension(path, ".hpp") || has_extension(path, ".h");
+}
+
+std::string executable_target_name(std::string_view path, TargetType type) {
+  auto name{fs::path{path}.stem().string()};
+  return type == TargetType::Test ? "test_" + name : name;
+}
+
+bool has_module_units(const ProjectLayout& pl) {
+  return std::any_of(pl.targets.begin(), pl.targets.end(), [](const Target& t) {
+    return std::any_of(t.source_files.begin(), t.source_files.end(),
+                       [](const std::string& src) {
+                         return is_module_interface(src);
+                       });
+  });
+}
+
+int discovery_rank(TargetType type, std::string_view name) {
+  switch (type) {
+    case TargetType::Library:
+      return name == default_lib_name ? 1 : 0;
+    case TargetType::Executable:
+      return 2;
+    case TargetType::Test:
+      return 3;
+  }
+  return 3;
+}
 
 ProjectLayout make_project_layout(const std::filesystem::path& project_root) {
   return {project_root.filename().string(), fs::canonical(project_root), {}};
 }
 
+std::vector<std::string> project_tree_roots(const Config& cfg) {
+  return {cfg.include_folder_name, cfg.source_folder_name,
+          cfg.apps_folder_name, cfg.tests_folder_name};
+}
+
 void discover_targets(const Config& cfg, ProjectLayout& pl) {
+  discover_targets(cfg, pl, walk_trees(pl.project_root, project_tree_roots(cfg)));
+}
+
+void discover_targets(const Config& cfg, ProjectLayout& pl,
+                      const TreeScan& scan) {
   pl.targets.clear();
-  
+
   // If there are files that are not in a subfolder, group them into unnamed
   // target as a lib
   Target files_not_grouped{
       std::string{default_lib_name}, TargetType::Library, {}, {}, {}};
 
-  const auto src_path{pl.project_root / cfg.source_folder_name};
-  if (fs::exists(src_path)) {
-    for (const auto& entry : fs::directory_iterator(src_path)) {
-      if (fs::is_directory(entry)) {
-        pl.targets.emplace_back(entry.path().filename().string(),
-                                TargetType::Library, std::vector<std::string>{},
-                                std::vector<std::string>{},
-                                std::vector<std::string>{});
-      } else if (fs::is_regular_file(entry) &&
-                 entry.path().extension() == ".cpp") {
-        files_not_grouped.source_files.push_back(
-            fs::relative(entry.path(), pl.project_root).string());
-      }
-    }
-    for (auto& target : pl.targets) {
-      const auto lib_src{src_path / target.name};
-      if (!fs::exists(lib_src)) continue;
-
-      for (const auto& entry : fs::recursive_directory_iterator(lib_src)) {
-        if (entry.path().extension() != ".cpp") continue;
-        target.source_files.push_back(
-            fs::relative(entry.path(), pl.project_root).string());
-      }
-    }
+  const auto src_prefix{folder_prefix(cfg.source_folder_name)};
+  for (const auto& dir : under(scan.directories, src_prefix)) {
+    const auto name{child_name(dir, src_prefix)};
+    if (!name.empty())
+      pl.targets.emplace_back(std::string{name}, TargetType::Library,
+                              std::vector<std::string>{},
+                              std::vector<std::string>{},
+                              std::vector<std::string>{});
+  }
+  for (const auto& file : under(scan.files, src_prefix)) {
+    if (!child_name(file, src_prefix).empty() && is_source(file))
+      files_not_grouped.source_files.push_back(file);
   }
 
-  const auto include_path{pl.project_root / cfg.include_folder_name /
-                          pl.project_name};
-  if (fs::exists(include_path)) {
-    for (const auto& entry : fs::directory_iterator(include_path)) {
-      if (fs::is_directory(entry)) continue;
-      if (!fs::is_regular_file(entry)) continue;
-
-      const auto ext{entry.path().extension()};
-      if (ext == ".hpp" || ext == ".h")
-        files_not_grouped.header_files.push_back(
-            fs::relative(entry.path(), pl.project_root).string());
-    }
-
-    for (auto& target : pl.targets) {
-      const auto lib_inc{include_path / target.name};
-      if (!fs::exists(lib_inc)) continue;
-
-      for (const auto& entry : fs::recursive_directory_iterator(lib_inc)) {
-        if (!fs::is_regular_file(entry)) continue;
-        const auto ext{entry.path().extension()};
-        if (ext != ".hpp" && ext != ".h") continue;
+  const auto include_prefix{
+      folder_prefix(cfg.include_folder_name + "/" + pl.project_name)};
+  for (const auto& file : under(scan.files, include_prefix)) {
+    if (!child_name(file, include_prefix).empty() && is_header(file))
+      files_not_grouped.header_files.push_back(file);
+  }
 
-        target.header_files.push_back(
-            fs::relative(entry.path(), pl.project_root).string());
-      }
+  // The scan is sorted, so every per-library file list is a contiguous,
+  // already ordered range.
+  for (auto& target : pl.targets) {
+    for (const auto& file : under(scan.files, src_prefix + target.name + "/")) {
+      if (is_source(file)) target.source_files.push_back(file);
+    }
+    for (const auto& file :
+         under(scan.files, include_prefix + target.name + "/")) {
+      if (is_header(file)) target.header_files.push_back(file);
     }
   }
 
@@ -109,75 +157,145 @@ void discover_targets(const Config& cfg, ProjectLayout& pl) {
       !files_not_grouped.header_files.empty())
     pl.targets.push_back(std::move(files_not_grouped));
 
-  const auto apps_path{pl.project_root / cfg.apps_folder_name};
-  if (fs::exists(apps_path)) {
-    for (const auto& entry : fs::directory_iterator(apps_path)) {
-      if (!fs::is_regular_file(entry) || entry.path().extension() != ".cpp")
+  // Apps, then tests: one executable per source file, sorted by name.
+  // Module interfaces only make sense in a library. CMake rejects two
+  // targets of the same name, so the first one listed keeps it.
+  std::unordered_set<std::string> names;
+  for (const auto& target : pl.targets) names.insert(target.name);
+  const auto add_executables{[&](const std::string& folder, TargetType type) {
+    const auto prefix{folder_prefix(folder)};
+    const auto first{pl.targets.size()};
+    for (const auto& file : under(scan.files, prefix)) {
+      if (child_name(file, prefix).empty() || !is_source(file) ||
+          is_module_interface(file))
         continue;
 
-      pl.targets.emplace_back(
-          entry.path().stem().string(), TargetType::Executable,
-          std::vector<std::string>{
-              fs::relative(entry.path(), pl.project_root).string()},
-          std::vector<std::string>{}, std::vector<std::string>{});
+      auto name{executable_target_name(file, type)};
+      if (!names.insert(name).second) {
+        log_warning("Skipping {file}: target name {target} is already taken",
+                    {{"file", file}, {"target", name}});
+        continue;
+      }
+      pl.targets.emplace_back(std::move(name), type,
+                              std::vector<std::string>{file},
+                              std::vector<std::string>{},
+                              std::vector<std::string>{});
     }
-  }
+    std::sort(pl.targets.begin() + static_cast<std::ptrdiff_t>(first),
+              pl.targets.end(),
+              [](const Target& a, const Target& b) { return a.name < b.name; });
+  }};
+  add_executables(cfg.apps_folder_name, TargetType::Executable);
+  add_executables(cfg.tests_folder_name, TargetType::Test);
 }
 
-void infer_target_dependencies(ProjectLayout& pl) {
-  for (auto& target : pl.targets) {
-    std::unordered_set<std::string> unique_deps;
-
-    auto fill_unique_deps{[&](const std::vector<std::string>& files) {
-      for (const auto& rel_file_path : files) {
-        const fs::path file_path{pl.project_root / rel_file_path};
-        const auto dependencies{parse_includes(file_path)};
-        for (const auto& header : dependencies) {
-          // Assuming header is formatted <project>/<lib>/<...>.hpp
-          const auto first_slash_pos{header.find('/')};
-          if (first_slash_pos == std::string::npos) continue;
-
-          const auto second_slash_pos{header.find('/', first_slash_pos + 1)};
-          // If second slash is missing, assume it's default lib
-          std::string lib_name{};
-          if (second_slash_pos != std::string::npos) {
-            lib_name = header.substr(first_slash_pos + 1,
-                                     second_slash_pos - first_slash_pos - 1);
-          } else {
-            lib_name = default_lib_name;
-          }
-
-          unique_deps.insert(lib_name);
+namespace {
+
+void infer_dependencies(ProjectLayout& pl, const IncludeScanOptions& options,
+                        IncludeCache* cache, bool prune_cache) {
+  // Flatten every file of every target so the scan is balanced per file
+  // rather than per target.
+  struct FileRef {
+    std::size_t target_index;
+    const std::string* rel_path;
+  };
+
+  std::vector<FileRef> files;
+  for (std::size_t i{}; i < pl.targets.size(); ++i) {
+    for (const auto& src : pl.targets[i].source_files) files.push_back({i, &src});
+    for (const auto& hdr : pl.targets[i].header_files) files.push_back({i, &hdr});
+  }
+
+  // Unchanged files reuse their cached contribution; only the rest are read.
+  std::vector<const IncludeCache::Entry*> cached(files.size());
+  std::vector<std::optional<IncludeCache::Entry>> scanned(files.size());
+  shared_thread_pool().parallel_for(files.size(), [&](std::size_t i) {
+    const fs::path file_path{pl.project_root / *files[i].rel_path};
+
+    std::optional<FileStamp> stamp;
+    if (cache) {
+      stamp = stat_file(file_path);
+      if (stamp) {
+        if (const auto* entry{cache->find(*files[i].rel_path, *stamp)}) {
+          cached[i] = entry;
+          return;
         }
       }
-    }};
-
-    fill_unique_deps(target.source_files);
-    fill_unique_deps(target.header_files);
+    }
 
-    unique_deps.erase(target.name);
-    target.dependencies.assign(unique_deps.begin(), unique_deps.end());
+    // Pool threads live on, so each keeps one buffer for every scan it runs.
+    thread_local FileReader reader;
+    IncludeCache::Entry entry{stamp.value_or(FileStamp{}), {}, {}, {}};
+    const auto deps{
+        scan_dependencies(reader.read(file_path).value_or(""), options)};
+    for (const auto header : deps.includes) {
+      const auto lib_name{include_to_lib_name(header, pl.project_name)};
+      if (lib_name && std::find(entry.libs.begin(), entry.libs.end(),
+                                *lib_name) == entry.libs.end())
+        entry.libs.emplace_back(*lib_name);
+    }
+    for (const auto module : deps.imports) {
+      if (std::find(entry.imports.begin(), entry.imports.end(), module) ==
+          entry.imports.end())
+        entry.imports.emplace_back(module);
+    }
+    entry.exported_module = deps.exported_module;
+    scanned[i] = std::move(entry);
+  });
+
+  const auto entry_of{[&](std::size_t i) -> const IncludeCache::Entry& {
+    return cached[i] ? *cached[i] : *scanned[i];
+  }};
+
+  // An import depends on the target whose interface exports the module.
+  std::unordered_map<std::string_view, std::size_t> module_owners;
+  for (std::size_t i{}; i < files.size(); ++i) {
+    const auto& module{entry_of(i).exported_module};
+    if (!module.empty()) module_owners.emplace(module, files[i].target_index);
   }
-}
 
-TargetGraph::TargetGraph(const ProjectLayout& pl) {
-  TargetId id_counter{};
+  // Merge in file order into ordered sets so dependency lists are stable.
+  std::vector<std::set<std::string>> unique_deps(pl.targets.size());
+  for (std::size_t i{}; i < files.size(); ++i) {
+    const auto& entry{entry_of(i)};
+    auto& deps{unique_deps[files[i].target_index]};
+    deps.insert(entry.libs.begin(), entry.libs.end());
+    for (const auto& module : entry.imports) {
+      if (const auto it{module_owners.find(module)}; it != module_owners.end())
+        deps.insert(pl.targets[it->second].name);
+    }
+  }
 
-  for (const auto& target : pl.targets) {
-    target_name_to_id[target.name] = id_counter++;
+  for (std::size_t i{}; i < pl.targets.size(); ++i) {
+    auto& target{pl.targets[i]};
+    unique_deps[i].erase(target.name);
+    target.dependencies.assign(unique_deps[i].begin(), unique_deps[i].end());
   }
 
-  dependencies = std::vector<std::vector<TargetId>>(id_counter);
-  reverse_dependencies = std::vector<std::vector<TargetId>>(id_counter);
+  if (!cache) return;
 
-  for (const auto& target : pl.targets) {
-    const auto& target_id {target_name_to_id[target.name]};
-    for (const auto& dep_name : target.dependencies) {
-        const auto& dep_id {target_name_to_id[dep_name]};
-        dependencies[target_id].push_back(dep_id);
-        reverse_dependencies[dep_id].push_back(target_id);
-    }
+  std::unordered_set<std::string_view> live_paths;
+  live_paths.reserve(files.size());
+  for (std::size_t i{}; i < files.size(); ++i) {
+    live_paths.insert(*files[i].rel_path);
+    if (scanned[i] && scanned[i]->stamp != FileStamp{})
+      cache->store(*files[i].rel_path, std::move(*scanned[i]));
   }
+  if (prune_cache) cache->retain(live_paths);
+}
+
+}  // namespace
+
+void infer_target_dependencies(ProjectLayout& pl,
+                               const IncludeScanOptions& options,
+                               IncludeCache* cache) {
+  infer_dependencies(pl, options, cache, true);
+}
+
+void refresh_target_dependencies(ProjectLayout& pl,
+                                 const IncludeScanOptions& options,
+                                 IncludeCache& cache) {
+  infer_dependencies(pl, options, &cache, false);
 }
 
 }  // namespace daemonmake
\ No newline at end of file
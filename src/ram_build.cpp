@@ -0,0 +1,321 @@
+#include "daemonmake/ram_build.hpp"
+
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+#include "daemonmake/logger.hpp"
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Passes run after every build; this catches writes made outside one.
+constexpr std::chrono::seconds write_back_interval{30};
+
+// Left behind only if the process dies mid-copy.
+constexpr std::string_view partial_suffix{".daemonmake-partial"};
+
+// Headroom kept free on tmpfs beyond the restored tree.
+constexpr std::uintmax_t tmpfs_reserve_bytes{std::uintmax_t{256} << 20};
+
+std::uintmax_t to_mb(std::uintmax_t bytes) { return bytes >> 20; }
+
+/**
+ * Reads the build directory a CMake cache was written for.
+ *
+ * @return The directory, or an empty path if the tree is not configured.
+ */
+fs::path cache_directory(const fs::path& build_directory) {
+  std::ifstream cache{build_directory / "CMakeCache.txt"};
+  constexpr std::string_view key{"CMAKE_CACHEFILE_DIR:INTERNAL="};
+  std::string line;
+  while (std::getline(cache, line)) {
+    if (line.starts_with(key)) return line.substr(key.size());
+  }
+  return {};
+}
+
+/**
+ * Copies one file or symlink, keeping the mtime. Files go through a
+ * temporary sibling, so a reader never sees a partial copy.
+ *
+ * @throws std::filesystem::filesystem_error If the copy fails.
+ */
+void copy_entry(const fs::path& from, const fs::path& to, bool symlink) {
+  fs::create_directories(to.parent_path());
+  if (symlink) {
+    fs::remove(to);
+    fs::copy_symlink(from, to);
+    return;
+  }
+  auto partial{to};
+  partial += partial_suffix;
+  fs::copy_file(from, partial, fs::copy_options::overwrite_existing);
+  fs::last_write_time(partial, fs::last_write_time(from));
+  fs::rename(partial, to);
+}
+
+// What sits at ram_build_path().
+enum class RamEntry { missing, directory, symlink, foreign };
+
+/**
+ * Classifies the entry at path without following it. /dev/shm is shared,
+ * so only a mode 0700 directory or a symlink owned by this user is ours;
+ * anything else may have been planted by another user.
+ */
+RamEntry inspect_ram_entry(const fs::path& path) {
+  struct stat st {};
+  if (::lstat(path.c_str(), &st) != 0)
+    return errno == ENOENT ? RamEntry::missing : RamEntry::foreign;
+  if (st.st_uid != ::getuid()) return RamEntry::foreign;
+  if (S_ISLNK(st.st_mode)) return RamEntry::symlink;
+  if (S_ISDIR(st.st_mode) && (st.st_mode & 07777) == S_IRWXU)
+    return RamEntry::directory;
+  return RamEntry::foreign;
+}
+
+}  // namespace
+
+fs::path ram_build_path(const Config& cfg) {
+  fs::path root{"/dev/shm"};
+  std::error_code ec;
+  if (const char* runtime_dir{std::getenv("XDG_RUNTIME_DIR")};
+      runtime_dir && fs::is_directory(runtime_dir, ec))
+    root = runtime_dir;
+
+  std::ostringstream name;
+  name << "daemonmake-" << cfg.project_root.filename().string() << '-'
+       << std::hex << std::hash<std::string>{}(cfg.project_root.string());
+  return root / name.str();
+}
+
+void redirect_build_directory(Config& cfg) {
+  if (!cfg.ram_build_directory) return;
+  const auto ram{ram_build_path(cfg)};
+  switch (inspect_ram_entry(ram)) {
+    case RamEntry::missing:
+      fs::create_directories(cfg.build_directory);
+      fs::create_directory_symlink(cfg.build_directory, ram);
+      break;
+    case RamEntry::foreign:
+      log_warning("{path} is held by another user; building in "
+                  "{build_directory}",
+                  {{"path", ram.string()},
+                   {"build_directory", cfg.build_directory.string()}});
+      return;
+    case RamEntry::directory:
+    case RamEntry::symlink:
+      break;
+  }
+  cfg.build_directory = ram;
+}
+
+RamBuildDirectory::RamBuildDirectory(Config& cfg)
+    : disk_{cfg.build_directory},
+      ram_{ram_build_path(cfg)},
+      budget_bytes_{std::uintmax_t{cfg.ram_build_budget_mb} << 20} {
+  if (inspect_ram_entry(ram_) == RamEntry::foreign) {
+    // Neither adopted nor replaced; writes there could be read or swapped
+    // by its owner.
+    log_error("{path} is not a mode 0700 directory or link owned by this "
+              "user; building in {build_directory}",
+              {{"path", ram_.string()}, {"build_directory", disk_.string()}});
+  } else {
+    cfg.build_directory = ram_;
+    in_ram_ = restore();
+    if (!in_ram()) link_to_disk();
+  }
+
+  writer_ = std::jthread{[this](const std::stop_token& token) {
+    while (!token.stop_requested()) {
+      {
+        std::unique_lock lock{wake_mutex_};
+        wake_.wait_for(lock, token, write_back_interval,
+                       [this] { return sync_requested_; });
+        sync_requested_ = false;
+      }
+      if (token.stop_requested()) break;
+      std::lock_guard lock{mutex_};
+      if (in_ram()) sync();
+    }
+  }};
+}
+
+RamBuildDirectory::~RamBuildDirectory() {
+  writer_.request_stop();
+  if (writer_.joinable()) writer_.join();
+  // The RAM tree stays, so a restarted daemon skips the restore.
+  std::lock_guard lock{mutex_};
+  if (in_ram()) sync();
+}
+
+void RamBuildDirectory::request_sync() {
+  {
+    std::lock_guard lock{wake_mutex_};
+    sync_requested_ = true;
+  }
+  wake_.notify_one();
+}
+
+void RamBuildDirectory::fall_back_to_disk() {
+  std::lock_guard lock{mutex_};
+  if (!in_ram()) return;
+  sync();
+  in_ram_ = false;
+  link_to_disk();
+}
+
+RamBuildDirectory::TreeState RamBuildDirectory::scan(
+    const fs::path& root, std::uintmax_t* total_bytes) {
+  TreeState state;
+  std::error_code ec;
+  for (fs::recursive_directory_iterator it{
+           root, fs::directory_options::skip_permission_denied, ec},
+       end;
+       it != end; it.increment(ec)) {
+    if (ec) break;
+    const auto& path{it->path()};
+    struct stat st {};
+    if (::lstat(path.c_str(), &st) != 0) continue;
+    const bool symlink{S_ISLNK(st.st_mode)};
+    if (!symlink && !S_ISREG(st.st_mode)) continue;
+    if (path.native().ends_with(partial_suffix)) continue;
+
+    state.emplace(path.lexically_relative(root).string(),
+                  FileState{static_cast<std::uintmax_t>(st.st_size),
+                            std::int64_t{st.st_mtim.tv_sec} * 1'000'000'000 +
+                                st.st_mtim.tv_nsec,
+                            symlink});
+    if (total_bytes) *total_bytes += static_cast<std::uintmax_t>(st.st_size);
+  }
+  return state;
+}
+
+bool RamBuildDirectory::restore() {
+  std::error_code ec;
+  fs::create_directories(disk_, ec);
+
+  if (inspect_ram_entry(ram_) == RamEntry::directory) {
+    // Left by an earlier daemon, and at least as new as the disk copy.
+    std::uintmax_t bytes{};
+    scan(ram_, &bytes);
+    over_budget_ = bytes > budget_bytes_;
+    synced_ = scan(disk_);
+    log_info("Building in RAM at {path} ({mb} MB kept from the last run)",
+             {{"path", ram_.string()}, {"mb", to_mb(bytes)}});
+    return true;
+  }
+
+  std::uintmax_t bytes{};
+  auto disk_state{scan(disk_, &bytes)};
+  if (bytes > budget_bytes_) {
+    log_warning(
+        "Build directory needs {mb} MB, more than ram_build_budget_mb; "
+        "building on disk",
+        {{"mb", to_mb(bytes)}});
+    return false;
+  }
+  struct statvfs fs_stats {};
+  if (::statvfs(ram_.parent_path().c_str(), &fs_stats) == 0 &&
+      std::uintmax_t{fs_stats.f_bavail} * fs_stats.f_frsize <
+          bytes + tmpfs_reserve_bytes) {
+    log_warning("Not enough free space in {path} for {mb} MB; building on disk",
+                {{"path", ram_.parent_path().string()}, {"mb", to_mb(bytes)}});
+    return false;
+  }
+
+  // A tree configured for the disk path cannot be used from another one;
+  // CMake only accepts it through the symlink.
+  const auto configured{cache_directory(disk_)};
+  const bool reusable{configured.empty() || configured == ram_};
+
+  // Only this user can read the tree, and mkdir fails rather than adopt an
+  // entry that appeared since the check.
+  fs::remove(ram_, ec);
+  try {
+    if (::mkdir(ram_.c_str(), S_IRWXU) != 0)
+      throw fs::filesystem_error{"mkdir", ram_,
+                                 std::error_code{errno, std::generic_category()}};
+    if (reusable) {
+      for (const auto& [rel, state] : disk_state)
+        copy_entry(disk_ / rel, ram_ / rel, state.symlink);
+    }
+  } catch (const fs::filesystem_error& ex) {
+    log_warning("Failed to restore {path}: {error}; building on disk",
+                {{"path", ram_.string()}, {"error", ex.what()}});
+    fs::remove_all(ram_, ec);
+    return false;
+  }
+  synced_ = std::move(disk_state);
+
+  if (reusable)
+    log_info("Building in RAM at {path} ({mb} MB restored from disk)",
+             {{"path", ram_.string()}, {"mb", to_mb(bytes)}});
+  else
+    log_info(
+        "Building in RAM at {path}; {build_directory} was configured "
+        "elsewhere, so the first build starts from scratch",
+        {{"path", ram_.string()}, {"build_directory", disk_.string()}});
+  return true;
+}
+
+void RamBuildDirectory::sync() {
+  std::uintmax_t bytes{};
+  const auto ram_state{scan(ram_, &bytes)};
+  over_budget_ = bytes > budget_bytes_;
+
+  std::size_t copied{};
+  for (const auto& [rel, state] : ram_state) {
+    const auto it{synced_.find(rel)};
+    if (it != synced_.end() && it->second == state) continue;
+    try {
+      copy_entry(ram_ / rel, disk_ / rel, state.symlink);
+      synced_.insert_or_assign(rel, state);
+      ++copied;
+    } catch (const fs::filesystem_error&) {
+      // Removed or replaced mid-build; the next pass sees its final state.
+    }
+  }
+
+  std::size_t removed{};
+  std::error_code ec;
+  for (auto it{synced_.begin()}; it != synced_.end();) {
+    if (ram_state.count(it->first) != 0) {
+      ++it;
+      continue;
+    }
+    fs::remove(disk_ / it->first, ec);
+    it = synced_.erase(it);
+    ++removed;
+  }
+
+  if (copied > 0 || removed > 0)
+    log_debug("Wrote back {copied} file(s) and removed {removed} from {path}",
+              {{"copied", copied},
+               {"removed", removed},
+               {"path", disk_.string()}});
+}
+
+void RamBuildDirectory::link_to_disk() {
+  std::error_code ec;
+  fs::remove_all(ram_, ec);
+  fs::create_directory_symlink(disk_, ram_, ec);
+  if (ec)
+    log_error("Failed to link {path} to {build_directory}: {error}",
+              {{"path", ram_.string()},
+               {"build_directory", disk_.string()},
+               {"error", ec.message()}});
+}
+
+}  // namespace daemonmake
@@ -0,0 +1,158 @@
+#include "daemonmake/subprocess.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+
+#include "daemonmake/logger.hpp"
+
+namespace daemonmake {
+
+namespace {
+
+std::vector<char*> make_argv(const std::vector<std::string>& argv) {
+  std::vector<char*> args;
+  for (auto& arg : argv) {
+    args.push_back(const_cast<char*>(arg.c_str()));
+  }
+  args.push_back(nullptr);
+  return args;
+}
+
+int wait_for_child(pid_t pid) {
+  int status{};
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) return 1;
+  }
+
+  if (WIFEXITED(status)) return WEXITSTATUS(status);
+  return 1;
+}
+
+}  // namespace
+
+int run_subprocess(const std::vector<std::string>& argv) {
+  if (argv.empty()) return 1;
+
+  auto args{make_argv(argv)};
+  // The child writes to the same terminal; queued messages come first.
+  flush_log();
+
+  pid_t pid{::fork()};
+
+  if (pid < 0) {
+    return 1;
+  } else if (pid == 0) {
+    ::execvp(args[0], args.data());
+    ::_exit(127);
+  }
+
+  // Parent
+  return wait_for_child(pid);
+}
+
+int run_subprocess_capture(const std::vector<std::string>& argv,
+                           std::string& output) {
+  output.clear();
+  if (argv.empty()) return 1;
+
+  auto args{make_argv(argv)};
+
+  int fds[2];
+  if (::pipe2(fds, O_CLOEXEC) < 0) return 1;
+
+  pid_t pid{::fork()};
+
+  if (pid < 0) {
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return 1;
+  } else if (pid == 0) {
+    ::dup2(fds[1], STDOUT_FILENO);
+    ::execvp(args[0], args.data());
+    ::_exit(127);
+  }
+
+  // Parent
+  ::close(fds[1]);
+
+  std::array<char, 64 * 1024> buffer;
+  while (true) {
+    const ssize_t n{::read(fds[0], buffer.data(), buffer.size())};
+    if (n > 0) {
+      output.append(buffer.data(), static_cast<std::size_t>(n));
+    } else if (n == 0 || errno != EINTR) {
+      break;
+    }
+  }
+  ::close(fds[0]);
+
+  return wait_for_child(pid);
+}
+
+int run_subprocess_cancellable(const std::vector<std::string>& argv,
+                               const std::filesystem::path& working_directory,
+                               std::string& output,
+                               const std::stop_token& token) {
+  output.clear();
+  if (argv.empty()) return 1;
+
+  auto args{make_argv(argv)};
+
+  int fds[2];
+  if (::pipe2(fds, O_CLOEXEC) < 0) return 1;
+
+  pid_t pid{::fork()};
+
+  if (pid < 0) {
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return 1;
+  } else if (pid == 0) {
+    // Own group, so cancelling also reaches anything the child spawns.
+    ::setpgid(0, 0);
+    ::dup2(fds[1], STDOUT_FILENO);
+    ::dup2(fds[1], STDERR_FILENO);
+    if (::chdir(working_directory.c_str()) != 0) ::_exit(127);
+    ::execvp(args[0], args.data());
+    ::_exit(127);
+  }
+
+  // Parent. Set the group here too, so a kill cannot race the child's own
+  // setpgid.
+  ::setpgid(pid, pid);
+  ::close(fds[1]);
+
+  bool cancelled{};
+  std::array<char, 64 * 1024> buffer;
+  pollfd pfd{fds[0], POLLIN, 0};
+  while (true) {
+    if (!cancelled && token.stop_requested()) {
+      ::kill(-pid, SIGKILL);
+      cancelled = true;
+    }
+
+    const int ready{::poll(&pfd, 1, 50)};
+    if (ready < 0 && errno != EINTR) break;
+    if (ready <= 0) continue;
+
+    const ssize_t n{::read(fds[0], buffer.data(), buffer.size())};
+    if (n > 0) {
+      output.append(buffer.data(), static_cast<std::size_t>(n));
+    } else if (n == 0 || errno != EINTR) {
+      break;
+    }
+  }
+  ::close(fds[0]);
+
+  const int rc{wait_for_child(pid)};
+  return cancelled ? subprocess_cancelled : rc;
+}
+
+}  // namespace daemonmake
@@ -0,0 +1,246 @@
+#include "daemonmake/target_graph.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace daemonmake {
+
+namespace {
+
+constexpr std::uint32_t unvisited{std::numeric_limits<std::uint32_t>::max()};
+
+}  // namespace
+
+struct TargetGraph::Components {
+  std::vector<std::uint32_t> scc_of;
+  std::vector<TargetId> order;           // members grouped by SCC
+  std::vector<std::uint32_t> offsets{0};  // SCC k is order[offsets[k]..]
+};
+
+TargetGraph::TargetGraph(const ProjectLayout& pl) {
+  std::vector<std::string> names;
+  names.reserve(pl.targets.size());
+  for (const auto& target : pl.targets) names.push_back(target.name);
+  set_names(std::move(names));
+
+  std::vector<std::pair<TargetId, TargetId>> edges;  // (target, dependency)
+  for (TargetId id{}; id < size(); ++id) {
+    for (const auto& dep_name : pl.targets[id].dependencies) {
+      const auto dep_id{find(dep_name)};
+      if (!dep_id)
+        unresolved_.emplace_back(id, dep_name);
+      else if (*dep_id != id)
+        edges.emplace_back(id, *dep_id);
+    }
+  }
+  build(std::move(edges));
+}
+
+TargetGraph::TargetGraph(const CompactLayout& layout) {
+  std::vector<std::string> names;
+  names.reserve(layout.targets().size());
+  for (const auto& target : layout.targets()) names.emplace_back(target.name);
+  set_names(std::move(names));
+
+  std::vector<std::pair<TargetId, TargetId>> edges;
+  for (TargetId id{}; id < size(); ++id) {
+    for (const auto dep : layout.targets()[id].dependencies)
+      edges.emplace_back(id, dep);
+  }
+  build(std::move(edges));
+}
+
+void TargetGraph::set_names(std::vector<std::string> names) {
+  names_ = std::move(names);
+  by_name_.resize(names_.size());
+  std::iota(by_name_.begin(), by_name_.end(), TargetId{});
+  std::stable_sort(by_name_.begin(), by_name_.end(),
+                   [this](TargetId a, TargetId b) { return names_[a] < names_[b]; });
+}
+
+void TargetGraph::build(std::vector<std::pair<TargetId, TargetId>> edges) {
+  const auto n{static_cast<TargetId>(size())};
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  dep_offsets_.assign(n + 1, 0);
+  rdep_offsets_.assign(n + 1, 0);
+  dep_edges_.reserve(edges.size());
+  for (const auto& [target, dep] : edges) {
+    ++dep_offsets_[target + 1];
+    ++rdep_offsets_[dep + 1];
+    dep_edges_.push_back(dep);
+  }
+  std::partial_sum(dep_offsets_.begin(), dep_offsets_.end(), dep_offsets_.begin());
+  std::partial_sum(rdep_offsets_.begin(), rdep_offsets_.end(),
+                   rdep_offsets_.begin());
+
+  // Counting sort by dependency; edges are already ordered by target, so
+  // each reverse row comes out sorted too.
+  rdep_edges_.resize(edges.size());
+  std::vector<std::uint32_t> cursor(rdep_offsets_.begin(), rdep_offsets_.end() - 1);
+  for (const auto& [target, dep] : edges) rdep_edges_[cursor[dep]++] = target;
+
+  compute_closures(compute_levels_and_cycles());
+}
+
+std::optional<TargetId> TargetGraph::find(std::string_view name) const {
+  const auto it{std::lower_bound(
+      by_name_.begin(), by_name_.end(), name,
+      [this](TargetId id, std::string_view key) { return names_[id] < key; })};
+  if (it == by_name_.end() || names_[*it] != name) return std::nullopt;
+  return *it;
+}
+
+TargetSet TargetGraph::affected(std::span<const TargetId> changed) const {
+  TargetSet result{size()};
+  for (const auto id : changed) {
+    if (row_of_[id] == no_row)
+      result.insert(id);
+    else
+      result.merge(closure_row(row_of_[id]));
+  }
+  return result;
+}
+
+std::size_t TargetGraph::memory_usage() const {
+  std::size_t bytes{};
+  for (const auto& name : names_) bytes += sizeof(name) + name.capacity();
+  bytes += by_name_.capacity() * sizeof(TargetId);
+  bytes += (dep_offsets_.capacity() + rdep_offsets_.capacity() +
+            levels_.capacity()) *
+           sizeof(std::uint32_t);
+  bytes += (dep_edges_.capacity() + rdep_edges_.capacity() + cyclic_.capacity()) *
+           sizeof(TargetId);
+  bytes += row_of_.capacity() * sizeof(std::uint32_t);
+  bytes += closures_.capacity() * sizeof(std::uint64_t);
+  return bytes;
+}
+
+TargetGraph::Components TargetGraph::compute_levels_and_cycles() {
+  // Iterative Tarjan over dependency edges. An SCC is emitted only after
+  // every SCC it depends on, so emission order is bottom-up topological.
+  const auto n{static_cast<TargetId>(size())};
+
+  std::vector<std::uint32_t> index(n, unvisited);
+  std::vector<std::uint32_t> low(n);
+  std::vector<bool> on_stack(n);
+  std::vector<TargetId> stack;
+  std::vector<std::pair<TargetId, std::uint32_t>> calls;  // (node, next edge)
+
+  Components c;
+  c.scc_of.assign(n, 0);
+
+  std::uint32_t counter{};
+  for (TargetId root{}; root < n; ++root) {
+    if (index[root] != unvisited) continue;
+
+    index[root] = low[root] = counter++;
+    stack.push_back(root);
+    on_stack[root] = true;
+    calls.emplace_back(root, dep_offsets_[root]);
+
+    while (!calls.empty()) {
+      const auto v{calls.back().first};
+      auto& edge{calls.back().second};
+
+      if (edge < dep_offsets_[v + 1]) {
+        const auto w{dep_edges_[edge++]};
+        if (index[w] == unvisited) {
+          index[w] = low[w] = counter++;
+          stack.push_back(w);
+          on_stack[w] = true;
+          calls.emplace_back(w, dep_offsets_[w]);
+        } else if (on_stack[w]) {
+          low[v] = std::min(low[v], index[w]);
+        }
+        continue;
+      }
+
+      if (low[v] == index[v]) {
+        const auto scc{static_cast<std::uint32_t>(c.offsets.size() - 1)};
+        TargetId member{};
+        do {
+          member = stack.back();
+          stack.pop_back();
+          on_stack[member] = false;
+          c.scc_of[member] = scc;
+          c.order.push_back(member);
+        } while (member != v);
+        c.offsets.push_back(static_cast<std::uint32_t>(c.order.size()));
+      }
+
+      calls.pop_back();
+      if (!calls.empty()) {
+        const auto parent{calls.back().first};
+        low[parent] = std::min(low[parent], low[v]);
+      }
+    }
+  }
+
+  // Levels per SCC, visiting dependencies before dependents.
+  const auto num_sccs{c.offsets.size() - 1};
+  std::vector<std::uint32_t> scc_level(num_sccs, 0);
+  for (std::size_t scc{}; scc < num_sccs; ++scc) {
+    for (auto i{c.offsets[scc]}; i < c.offsets[scc + 1]; ++i) {
+      for (const auto dep : dependencies(c.order[i])) {
+        if (c.scc_of[dep] != scc)
+          scc_level[scc] = std::max(scc_level[scc], scc_level[c.scc_of[dep]] + 1);
+      }
+    }
+  }
+
+  levels_.resize(n);
+  cyclic_.clear();
+  for (TargetId id{}; id < n; ++id) {
+    levels_[id] = scc_level[c.scc_of[id]];
+    const auto scc{c.scc_of[id]};
+    if (c.offsets[scc + 1] - c.offsets[scc] > 1) cyclic_.push_back(id);
+  }
+
+  return c;
+}
+
+void TargetGraph::compute_closures(const Components& c) {
+  const auto n{size()};
+  words_per_row_ = (n + 63) / 64;
+
+  row_of_.assign(n, no_row);
+  std::uint32_t rows{};
+  for (TargetId id{}; id < n; ++id) {
+    if (!reverse_dependencies(id).empty()) row_of_[id] = rows++;
+  }
+  closures_.assign(std::size_t{rows} * words_per_row_, 0);
+
+  // Dependents are emitted after their dependencies, so walking SCCs in
+  // reverse emission order sees every dependent's row before it is needed.
+  std::vector<std::uint64_t> row(words_per_row_);
+  for (auto scc{c.offsets.size() - 1}; scc-- > 0;) {
+    const auto first{c.offsets[scc]};
+    const auto last{c.offsets[scc + 1]};
+    if (last - first == 1 && row_of_[c.order[first]] == no_row) continue;
+
+    std::fill(row.begin(), row.end(), 0);
+    for (auto i{first}; i < last; ++i) {
+      const auto member{c.order[i]};
+      row[member / 64] |= std::uint64_t{1} << (member % 64);
+      for (const auto dependent : reverse_dependencies(member)) {
+        if (c.scc_of[dependent] == scc) continue;
+        if (row_of_[dependent] == no_row) {
+          row[dependent / 64] |= std::uint64_t{1} << (dependent % 64);
+          continue;
+        }
+        const auto other{closure_row(row_of_[dependent])};
+        for (std::size_t w{}; w < words_per_row_; ++w) row[w] |= other[w];
+      }
+    }
+    for (auto i{first}; i < last; ++i) {
+      std::copy(row.begin(), row.end(),
+                closures_.begin() + static_cast<std::ptrdiff_t>(
+                                        row_of_[c.order[i]] * words_per_row_));
+    }
+  }
+}
+
+}  // namespace daemonmake
@@ -0,0 +1,53 @@
+#include "daemonmake/test_runner.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+std::vector<TestResult> run_tests(
+    const Config& cfg, const std::vector<std::string>& tests,
+    const std::stop_token& token,
+    const std::function<void(const TestResult&)>& on_result) {
+  const auto jobs{std::min<std::size_t>(
+      cfg.test_jobs > 0 ? cfg.test_jobs
+                        : std::max(1u, std::thread::hardware_concurrency()),
+      tests.size())};
+
+  std::vector<TestResult> results;
+  std::mutex results_mtx;
+  std::atomic<std::size_t> next{};
+
+  const auto worker{[&] {
+    for (auto i{next++}; i < tests.size() && !token.stop_requested();
+         i = next++) {
+      TestResult result{tests[i], 127, {}, {}};
+      const auto executable{cfg.build_directory / tests[i]};
+      const auto start{std::chrono::steady_clock::now()};
+      if (fs::exists(executable)) {
+        result.exit_code = run_subprocess_cancellable(
+            {executable.string()}, cfg.build_directory, result.output, token);
+      } else {
+        result.output = executable.string() + " has not been built\n";
+      }
+      result.duration = std::chrono::steady_clock::now() - start;
+
+      std::scoped_lock<std::mutex> lock{results_mtx};
+      on_result(result);
+      results.push_back(std::move(result));
+    }
+  }};
+
+  {
+    std::vector<std::jthread> workers;
+    for (std::size_t i{}; i < jobs; ++i) workers.emplace_back(worker);
+  }
+  return results;
+}
+
+}  // namespace daemonmake
@@ -0,0 +1,154 @@
+#include "daemonmake/thread_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+
+namespace daemonmake {
+
+namespace {
+
+thread_local const ThreadPool* tls_pool{};
+thread_local std::size_t tls_worker_index{};
+
+}  // namespace
+
+ThreadPool::ThreadPool(std::size_t num_threads) {
+  if (num_threads == 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  workers_.reserve(num_threads);
+  for (std::size_t i{}; i < num_threads; ++i)
+    workers_.push_back(std::make_unique<Worker>());
+
+  threads_.reserve(num_threads);
+  for (std::size_t i{}; i < num_threads; ++i) {
+    threads_.emplace_back([this, i](const std::stop_token& token) {
+      worker_loop(token, i);
+    });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  for (auto& thread : threads_) thread.request_stop();
+  cv_work_.notify_all();
+  threads_.clear();
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+  const std::size_t target{
+      tls_pool == this
+          ? tls_worker_index
+          : next_queue_.fetch_add(1, std::memory_order_relaxed) %
+                workers_.size()};
+  pending_.fetch_add(1, std::memory_order_release);
+  {
+    std::scoped_lock<std::mutex> lock{workers_[target]->mtx};
+    workers_[target]->jobs.push_back(std::move(job));
+  }
+
+  // Taking the lock orders this notify after any sleeper's predicate check.
+  { std::scoped_lock<std::mutex> lock{sleep_mtx_}; }
+  cv_work_.notify_one();
+}
+
+void ThreadPool::parallel_for(std::size_t count,
+                              const std::function<void(std::size_t)>& fn) {
+  if (count == 0) return;
+
+  struct State {
+    std::atomic<std::size_t> next{};
+    std::atomic<std::size_t> done{};
+    std::size_t count{};
+    const std::function<void(std::size_t)>* fn{};
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::exception_ptr error;
+  };
+
+  auto state{std::make_shared<State>()};
+  state->count = count;
+  state->fn = &fn;
+
+  // Helpers that start after every index was claimed exit without touching
+  // fn, so the caller only has to wait for completed iterations.
+  const auto drain{[state] {
+    std::size_t finished{};
+    for (std::size_t i{state->next.fetch_add(1)}; i < state->count;
+         i = state->next.fetch_add(1)) {
+      try {
+        (*state->fn)(i);
+      } catch (...) {
+        std::scoped_lock<std::mutex> lock{state->mtx};
+        if (!state->error) state->error = std::current_exception();
+      }
+      ++finished;
+    }
+    if (finished != 0 &&
+        state->done.fetch_add(finished) + finished == state->count) {
+      std::scoped_lock<std::mutex> lock{state->mtx};
+      state->cv.notify_all();
+    }
+  }};
+
+  const std::size_t helpers{std::min(workers_.size(), count - 1)};
+  for (std::size_t i{}; i < helpers; ++i) submit(drain);
+
+  drain();
+
+  std::unique_lock<std::mutex> lock{state->mtx};
+  state->cv.wait(lock, [&] { return state->done.load() == state->count; });
+  if (state->error) std::rethrow_exception(state->error);
+}
+
+bool ThreadPool::try_pop(std::size_t self, std::function<void()>& job) {
+  {
+    auto& own{*workers_[self]};
+    std::scoped_lock<std::mutex> lock{own.mtx};
+    if (!own.jobs.empty()) {
+      job = std::move(own.jobs.back());
+      own.jobs.pop_back();
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  for (std::size_t offset{1}; offset < workers_.size(); ++offset) {
+    auto& victim{*workers_[(self + offset) % workers_.size()]};
+    std::scoped_lock<std::mutex> lock{victim.mtx};
+    if (!victim.jobs.empty()) {
+      job = std::move(victim.jobs.front());
+      victim.jobs.pop_front();
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ThreadPool::worker_loop(const std::stop_token& token, std::size_t index) {
+  tls_pool = this;
+  tls_worker_index = index;
+
+  std::function<void()> job;
+  while (!token.stop_requested()) {
+    if (try_pop(index, job)) {
+      job();
+      job = nullptr;
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock{sleep_mtx_};
+    cv_work_.wait(lock, token, [this] {
+      return pending_.load(std::memory_order_acquire) != 0;
+    });
+  }
+}
+
+ThreadPool& shared_thread_pool() {
+  static ThreadPool pool{};
+  return pool;
+}
+
+}  // namespace daemonmake
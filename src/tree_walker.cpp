@@ -0,0 +1,183 @@
+#include "daemonmake/tree_walker.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+#include "daemonmake/thread_pool.hpp"
+
+namespace daemonmake {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Layout the kernel uses for getdents64 records; glibc does not export it.
+struct linux_dirent64 {
+  std::uint64_t d_ino;
+  std::int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+// Directories listed on the calling thread before the rest is handed to
+// the pool, so that one large subtree does not serialise the walk.
+constexpr std::size_t max_eager_depth{3};
+
+class DirectoryFd {
+ public:
+  DirectoryFd(int at_fd, const char* path)
+      : fd_{::openat(at_fd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)} {}
+  ~DirectoryFd() {
+    if (fd_ >= 0) ::close(fd_);
+  }
+
+  DirectoryFd(const DirectoryFd&) = delete;
+  DirectoryFd& operator=(const DirectoryFd&) = delete;
+
+  int get() const { return fd_; }
+  bool is_open() const { return fd_ >= 0; }
+
+ private:
+  int fd_;
+};
+
+enum class EntryKind { File, Directory, Other };
+
+EntryKind classify(int dir_fd, const char* name, unsigned char d_type) {
+  switch (d_type) {
+    case DT_REG:
+      return EntryKind::File;
+    case DT_DIR:
+      return EntryKind::Directory;
+    case DT_LNK:
+    case DT_UNKNOWN:
+      break;
+    default:
+      return EntryKind::Other;
+  }
+
+  struct stat st {};
+  if (d_type == DT_UNKNOWN) {
+    if (::fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+      return EntryKind::Other;
+    if (S_ISREG(st.st_mode)) return EntryKind::File;
+    if (S_ISDIR(st.st_mode)) return EntryKind::Directory;
+    if (!S_ISLNK(st.st_mode)) return EntryKind::Other;
+  }
+
+  // Symlinks count as files when they resolve to one, but are never
+  // descended into, matching recursive_directory_iterator's default.
+  if (::fstatat(dir_fd, name, &st, 0) != 0) return EntryKind::Other;
+  return S_ISREG(st.st_mode) ? EntryKind::File : EntryKind::Other;
+}
+
+std::string join(const std::string& rel, std::string_view name) {
+  if (rel.empty()) return std::string{name};
+  std::string path;
+  path.reserve(rel.size() + 1 + name.size());
+  path.append(rel).append(1, '/').append(name);
+  return path;
+}
+
+/**
+ * Lists one open directory, recording it and its files.
+ *
+ * @return Names of its subdirectories.
+ */
+std::vector<std::string> scan_directory(int fd, const std::string& rel,
+                                        TreeScan& out) {
+  out.directories.push_back(rel);
+
+  std::vector<std::string> subdirs;
+  alignas(linux_dirent64) std::array<char, 32 * 1024> buffer;
+  for (;;) {
+    const auto bytes{::syscall(SYS_getdents64, fd, buffer.data(), buffer.size())};
+    if (bytes <= 0) break;
+
+    for (long offset{}; offset < bytes;) {
+      const auto* entry{
+          reinterpret_cast<const linux_dirent64*>(buffer.data() + offset)};
+      offset += entry->d_reclen;
+
+      const std::string_view name{entry->d_name};
+      if (name == "." || name == "..") continue;
+
+      switch (classify(fd, entry->d_name, entry->d_type)) {
+        case EntryKind::File:
+          out.files.push_back(join(rel, name));
+          break;
+        case EntryKind::Directory:
+          subdirs.emplace_back(name);
+          break;
+        case EntryKind::Other:
+          break;
+      }
+    }
+  }
+  return subdirs;
+}
+
+void walk_recursive(int fd, const std::string& rel, TreeScan& out) {
+  for (const auto& name : scan_directory(fd, rel, out)) {
+    const DirectoryFd child{fd, name.c_str()};
+    if (child.is_open()) walk_recursive(child.get(), join(rel, name), out);
+  }
+}
+
+fs::path absolute_path(const fs::path& base, const std::string& rel) {
+  return rel.empty() ? base : base / rel;
+}
+
+}  // namespace
+
+TreeScan walk_trees(const fs::path& base, const std::vector<std::string>& roots) {
+  TreeScan result;
+  auto& pool{shared_thread_pool()};
+
+  // Expand breadth-first until there are enough subtrees to keep every
+  // worker busy.
+  std::vector<std::string> frontier{roots};
+  for (std::size_t depth{};
+       depth < max_eager_depth && !frontier.empty() &&
+       frontier.size() < 4 * pool.size();
+       ++depth) {
+    std::vector<std::string> next;
+    for (const auto& rel : frontier) {
+      const DirectoryFd dir{AT_FDCWD, absolute_path(base, rel).c_str()};
+      if (!dir.is_open()) continue;
+      for (const auto& name : scan_directory(dir.get(), rel, result))
+        next.push_back(join(rel, name));
+    }
+    frontier = std::move(next);
+  }
+
+  std::vector<TreeScan> partial(frontier.size());
+  pool.parallel_for(frontier.size(), [&](std::size_t i) {
+    const DirectoryFd dir{AT_FDCWD, absolute_path(base, frontier[i]).c_str()};
+    if (dir.is_open()) walk_recursive(dir.get(), frontier[i], partial[i]);
+  });
+
+  for (auto& scan : partial) {
+    result.directories.insert(result.directories.end(),
+                              std::make_move_iterator(scan.directories.begin()),
+                              std::make_move_iterator(scan.directories.end()));
+    result.files.insert(result.files.end(),
+                        std::make_move_iterator(scan.files.begin()),
+                        std::make_move_iterator(scan.files.end()));
+  }
+  std::sort(result.directories.begin(), result.directories.end());
+  std::sort(result.files.begin(), result.files.end());
+  return result;
+}
+
+}  // namespace daemonmake
@@ -0,0 +1,171 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "daemonmake/build_backend.hpp"
+#include "daemonmake/config.hpp"
+
+namespace daemonmake::test {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * Puts a fake ninja first on PATH for the object's lifetime. It appends
+ * each command line to `calls` next to itself and lists four targets for
+ * `-t targets`. Builds log two overlapping steps per target and fail if
+ * asked for `broken`.
+ */
+class StubNinja {
+ public:
+  explicit StubNinja(const fs::path& dir)
+      : calls_{dir / "calls"}, old_path_{std::getenv("PATH")} {
+    fs::create_directories(dir);
+    const auto script{dir / "ninja"};
+    std::ofstream{script}
+        << "#!/bin/sh\n"
+           "echo \"$@\" >> \"$(dirname \"$0\")/calls\"\n"
+           "if [ \"$3\" = -t ]; then\n"
+           "  printf 'app: phony\\nlib: phony\\ntool: phony\\n"
+           "broken: phony\\n'\n"
+           "  exit 0\n"
+           "fi\n"
+           "log=$2/.ninja_log; shift 2; rc=0\n"
+           "for t in \"$@\"; do\n"
+           "  [ $t = broken ] && rc=1 && continue\n"
+           "  printf '10\\t40\\t0\\tCMakeFiles/%s.dir/a.o\\t0\\n"
+           "20\\t%s00\\t0\\tCMakeFiles/%s.dir/b.o\\t0\\n' "
+           "$t ${#t} $t >> $log\n"
+           "done\n"
+           "exit $rc\n";
+    fs::permissions(script, fs::perms::owner_all);
+    ::setenv("PATH", (dir.string() + ":" + old_path_).c_str(), 1);
+  }
+
+  ~StubNinja() { ::setenv("PATH", old_path_.c_str(), 1); }
+
+  /**
+   * @return The command lines ninja ran with, arguments after `-C <dir>`.
+   */
+  std::vector<std::string> calls() const {
+    std::vector<std::string> calls;
+    std::ifstream in{calls_};
+    std::string line;
+    while (std::getline(in, line)) {
+      const auto args{line.find(' ', line.find(' ') + 1)};
+      calls.push_back(args == std::string::npos ? "" : line.substr(args + 1));
+    }
+    return calls;
+  }
+
+ private:
+  fs::path calls_;
+  std::string old_path_;
+};
+
+struct Built {
+  std::string target;
+  int exit_code;
+  std::chrono::steady_clock::duration duration;
+
+  bool operator==(const Built&) const = default;
+};
+
+std::ostream& operator<<(std::ostream& os, const Built& built) {
+  return os << built.target << " rc=" << built.exit_code << ' '
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   built.duration)
+                   .count()
+            << "ms";
+}
+
+/**
+ * @return A request for the targets that records what it reports.
+ */
+BuildRequest recording_request(std::vector<std::string> targets,
+                               std::size_t first_batch,
+                               std::vector<Built>& built) {
+  BuildRequest request{std::move(targets), first_batch, {}};
+  request.on_target_built = [&built](const std::string& target, int rc,
+                                     auto duration) {
+    built.push_back({target, rc, duration});
+  };
+  return request;
+}
+
+Config make_ninja_config(const fs::path& root) {
+  auto cfg{make_default_config(root)};
+  cfg.build_directory = root / "build";
+  cfg.build_backend = build_backend_ninja;
+  fs::create_directories(cfg.build_directory);
+  std::ofstream{cfg.build_directory / "build.ninja"};
+  return cfg;
+}
+
+}  // namespace
+
+DAEMONMAKE_TEST(build_backend, ninja_targets_listed_once_per_manifest) {
+  const auto root{make_scratch_dir("ninja_targets_listed_once_per_manifest")};
+  const StubNinja ninja{root / "bin"};
+  const auto cfg{make_ninja_config(root)};
+  const auto manifest{cfg.build_directory / "build.ninja"};
+
+  const auto backend{make_build_backend(cfg)};
+  CHECK_EQ(backend->name(), build_backend_ninja);
+  CHECK_EQ(backend->build({{"app"}}), 0);
+  CHECK_EQ(backend->build({{"lib"}}), 0);
+  CHECK_EQ(ninja.calls(), (std::vector<std::string>{
+                              "-t targets all", "app", "lib"}));
+
+  // A regenerated manifest may name other targets.
+  fs::last_write_time(manifest, fs::last_write_time(manifest) +
+                                    std::chrono::seconds{1});
+  CHECK_EQ(backend->build({{"missing"}}), 0);
+  CHECK_EQ(ninja.calls(), (std::vector<std::string>{
+                              "-t targets all", "app", "lib",
+                              "-t targets all", ""}));
+}
+
+DAEMONMAKE_TEST(build_backend, first_batch_builds_before_the_rest) {
+  const auto root{make_scratch_dir("first_batch_builds_before_the_rest")};
+  const StubNinja ninja{root / "bin"};
+  const auto backend{make_build_backend(make_ninja_config(root))};
+
+  std::vector<Built> built;
+  CHECK_EQ(backend->build(recording_request({"app", "lib", "tool"}, 1, built)),
+           0);
+  CHECK_EQ(ninja.calls(), (std::vector<std::string>{
+                              "-t targets all", "app", "lib tool"}));
+  // Spans run from the first step's start to the last one's end.
+  using std::chrono::milliseconds;
+  CHECK_EQ(built, (std::vector<Built>{{"app", 0, milliseconds{290}},
+                                      {"lib", 0, milliseconds{290}},
+                                      {"tool", 0, milliseconds{390}}}));
+}
+
+DAEMONMAKE_TEST(build_backend, failed_first_batch_stops_the_build) {
+  const auto root{make_scratch_dir("failed_first_batch_stops_the_build")};
+  const StubNinja ninja{root / "bin"};
+  auto cfg{make_ninja_config(root)};
+  cfg.keep_going = false;
+  const auto backend{make_build_backend(cfg)};
+
+  std::vector<Built> built;
+  CHECK_EQ(backend->build(recording_request({"broken", "lib"}, 1, built)), 1);
+  CHECK_EQ(ninja.calls(), (std::vector<std::string>{"-t targets all",
+                                                    "broken"}));
+  CHECK_EQ(built, (std::vector<Built>{{"broken", 1, {}}}));
+
+  // Nothing is split off when the first batch would be everything.
+  built.clear();
+  CHECK_EQ(backend->build(recording_request({"app", "lib"}, 2, built)), 0);
+  CHECK_EQ(ninja.calls().back(), "app lib");
+  CHECK_EQ(built.size(), 2u);
+}
+
+}  // namespace daemonmake::test
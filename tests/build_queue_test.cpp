@@ -0,0 +1,103 @@
+#include <chrono>
+#include <future>
+#include <stop_token>
+#include <thread>
+
+#include "check.hpp"
+#include "daemonmake/build_queue.hpp"
+#include "daemonmake/file_watcher.hpp"
+
+namespace daemonmake::test {
+
+namespace {
+
+using namespace std::chrono_literals;
+using clock = std::chrono::steady_clock;
+
+constexpr auto debounce{50ms};
+constexpr auto hold_timeout{1000ms};
+
+/**
+ * Pops the next batch on another thread, so a test can check whether it
+ * was let go yet.
+ */
+std::future<BuildQueue::Task> pop_async(BuildQueue& queue) {
+  return std::async(std::launch::async,
+                    [&queue] { return queue.pop_all_events({}); });
+}
+
+bool ready(const std::future<BuildQueue::Task>& task,
+           std::chrono::milliseconds wait) {
+  return task.wait_for(wait) == std::future_status::ready;
+}
+
+}  // namespace
+
+DAEMONMAKE_TEST(build_queue, unheld_batch_goes_after_debounce) {
+  BuildQueue queue{16, debounce, hold_timeout};
+  queue.push_event({"a.cpp", FileEventType::Modified});
+  const auto start{clock::now()};
+  const auto task{pop_async(queue).get()};
+  CHECK(clock::now() - start < hold_timeout);
+  CHECK_EQ(task.events.size(), 1u);
+}
+
+DAEMONMAKE_TEST(build_queue, hold_keeps_events_past_debounce) {
+  BuildQueue queue{16, debounce, hold_timeout};
+  queue.hold(true);
+  queue.push_event({"a.cpp", FileEventType::Modified});
+  auto task{pop_async(queue)};
+  CHECK(!ready(task, 4 * debounce));
+
+  // Events pushed while held join the same batch.
+  queue.push_event({"b.cpp", FileEventType::Created});
+  CHECK(!ready(task, 4 * debounce));
+  queue.hold(false);
+  CHECK(ready(task, hold_timeout));
+  const auto batch{task.get()};
+  CHECK_EQ(batch.events.size(), 2u);
+  CHECK(batch.requires_discovery());
+}
+
+DAEMONMAKE_TEST(build_queue, release_still_waits_for_debounce) {
+  BuildQueue queue{16, debounce, hold_timeout};
+  queue.hold(true);
+  auto task{pop_async(queue)};
+  queue.push_event({"a.cpp", FileEventType::Modified});
+  const auto last_push{clock::now()};
+  queue.hold(false);
+
+  const auto batch{task.get()};
+  CHECK(clock::now() - last_push >= debounce);
+  CHECK_EQ(batch.events.size(), 1u);
+}
+
+DAEMONMAKE_TEST(build_queue, hold_times_out) {
+  BuildQueue queue{16, debounce, hold_timeout};
+  const auto held{clock::now()};
+  queue.hold(true);
+  queue.push_event({"a.cpp", FileEventType::Modified});
+
+  // Never released, as after a crashed checkout left its lock behind.
+  const auto batch{pop_async(queue).get()};
+  const auto elapsed{clock::now() - held};
+  CHECK(elapsed >= hold_timeout);
+  CHECK(elapsed < 10 * hold_timeout);
+  CHECK_EQ(batch.events.size(), 1u);
+}
+
+DAEMONMAKE_TEST(build_queue, held_full_rebuild_waits_for_release) {
+  BuildQueue queue{16, debounce, hold_timeout};
+  queue.hold(true);
+  queue.push_event({{}, FileEventType::Overflow});
+  auto task{pop_async(queue)};
+  CHECK(!ready(task, 4 * debounce));
+
+  queue.hold(false);
+  CHECK(ready(task, hold_timeout));
+  const auto batch{task.get()};
+  CHECK(batch.full_rebuild);
+  CHECK(batch.events.empty());
+}
+
+}  // namespace daemonmake::test
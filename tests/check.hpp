@@ -0,0 +1,98 @@
+#ifndef DAEMONMAKE__TESTS_CHECK
+#define DAEMONMAKE__TESTS_CHECK
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace daemonmake::test {
+
+/**
+ * A registered test case. Names read "<suite>.<case>".
+ */
+struct TestCase {
+  std::string_view name;
+  void (*fn)();
+};
+
+inline std::vector<TestCase>& registry() {
+  static std::vector<TestCase> cases;
+  return cases;
+}
+
+/**
+ * @return Number of failed checks so far.
+ */
+inline int& failures() {
+  static int count{};
+  return count;
+}
+
+inline bool add(std::string_view name, void (*fn)()) {
+  registry().push_back({name, fn});
+  return true;
+}
+
+inline void check(bool ok, std::string_view expr, const char* file, int line) {
+  if (ok) return;
+  ++failures();
+  std::cerr << file << ':' << line << ": check failed: " << expr << '\n';
+}
+
+inline void print_value(std::ostream& os, const std::string& value) {
+  os << '"' << value << '"';
+}
+
+template <typename T>
+void print_value(std::ostream& os, const T& value) {
+  os << value;
+}
+
+template <typename T>
+void print_value(std::ostream& os, const std::vector<T>& values) {
+  os << "{\n";
+  for (const auto& value : values) {
+    os << "    ";
+    print_value(os, value);
+    os << '\n';
+  }
+  os << "  }";
+}
+
+template <typename A, typename B>
+void check_eq(const A& actual, const B& expected, std::string_view expr,
+              const char* file, int line) {
+  if (actual == expected) return;
+  ++failures();
+  std::cerr << file << ':' << line << ": check failed: " << expr
+            << "\n  actual:   ";
+  print_value(std::cerr, actual);
+  std::cerr << "\n  expected: ";
+  print_value(std::cerr, expected);
+  std::cerr << '\n';
+}
+
+/**
+ * Creates an empty scratch directory under the system temp directory.
+ *
+ * @param name Used in the directory name.
+ */
+std::filesystem::path make_scratch_dir(std::string_view name);
+
+}  // namespace daemonmake::test
+
+#define DAEMONMAKE_TEST(suite, name)                                       \
+  static void suite##_##name();                                            \
+  [[maybe_unused]] static const bool suite##_##name##_registered{          \
+      ::daemonmake::test::add(#suite "." #name, suite##_##name)};          \
+  static void suite##_##name()
+
+#define CHECK(cond) ::daemonmake::test::check((cond), #cond, __FILE__, __LINE__)
+
+#define CHECK_EQ(actual, expected)                                         \
+  ::daemonmake::test::check_eq((actual), (expected),                       \
+                               #actual " == " #expected, __FILE__, __LINE__)
+
+#endif
@@ -0,0 +1,148 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+#include "daemonmake/compact_layout.hpp"
+
+namespace daemonmake::test {
+
+namespace {
+
+ProjectLayout make_layout(std::size_t num_files) {
+  ProjectLayout pl{"proj", "/proj", {}};
+  pl.targets.push_back({"a", TargetType::Library, {}, {}, {}});
+  pl.targets.push_back(
+      {"app", TargetType::Executable, {"apps/app.cpp"}, {}, {"a"}});
+  for (std::size_t i{}; i < num_files; ++i) {
+    const auto stem{"f" + std::to_string(i)};
+    pl.targets[0].source_files.push_back("src/a/" + stem + ".cpp");
+    pl.targets[0].header_files.push_back("include/proj/a/" + stem + ".hpp");
+  }
+  return pl;
+}
+
+}  // namespace
+
+DAEMONMAKE_TEST(compact_layout, round_trips_a_layout) {
+  auto pl{make_layout(50)};
+  pl.targets.push_back(
+      {"test_a", TargetType::Test, {"tests/a.cpp"}, {}, {"a"}});
+  const CompactLayout layout{pl, std::make_shared<PathTable>()};
+
+  const auto back{layout.to_project_layout()};
+  CHECK_EQ(back.project_name, pl.project_name);
+  CHECK_EQ(back.targets.size(), pl.targets.size());
+  for (std::size_t i{}; i < pl.targets.size(); ++i) {
+    CHECK_EQ(back.targets[i].name, pl.targets[i].name);
+    CHECK(back.targets[i].type == pl.targets[i].type);
+    CHECK_EQ(back.targets[i].source_files, pl.targets[i].source_files);
+    CHECK_EQ(back.targets[i].header_files, pl.targets[i].header_files);
+    CHECK_EQ(back.targets[i].dependencies, pl.targets[i].dependencies);
+  }
+}
+
+DAEMONMAKE_TEST(compact_layout, drops_unknown_and_self_dependencies) {
+  auto pl{make_layout(1)};
+  pl.targets[0].dependencies = {"a", "gone"};
+  const CompactLayout layout{pl, std::make_shared<PathTable>()};
+
+  CHECK(layout.targets()[0].dependencies.empty());
+  CHECK_EQ(layout.targets()[1].dependencies.size(), std::size_t{1});
+}
+
+DAEMONMAKE_TEST(compact_layout, derived_layout_replaces_and_drops_targets) {
+  const auto paths{std::make_shared<PathTable>()};
+  auto pl{make_layout(3)};
+  pl.targets.push_back({"b", TargetType::Library, {"src/b/b.cpp"}, {}, {}});
+  const CompactLayout base{pl, paths};
+
+  // b goes; a gains a file; a new library c sorts among the libraries.
+  const CompactLayout derived{
+      base,
+      {{"a", TargetType::Library, {"src/a/f0.cpp", "src/a/new.cpp"}, {}, {"c"}},
+       {"c", TargetType::Library, {"src/c/c.cpp"}, {}, {}}},
+      {"b"}};
+
+  ProjectLayout expected{"proj", "/proj", {}};
+  expected.targets.push_back(
+      {"a", TargetType::Library, {"src/a/f0.cpp", "src/a/new.cpp"}, {}, {"c"}});
+  expected.targets.push_back(
+      {"c", TargetType::Library, {"src/c/c.cpp"}, {}, {}});
+  expected.targets.push_back(pl.targets[1]);
+  const auto actual{derived.to_project_layout()};
+  CHECK_EQ(actual.targets.size(), expected.targets.size());
+  for (std::size_t i{}; i < expected.targets.size(); ++i) {
+    CHECK_EQ(actual.targets[i].name, expected.targets[i].name);
+    CHECK_EQ(actual.targets[i].source_files, expected.targets[i].source_files);
+    CHECK_EQ(actual.targets[i].dependencies, expected.targets[i].dependencies);
+  }
+
+  const auto file{derived.find("src/b/b.cpp")};
+  CHECK(file.has_value());
+  CHECK(!derived.owner(file.value_or(PathTable::root)).has_value());
+  const auto added{derived.find("src/a/new.cpp")};
+  CHECK(derived.owner(added.value_or(PathTable::root)) ==
+        std::optional<TargetId>{0});
+}
+
+DAEMONMAKE_TEST(compact_layout, find_agrees_with_writer_lookup) {
+  const auto pl{make_layout(100)};
+  const CompactLayout layout{pl, std::make_shared<PathTable>()};
+
+  for (const auto& target : pl.targets) {
+    for (const auto& file : target.source_files) {
+      const auto id{layout.find(file)};
+      CHECK(id.has_value());
+      CHECK(id == layout.paths().find(file));
+      CHECK_EQ(layout.paths().path(id.value_or(PathTable::root)), file);
+    }
+  }
+  CHECK(layout.find("src/a").has_value());
+  CHECK(!layout.find("src/a/missing.cpp").has_value());
+  CHECK(!layout.find("src/b/f1.cpp").has_value());
+  CHECK(!CompactLayout{}.find("src/a/f1.cpp").has_value());
+}
+
+DAEMONMAKE_TEST(compact_layout, find_ignores_paths_added_later) {
+  const auto paths{std::make_shared<PathTable>()};
+  const CompactLayout before{make_layout(10), paths};
+  const CompactLayout after{make_layout(20), paths};
+
+  CHECK(before.find("src/a/f9.cpp").has_value());
+  CHECK(!before.find("src/a/f10.cpp").has_value());
+  CHECK(after.find("src/a/f10.cpp").has_value());
+  CHECK(before.find("src/a/f9.cpp") == after.find("src/a/f9.cpp"));
+}
+
+DAEMONMAKE_TEST(compact_layout, readers_run_alongside_the_writer) {
+  const auto paths{std::make_shared<PathTable>()};
+  const auto pl{make_layout(200)};
+  const CompactLayout published{pl, paths};
+
+  // The reader sticks to the published layout while the writer keeps
+  // interning paths into the same table for newer ones.
+  std::atomic_bool done{};
+  std::atomic_bool consistent{true};
+  std::thread reader{[&] {
+    while (!done.load()) {
+      const auto file{published.find("src/a/f150.cpp")};
+      if (!file || published.owner(*file) != TargetId{0} ||
+          published.find("src/a/f250.cpp") ||
+          published.to_project_layout().targets[0].source_files.size() != 200)
+        consistent = false;
+    }
+  }};
+  for (std::size_t n{300}; n <= 6000; n += 300) {
+    const CompactLayout next{make_layout(n), paths};
+    CHECK(next.find("src/a/f250.cpp").has_value());
+  }
+  done = true;
+  reader.join();
+
+  CHECK(consistent.load());
+}
+
+}  // namespace daemonmake::test
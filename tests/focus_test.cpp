@@ -0,0 +1,51 @@
+#include <filesystem>
+
+#include "check.hpp"
+#include "daemonmake/focus.hpp"
+
+namespace daemonmake::test {
+
+namespace fs = std::filesystem;
+
+DAEMONMAKE_TEST(focus, unsaved_tracks_edit_times) {
+  FocusSet focus;
+  CHECK(!focus.unsaved());
+  CHECK(focus.touch("app", 100));
+  CHECK(focus.unsaved());
+
+  const auto file{make_scratch_dir("unsaved_tracks_edit_times") /
+                  ".daemonmake" / "focus.json"};
+  focus.save(file);
+  CHECK(!focus.unsaved());
+  CHECK(!fs::exists(file.string() + ".tmp"));
+
+  // Another edit within the same second changes nothing on disk.
+  CHECK(!focus.touch("app", 100));
+  CHECK(!focus.unsaved());
+  CHECK(!focus.expire(100, 60));
+  CHECK(!focus.unsaved());
+
+  CHECK(!focus.touch("app", 130));
+  CHECK(focus.unsaved());
+  focus.save(file);
+  CHECK(focus.expire(200, 60));
+  CHECK(focus.unsaved());
+}
+
+DAEMONMAKE_TEST(focus, save_round_trips) {
+  const auto file{make_scratch_dir("save_round_trips") / "focus.json"};
+  FocusSet focus;
+  focus.touch("app", 100);
+  focus.touch("lib", 200);
+  focus.save(file);
+
+  auto loaded{FocusSet::load(file)};
+  CHECK(loaded.contains("app"));
+  CHECK(loaded.contains("lib"));
+  CHECK(!loaded.contains("tool"));
+  CHECK(!loaded.unsaved());
+  CHECK(loaded.expire(200, 60));
+  CHECK(!loaded.contains("app"));
+}
+
+}  // namespace daemonmake::test
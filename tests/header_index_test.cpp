@@ -0,0 +1,183 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "daemonmake/config.hpp"
+#include "daemonmake/header_index.hpp"
+#include "daemonmake/ninja_log.hpp"
+
+namespace daemonmake::test {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::vector<std::string> tus_for(const HeaderIndex& index,
+                                 std::string_view rel_path) {
+  const auto tus{index.translation_units_for(rel_path)};
+  return {tus.begin(), tus.end()};
+}
+
+void write_depfile(const fs::path& path, const std::string& contents) {
+  fs::create_directories(path.parent_path());
+  std::ofstream{path} << contents;
+  // Later writes in a test must look newer, whatever the clock resolution.
+  static auto mtime{fs::file_time_type::clock::now()};
+  mtime += std::chrono::seconds{1};
+  fs::last_write_time(path, mtime);
+}
+
+/**
+ * Puts a stub ninja first on PATH for the lifetime of the object. It logs
+ * its arguments to <dir>/calls and prints a deps record for each output
+ * asked for, or for a.o and b.o without any; b.o includes whatever header
+ * <dir>/b_header names.
+ */
+class StubNinja {
+ public:
+  explicit StubNinja(const fs::path& dir, const fs::path& root)
+      : old_path_{std::getenv("PATH")} {
+    fs::create_directories(dir);
+    const auto script{dir / "ninja"};
+    std::ofstream{script} << "#!/bin/sh\n"
+                             "dir=$(dirname \"$0\")\n"
+                             "echo \"$@\" >> \"$dir/calls\"\n"
+                             "shift 4\n"
+                             "[ $# -eq 0 ] && set -- a.o b.o\n"
+                             "for o in \"$@\"; do case $o in\n"
+                             "a.o) printf 'a.o: #deps 2, deps mtime 1 (VALID)\\n"
+                             "    " + (root / "src/a.cpp").string() + "\\n"
+                             "    " + (root / "include/a.hpp").string() +
+                                 "\\n\\n' ;;\n"
+                             "b.o) printf 'b.o: #deps 2, deps mtime 1 (VALID)\\n"
+                             "    " + (root / "src/b.cpp").string() + "\\n"
+                             "    " + (root / "include").string() +
+                                 "/%s\\n\\n' \"$(cat \"$dir/b_header\")\" ;;\n"
+                             "esac; done\n";
+    fs::permissions(script, fs::perms::owner_all);
+    ::setenv("PATH", (dir.string() + ":" + old_path_).c_str(), 1);
+  }
+
+  ~StubNinja() { ::setenv("PATH", old_path_.c_str(), 1); }
+
+ private:
+  std::string old_path_;
+};
+
+}  // namespace
+
+DAEMONMAKE_TEST(header_index, merged_replaces_only_given_units) {
+  const fs::path root{"/proj"};
+  const HeaderIndex index{{{"src/a.cpp", {"include/a.hpp", "include/c.hpp"}},
+                           {"src/b.cpp", {"include/c.hpp"}},
+                           {"src/lone.cpp", {}}},
+                          root, root};
+
+  const auto merged{index.merged({{"/proj/src/a.cpp", {"include/b.hpp"}}},
+                                 root, root)};
+  CHECK_EQ(tus_for(merged, "include/a.hpp"), std::vector<std::string>{});
+  CHECK_EQ(tus_for(merged, "include/b.hpp"),
+           std::vector<std::string>{"src/a.cpp"});
+  CHECK_EQ(tus_for(merged, "include/c.hpp"),
+           std::vector<std::string>{"src/b.cpp"});
+  CHECK_EQ(tus_for(merged, "src/lone.cpp"),
+           std::vector<std::string>{"src/lone.cpp"});
+}
+
+DAEMONMAKE_TEST(header_index, harvester_reads_only_new_depfiles) {
+  const auto root{make_scratch_dir("harvester_reads_only_new_depfiles")};
+  auto cfg{make_default_config(root)};
+  cfg.build_directory = root / "build";
+  const auto objects{cfg.build_directory / "CMakeFiles" / "a.dir"};
+  write_depfile(objects / "a.cpp.o.d",
+                "a.cpp.o: " + (root / "src/a.cpp").string() + " " +
+                    (root / "include/a.hpp").string() + "\n");
+  write_depfile(objects / "b.cpp.o.d",
+                "b.cpp.o: " + (root / "src/b.cpp").string() + "\n");
+
+  HeaderIndexHarvester harvester{cfg};
+  const auto first{harvester.harvest(HeaderIndex{})};
+  CHECK(first.has_value());
+  CHECK_EQ(tus_for(first.value_or(HeaderIndex{}), "include/a.hpp"),
+           std::vector<std::string>{"src/a.cpp"});
+  CHECK(!harvester.harvest(*first).has_value());
+
+  // b now includes a.hpp; a's depfile is untouched.
+  write_depfile(objects / "b.cpp.o.d",
+                "b.cpp.o: " + (root / "src/b.cpp").string() + " \\\n " +
+                    (root / "include/a.hpp").string() + "\n");
+  const auto second{harvester.harvest(*first)};
+  CHECK(second.has_value());
+  CHECK_EQ(tus_for(second.value_or(HeaderIndex{}), "include/a.hpp"),
+           (std::vector<std::string>{"src/a.cpp", "src/b.cpp"}));
+  CHECK_EQ(tus_for(HeaderIndex::harvest(cfg), "include/a.hpp"),
+           (std::vector<std::string>{"src/a.cpp", "src/b.cpp"}));
+}
+
+DAEMONMAKE_TEST(header_index, harvester_asks_ninja_for_logged_outputs) {
+  const auto root{make_scratch_dir("harvester_asks_ninja_for_logged_outputs")};
+  auto cfg{make_default_config(root)};
+  cfg.build_directory = root / "build";
+  const auto bin{root / "bin"};
+  const StubNinja ninja{bin, root};
+  std::ofstream{bin / "b_header"} << "b.hpp";
+  fs::create_directories(cfg.build_directory);
+  std::ofstream{cfg.build_directory / ".ninja_deps"};
+  const auto log{cfg.build_directory / ".ninja_log"};
+  std::ofstream{log} << "# ninja log v5\n"
+                       "0\t10\t1\ta.o\tff\n0\t10\t1\tb.o\tff\n";
+
+  HeaderIndexHarvester harvester{cfg};
+  const auto first{harvester.harvest(HeaderIndex{})};
+  CHECK(!harvester.harvest(first.value_or(HeaderIndex{})).has_value());
+
+  // Only b.o was rebuilt, now including a.hpp.
+  std::ofstream{bin / "b_header"} << "a.hpp";
+  std::ofstream{log, std::ios::app} << "20\t30\t2\tb.o\tff\n";
+  const auto second{harvester.harvest(first.value_or(HeaderIndex{}))};
+  CHECK_EQ(tus_for(second.value_or(HeaderIndex{}), "include/a.hpp"),
+           (std::vector<std::string>{"src/a.cpp", "src/b.cpp"}));
+  CHECK_EQ(tus_for(second.value_or(HeaderIndex{}), "include/b.hpp"),
+           std::vector<std::string>{});
+
+  std::ifstream calls{bin / "calls"};
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(calls, line);)
+    lines.push_back(line.substr(line.find("-t")));
+  CHECK_EQ(lines, (std::vector<std::string>{"-t deps", "-t deps b.o"}));
+}
+
+DAEMONMAKE_TEST(header_index, ninja_log_tail_follows_appends) {
+  const auto dir{make_scratch_dir("ninja_log_tail_follows_appends")};
+  const auto log{dir / ".ninja_log"};
+  std::ofstream{log} << "# ninja log v5\n0\t10\t1\ta.o\tff\n";
+
+  NinjaLogTail tail{dir};
+  bool restarted{};
+  auto entries{tail.read_new(&restarted)};
+  CHECK_EQ(entries.size(), std::size_t{1});
+  CHECK(!restarted);
+
+  // A line still being written waits for its newline.
+  std::ofstream{log, std::ios::app} << "10\t25\t2\tb.o\tff\n30\t3";
+  entries = tail.read_new(&restarted);
+  CHECK_EQ(entries.size(), std::size_t{1});
+  CHECK_EQ(entries.front().output, std::string{"b.o"});
+  CHECK_EQ(entries.front().end_ms - entries.front().start_ms,
+           std::int64_t{15});
+  std::ofstream{log, std::ios::app} << "5\t3\tc.o\tff\n";
+  CHECK_EQ(tail.read_new().size(), std::size_t{1});
+  CHECK(tail.read_new().empty());
+
+  // Recompaction rewrites the log shorter.
+  std::ofstream{log} << "# ninja log v5\n0\t10\t1\ta.o\tff\n";
+  entries = tail.read_new(&restarted);
+  CHECK(restarted);
+  CHECK_EQ(entries.size(), std::size_t{1});
+}
+
+}  // namespace daemonmake::test
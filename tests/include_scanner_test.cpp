@@ -0,0 +1,207 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "daemonmake/include_scanner.hpp"
+
+namespace daemonmake::test {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+fs::path write_scratch_file(std::string_view dir, const std::string& contents) {
+  const auto path{make_scratch_dir(dir) / "file.cpp"};
+  std::ofstream{path, std::ios::binary} << contents;
+  return path;
+}
+
+std::vector<std::string> includes(std::string_view source,
+                                  bool preamble_only = false) {
+  const auto found{scan_includes(source, {preamble_only})};
+  return {found.begin(), found.end()};
+}
+
+std::vector<std::string> imports(std::string_view source) {
+  const auto found{scan_dependencies(source).imports};
+  return {found.begin(), found.end()};
+}
+
+}  // namespace
+
+DAEMONMAKE_TEST(include_scanner, ignores_comments_and_literals) {
+  CHECK_EQ(includes("// #include \"line.h\"\n"
+                    "/* #include \"block.h\"\n"
+                    "#include \"still_block.h\" */\n"
+                    "const char* s = \"#include \\\"string.h\\\"\";\n"
+                    "const char* r = R\"x(\n#include \"raw.h\"\n)x\";\n"
+                    "#include \"real.h\"\n"),
+           std::vector<std::string>{"real.h"});
+}
+
+DAEMONMAKE_TEST(include_scanner, line_comment_continues_past_backslash) {
+  CHECK_EQ(includes("// comment \\\n#include \"hidden.h\"\n"
+                    "#include <shown.h>\n"),
+           std::vector<std::string>{"shown.h"});
+}
+
+DAEMONMAKE_TEST(include_scanner, spaced_and_continued_directives) {
+  CHECK_EQ(includes("#  include \"spaced.h\"\n"
+                    "  #\tinclude <tabbed.h>\n"
+                    "#include \\\n  \"continued.h\"\n"
+                    "#\\\ninclude <split.h>\n"
+                    "#include_next <next.h>\n"),
+           (std::vector<std::string>{"spaced.h", "tabbed.h", "continued.h",
+                                     "split.h", "next.h"}));
+}
+
+DAEMONMAKE_TEST(include_scanner, continued_define_is_not_a_directive) {
+  CHECK_EQ(includes("#define X \\\n#include \"macro_body.h\"\n"
+                    "#include \"real.h\"\n"),
+           std::vector<std::string>{"real.h"});
+}
+
+DAEMONMAKE_TEST(include_scanner, digit_separators_are_not_quotes) {
+  CHECK_EQ(includes("int x = 1'000'000;\n#include \"after.h\"\n"
+                    "char c = '\\'';\n#include \"after_char.h\"\n"),
+           (std::vector<std::string>{"after.h", "after_char.h"}));
+}
+
+DAEMONMAKE_TEST(include_scanner, computed_includes_are_skipped) {
+  CHECK_EQ(includes("#include HEADER\n#include \"real.h\"\n"),
+           std::vector<std::string>{"real.h"});
+}
+
+DAEMONMAKE_TEST(include_scanner, import_directive_counts_as_include) {
+  CHECK_EQ(includes("#import \"objc.h\"\n#import <sys.h>\n"),
+           (std::vector<std::string>{"objc.h", "sys.h"}));
+}
+
+DAEMONMAKE_TEST(include_scanner, module_interface_partition) {
+  const auto deps{scan_dependencies("module;\n"
+                                    "#include <cstdio>\n"
+                                    "export module a.b:part;\n"
+                                    "import :p;\n"
+                                    "import <vector>;\n"
+                                    "import \"local.h\" [[attr]];\n"
+                                    "export import x;\n"
+                                    "import y.z;\n")};
+  CHECK_EQ(deps.exported_module, std::string_view{"a.b"});
+  CHECK_EQ(std::vector<std::string>(deps.imports.begin(), deps.imports.end()),
+           (std::vector<std::string>{"x", "y.z"}));
+  CHECK_EQ(
+      std::vector<std::string>(deps.includes.begin(), deps.includes.end()),
+      (std::vector<std::string>{"cstdio", "vector", "local.h"}));
+}
+
+DAEMONMAKE_TEST(include_scanner, module_implementation_imports_its_module) {
+  CHECK_EQ(imports("module a.b;\nimport c;\n"),
+           (std::vector<std::string>{"a.b", "c"}));
+  CHECK_EQ(imports("module a.b:impl;\nmodule :private;\n"),
+           std::vector<std::string>{});
+  CHECK_EQ(scan_dependencies("module a;\n").exported_module,
+           std::string_view{});
+}
+
+DAEMONMAKE_TEST(include_scanner, code_starting_with_module_words) {
+  for (const std::string_view line :
+       {"module.x = 1;\n", "module m = 3;\n", "import foo(1);\n",
+        "module::f();\n", "import .x;\n", "import a.;\n", "import\nb;\n",
+        "importer y;\n"}) {
+    const auto deps{scan_dependencies(line)};
+    CHECK_EQ(deps.imports.size(), 0u);
+    CHECK(deps.includes.empty());
+  }
+  CHECK_EQ(scan_dependencies("export module;\n").exported_module,
+           std::string_view{});
+  CHECK_EQ(scan_dependencies("import <a.h> + 1;\n").includes.size(), 0u);
+}
+
+DAEMONMAKE_TEST(include_scanner, module_lines_after_code_are_code) {
+  CHECK_EQ(imports("import a;\n"
+                   "void f() {\n"
+                   "module.x = 1;\n"
+                   "import b;\n"
+                   "}\n"),
+           std::vector<std::string>{"a"});
+  CHECK_EQ(scan_dependencies("int x;\nexport module m;\n").exported_module,
+           std::string_view{});
+}
+
+DAEMONMAKE_TEST(include_scanner, preamble_stops_at_first_code) {
+  const std::string source{
+      "// header comment\n"
+      "#include \"a.h\"\n"
+      "int x;\n"
+      "#include \"late.h\"\n"};
+  CHECK_EQ(includes(source, true), std::vector<std::string>{"a.h"});
+  CHECK_EQ(includes(source), (std::vector<std::string>{"a.h", "late.h"}));
+}
+
+DAEMONMAKE_TEST(include_scanner, preamble_sees_through_include_guard) {
+  CHECK_EQ(includes("#ifndef GUARD_H\n#define GUARD_H\n"
+                    "#include \"a.h\"\n"
+                    "int x;\n"
+                    "#include \"late.h\"\n"
+                    "#endif\n",
+                    true),
+           std::vector<std::string>{"a.h"});
+}
+
+DAEMONMAKE_TEST(include_scanner, preamble_continues_inside_conditionals) {
+  CHECK_EQ(includes("#include \"a.h\"\n"
+                    "#ifdef FEATURE\n"
+                    "int feature;\n"
+                    "#include \"feature.h\"\n"
+                    "#endif\n"
+                    "#include \"b.h\"\n"
+                    "int x;\n"
+                    "#include \"late.h\"\n",
+                    true),
+           (std::vector<std::string>{"a.h", "feature.h", "b.h"}));
+}
+
+DAEMONMAKE_TEST(include_scanner, reader_reads_whole_file) {
+  std::string contents;
+  for (int i{}; i < 20000; ++i)
+    contents += "#include \"proj/h" + std::to_string(i) + ".hpp\"\n";
+  const auto path{write_scratch_file("reader_reads_whole_file", contents)};
+
+  FileReader reader;
+  const auto read{reader.read(path)};
+  CHECK(read.has_value());
+  CHECK_EQ(std::string{read.value_or("")}, contents);
+  CHECK_EQ(scan_includes(*read).size(), std::size_t{20000});
+}
+
+DAEMONMAKE_TEST(include_scanner, reader_reuses_buffer_for_smaller_file) {
+  const auto large{write_scratch_file("reader_large", std::string(8192, 'x'))};
+  const auto small{write_scratch_file("reader_small", "#include <a>\n")};
+
+  FileReader reader;
+  CHECK_EQ(reader.read(large).value_or("").size(), std::size_t{8192});
+  CHECK_EQ(std::string{reader.read(small).value_or("")},
+           std::string{"#include <a>\n"});
+}
+
+DAEMONMAKE_TEST(include_scanner, reader_grows_past_reported_size) {
+  // procfs reports a size of zero for files that are not empty.
+  FileReader reader;
+  const auto read{reader.read("/proc/self/status")};
+  CHECK(read.has_value());
+  CHECK(read.value_or("").find("Name:") != std::string_view::npos);
+}
+
+DAEMONMAKE_TEST(include_scanner, reader_missing_and_empty_files) {
+  const auto empty{write_scratch_file("reader_empty", "")};
+
+  FileReader reader;
+  CHECK(!reader.read(empty.parent_path() / "missing.cpp").has_value());
+  const auto read{reader.read(empty)};
+  CHECK(read.has_value());
+  CHECK(read.value_or("x").empty());
+}
+
+}  // namespace daemonmake::test
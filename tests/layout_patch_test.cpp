@@ -0,0 +1,224 @@
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "daemonmake/compact_layout.hpp"
+#include "daemonmake/config.hpp"
+#include "daemonmake/include_cache.hpp"
+#include "daemonmake/layout_patch.hpp"
+#include "daemonmake/project.hpp"
+
+namespace daemonmake::test {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void write_file(const fs::path& root, const std::string& rel,
+                const std::string& contents) {
+  fs::create_directories((root / rel).parent_path());
+  std::ofstream{root / rel} << contents;
+}
+
+/**
+ * A small project "proj": libraries a and b (a includes b), a loose source
+ * in the default library, an app including a and a test of a.
+ */
+fs::path make_project(std::string_view name) {
+  const auto root{make_scratch_dir(name) / "proj"};
+  write_file(root, "include/proj/a/a.hpp", "#pragma once\nint a();\n");
+  write_file(root, "include/proj/b/b.hpp", "#pragma once\nint b();\n");
+  write_file(root, "include/proj/top.hpp", "#pragma once\n");
+  write_file(root, "src/a/a.cpp",
+             "#include \"proj/a/a.hpp\"\n#include \"proj/b/b.hpp\"\n"
+             "int a() { return b(); }\n");
+  write_file(root, "src/b/b.cpp",
+             "#include \"proj/b/b.hpp\"\nint b() { return 1; }\n");
+  write_file(root, "src/main.cpp", "#include \"proj/top.hpp\"\n");
+  write_file(root, "apps/app.cpp",
+             "#include \"proj/a/a.hpp\"\nint main() { return a(); }\n");
+  write_file(root, "tests/a.cpp",
+             "#include \"proj/a/a.hpp\"\nint main() { return a() - 1; }\n");
+  return root;
+}
+
+/**
+ * One line per target, so a mismatch prints as a readable diff.
+ */
+std::vector<std::string> describe(const ProjectLayout& pl) {
+  std::vector<std::string> lines;
+  for (const auto& target : pl.targets) {
+    std::string line{std::to_string(static_cast<int>(target.type)) + ' ' +
+                     target.name + " |"};
+    for (const auto& file : target.source_files) line += ' ' + file;
+    line += " |";
+    for (const auto& file : target.header_files) line += ' ' + file;
+    line += " ->";
+    for (const auto& dep : target.dependencies) line += ' ' + dep;
+    lines.push_back(std::move(line));
+  }
+  return lines;
+}
+
+ProjectLayout discover(const Config& cfg, IncludeCache* cache) {
+  auto pl{make_project_layout(cfg.project_root)};
+  discover_targets(cfg, pl);
+  infer_target_dependencies(pl, {}, cache);
+  return pl;
+}
+
+/**
+ * A project discovered with a warm cache, ready to patch.
+ */
+struct Fixture {
+  explicit Fixture(std::string_view name)
+      : cfg{make_default_config(make_project(name))},
+        layout{discover(cfg, &cache), std::make_shared<PathTable>()} {}
+
+  /**
+   * Patches the layout with the given paths and checks the result against
+   * a full rediscovery of the tree as it now is. Both go through
+   * CompactLayout, which drops includes of libraries that do not exist,
+   * as the daemon sees them.
+   */
+  LayoutPatch patch(const std::vector<std::string>& rel_paths) {
+    auto patch{patch_layout(cfg, layout, rel_paths, cache)};
+    if (!patch) throw std::runtime_error{"patch_layout asked for discovery"};
+    const CompactLayout fresh{discover(cfg, nullptr),
+                              std::make_shared<PathTable>()};
+    CHECK_EQ(describe(patch->layout.to_project_layout()),
+             describe(fresh.to_project_layout()));
+    return std::move(*patch);
+  }
+
+  /**
+   * Starts over from a full discovery, as the daemon does after one.
+   */
+  void rediscover() {
+    layout = CompactLayout{discover(cfg, &cache), std::make_shared<PathTable>()};
+  }
+
+  void write(const std::string& rel, const std::string& contents) const {
+    write_file(cfg.project_root, rel, contents);
+  }
+
+  void remove(const std::string& rel) const {
+    fs::remove_all(cfg.project_root / rel);
+  }
+
+  IncludeCache cache;
+  Config cfg;
+  CompactLayout layout;
+};
+
+}  // namespace
+
+DAEMONMAKE_TEST(layout_patch, create_source) {
+  Fixture f{"create_source"};
+  f.write("src/b/extra.cpp", "#include \"proj/top.hpp\"\n");
+  const auto patch{f.patch({"src/b/extra.cpp"})};
+  CHECK_EQ(patch.changed_targets, std::vector<std::string>{"b"});
+}
+
+DAEMONMAKE_TEST(layout_patch, delete_source_and_header) {
+  Fixture f{"delete_source_and_header"};
+  f.remove("src/main.cpp");
+  f.remove("include/proj/top.hpp");
+  f.remove("include/proj/a/a.hpp");
+  f.patch({"src/main.cpp", "include/proj/top.hpp", "include/proj/a/a.hpp"});
+}
+
+DAEMONMAKE_TEST(layout_patch, edit_in_same_batch_as_create) {
+  Fixture f{"edit_in_same_batch_as_create"};
+  // b gains a through an edit made alongside a new file.
+  f.write("src/b/b.cpp",
+          "#include \"proj/a/a.hpp\"\n#include \"proj/b/b.hpp\"\n"
+          "int b() { return 2; }\n");
+  f.write("src/b/new.cpp", "int n() { return 0; }\n");
+  const auto patch{f.patch({"src/b/b.cpp", "src/b/new.cpp"})};
+  CHECK(patch.graph_changed);
+}
+
+DAEMONMAKE_TEST(layout_patch, edit_elsewhere_in_same_batch) {
+  Fixture f{"edit_elsewhere_in_same_batch"};
+  f.write("apps/app.cpp",
+          "#include \"proj/b/b.hpp\"\nint main() { return b(); }\n");
+  f.write("src/a/new.cpp", "int n() { return 0; }\n");
+  f.patch({"apps/app.cpp", "src/a/new.cpp"});
+}
+
+DAEMONMAKE_TEST(layout_patch, new_library_and_edit_that_includes_it) {
+  Fixture f{"new_library_and_edit_that_includes_it"};
+  f.write("src/c/c.cpp", "#include \"proj/c/c.hpp\"\nint c() { return 3; }\n");
+  f.write("include/proj/c/c.hpp", "#pragma once\nint c();\n");
+  f.write("apps/app.cpp",
+          "#include \"proj/a/a.hpp\"\n#include \"proj/c/c.hpp\"\n"
+          "int main() { return a() + c(); }\n");
+  const auto patch{f.patch({"src/c", "src/c/c.cpp", "include/proj/c",
+                            "include/proj/c/c.hpp", "apps/app.cpp"})};
+  CHECK(patch.graph_changed);
+  CHECK_EQ(patch.changed_targets, (std::vector<std::string>{"app", "c"}));
+}
+
+DAEMONMAKE_TEST(layout_patch, delete_library) {
+  Fixture f{"delete_library"};
+  f.remove("src/b");
+  f.patch({"src/b"});
+}
+
+DAEMONMAKE_TEST(layout_patch, create_and_delete_apps_and_tests) {
+  Fixture f{"create_and_delete_apps_and_tests"};
+  f.write("apps/tool.cpp", "#include \"proj/b/b.hpp\"\nint main() {}\n");
+  f.write("tests/b.cpp", "#include \"proj/b/b.hpp\"\nint main() {}\n");
+  f.remove("tests/a.cpp");
+  f.patch({"apps/tool.cpp", "tests/b.cpp", "tests/a.cpp"});
+}
+
+DAEMONMAKE_TEST(layout_patch, clashing_names) {
+  Fixture f{"clashing_names"};
+  // Discovery keeps the library and skips the app of the same name...
+  f.write("apps/a.cpp", "int main() {}\n");
+  f.write("apps/test_b.cpp", "int main() {}\n");
+  f.write("tests/b.cpp", "int main() {}\n");
+  f.patch({"apps/a.cpp", "apps/test_b.cpp", "tests/b.cpp"});
+  f.rediscover();
+
+  // ...and hands the name over once the library is gone.
+  f.remove("src/a");
+  f.remove("apps/test_b.cpp");
+  f.patch({"src/a", "apps/test_b.cpp"});
+}
+
+DAEMONMAKE_TEST(layout_patch, stale_cache_entry_is_reread) {
+  Fixture f{"stale_cache_entry_is_reread"};
+  // A rewrite of the same size within the same clock tick leaves the stamp
+  // unchanged, which is exactly what poisoned entries guard against.
+  f.write("src/a/a.cpp",
+          "#include \"proj/a/a.hpp\"\n#include \"proj/top.hpp\"\n"
+          "int a() { return 1+1; }\n");
+  f.write("src/a/new.cpp", "int n() { return 0; }\n");
+  f.patch({"src/a/a.cpp", "src/a/new.cpp"});
+}
+
+DAEMONMAKE_TEST(layout_patch, module_interface_and_importer) {
+  Fixture f{"module_interface_and_importer"};
+  f.write("src/b/b.cppm", "export module proj.b;\nexport int mb();\n");
+  f.write("apps/app.cpp", "import proj.b;\nint main() { return mb(); }\n");
+  f.patch({"src/b/b.cppm", "apps/app.cpp"});
+
+  f.rediscover();
+  f.remove("src/b/b.cppm");
+  f.patch({"src/b/b.cppm"});
+}
+
+DAEMONMAKE_TEST(layout_patch, tree_root_needs_discovery) {
+  Fixture f{"tree_root_needs_discovery"};
+  f.remove("apps");
+  CHECK(!patch_layout(f.cfg, f.layout, {"apps"}, f.cache).has_value());
+}
+
+}  // namespace daemonmake::test
@@ -0,0 +1,59 @@
+#include <chrono>
+#include <filesystem>
+#include <stop_token>
+#include <string>
+#include <thread>
+
+#include "check.hpp"
+#include "daemonmake/subprocess.hpp"
+
+namespace daemonmake::test {
+
+namespace fs = std::filesystem;
+
+DAEMONMAKE_TEST(subprocess, cancellable_captures_stdout_and_stderr) {
+  const auto dir{make_scratch_dir("cancellable_captures_stdout_and_stderr")};
+  std::string output;
+  const std::stop_source stop;
+  const int rc{run_subprocess_cancellable(
+      {"sh", "-c", "echo out; echo err >&2; pwd; exit 3"}, dir, output,
+      stop.get_token())};
+  CHECK_EQ(rc, 3);
+  CHECK_EQ(output, "out\nerr\n" + fs::canonical(dir).string() + "\n");
+}
+
+DAEMONMAKE_TEST(subprocess, cancel_kills_grandchildren) {
+  const auto dir{make_scratch_dir("cancel_kills_grandchildren")};
+  std::string output;
+  std::stop_source stop;
+  const std::jthread canceller{[&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds{200});
+    stop.request_stop();
+  }};
+
+  // The backgrounded sleep holds the output pipe open, so the call only
+  // returns early if it is killed along with the shell.
+  const auto start{std::chrono::steady_clock::now()};
+  const int rc{run_subprocess_cancellable(
+      {"sh", "-c", "echo started; sleep 30 & wait"}, dir, output,
+      stop.get_token())};
+  const auto elapsed{std::chrono::steady_clock::now() - start};
+
+  CHECK_EQ(rc, subprocess_cancelled);
+  CHECK_EQ(output, "started\n");
+  CHECK(elapsed < std::chrono::seconds{10});
+}
+
+DAEMONMAKE_TEST(subprocess, cancellable_reports_missing_program) {
+  const auto dir{make_scratch_dir("cancellable_reports_missing_program")};
+  std::string output;
+  const std::stop_source stop;
+  CHECK_EQ(run_subprocess_cancellable({"daemonmake-no-such-program"}, dir,
+                                      output, stop.get_token()),
+           127);
+  CHECK_EQ(run_subprocess_cancellable({"true"}, dir / "missing", output,
+                                      stop.get_token()),
+           127);
+}
+
+}  // namespace daemonmake::test
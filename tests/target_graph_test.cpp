@@ -0,0 +1,123 @@
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "daemonmake/compact_layout.hpp"
+#include "daemonmake/target_graph.hpp"
+
+namespace daemonmake::test {
+
+namespace {
+
+/**
+ * Targets t0..tN-1 with random dependencies; only on lower ids unless
+ * cycles are allowed.
+ */
+ProjectLayout random_layout(std::mt19937& rng, std::size_t size,
+                            bool allow_cycles) {
+  ProjectLayout pl{"proj", "/proj", {}};
+  for (std::size_t i{}; i < size; ++i)
+    pl.targets.push_back(
+        {"t" + std::to_string(i), TargetType::Library, {}, {}, {}});
+  for (std::size_t i{1}; i < size; ++i) {
+    std::uniform_int_distribution<std::size_t> pick{
+        0, allow_cycles ? size - 1 : i - 1};
+    for (int edge{}; edge < 3; ++edge) {
+      const auto dep{pick(rng)};
+      if (dep != i)
+        pl.targets[i].dependencies.push_back("t" + std::to_string(dep));
+    }
+  }
+  return pl;
+}
+
+// Reverse-dependency closure by plain search, for comparison.
+std::vector<TargetId> naive_affected(const TargetGraph& graph,
+                                     const std::vector<TargetId>& changed) {
+  std::vector<bool> seen(graph.size());
+  std::vector<TargetId> stack{changed};
+  while (!stack.empty()) {
+    const auto id{stack.back()};
+    stack.pop_back();
+    if (seen[id]) continue;
+    seen[id] = true;
+    for (const auto rdep : graph.reverse_dependencies(id)) stack.push_back(rdep);
+  }
+  std::vector<TargetId> ids;
+  for (TargetId id{}; id < graph.size(); ++id)
+    if (seen[id]) ids.push_back(id);
+  return ids;
+}
+
+void check_affected_matches_search(bool allow_cycles) {
+  std::mt19937 rng{allow_cycles ? 7u : 3u};
+  for (const std::size_t size : {1, 2, 63, 64, 65, 300}) {
+    const TargetGraph graph{random_layout(rng, size, allow_cycles)};
+    CHECK(allow_cycles || !graph.has_cycle());
+    std::uniform_int_distribution<TargetId> pick{
+        0, static_cast<TargetId>(size - 1)};
+    for (int round{}; round < 20; ++round) {
+      std::vector<TargetId> changed;
+      for (int i{}; i < 1 + round % 4; ++i) changed.push_back(pick(rng));
+      CHECK_EQ(graph.affected(changed).to_vector(),
+               naive_affected(graph, changed));
+    }
+  }
+}
+
+}  // namespace
+
+DAEMONMAKE_TEST(target_graph, affected_matches_search_acyclic) {
+  check_affected_matches_search(false);
+}
+
+DAEMONMAKE_TEST(target_graph, affected_matches_search_with_cycles) {
+  check_affected_matches_search(true);
+}
+
+DAEMONMAKE_TEST(target_graph, levels_sit_above_dependencies) {
+  std::mt19937 rng{11};
+  const TargetGraph graph{random_layout(rng, 200, false)};
+  for (TargetId id{}; id < graph.size(); ++id) {
+    for (const auto dep : graph.dependencies(id))
+      CHECK(graph.level(id) > graph.level(dep));
+  }
+}
+
+DAEMONMAKE_TEST(target_graph, cycles_and_unresolved_names) {
+  ProjectLayout pl{"proj", "/proj", {}};
+  pl.targets.push_back({"a", TargetType::Library, {}, {}, {"b"}});
+  pl.targets.push_back({"b", TargetType::Library, {}, {}, {"a", "gone"}});
+  pl.targets.push_back({"c", TargetType::Executable, {}, {}, {"b"}});
+  const TargetGraph graph{pl};
+
+  CHECK_EQ(graph.cyclic_targets(), (std::vector<TargetId>{0, 1}));
+  CHECK_EQ(graph.unresolved_dependencies().size(), std::size_t{1});
+  CHECK_EQ(graph.affected(std::vector<TargetId>{0}).to_vector(),
+           (std::vector<TargetId>{0, 1, 2}));
+  CHECK_EQ(graph.affected(std::vector<TargetId>{2}).to_vector(),
+           (std::vector<TargetId>{2}));
+}
+
+DAEMONMAKE_TEST(target_graph, compact_layout_builds_the_same_graph) {
+  std::mt19937 rng{5};
+  const auto pl{random_layout(rng, 150, true)};
+  const TargetGraph from_layout{pl};
+  const TargetGraph from_compact{
+      CompactLayout{pl, std::make_shared<PathTable>()}};
+
+  CHECK_EQ(from_compact.size(), from_layout.size());
+  for (TargetId id{}; id < from_layout.size(); ++id) {
+    CHECK_EQ(from_compact.name(id), from_layout.name(id));
+    CHECK_EQ(std::vector<TargetId>(from_compact.dependencies(id).begin(),
+                                   from_compact.dependencies(id).end()),
+             std::vector<TargetId>(from_layout.dependencies(id).begin(),
+                                   from_layout.dependencies(id).end()));
+    CHECK_EQ(from_compact.level(id), from_layout.level(id));
+  }
+  CHECK_EQ(from_compact.cyclic_targets(), from_layout.cyclic_targets());
+}
+
+}  // namespace daemonmake::test
@@ -0,0 +1,55 @@
+#include <unistd.h>
+
+#include <string>
+
+#include "check.hpp"
+#include "daemonmake/logger.hpp"
+
+namespace daemonmake::test {
+
+namespace fs = std::filesystem;
+
+fs::path make_scratch_dir(std::string_view name) {
+  const auto dir{fs::temp_directory_path() /
+                 ("daemonmake_test_" + std::to_string(::getpid())) /
+                 std::string{name}};
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  return dir;
+}
+
+}  // namespace daemonmake::test
+
+// Runs every test whose name contains the optional argument, and exits
+// non-zero if any check failed.
+int main(int argc, char** argv) {
+  using namespace daemonmake::test;
+
+  const std::string_view filter{argc >= 2 ? argv[1] : ""};
+  int ran{};
+  for (const auto& test : registry()) {
+    if (test.name.find(filter) == std::string_view::npos) continue;
+    const int before{failures()};
+    try {
+      test.fn();
+    } catch (const std::exception& ex) {
+      ++failures();
+      std::cerr << test.name << ": unexpected exception: " << ex.what() << '\n';
+    }
+    std::cout << (failures() == before ? "[  OK  ] " : "[FAILED] ")
+              << test.name << '\n';
+    ++ran;
+  }
+
+  std::error_code ec;
+  std::filesystem::remove_all(
+      std::filesystem::temp_directory_path() /
+          ("daemonmake_test_" + std::to_string(::getpid())),
+      ec);
+  daemonmake::flush_log();
+  if (ran == 0) {
+    std::cerr << "no test matches '" << filter << "'\n";
+    return 1;
+  }
+  return failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+#include "daemonmake/config.hpp"
+#include "daemonmake/test_runner.hpp"
+
+namespace daemonmake::test {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * Writes a shell script test executable into the build directory. Scripts
+ * run from there, so relative paths in them land next to each other.
+ */
+void write_test(const Config& cfg, const std::string& name,
+                const std::string& body) {
+  const auto path{cfg.build_directory / name};
+  std::ofstream{path} << "#!/bin/sh\n" << body;
+  fs::permissions(path, fs::perms::owner_all);
+}
+
+Config make_config(const std::string& name) {
+  const auto root{make_scratch_dir(name)};
+  auto cfg{make_default_config(root)};
+  cfg.build_directory = root / "build";
+  fs::create_directories(cfg.build_directory);
+  return cfg;
+}
+
+std::vector<std::string> read_lines(const fs::path& path) {
+  std::vector<std::string> lines;
+  std::ifstream in{path};
+  std::string line;
+  while (std::getline(in, line)) lines.push_back(line);
+  return lines;
+}
+
+std::vector<std::string> names(const std::vector<TestResult>& results) {
+  std::vector<std::string> names;
+  for (const auto& result : results) names.push_back(result.name);
+  return names;
+}
+
+}  // namespace
+
+DAEMONMAKE_TEST(test_runner, runs_tests_in_given_order) {
+  auto cfg{make_config("runs_tests_in_given_order")};
+  cfg.test_jobs = 1;
+  for (const std::string name : {"a", "b", "c"})
+    write_test(cfg, name, "echo " + name + " >> started\n");
+  write_test(cfg, "fails", "echo broken; exit 2\n");
+
+  std::vector<std::string> reported;
+  const std::stop_source stop;
+  const auto results{run_tests(
+      cfg, {"c", "fails", "a", "unbuilt", "b"}, stop.get_token(),
+      [&](const TestResult& result) { reported.push_back(result.name); })};
+
+  const std::vector<std::string> order{"c", "fails", "a", "unbuilt", "b"};
+  CHECK_EQ(names(results), order);
+  CHECK_EQ(reported, order);
+  CHECK_EQ(read_lines(cfg.build_directory / "started"),
+           (std::vector<std::string>{"c", "a", "b"}));
+  CHECK_EQ(results[1].exit_code, 2);
+  CHECK_EQ(results[1].output, "broken\n");
+  CHECK_EQ(results[3].exit_code, 127);
+  CHECK(results[4].passed());
+}
+
+DAEMONMAKE_TEST(test_runner, runs_at_most_test_jobs_at_once) {
+  auto cfg{make_config("runs_at_most_test_jobs_at_once")};
+  cfg.test_jobs = 2;
+  // Each test notes how many tests were running when it started.
+  std::vector<std::string> tests;
+  for (int i{}; i < 6; ++i) {
+    tests.push_back("t" + std::to_string(i));
+    write_test(cfg, tests.back(),
+               "touch running." + tests.back() + "\n"
+               "ls running.* | wc -l >> counts\n"
+               "sleep 0.2\n"
+               "rm running." + tests.back() + "\n");
+  }
+
+  const std::stop_source stop;
+  const auto results{
+      run_tests(cfg, tests, stop.get_token(), [](const TestResult&) {})};
+
+  CHECK_EQ(results.size(), tests.size());
+  const auto counts{read_lines(cfg.build_directory / "counts")};
+  CHECK_EQ(counts.size(), tests.size());
+  for (const auto& count : counts) CHECK(std::stoi(count) <= 2);
+}
+
+DAEMONMAKE_TEST(test_runner, stop_skips_remaining_tests) {
+  auto cfg{make_config("stop_skips_remaining_tests")};
+  cfg.test_jobs = 1;
+  for (const std::string name : {"a", "b", "c"})
+    write_test(cfg, name, "echo " + name + " >> started\n");
+
+  std::stop_source stop;
+  const auto results{run_tests(cfg, {"a", "b", "c"}, stop.get_token(),
+                               [&](const TestResult&) {
+                                 stop.request_stop();
+                               })};
+
+  CHECK_EQ(names(results), std::vector<std::string>{"a"});
+  CHECK_EQ(read_lines(cfg.build_directory / "started"),
+           std::vector<std::string>{"a"});
+}
+
+DAEMONMAKE_TEST(test_runner, stop_kills_running_test) {
+  auto cfg{make_config("stop_kills_running_test")};
+  cfg.test_jobs = 1;
+  write_test(cfg, "slow", "sleep 30\n");
+  write_test(cfg, "next", "touch started\n");
+
+  std::stop_source stop;
+  const std::jthread canceller{[&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds{200});
+    stop.request_stop();
+  }};
+  const auto results{run_tests(cfg, {"slow", "next"}, stop.get_token(),
+                               [](const TestResult&) {})};
+
+  CHECK_EQ(names(results), std::vector<std::string>{"slow"});
+  CHECK(results[0].cancelled());
+  CHECK(!fs::exists(cfg.build_directory / "started"));
+}
+
+}  // namespace daemonmake::test